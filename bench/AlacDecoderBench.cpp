@@ -0,0 +1,136 @@
+#include "AlacDecoder.h"
+#include "../test/AlacCorpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// decodes the stored corpus with each set of kernels and reports the throughput,
+// it needs nothing but the decoder, so it runs anywhere, also without network and audio,
+// it fails if a packet does not decode to its hash or if decoding allocates memory
+
+static atomic<size_t> allocations{ 0 };
+
+// the replaced operators pair malloc and free, which GCC can't see through once they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size)
+{
+    ++allocations;
+
+    if (void* p = malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+static bool Verify(alac::alac_file* decoder, const vector<AlacCorpus::Packet>& packets, vector<int16_t>& pcm)
+{
+    for (size_t i = 0; i < packets.size(); ++i)
+    {
+        int size = 0;
+        alac::decode_frame(decoder, packets[i].data.data(), packets[i].data.size(), pcm.data(), &size);
+
+        if (static_cast<uint32_t>(size) != packets[i].frames * 4 || AlacCorpus::Hash(pcm.data(), size) != packets[i].hash)
+        {
+            fprintf(stderr, "%s: packet %zu does not decode to its hash\n", decoder->kernels->name, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : ALAC_CORPUS;
+
+    vector<AlacCorpus::Packet> packets;
+
+    try
+    {
+        packets = AlacCorpus::Read(path);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    size_t frames = 0;
+
+    for (const auto& packet : packets)
+    {
+        frames += packet.frames;
+    }
+    if (frames == 0)
+    {
+        fprintf(stderr, "%s has no frames\n", path);
+        return 1;
+    }
+    printf("%zu packets, %zu frames from %s\n", packets.size(), frames, path);
+
+    // about a second of work per set of kernels, the fastest of the rounds counts
+    const size_t passes = max<size_t>(1, 44100 / 5 * 60 / frames);
+    const int rounds = 5;
+
+    int result = 0;
+
+    for (const auto* kernels : { &AlacDsp::GetScalarKernels(), &AlacDsp::GetKernels() })
+    {
+        alac::alac_file* decoder = AlacCorpus::CreateDecoder();
+        decoder->kernels = kernels;
+
+        vector<int16_t> pcm(AlacCorpus::MAX_FRAMES * 2);
+
+        if (!Verify(decoder, packets, pcm))
+        {
+            result = 1;
+        }
+        double best = INFINITY;
+        const size_t allocated = allocations;
+
+        for (int round = 0; round < rounds; ++round)
+        {
+            const auto start = chrono::steady_clock::now();
+
+            for (size_t pass = 0; pass < passes; ++pass)
+            {
+                for (const auto& packet : packets)
+                {
+                    int size = 0;
+                    alac::decode_frame(decoder, packet.data.data(), packet.data.size(), pcm.data(), &size);
+                }
+            }
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        const size_t decodeAllocations = allocations - allocated;
+        const double ns = best * 1e9 / (passes * frames);
+
+        printf("%-8s %10.0f frames/s %8.1f ns/frame %8.0f ns/packet %6zu allocations\n",
+            kernels->name, 1e9 / ns, ns, ns * frames / packets.size(), decodeAllocations);
+
+        if (decodeAllocations != 0)
+        {
+            result = 1;
+        }
+        alac::destroy_alac(decoder);
+    }
+    return result;
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "AlacDsp.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace std;
+using namespace string_literals;
+
+static constexpr int FRAMES_PER_PACKET = 352;
+
+// returns the nanoseconds per frame of the fastest round
+template<class Run>
+static double MeasureFrames(Run run, size_t frames, int rounds)
+{
+    double best = INFINITY;
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        const auto start = chrono::steady_clock::now();
+        run();
+        best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+    }
+    return best / frames;
+}
+
+TEST(AlacDspBench, Kernels)
+{
+    const auto& scalar = AlacDsp::GetScalarKernels();
+    const auto& current = AlacDsp::GetKernels();
+
+    // residuals of the size a bit of noise in the music leaves
+    mt19937 random(19);
+    normal_distribution<double> residual(0., 60.);
+
+    vector<int32_t> error(FRAMES_PER_PACKET);
+
+    for (auto& e : error)
+    {
+        e = static_cast<int32_t>(lround(residual(random)));
+    }
+    vector<int32_t> samples(FRAMES_PER_PACKET);
+    vector<int16_t> out(FRAMES_PER_PACKET * 2);
+
+    for (const int order : { 4, 8, 16 })
+    {
+        const auto predict = [&](const AlacDsp::Kernels& kernels)
+        {
+            return MeasureFrames([&]()
+            {
+                for (int packet = 0; packet < 1000; ++packet)
+                {
+                    int16_t coefs[32] = { 160, -190, 170, -130, 80, -30 };
+                    kernels.predict(error.data(), samples.data(), FRAMES_PER_PACKET, 17, coefs, order, 9);
+                }
+            }, 1000 * FRAMES_PER_PACKET, 20);
+        };
+        printf("predictor of order %d: scalar %.1f ns/frame, %s %.1f ns/frame\n", order, predict(scalar), current.name, predict(current));
+    }
+    const auto deinterlace = [&](const AlacDsp::Kernels& kernels)
+    {
+        return MeasureFrames([&]()
+        {
+            for (int packet = 0; packet < 1000; ++packet)
+            {
+                kernels.deinterlace16(samples.data(), error.data(), out.data(), 2, FRAMES_PER_PACKET, 1, 1);
+            }
+        }, 1000 * FRAMES_PER_PACKET, 20);
+    };
+    printf("deinterlace: scalar %.2f ns/frame, %s %.2f ns/frame\n", deinterlace(scalar), current.name, deinterlace(current));
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "crypto.h"
+#include "RaopEndpoint.h"
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+
+#ifndef _WIN32
+#include <openssl/aes.h>
+#endif
+
+using namespace std;
+using namespace string_literals;
+
+// the payload of an audio packet, 352 frames compress to about a kilobyte
+static constexpr size_t PAYLOAD_SIZE = 1036;
+
+// returns the packets per second of the fastest round
+template<class Run>
+static double MeasurePackets(Run run, size_t packets, int rounds)
+{
+    double best = INFINITY;
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        const auto start = chrono::steady_clock::now();
+        run();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return packets / best;
+}
+
+#ifndef _WIN32
+
+// the decryption as it has been before: the low level AES functions, which don't use
+// AES-NI, a lock for every packet and a copy of the packet and of the vector on the stack
+class LegacyAes
+{
+public:
+    LegacyAes(const vector<uint8_t>& key, const vector<uint8_t>& iv)
+        : m_iv{ iv }
+    {
+        AES_set_decrypt_key(key.data(), static_cast<int>(key.size() * 8), &m_key);
+    }
+
+    // returns a byte of the decrypted packet, so the work isn't optimized away
+    unsigned char DecryptPacket(RtpPacket& packet)
+    {
+        const unsigned char* pBuf = packet.getData();
+        const int len = packet.getDataLen();
+
+        unsigned char dest[RAOP_PACKET_MAX_SIZE];
+        const int aeslen = len & ~0xf;
+
+        uint8_t iv[16];
+        memcpy(iv, m_iv.data(), 16);
+        {
+            const lock_guard<mutex> guard(m_mtx);
+            AES_cbc_encrypt(pBuf, dest, aeslen, &m_key, iv, AES_DECRYPT);
+        }
+        memcpy(dest + aeslen, pBuf + aeslen, len - aeslen);
+
+        return dest[0];
+    }
+
+private:
+    AES_KEY m_key;
+    const vector<uint8_t> m_iv;
+    mutex m_mtx;
+};
+
+#endif
+
+TEST(CryptoBench, AesPackets)
+{
+    mt19937 random(21);
+    uniform_int_distribution<int> byte(0, 255);
+
+    vector<uint8_t> key(16);
+    vector<uint8_t> iv(16);
+
+    for (auto& b : key)
+    {
+        b = static_cast<uint8_t>(byte(random));
+    }
+    for (auto& b : iv)
+    {
+        b = static_cast<uint8_t>(byte(random));
+    }
+    RtpPacket packet;
+    packet.resize(RTP_DATA_OFFSET + PAYLOAD_SIZE);
+
+    for (size_t i = 0; i < PAYLOAD_SIZE; ++i)
+    {
+        packet.getData()[i] = static_cast<uint8_t>(byte(random));
+    }
+    const size_t packets = 20000;
+
+    // decrypting the same packet over and over again in place is as much work as decrypting new ones
+    Crypto::Aes aes(key, iv);
+
+    const double current = MeasurePackets([&]()
+    {
+        for (size_t i = 0; i < packets; ++i)
+        {
+            aes.Decrypt(packet.getData(), packet.getData(), PAYLOAD_SIZE & ~0xf);
+        }
+    }, packets, 10);
+
+#ifndef _WIN32
+    LegacyAes legacy(key, iv);
+    volatile unsigned char sink = 0;
+
+    const double before = MeasurePackets([&]()
+    {
+        for (size_t i = 0; i < packets; ++i)
+        {
+            sink = legacy.DecryptPacket(packet);
+        }
+    }, packets, 10);
+
+    printf("AES-CBC of %zu bytes: legacy %.0f packets/s, EVP in place %.0f packets/s (%.1fx)\n",
+        PAYLOAD_SIZE, before, current, current / before);
+#else
+    printf("AES-CBC of %zu bytes: %.0f packets/s\n", PAYLOAD_SIZE, current);
+#endif
+}
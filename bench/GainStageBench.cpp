@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "GainStage.h"
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace string_literals;
+
+// the volume as it was applied to each sample before
+static int16_t ApplyVolumeToChannel(const int16_t in, const double lfVolume, double& e)
+{
+    if (0 == in)
+    {
+        e = 0;
+        return 0;
+    }
+    const double qOut = (static_cast<double>(in) * lfVolume) + e;
+    const int16_t out = static_cast<int16_t>(floor(qOut + 0.5));
+    e = qOut - static_cast<double>(out);
+    return out;
+}
+
+// scales packets of 352 frames over and over,
+// returns the nanoseconds per frame
+template<class Scale>
+static double MeasureScale(Scale scale, size_t rounds)
+{
+    vector<int16_t> packet(352 * 2);
+
+    for (size_t i = 0; i < packet.size(); ++i)
+    {
+        packet[i] = static_cast<int16_t>(lround(20000. * sin(i * 0.01)));
+    }
+    const vector<int16_t> source = packet;
+
+    const auto start = chrono::steady_clock::now();
+
+    for (size_t round = 0; round < rounds; ++round)
+    {
+        // the same content each round, the scaled values would fall to zero
+        memcpy(packet.data(), source.data(), packet.size() * sizeof(int16_t));
+        scale(packet.data(), size_t{ 352 });
+    }
+    const double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    return ns / (rounds * 352.);
+}
+
+TEST(GainStageBench, Throughput)
+{
+    const size_t rounds = 200000;
+    const double db = -12.;
+
+    const double lfVolume = pow(10., db / 20.);
+    double eChannelOne = 0.;
+    double eChannelTwo = 0.;
+
+    const double legacy = MeasureScale([&](int16_t* samples, size_t frames)
+    {
+        for (size_t i = 0; i < frames; ++i)
+        {
+            samples[i * 2] = ApplyVolumeToChannel(samples[i * 2], lfVolume, eChannelOne);
+            samples[i * 2 + 1] = ApplyVolumeToChannel(samples[i * 2 + 1], lfVolume, eChannelTwo);
+        }
+    }, rounds);
+
+    printf("volume per sample with error feedback: %.2f ns per frame\n", legacy);
+
+    for (const auto dither : { GainStage::Dither::none, GainStage::Dither::tpdf, GainStage::Dither::shaped })
+    {
+        GainStage gain(dither);
+        gain.SetGain(db);
+        gain.Reset();
+
+        const double current = MeasureScale([&](int16_t* samples, size_t frames)
+        {
+            gain.Process(samples, frames);
+        }, rounds);
+
+        printf("GainStage with dither %d: %.2f ns per frame (%.1fx)\n", static_cast<int>(dither), current, legacy / current);
+    }
+}
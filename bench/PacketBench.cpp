@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "RaopEndpoint.h"
+#include <chrono>
+
+using namespace std;
+using namespace string_literals;
+
+// the packet as it has been before: 4 KB of storage
+// which are cleared every time it is recycled
+class LegacyRtpPacket
+{
+public:
+    LegacyRtpPacket() noexcept
+    {
+        Init();
+    }
+
+	inline void Init() noexcept
+	{
+		memset(buffer, 0, sizeof(buffer));
+		buffer[0]	= 0x80;
+		bufSize		= RAOP_PACKET_MAX_SIZE;
+	}
+	uint8_t* data() noexcept
+	{
+		return buffer;
+	}
+	void resize(size_t size) noexcept
+	{
+		if (size > bufSize)
+		{
+			memset(buffer + bufSize, 0, size - bufSize);
+		}
+		bufSize = size;
+	}
+
+private:
+	uint8_t buffer[4096];
+	size_t bufSize;
+};
+
+// receive, decode and recycle as it happens to every audio packet
+template<class T>
+static double MeasureRecycle(vector<unique_ptr<T>>& packets, const uint8_t* datagram, size_t len, int rounds)
+{
+    const auto start = chrono::steady_clock::now();
+
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (auto& packet : packets)
+        {
+            memcpy(packet->data(), datagram, len);
+            packet->resize(len);
+            packet->resize(1408);
+            packet->Init();
+        }
+    }
+    const chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(rounds) * packets.size());
+}
+
+TEST(PacketBench, RecycleCost)
+{
+    const int rounds = 20000;
+    const size_t count = 128;
+
+    uint8_t datagram[1024];
+
+    for (size_t i = 0; i < sizeof(datagram); ++i)
+    {
+        datagram[i] = static_cast<uint8_t>(i);
+    }
+    vector<unique_ptr<LegacyRtpPacket>> legacy;
+    vector<unique_ptr<RtpPacket>> current;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        legacy.emplace_back(make_unique<LegacyRtpPacket>());
+        current.emplace_back(make_unique<RtpPacket>());
+    }
+    const double nsLegacy  = MeasureRecycle(legacy, datagram, sizeof(datagram), rounds);
+    const double nsCurrent = MeasureRecycle(current, datagram, sizeof(datagram), rounds);
+
+    printf("packet recycle: legacy %.1f ns/packet, current %.1f ns/packet (sizeof %zu -> %zu bytes)\n", 
+        nsLegacy, nsCurrent, sizeof(LegacyRtpPacket), sizeof(RtpPacket));
+
+    EXPECT_LT(nsCurrent, nsLegacy);
+}
+
+TEST(PacketBench, PoolRoundTrip)
+{
+    const int rounds = 1000000;
+
+    const auto start = chrono::steady_clock::now();
+
+    for (int r = 0; r < rounds; ++r)
+    {
+        auto packet = GetNewPacketFromPool();
+        packet->resize(1408);
+        PutPacketToPool(move(packet));
+    }
+    const chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    printf("packet pool round trip: %.1f ns/packet\n", elapsed.count() / rounds);
+}
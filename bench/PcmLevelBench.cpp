@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "PcmLevel.h"
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace string_literals;
+
+// the scans over each packet before: the optimistic mute and whether it has sound
+static bool ScanLegacy(const int16_t* samples, size_t count) noexcept
+{
+    bool mute = true;
+    const uint32_t* frames = (const uint32_t*) samples;
+
+    for (size_t i = 0; i < count / 2; i++)
+    {
+        if (*frames++)
+        {
+            mute = false;
+            break;
+        }
+    }
+    bool hasSoundData = false;
+
+    for (size_t i = 0; i < count; i += 2)
+    {
+        if (samples[i] || samples[i + 1])
+        {
+            hasSoundData = true;
+            break;
+        }
+    }
+    return !mute && hasSoundData;
+}
+
+// returns the nanoseconds per packet
+template<class Measure>
+static double MeasurePackets(vector<int16_t> packet, Measure measure, size_t rounds)
+{
+    // written each round, so the scans can't be hoisted out of the loop
+    volatile int16_t first = packet[0];
+    size_t sound = 0;
+
+    const auto start = chrono::steady_clock::now();
+
+    for (size_t round = 0; round < rounds; ++round)
+    {
+        packet[0] = first;
+        sound += measure(packet.data(), packet.size()) ? 1 : 0;
+    }
+    const double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    EXPECT_TRUE(sound == 0 || sound == rounds);
+
+    return ns / rounds;
+}
+
+TEST(PcmLevelBench, Throughput)
+{
+    const size_t rounds = 1000000;
+
+    // silence has to be scanned completely, a sine is found at once by the legacy scans
+    vector<int16_t> silence(352 * 2, 0);
+    vector<int16_t> sine(352 * 2);
+
+    for (size_t i = 0; i < sine.size(); ++i)
+    {
+        sine[i] = static_cast<int16_t>(lround(20000. * sin(i * 0.01 + 0.5)));
+    }
+    for (const auto& [name, packet] : { make_pair("silence"s, silence), make_pair("sine"s, sine) })
+    {
+        const double legacy = MeasurePackets(packet, ScanLegacy, rounds);
+        const double current = MeasurePackets(packet, [](const int16_t* samples, size_t count)
+        {
+            return !MeasureLevel(samples, count).silent;
+        }, rounds);
+
+        printf("packet of %s: scans %.0f ns, level with peak and RMS %.0f ns\n", name.c_str(), legacy, current);
+    }
+}
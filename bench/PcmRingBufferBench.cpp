@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "PcmRingBuffer.h"
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace string_literals;
+
+static void Close(BlobStream& pipe)
+{
+    pipe.SetMode(BlobStream::Mode::pipeClosed);
+}
+
+static void Close(PcmRingBuffer& pipe)
+{
+    pipe.Close();
+}
+
+// pushes PCM through a pipe in packets while the reader takes periods,
+// the writer keeps the given level buffered like the start fill does,
+// returns the seconds until the reader got all of it
+template<class Pipe>
+static double MeasureTransfer(Pipe& pipe, size_t level, size_t total)
+{
+    const ULONG packetSize = 1408;
+    const ULONG periodSize = 4096;
+
+    size_t received = 0;
+
+    const auto start = chrono::steady_clock::now();
+
+    thread reader([&]()
+    {
+        vector<uint8_t> period(periodSize);
+        ULONG n = 0;
+
+        while (SUCCEEDED(pipe.Read(period.data(), periodSize, &n)) && n > 0)
+        {
+            received += n;
+        }
+    });
+    const vector<uint8_t> packet(packetSize, 0x55);
+    size_t written = 0;
+
+    while (written < total)
+    {
+        while (pipe.GetSize() > level)
+        {
+            this_thread::yield();
+        }
+        pipe.Write(packet.data(), packetSize, nullptr);
+        written += packetSize;
+    }
+    Close(pipe);
+    reader.join();
+
+    EXPECT_EQ(written, received);
+
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+TEST(PcmRingBufferBench, Throughput)
+{
+    const size_t total = 256 * 1024 * 1024;
+    const size_t bytesPerSecond = 44100 * 4;
+
+    // a short queue and the default start fill of half a second
+    for (const size_t level : { size_t{ 16 * 1024 }, bytesPerSecond / 2 })
+    {
+        SharedPtr<BlobStream> blob = MakeShared<BlobStream>();
+        blob->SetMode(BlobStream::Mode::pipeOpen);
+
+        const double legacy = MeasureTransfer(*blob, level, total);
+
+        SharedPtr<PcmRingBuffer> ring = MakeShared<PcmRingBuffer>(2 * bytesPerSecond * 2);
+
+        const double current = MeasureTransfer(*ring, level, total);
+
+        printf("PCM pipe with %zu bytes buffered: BlobStream %.0f MB/s, PcmRingBuffer %.0f MB/s\n",
+            level, total / legacy / 1e6, total / current / 1e6);
+
+        EXPECT_EQ(0u, ring->GetStats().dropped);
+    }
+}
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include "RaopEndpoint.h"
+#include "sockpp/udp_socket.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace string_literals;
+
+// the resend request as it has been sent before:
+// a new socket is connected for every request
+static bool LegacySendTo(const string& peer, const void* buf, size_t len, USHORT port) noexcept
+{
+    try
+    {
+        sockpp::udp_socket sock;
+
+        if (!sock.connect(sockpp::inet_address(peer, port)))
+        {
+            return false;
+        }
+        return sock.send(buf, len) == static_cast<ssize_t>(len);
+    }
+    catch (...)
+    {
+    }
+    return false;
+}
+
+// stands in for the sender, it answers every resend request with the
+// requested sequence, either to the source of the request or to a fixed port
+class ResendStandIn
+{
+public:
+    explicit ResendStandIn(USHORT replyPort = 0)
+        : m_replyPort{ replyPort }
+    {
+        if (!m_socket.bind(sockpp::inet_address("127.0.0.1"s, 0)))
+        {
+            throw runtime_error("failed to bind stand-in socket");
+        }
+        m_socket.read_timeout(100ms);
+        m_port = sockpp::inet_address(m_socket.address()).port();
+
+        m_thread = thread([this]()
+        {
+            uint8_t request[64];
+
+            while (!m_stop)
+            {
+                sockpp::inet_address from;
+
+                if (m_socket.recv_from(request, sizeof(request), &from) != 8)
+                {
+                    continue;
+                }
+                uint8_t response[RTP_BASE_HEADER_SIZE + RTP_DATA_OFFSET + 16] = { 0 };
+
+                response[0] = 0x80;
+                response[1] = PAYLOAD_TYPE_RESEND_RESPONSE | 0x80;
+                response[RTP_BASE_HEADER_SIZE + 0] = 0x80;
+                response[RTP_BASE_HEADER_SIZE + 1] = PAYLOAD_TYPE_STREAM_DATA;
+                response[RTP_BASE_HEADER_SIZE + 2] = request[4];
+                response[RTP_BASE_HEADER_SIZE + 3] = request[5];
+
+                if (m_replyPort)
+                {
+                    m_socket.send_to(response, sizeof(response), sockpp::inet_address("127.0.0.1"s, m_replyPort));
+                }
+                else
+                {
+                    m_socket.send_to(response, sizeof(response), from);
+                }
+            }
+        });
+    }
+
+    ~ResendStandIn()
+    {
+        m_stop = true;
+        m_thread.join();
+    }
+
+    USHORT GetPort() const noexcept
+    {
+        return m_port;
+    }
+
+private:
+    const USHORT        m_replyPort;
+    sockpp::udp_socket  m_socket;
+    USHORT              m_port = 0;
+    atomic_bool         m_stop{ false };
+    thread              m_thread;
+};
+
+class ResendResponseHandler
+    : public IRtpRequestHandler
+{
+public:
+    void OnRequest(RtpEndpoint*, unique_ptr<RtpPacket>&& packet) override
+    {
+        if (packet->getPayloadType() == PAYLOAD_TYPE_RESEND_RESPONSE && packet->size() >= RTP_BASE_HEADER_SIZE + 4)
+        {
+            lastSeqNo = (packet->data()[RTP_BASE_HEADER_SIZE + 2] << 8) | packet->data()[RTP_BASE_HEADER_SIZE + 3];
+        }
+        PutPacketToPool(move(packet));
+    }
+
+public:
+    atomic_int  lastSeqNo{ -1 };
+};
+
+// round trips in [us] from sending the request until the response is dispatched
+template<class Send>
+static vector<double> MeasureRoundTrips(ResendResponseHandler& handler, Send send, int rounds)
+{
+    vector<double> result;
+    result.reserve(rounds);
+
+    for (int i = 0; i < rounds; ++i)
+    {
+        const uint16_t seq = static_cast<uint16_t>(i);
+
+        uint8_t req[8] = { 0x80, PAYLOAD_TYPE_RESEND_REQUEST | 0x80, 0, 1, 0, 0, 0, 1 };
+        req[4] = seq >> 8;
+        req[5] = seq & 0xff;
+
+        const auto start = chrono::steady_clock::now();
+        const auto timeout = start + 1s;
+
+        if (!send(req, sizeof(req)))
+        {
+            continue;
+        }
+        while (handler.lastSeqNo != seq && chrono::steady_clock::now() < timeout)
+        {
+            this_thread::yield();
+        }
+        if (handler.lastSeqNo == seq)
+        {
+            const chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+            result.push_back(elapsed.count());
+        }
+    }
+    sort(result.begin(), result.end());
+    return result;
+}
+
+static void Print(const char* name, const vector<double>& us, int rounds)
+{
+    if (us.empty())
+    {
+        printf("%s: no responses\n", name);
+        return;
+    }
+    double sum = 0.;
+
+    for (const double v : us)
+    {
+        sum += v;
+    }
+    printf("%s: %zu/%d answered, mean %.1f us, p50 %.1f us, p99 %.1f us\n", name, us.size(), rounds,
+        sum / us.size(), us[us.size() / 2], us[(us.size() * 99) / 100]);
+}
+
+TEST(ResendBench, RoundTrip)
+{
+    const int rounds = 2000;
+
+    ResendResponseHandler handler;
+    RtpEndpoint control(&handler, "127.0.0.1"s);
+
+    // the sender has to answer to the advertised control port
+    // because the legacy request came from an ephemeral port
+    {
+        ResendStandIn standIn(control.GetPort());
+
+        const auto legacy = MeasureRoundTrips(handler, [&](const void* buf, size_t len)
+        {
+            return LegacySendTo("127.0.0.1"s, buf, len, standIn.GetPort());
+        }, rounds);
+
+        Print("resend round trip, socket per request", legacy, rounds);
+    }
+    // answers to the source of the request arrive at the control endpoint
+    {
+        ResendStandIn standIn;
+
+        const auto current = MeasureRoundTrips(handler, [&](const void* buf, size_t len)
+        {
+            return control.SendTo(buf, len, standIn.GetPort());
+        }, rounds);
+
+        Print("resend round trip, bound control socket", current, rounds);
+
+        EXPECT_EQ(static_cast<size_t>(rounds), current.size());
+    }
+}
+
+TEST(ResendBench, SendCost)
+{
+    const int rounds = 20000;
+
+    ResendResponseHandler handler;
+    RtpEndpoint control(&handler, "127.0.0.1"s);
+
+    sockpp::udp_socket sink;
+    ASSERT_TRUE(sink.bind(sockpp::inet_address("127.0.0.1"s, 0)));
+    const USHORT port = sockpp::inet_address(sink.address()).port();
+
+    const uint8_t req[8] = { 0x80, PAYLOAD_TYPE_RESEND_REQUEST | 0x80, 0, 1, 0, 0, 0, 1 };
+
+    auto start = chrono::steady_clock::now();
+
+    for (int i = 0; i < rounds; ++i)
+    {
+        LegacySendTo("127.0.0.1"s, req, sizeof(req), port);
+    }
+    const chrono::duration<double, micro> legacy = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+
+    for (int i = 0; i < rounds; ++i)
+    {
+        control.SendTo(req, sizeof(req), port);
+    }
+    const chrono::duration<double, micro> current = chrono::steady_clock::now() - start;
+
+    printf("resend request send cost: socket per request %.2f us, bound control socket %.2f us\n",
+        legacy.count() / rounds, current.count() / rounds);
+
+    EXPECT_LT(current.count(), legacy.count());
+}
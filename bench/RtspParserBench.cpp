@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include "RtspParser.h"
+#include "Trim.h"
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <regex>
+
+using namespace std;
+using namespace string_literals;
+
+// the parsing as it has been before: a regular expression built for each call
+template<class _Pr>
+static bool LegacyParseRegEx(const string& strToParse, const string& strRegExp, _Pr _Pred)
+{
+    const regex e(strRegExp);
+
+    sregex_token_iterator i(strToParse.cbegin(), strToParse.cend(), e);
+    const sregex_token_iterator end;
+
+    if (i != end)
+    {
+        do
+        {
+            if (!_Pred(*i))
+            {
+                break;
+            }
+        } while (++i != end);
+
+        return true;
+    }
+    return false;
+}
+
+// the key value pairs of text/parameters and of the SDP attributes the way RaopServer took them
+static map<string, string> LegacyParse(const string& body, const string& lineRegEx, bool attributes)
+{
+    map<string, string> mapKeyValue;
+
+    LegacyParseRegEx(body, lineRegEx, [&](string s) -> bool
+        {
+            string strLeft;
+            string strRight;
+
+            const auto item = attributes ? s.substr(s.find('=') + 1) : s;
+
+            if (!LegacyParseRegEx(item, "[^[:space:]:]+"s, [&strLeft](string t) -> bool
+                {
+                    strLeft = move(t);
+                    return false;
+                }))
+            {
+                return false;
+            }
+            if (!LegacyParseRegEx(item, ":[^\r\n]+"s, [&strRight](string t) -> bool
+                {
+                    Trim(t, " \t\r\n:"s);
+                    strRight = move(t);
+                    return false;
+                }))
+            {
+                return false;
+            }
+            mapKeyValue[strLeft] = move(strRight);
+            return true;
+        });
+    return mapKeyValue;
+}
+
+// returns the microseconds per call of the fastest round
+template<class Run>
+static double MeasureCalls(Run run, int calls, int rounds)
+{
+    double best = INFINITY;
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        const auto start = chrono::steady_clock::now();
+
+        for (int call = 0; call < calls; ++call)
+        {
+            run();
+        }
+        best = min(best, chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+    return best / calls;
+}
+
+TEST(RtspParserBench, SetParameterVolume)
+{
+    const string body = "volume: -11.123456\r\n";
+    double volume = 0.;
+
+    const double legacy = MeasureCalls([&]()
+    {
+        auto parameters = LegacyParse(body, "[^[:space:]:]+[:space:]*:[^\r\n]+[\r\n]*"s, false);
+        volume += stod(parameters["volume"s]);
+    }, 2000, 5);
+
+    const double current = MeasureCalls([&]()
+    {
+        string_view text(body);
+        string_view key;
+        string_view value;
+
+        while (RtspParser::NextParameter(text, key, value))
+        {
+            if (RtspParser::EqualsNoCase(key, "volume"))
+            {
+                volume += RtspParser::ToDouble(value).value_or(0.);
+            }
+        }
+    }, 200000, 5);
+
+    printf("SET_PARAMETER volume: regex %.2f us, string_view %.3f us (%.0fx)\n", legacy, current, legacy / current);
+    EXPECT_NE(0., volume);
+}
+
+TEST(RtspParserBench, Announce)
+{
+    const string body =
+        "v=0\r\n"
+        "o=iTunes 3413821438 0 IN IP4 fe80::217:f2ff:fe0f:e0f6\r\n"
+        "s=iTunes\r\n"
+        "c=IN IP4 fe80::5a55:caff:fe1a:e187\r\n"
+        "t=0 0\r\n"
+        "m=audio 0 RTP/AVP 96\r\n"
+        "a=rtpmap:96 AppleLossless\r\n"
+        "a=fmtp:96 352 0 16 40 10 14 2 255 0 0 44100\r\n"
+        "a=rsaaeskey:VjVbxWcmYgbBbhwBNlCh3K0CMNtWoB844BuiHGUJT51zQS7SDpMnlbBIobsKbfEJ3SCgWHRXjYWf7VQWRYtEcfx7ejA8xDIk5PSB"
+        "YTvXP5dU2QoGrSBv0leDS6uxlEWuxBq3lIxCxpWO2YswHYKJBt06Uz9P2Fq2hDUwl3qOQ8oXb0OateTKtfXEwHJMprkhsJsGDrIc5W5NJFMA"
+        "v6zZWlXuHEwAi==\r\n"
+        "a=aesiv:zcZmAZtqh7uGcEwPXk0QeA==\r\n";
+
+    size_t found = 0;
+
+    const double legacy = MeasureCalls([&]()
+    {
+        auto attributes = LegacyParse(body, "a[:space:]*=[:space:]*[^[:space:]:]+[:space:]*:[^\r\n]+[\r\n]+"s, true);
+        found += attributes["fmtp"s].size();
+    }, 200, 5);
+
+    const double current = MeasureCalls([&]()
+    {
+        string_view sdp(body);
+        string_view key;
+        string_view value;
+
+        while (RtspParser::NextAttribute(sdp, key, value))
+        {
+            if (RtspParser::EqualsNoCase(key, "fmtp"))
+            {
+                found += value.size();
+            }
+        }
+    }, 50000, 5);
+
+    printf("ANNOUNCE: regex %.2f us, string_view %.3f us (%.0fx)\n", legacy, current, legacy / current);
+    EXPECT_NE(0u, found);
+}
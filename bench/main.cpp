@@ -0,0 +1,11 @@
+#include <gtest/gtest.h>
+
+
+int main(int argc, char** argv)
+{
+	// Initialize GoogleTest
+	::testing::InitGoogleTest(&argc, argv);
+
+	// Execute the benchmarks
+	return RUN_ALL_TESTS();
+}
\ No newline at end of file
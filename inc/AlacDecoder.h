@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "AlacDsp.h"
+
+// the ALAC decoder, a library of its own which needs spdlog only,
+// so it is tested and benchmarked without a RAOP session
+namespace alac
+{
+    typedef struct alac_file alac_file;
+
+    // the setup is filled in either from the fmtp values followed by allocate_buffers,
+    // or from the 'alac' atom by alac_set_info, which allocates the buffers as well
+    alac_file *create_alac(int samplesize, int numchannels);
+    void destroy_alac(alac_file* alac) noexcept;
+
+    // decodes one packet to interleaved little endian PCM, outputsize is set to its size
+    // in bytes, the output buffer takes setinfo_max_samples_per_frame frames at least,
+    // it may overlap the packet since the whole packet is read before any sample is written
+    //
+    // the decoder never writes more than setinfo_max_samples_per_frame frames, a frame
+    // which declares more, is cut short or can't be decoded sets outputsize to 0
+    void decode_frame(alac_file *alac,
+                    const unsigned char *inbuffer, size_t insize,
+                    void *outbuffer, int *outputsize);
+    void alac_set_info(alac_file *alac, char *inputbuffer);
+    void allocate_buffers(alac_file *alac);
+
+    struct alac_file
+    {
+        int samplesize;
+        int numchannels;
+        int bytespersample;
+
+        /* the sample loops, the fastest ones the CPU runs unless set otherwise */
+        const AlacDsp::Kernels *kernels;
+
+        /* buffers */
+        int32_t *predicterror_buffer_a;
+        int32_t *predicterror_buffer_b;
+
+        int32_t *outputsamples_buffer_a;
+        int32_t *outputsamples_buffer_b;
+
+        int32_t *uncompressed_bytes_buffer_a;
+        int32_t *uncompressed_bytes_buffer_b;
+
+        /* stuff from setinfo */
+        uint32_t setinfo_max_samples_per_frame; /* 0x1000 = 4096 */    /* max samples per frame? */
+        uint8_t setinfo_7a; /* 0x00 */
+        uint8_t setinfo_sample_size; /* 0x10 */
+        uint8_t setinfo_rice_historymult; /* 0x28 */
+        uint8_t setinfo_rice_initialhistory; /* 0x0a */
+        uint8_t setinfo_rice_kmodifier; /* 0x0e */
+        uint8_t setinfo_7f; /* 0x02 */
+        uint16_t setinfo_80; /* 0x00ff */
+        uint32_t setinfo_82; /* 0x000020e7 */ /* max sample size?? */
+        uint32_t setinfo_86; /* 0x00069fe4 */ /* bit rate (avarge)?? */
+        uint32_t setinfo_8a_rate; /* 0x0000ac44 */
+        /* end setinfo stuff */
+    };
+} // namespace alac
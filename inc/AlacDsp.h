@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// the sample loops of the ALAC decoder after the entropy decoding: the adaptive FIR
+// predictor and the stereo deinterlacing to 16 bits, the scalar kernels are the reference,
+// the vector kernels give the same output bit for bit and are chosen at runtime by the CPU
+namespace AlacDsp
+{
+    // rebuilds the samples from the prediction errors, the coefficients are adapted in place
+    using Predict = void (*)(const int32_t* error, int32_t* out, int size, int sampleSize,
+        int16_t* coefs, int order, int quantization);
+
+    // mid and side or left and right to interleaved 16-bit frames
+    using Deinterlace16 = void (*)(const int32_t* a, const int32_t* b, int16_t* out,
+        int channels, int frames, uint8_t shift, uint8_t leftWeight);
+
+    struct Kernels
+    {
+        const char*     name;
+        Predict         predict;
+        Deinterlace16   deinterlace16;
+    };
+
+    const Kernels& GetScalarKernels() noexcept;
+
+    // the fastest kernels the CPU runs, checked once
+    const Kernels& GetKernels() noexcept;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// reads a big endian bit stream through a 64-bit cache: the cache is refilled
+// from a single unaligned load which needs no branch per bit or per byte, only
+// the last 7 bytes of the input are read one at a time, bits past its end read as zero
+//
+// a refill leaves 56 bits at least, which can be peeked and consumed in any portions;
+// a loop which stores to memory should work on a local copy, so the state stays in registers
+class BitReader
+{
+public:
+    static constexpr int MIN_BITS_AFTER_REFILL = 56;
+
+    BitReader(const uint8_t* data, size_t size) noexcept
+        : m_begin{ data }
+        , m_next{ data }
+        , m_end{ data + size }
+        , m_cache{ 0 }
+        , m_count{ 0 }
+        , m_pastEnd{ 0 }
+    {
+        Refill();
+    }
+
+    static inline int CountLeadingZeros(uint64_t value) noexcept
+    {
+        assert(value != 0);
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - static_cast<int>(index);
+#else
+        return __builtin_clzll(value);
+#endif
+    }
+
+    // tops the cache up to 56 bits at least
+    inline void Refill() noexcept
+    {
+        if (m_end - m_next >= 8)
+        {
+            uint64_t word;
+            memcpy(&word, m_next, sizeof(word));
+
+            // the bytes which are in the cache already are loaded once more and or'ed in place
+            m_cache |= ToBigEndian(word) >> m_count;
+            m_next += (63 - m_count) >> 3;
+            m_count |= 56;
+        }
+        else
+        {
+            RefillTail();
+        }
+    }
+
+    // the next bits without consuming them, 1 to 56 bits after a refill
+    inline uint32_t Peek(int bits) const noexcept
+    {
+        assert(bits > 0 && bits <= 32 && bits <= m_count);
+        return static_cast<uint32_t>(m_cache >> (64 - bits));
+    }
+
+    // the bits which follow the next offset bits
+    inline uint32_t Peek(int offset, int bits) const noexcept
+    {
+        assert(offset >= 0 && bits > 0 && bits <= 32 && offset + bits <= m_count);
+        return static_cast<uint32_t>((m_cache << offset) >> (64 - bits));
+    }
+
+    inline void Skip(int bits) noexcept
+    {
+        assert(bits >= 0 && bits <= m_count);
+        m_cache <<= bits;
+        m_count -= bits;
+    }
+
+    // 1 to 32 bits
+    inline uint32_t Read(int bits) noexcept
+    {
+        Refill();
+        const uint32_t result = Peek(bits);
+        Skip(bits);
+        return result;
+    }
+
+    inline uint32_t ReadBit() noexcept
+    {
+        return Read(1);
+    }
+
+    // the count of leading one bits up to the limit, 1 to 55, they are peeked only
+    inline int PeekOnes(int limit) const noexcept
+    {
+        assert(limit > 0 && limit < m_count);
+        return CountLeadingZeros(~m_cache | (uint64_t{ 1 } << (63 - limit)));
+    }
+
+    // the bits consumed since the start
+    size_t GetPosition() const noexcept
+    {
+        return (static_cast<size_t>(m_next - m_begin) + m_pastEnd) * 8 - m_count;
+    }
+
+private:
+    static inline uint64_t ToBigEndian(uint64_t word) noexcept
+    {
+#ifdef _MSC_VER
+        return _byteswap_uint64(word);
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return word;
+#else
+        return __builtin_bswap64(word);
+#endif
+    }
+
+    void RefillTail() noexcept
+    {
+        while (m_count <= 56)
+        {
+            if (m_next < m_end)
+            {
+                m_cache |= static_cast<uint64_t>(*m_next++) << (56 - m_count);
+            }
+            else
+            {
+                // zeros past the end
+                ++m_pastEnd;
+            }
+            m_count += 8;
+        }
+    }
+
+private:
+    const uint8_t*  m_begin;
+    const uint8_t*  m_next;     // the first byte which is not in the cache completely
+    const uint8_t*  m_end;
+    uint64_t        m_cache;    // the next bits from the top
+    int             m_count;    // the valid bits in the cache
+    size_t          m_pastEnd;  // the bytes of zeros read past the end
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include "definitions.h"
+
+// estimates the drift between the sender's clock and the clock of the audio device:
+// the progress of the RTP timestamps and the frames the device has consumed are
+// both fitted to the local time, the ratio of the two rates is the drift
+//
+// the resampling ratio compensates the drift and corrects the latency error
+// which has built up before the estimate was precise enough
+class DriftEstimator
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Stats
+    {
+        double      drift;          // device rate relative to the sender's rate [ppm]
+        double      ratio;          // resampling ratio
+        int64_t     latencyError;   // buffered frames above the target
+        uint64_t    restarts;
+    };
+
+    explicit DriftEstimator(uint32_t sampleRate);
+
+    DriftEstimator(const DriftEstimator&) = delete;
+    DriftEstimator& operator=(const DriftEstimator&) = delete;
+
+    // the frames up to the RTP timestamp have been handed to the output
+    void OnSource(clock::time_point t, uint32_t rtpTimestamp) noexcept;
+
+    // the device has consumed frames of the output, buffered frames are written but not played yet
+    void OnDevice(clock::time_point t, uint64_t consumed, int64_t buffered) noexcept;
+
+    // output frames per input frame
+    double GetRatio() const noexcept;
+
+    // the drift in ppm as soon as enough observations are known
+    std::optional<double> GetDrift() const noexcept;
+
+    // the streams start over after a pause, the last estimate is kept until a new one is known
+    void Restart() noexcept;
+
+    Stats GetStats() const noexcept;
+
+private:
+    struct Observation
+    {
+        double  seconds;    // since the time base
+        double  frames;
+    };
+
+    // frames per second fitted to the observations (least squares)
+    static std::optional<double> GetRate(const std::deque<Observation>& observations) noexcept;
+
+    double ToSeconds(clock::time_point t) noexcept;
+    void Add(std::deque<Observation>& observations, double seconds, double frames) noexcept;
+    void Update() noexcept;
+
+private:
+    const uint32_t              m_sampleRate;
+
+    std::optional<clock::time_point> m_base;
+
+    std::deque<Observation>     m_source;
+    std::deque<Observation>     m_device;
+
+    std::optional<clock::time_point> m_lastSource;
+    std::optional<clock::time_point> m_lastDevice;
+
+    uint32_t                    m_lastRtp;
+    int64_t                     m_sourceFrames;
+
+    std::optional<uint64_t>     m_firstConsumed;
+
+    std::optional<double>       m_drift;
+    std::optional<double>       m_level;        // smoothed buffered frames
+    std::optional<double>       m_target;       // buffered frames to keep
+    double                      m_ratio;
+
+    uint64_t                    m_restarts;
+};
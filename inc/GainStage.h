@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "definitions.h"
+
+// scales interleaved 16-bit frames by a gain of at most 0 dB: the samples are
+// scaled as floats, dithered and rounded, several frames at once where the CPU
+// supports it (SSE2, NEON), a new gain is reached by a linear ramp over the next buffer
+class GainStage
+{
+public:
+    enum class Dither
+    {
+        none,       // rounded to the nearest value
+        tpdf,       // triangular noise of one LSB peak added before rounding
+        shaped,     // triangular noise and first-order error feedback, one sample at a time
+    };
+
+    explicit GainStage(Dither dither = Dither::tpdf, unsigned int channels = NUM_CHANNELS);
+
+    GainStage(const GainStage&) = delete;
+    GainStage& operator=(const GainStage&) = delete;
+
+    // the gain the next buffer ramps to, a gain above 0 dB throws, one too low
+    // for any sample to round to a non-zero value mutes without dither
+    void SetGain(double db);
+    double GetGain() const noexcept;
+
+    void SetDither(Dither dither) noexcept;
+    Dither GetDither() const noexcept;
+
+    // scales the frames in place, they pass unchanged at 0 dB and become zeros when muted
+    void Process(int16_t* samples, size_t frames) noexcept;
+
+    // the gain is reached without a ramp, the error feedback starts over
+    void Reset() noexcept;
+
+private:
+    template<bool dither>
+    size_t ProcessVector(int16_t* samples, size_t frames, float step) noexcept;
+
+    template<bool dither>
+    void ProcessScalar(int16_t* samples, size_t frames, size_t first, float step) noexcept;
+
+    void ProcessShaped(int16_t* samples, size_t frames, float step) noexcept;
+
+    // triangular noise between -1 and 1
+    float NextDither() noexcept;
+
+private:
+    const unsigned int  m_channels;
+
+    Dither              m_dither;
+    double              m_db;
+
+    // the linear gain of the last frame processed and the one to ramp to
+    float               m_gain;
+    float               m_target;
+
+    // xorshift states, the first four lanes and the last four lanes make up one triangular value
+    alignas(16) uint32_t m_random[8];
+
+    // the quantization error of each channel, fed back by the shaped dither
+    std::vector<float>  m_error;
+};
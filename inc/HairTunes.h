@@ -7,19 +7,48 @@
 #include "Condition.h"
 #include <atomic>
 #include "RaopEndpoint.h"
-#include <list>
+#include "JitterBuffer.h"
+#include "ResendScheduler.h"
+#include "PlayoutClock.h"
+#include <optional>
+#include <chrono>
+#include <future>
 #include "crypto.h"
+#include "audio/PlaySound.h"
+#include "PcmLevel.h"
+#include "SpscQueue.h"
 
 namespace alac
 {
     struct alac_file;
 };
 
+// the parts of a session which don't depend on the keys and the format of its
+// client: the bound endpoints and a decoder with its buffers, they are made ahead
+// of SETUP for a client of the same address family as the peer
+struct SessionResources
+{
+    explicit SessionResources(const std::string& peer);
+    ~SessionResources();
+
+    SessionResources(const SessionResources&) = delete;
+    SessionResources& operator=(const SessionResources&) = delete;
+
+    std::unique_ptr<RtpEndpoint>            controlEndpoint;
+    std::unique_ptr<RtpEndpoint>            dataEndpoint;
+    std::unique_ptr<RtpEndpoint>            timingEndpoint;
+
+    // the buffers take PREWARM_FRAMES_PER_PACKET frames
+    alac::alac_file*                        decoder = nullptr;
+};
+
 class HairTunes
     : public IRtpRequestHandler
 {
 public:
-    HairTunes(const SharedPtr<IValueCollection> config, const SharedPtr<IValueCollection>& client);
+    // takes the resources if they fit the client, otherwise it makes its own
+    HairTunes(const SharedPtr<IValueCollection> config, const SharedPtr<IValueCollection>& client,
+        std::unique_ptr<SessionResources> resources = nullptr);
     ~HairTunes();
 
     unsigned int GetServerPort() const noexcept;
@@ -35,43 +64,89 @@ public:
     bool IsPlaying() const noexcept;
     uint64_t GetSamplingFreq() const noexcept;
 
+    // the time from SETUP until the device started to play
+    std::optional<std::chrono::milliseconds> GetTimeToFirstAudio() const noexcept;
+
+    struct OutputLatency
+    {
+        uint64_t periodFrames;  // zero if the device doesn't tell
+        uint64_t bufferFrames;  // zero if the device doesn't tell
+        uint64_t delayFrames;   // written but not played yet
+    };
+
+    // the buffer of the output device and how much of it is filled, once the device is playing
+    std::optional<OutputLatency> GetOutputLatency() const noexcept;
+
+    // the underruns and suspends of the output device during this session
+    AlsaAudio::XrunStats GetXrunStats() const noexcept;
+
+    // the level of the packet decoded last, for a level meter
+    PcmLevel GetLevel() const noexcept;
+
 protected:
     void OnRequest(RtpEndpoint* endpoint, std::unique_ptr<RtpPacket>&& packet) override;
+    void OnBatchRequest(RtpEndpoint* endpoint, RtpPacketBatch& packets) override;
         
 private:
 
+    // the stages of the pipeline: releasing packets from the jitter buffer,
+    // decrypting and decoding them, processing and writing the samples
     void RunQueue() noexcept;
+    void RunDecode() noexcept;
+    void RunOutput() noexcept;
+    void RunTiming() noexcept;
+
+    void RequestTiming() noexcept;
+    void AnswerTiming(const RtpPacket& request) noexcept;
+    void OnTimingResponse(const RtpPacket& response) noexcept;
+    void OnSync(const RtpPacket& packet) noexcept;
 
     void QueuePacket(std::unique_ptr<RtpPacket>&& p, bool isResendPacket);
+    void QueuePacket(const std::unique_lock<std::mutex>& sync, std::unique_ptr<RtpPacket>&& p, bool isResendPacket);
+    void NotifyQueue(std::unique_lock<std::mutex>& sync) noexcept;
+
+    static bool UnwrapResendResponse(RtpPacket& packet) noexcept;
     	
-    void RequestResend(const USHORT nSeq, const short nCount) noexcept;
-    bool AsyncRequestResend(const std::unique_lock<std::mutex>& sync, const USHORT nSeq, const short nCount) noexcept;
+    bool RequestResend(const USHORT nSeq, const USHORT nCount) noexcept;
+    void ScheduleResend(const std::unique_lock<std::mutex>& sync, const USHORT nSeq, const USHORT nCount) noexcept;
+    ResendScheduler::clock::time_point GetPlayDeadline(const std::unique_lock<std::mutex>& sync, const USHORT nSeq) const noexcept;
+    std::optional<PlayoutClock::clock::time_point> GetReleaseTime(const std::unique_lock<std::mutex>& sync, const USHORT nSeq) const noexcept;
 
-    void AlacDecode(std::unique_ptr<RtpPacket>& packet);
+    void DecryptPacket(RtpPacket& packet);
+    void AlacDecode(RtpPacket& packet);
 
-private:
-    class ResendRequest
+    // a packet handed to the next stage of the pipeline
+    struct StagedPacket
     {
-    public:
-        ResendRequest(const uint16_t _seq, const short _count, std::future<void>&& _async)
-            : seq{ _seq }
-            , count { _count }
-            , async { std::move(_async) }
-        {
-        }
-
-    public:
-        const uint16_t              seq;
-        const short                 count;
-        const std::future<void>     async;
+        std::unique_ptr<RtpPacket>              packet;
+        uint32_t                                timestamp;  // RTP, the decoded samples take the header's place
+        std::chrono::steady_clock::time_point   queued;
     };
-    using ResendRequestPtr = std::unique_ptr<ResendRequest>;
 
+    // the time packets wait for a stage and are processed by it, written by the stage's thread only
+    struct StageLatency
+    {
+        uint64_t                    packets{ 0 };
+        std::chrono::nanoseconds    waiting{ 0 };
+        std::chrono::nanoseconds    processing{ 0 };
+        std::chrono::nanoseconds    maxWaiting{ 0 };
+        std::chrono::nanoseconds    maxProcessing{ 0 };
+
+        void Add(std::chrono::nanoseconds waited, std::chrono::nanoseconds processed) noexcept;
+
+        // on average
+        std::chrono::microseconds GetWaiting() const noexcept;
+        std::chrono::microseconds GetProcessing() const noexcept;
+    };
+
+private:
 	const SharedPtr<IValueCollection>       m_config;
     const SharedPtr<IValueCollection>       m_client;
 
     const std::string                       m_clientID;
     const int                               m_remoteControlPort;
+    const int                               m_remoteTimingPort;
+    const size_t                            m_msStartFill;
 
     int                                     m_frameBytes;
     int                                     m_samplingRate;
@@ -81,6 +156,15 @@ private:
     std::atomic_bool                        m_mute;
 
     std::unique_ptr<std::thread>            m_queueThread;
+    std::unique_ptr<std::thread>            m_decodeThread;
+    std::unique_ptr<std::thread>            m_outputThread;
+    std::unique_ptr<std::thread>            m_timingThread;
+
+    std::mutex                              m_mtxTiming;
+    Condition                               m_condTiming;
+    bool                                    m_stopTiming{ false };
+
+    std::unique_ptr<PlayoutClock>           m_playoutClock;
 
     std::mutex                              m_mtxQueue;
     Condition                               m_condQueue;
@@ -91,17 +175,35 @@ private:
     std::unique_ptr<RtpEndpoint>            m_dataEndpoint;
     std::unique_ptr<RtpEndpoint>            m_timingEndpoint;
 
-    std::list<std::unique_ptr<RtpPacket>>   m_packetQueue;
-    std::list<ResendRequestPtr>             m_asyncResend;
+    ResendScheduler                         m_resendScheduler;
 
     const size_t                            m_lowLevelQueue;
     const size_t                            m_highLevelQueue;
+    JitterBuffer                            m_jitterBuffer;
     
     Crypto::Aes                             m_aes;
-    const std::vector<uint8_t>              m_iv;
+
+    SpscQueue<StagedPacket>                 m_decodeQueue;
+    SpscQueue<StagedPacket>                 m_outputQueue;
+    StageLatency                            m_decodeLatency;
+    StageLatency                            m_outputLatency;
+
+    // the output device has been started, so packets may be released ahead of time
+    std::atomic_bool                        m_outputPlaying{ false };
+
+    // a session torn down in the background may still play what is left,
+    // the output of the next one waits for it to let go of the device
+    std::shared_future<void>                m_previousOutput;
+    std::promise<void>                      m_outputDone;
 
     std::atomic_int64_t                     m_progressData;
     std::atomic_int64_t                     m_pendingData;
 
     std::atomic_bool                        m_isPlaying{ false };
+    std::atomic<PcmLevel>                   m_level;
+
+    const std::shared_ptr<AlsaAudio::PlaybackPosition> m_position{ std::make_shared<AlsaAudio::PlaybackPosition>() };
+
+    const std::chrono::steady_clock::time_point m_setupTime{ std::chrono::steady_clock::now() };
+    std::atomic_int64_t                     m_msFirstAudio{ -1 };
 };
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "RaopEndpoint.h"
+
+// fixed capacity ring of RTP packets indexed by their sequence number,
+// the sequence arithmetic is aware of the 16-bit wraparound
+//
+// all packets are kept within [head, end), slots without a packet are
+// missing; the buffer isn't thread-safe, the owner has to lock it
+class JitterBuffer
+{
+public:
+    enum class InsertResult
+    {
+        queued,     // the packet has been taken
+        duplicate,  // the sequence is queued already
+        late,       // the sequence is older than the head
+        resynced    // the sequence was out of range, the buffer restarted with it
+    };
+
+    explicit JitterBuffer(size_t capacity);
+    ~JitterBuffer();
+
+    JitterBuffer(const JitterBuffer&) = delete;
+    JitterBuffer& operator=(const JitterBuffer&) = delete;
+
+    // the packet is only moved from if it has been taken (queued or resynced)
+    InsertResult Insert(std::unique_ptr<RtpPacket>&& packet);
+
+    // removes the packet at head, which must be present, and advances the head
+    std::unique_ptr<RtpPacket> Pop() noexcept;
+
+    // advances the head to the next present packet and returns the number of skipped sequences
+    uint16_t SkipMissing() noexcept;
+
+    // recycles all packets, the next inserted packet defines the head again
+    void Reset() noexcept;
+
+    // true if the sequence lies within [head, end) and has no packet yet
+    bool IsMissing(uint16_t seq) const noexcept;
+    bool IsPresent(uint16_t seq) const noexcept;
+
+    // number of consecutive missing sequences starting at seq
+    uint16_t GetMissingCount(uint16_t seq) const noexcept;
+
+    // calls fn(seq, count) for every run of missing sequences within [head, end)
+    template<class Fn>
+    void ForEachMissingRun(Fn fn) const
+    {
+        uint16_t seq = m_head;
+
+        while (Distance(seq, m_end) > 0)
+        {
+            const uint16_t count = GetMissingCount(seq);
+
+            if (count > 0)
+            {
+                fn(seq, count);
+                seq += count;
+            }
+            else
+            {
+                ++seq;
+            }
+        }
+    }
+
+    inline const RtpPacket* Front() const noexcept
+    {
+        return m_slots[Index(m_head)].get();
+    }
+
+    // the packet with the sequence number or nullptr if it isn't present
+    inline const RtpPacket* Get(uint16_t seq) const noexcept
+    {
+        return IsPresent(seq) ? m_slots[Index(seq)].get() : nullptr;
+    }
+
+    inline bool IsStarted() const noexcept
+    {
+        return m_started;
+    }
+
+    // number of queued packets
+    inline size_t Size() const noexcept
+    {
+        return m_count;
+    }
+
+    inline bool Empty() const noexcept
+    {
+        return m_count == 0;
+    }
+
+    // number of sequences from head to end including the missing ones
+    inline size_t Span() const noexcept
+    {
+        return static_cast<uint16_t>(m_end - m_head);
+    }
+
+    inline size_t Capacity() const noexcept
+    {
+        return m_slots.size();
+    }
+
+    inline uint16_t GetHeadSeqNo() const noexcept
+    {
+        return m_head;
+    }
+
+    // one past the newest sequence
+    inline uint16_t GetEndSeqNo() const noexcept
+    {
+        return m_end;
+    }
+
+    // signed distance from a to b within the 16-bit sequence space
+    static inline int Distance(uint16_t a, uint16_t b) noexcept
+    {
+        return static_cast<int16_t>(static_cast<uint16_t>(b - a));
+    }
+
+private:
+    inline size_t Index(uint16_t seq) const noexcept
+    {
+        return seq & m_mask;
+    }
+
+    void Restart(uint16_t seq) noexcept;
+
+private:
+    std::vector<std::unique_ptr<RtpPacket>> m_slots;
+    std::vector<uint64_t>                   m_present;
+    const size_t                            m_mask;
+    uint16_t                                m_head;
+    uint16_t                                m_end;
+    size_t                                  m_count;
+    bool                                    m_started;
+};
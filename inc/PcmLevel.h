@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// the level of a block of 16-bit samples, measured in a single pass
+struct PcmLevel
+{
+    float       rms{ 0.f };     // root mean square, 0 to 32768
+    uint16_t    peak{ 0 };      // largest magnitude, 0 to 32767 (-32768 counts as 32767)
+    bool        silent{ true }; // all samples are zero
+
+    // relative to full scale, -inf for silence
+    double GetPeakDb() const noexcept;
+    double GetRmsDb() const noexcept;
+};
+
+// peak, RMS and silence of interleaved samples of all channels,
+// several samples at once where the CPU supports it (SSE2, NEON)
+PcmLevel MeasureLevel(const int16_t* samples, size_t count) noexcept;
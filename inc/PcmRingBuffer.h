@@ -0,0 +1,99 @@
+#pragma once
+
+#include "LayerCake.h"
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+// a fixed size pipe for PCM data from a single writer to a single reader:
+// both sides only share the atomic read and write positions, the mutex is
+// taken only by a side which has to wait for the other one
+//
+// a waiting reader is woken up as soon as the data it asked for, limited by the
+// read watermark, is available, a waiting writer as soon as the fill level has
+// dropped to the level it waits for; a write which doesn't fit is cut off
+class PcmRingBuffer : public RefCount<IStream>
+{
+public:
+    struct Stats
+    {
+        uint64_t written;   // bytes
+        uint64_t read;      // bytes
+        uint64_t dropped;   // bytes which didn't fit
+        uint64_t waits;     // reads which had to wait for data
+    };
+
+    // the capacity is rounded up to a power of two
+    explicit PcmRingBuffer(size_t capacity);
+    ~PcmRingBuffer();
+
+    PcmRingBuffer(const PcmRingBuffer&) = delete;
+    PcmRingBuffer& operator=(const PcmRingBuffer&) = delete;
+
+    size_t GetCapacity() const noexcept;
+
+    // the bytes written but not read yet
+    size_t GetSize() const noexcept;
+
+    // a read waits until this many bytes are available (or all it asked for)
+    void SetReadWatermark(size_t bytes) noexcept;
+
+    // waits until the fill level is at most the given size, returns false on timeout
+    bool WaitForSize(size_t size, std::chrono::milliseconds timeout) noexcept;
+
+    // no more data will be written, the reader gets the rest and the end of the stream
+    void Close() noexcept;
+    bool IsClosed() const noexcept;
+
+    Stats GetStats() const noexcept;
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(const IID& iid, void** ppv) override;
+
+    // blocks until data is available, STG_E_NOMOREFILES after the stream has been closed and read
+    HRESULT STDMETHODCALLTYPE Read(void* pv, ULONG cb, ULONG* pcbRead) override;
+
+    // never blocks, S_FALSE if the data didn't fit completely
+    HRESULT STDMETHODCALLTYPE Write(const void* pv, ULONG cb, ULONG* pcbWritten) override;
+
+    // a pipe can't seek, the position is the number of bytes read
+    HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition) override;
+
+    HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER libNewSize) override;
+    HRESULT STDMETHODCALLTYPE CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten) override;
+    HRESULT STDMETHODCALLTYPE Commit(DWORD grfCommitFlags) override;
+    HRESULT STDMETHODCALLTYPE Revert(void) override;
+    HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) override;
+    HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) override;
+    HRESULT STDMETHODCALLTYPE Stat(STATSTG* pstatstg, DWORD grfStatFlag) override;
+    HRESULT STDMETHODCALLTYPE Clone(IStream** ppstm) override;
+
+private:
+    void NotifyReader() noexcept;
+    void NotifyWriter() noexcept;
+
+private:
+    const size_t                m_capacity;
+    const size_t                m_mask;
+    std::unique_ptr<uint8_t[]>  m_buffer;
+
+    // both positions only grow, their difference is the fill level
+    alignas(64) std::atomic<uint64_t>   m_readPos;
+    alignas(64) std::atomic<uint64_t>   m_writePos;
+
+    std::atomic_bool            m_closed;
+    std::atomic<size_t>         m_readWatermark;
+
+    // the sizes a waiting side waits for, zero if none is waiting
+    std::atomic<size_t>         m_readerWaitsFor;
+    std::atomic<size_t>         m_writerWaitsFor;
+
+    std::mutex                  m_mtx;
+    std::condition_variable     m_readable;
+    std::condition_variable     m_writable;
+
+    std::atomic<uint64_t>       m_dropped;
+    std::atomic<uint64_t>       m_waits;
+};
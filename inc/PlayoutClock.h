@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include "definitions.h"
+
+// maps RTP timestamps of the sender to local points in time:
+// the NTP timing exchange tells the offset between the sender's clock
+// and ours, the sync packets anchor an RTP timestamp to the sender's clock
+//
+// all NTP timestamps are 32.32 fixed point, the local ones are based on
+// the steady clock, so only differences to them are meaningful
+class PlayoutClock
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Stats
+    {
+        std::chrono::nanoseconds    rtt;            // round trip time of the selected sample
+        uint64_t                    timingSamples;  // accepted timing responses
+        uint64_t                    syncs;          // received sync packets
+        uint32_t                    latency;        // sender latency in frames
+    };
+
+    explicit PlayoutClock(uint32_t sampleRate);
+
+    PlayoutClock(const PlayoutClock&) = delete;
+    PlayoutClock& operator=(const PlayoutClock&) = delete;
+
+    static uint64_t ToNtp(clock::time_point t) noexcept;
+    static clock::time_point FromNtp(uint64_t ntp) noexcept;
+
+    static inline uint64_t NowNtp() noexcept
+    {
+        return ToNtp(clock::now());
+    }
+
+    // a timing exchange: reference and arrival are local, received and send are the sender's times,
+    // returns false if the sample is inconsistent
+    bool OnTimingResponse(uint64_t reference, uint64_t received, uint64_t send, uint64_t arrival) noexcept;
+
+    // the frame rtpLessLatency is played at the sender's time remoteNtp, rtpNow is the sender's current frame
+    void OnSync(uint32_t rtpLessLatency, uint64_t remoteNtp, uint32_t rtpNow) noexcept;
+
+    // the stream starts over, the next sync packet defines the anchor again
+    void ResetSync() noexcept;
+
+    // true if the timing offset and a sync anchor are known
+    bool IsSynchronized() const noexcept;
+
+    // local point in time the frame with the RTP timestamp has to be played at
+    std::optional<clock::time_point> GetPlayoutTime(uint32_t rtpTimestamp) const noexcept;
+
+    // the sender's time minus the local time in NTP units (modulo 2^64)
+    std::optional<uint64_t> GetOffset() const noexcept;
+
+    Stats GetStats() const noexcept;
+
+private:
+    struct Sample
+    {
+        uint64_t    offset;
+        int64_t     rtt;
+        bool        valid;
+    };
+
+    std::optional<uint64_t> GetOffset(const std::unique_lock<std::mutex>& sync) const noexcept;
+    const Sample* GetBestSample(const std::unique_lock<std::mutex>& sync) const noexcept;
+
+private:
+    const uint32_t                                      m_sampleRate;
+
+    mutable std::mutex                                  m_mtx;
+
+    // the offset of the sample with the lowest round trip time is the
+    // least disturbed by queueing delays (NTP clock filter)
+    std::array<Sample, PLAYOUT_CLOCK_FILTER_SIZE>       m_samples;
+    size_t                                              m_nextSample;
+
+    bool                                                m_hasAnchor;
+    uint32_t                                            m_anchorRtp;
+    uint64_t                                            m_anchorRemoteNtp;
+
+    Stats                                               m_stats;
+};
@@ -4,6 +4,7 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
 #include "LayerCake.h"
 
 #define RTP_BASE_HEADER_SIZE			0x04
@@ -24,9 +25,18 @@
 // maximum number of bytes in an RAOP audio data packet including headers
 #define RAOP_PACKET_MAX_SIZE			2048
 
+// number of recycled packets the pool can hold and how many of them
+// are being allocated up front
+#define RTP_PACKET_POOL_CAPACITY		1024
+#define RTP_PACKET_POOL_PREALLOC		256
+
+// maximum number of datagrams being received by a single syscall
+#define RTP_RECV_BATCH_SIZE				16
+
 namespace sockpp
 {
     class datagram_socket;
+    class sock_address;
 }
 
 #ifdef _WIN32
@@ -38,16 +48,25 @@ class RtpPacket
 {
 public:
     RtpPacket() noexcept
+		: bufSize{ RAOP_PACKET_MAX_SIZE }
     {
-        Init();
     }
 
+	// makes a recycled packet ready for receiving, the content is
+	// left as it is because every datagram brings its own header
 	inline void Init() noexcept
 	{
-		assert(RAOP_PACKET_MAX_SIZE <= sizeof(buffer));
-		memset(buffer, 0, sizeof(buffer));
+		bufSize = RAOP_PACKET_MAX_SIZE;
+	}
+
+	// clears the header of a packet which is going to be sent
+	inline void InitHeader(const uint8_t payloadType, size_t size = RTP_DATA_OFFSET) noexcept
+	{
+		assert(size >= RTP_BASE_HEADER_SIZE && size <= capacity());
+		memset(buffer, 0, RTP_DATA_OFFSET);
 		buffer[0]	= 0x80;
-		bufSize		= RAOP_PACKET_MAX_SIZE;
+		setPayloadType(payloadType);
+		bufSize		= size;
 	}
 	inline bool getExtension() const noexcept
 	{
@@ -159,6 +178,14 @@ public:
 	{
 		return SWAP16(*(unsigned short*)(&buffer[6]));
 	}
+	inline uint32_t getTimeLessLatency() const noexcept
+	{
+		return SWAP32(*(uint32_t *)(&buffer[4]));
+	}
+	inline uint32_t getRtpSync() const noexcept
+	{
+		return SWAP32(*(uint32_t *)(&buffer[16]));
+	}
 	inline void setTimeLessLatency(uint32_t nVal) noexcept
 	{
 		*(uint32_t *)(&buffer[4]) = SWAP32(nVal);
@@ -179,15 +206,24 @@ public:
 	{
 		return buffer;
 	}
+	const uint8_t* data() const noexcept
+	{
+		return buffer;
+	}
 	size_t size() const noexcept
 	{
 		return bufSize;
 	}
-	void resize(size_t size) noexcept
+	static constexpr size_t capacity() noexcept
 	{
-		assert(size <= sizeof(buffer));
+		return RAOP_PACKET_MAX_SIZE;
+	}
+	// growing leaves the new bytes undefined unless zeroFill is requested
+	void resize(size_t size, bool zeroFill = false) noexcept
+	{
+		assert(size <= capacity());
 
-		if (size > bufSize)
+		if (zeroFill && size > bufSize)
 		{
 			memset(buffer + bufSize, 0, size - bufSize);
 		}
@@ -195,26 +231,70 @@ public:
 	}
 
 private:
-	uint8_t buffer[4096];
+	alignas(16) uint8_t buffer[RAOP_PACKET_MAX_SIZE];
 	size_t bufSize;
 };
 
+struct RtpPacketPoolStats
+{
+	uint64_t	hits;			// packets served from the pool
+	uint64_t	misses;			// packets which had to be allocated
+	int64_t		outstanding;	// packets handed out and not returned yet
+	int64_t		highWaterMark;	// maximum of outstanding packets
+	size_t		available;		// packets ready in the pool
+};
+
+std::unique_ptr<RtpPacket> GetNewPacketFromPool();
 void PutPacketToPool(std::unique_ptr<RtpPacket>&& p);
+RtpPacketPoolStats GetPacketPoolStats() noexcept;
+
+// packets which had been received by one syscall
+using RtpPacketBatch = std::vector<std::unique_ptr<RtpPacket>>;
 
 class RtpEndpoint;
+class RtpReactor;
 
 class IRtpRequestHandler
 {
 public:
 	virtual void OnRequest(RtpEndpoint* endpoint, std::unique_ptr<RtpPacket>&& packet) = 0;
+
+	// the handler may take ownership of any packet in the batch,
+	// the remaining packets will be recycled by the endpoint;
+	// it may destroy other endpoints, but not the one it is called for
+	virtual void OnBatchRequest(RtpEndpoint* endpoint, RtpPacketBatch& packets)
+	{
+		for (auto& packet : packets)
+		{
+			OnRequest(endpoint, std::move(packet));
+		}
+	}
 };
 
+// on Linux all endpoints of the process are served by a single epoll
+// reactor thread, other platforms use one receiving thread per endpoint
+//
+// an endpoint bound ahead of its session has no request handler yet,
+// it drops what it receives until it is attached
 class RtpEndpoint 
 {
+	friend class RtpReactor;
+
 public:
-	RtpEndpoint(IRtpRequestHandler* requestHandler, const std::string& peer);
+	RtpEndpoint(IRtpRequestHandler* requestHandler, const std::string& peer, size_t batchSize = RTP_RECV_BATCH_SIZE);
     ~RtpEndpoint();
 
+	// hands the endpoint to its session, the peer has to be of the same address family
+	void Attach(IRtpRequestHandler* requestHandler, const std::string& peer);
+
+	static bool IsV4(const std::string& peer) noexcept;
+
+	inline bool IsV4() const noexcept
+	{
+		return m_isV4;
+	}
+
+	// sends from the bound port of the endpoint, so answers arrive here
 	bool SendTo(const void* buf, size_t len, USHORT port) noexcept;
 
 	inline uint16_t GetPort() const noexcept
@@ -222,15 +302,42 @@ public:
 		return m_port;
 	}
 
+	inline uint64_t GetReceivedPackets() const noexcept
+	{
+		return m_receivedPackets;
+	}
+
+	inline double GetAverageBatchSize() const noexcept
+	{
+		const uint64_t batches = m_receivedBatches;
+
+		if (batches == 0)
+		{
+			return 0.;
+		}
+		return static_cast<double>(m_receivedPackets) / static_cast<double>(batches);
+	}
+
 private:
     void Run() noexcept;
+	bool Dispatch(bool wait) noexcept;
+	size_t Receive(bool wait);
 
 private:
-	IRtpRequestHandler*	const       			m_requestHandler;
-	const std::string			       			m_peer;
+	std::atomic<IRtpRequestHandler*>			m_requestHandler;
+	std::string									m_peer;
+	const size_t								m_batchSize;
 	bool										m_isV4;
     std::unique_ptr<std::thread>    			m_thread;
+	std::shared_ptr<RtpReactor>					m_reactor;
     std::unique_ptr<sockpp::datagram_socket> 	m_socket;
+	RtpPacketBatch								m_slots;
+	RtpPacketBatch								m_batch;
 	uint16_t									m_port;
+	std::mutex									m_mtxSend;
+	std::unique_ptr<sockpp::sock_address>		m_peerAddr;
+	USHORT										m_peerAddrPort;
 	std::atomic_bool							m_stop;
+	std::atomic_uint64_t						m_receivedPackets;
+	std::atomic_uint64_t						m_receivedBatches;
 };
\ No newline at end of file
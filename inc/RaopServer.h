@@ -3,8 +3,11 @@
 #include <thread>
 #include <memory>
 #include <mutex>
+#include <future>
+#include <vector>
 #include "LayerCake.h"
 #include "DmapParser.h"
+#include "PcmLevel.h"
 
 typedef struct structDacpID
 {
@@ -43,6 +46,7 @@ namespace Crypto
 
 class DnsSD;
 class HairTunes;
+struct SessionResources;
 
 class RaopServer
 	: protected DmapParser
@@ -64,6 +68,9 @@ public:
 	bool GetProgress(int& duration, int& position, std::string& clientID) const noexcept;
 	bool IsPlaying() const noexcept;
 
+	// the level of the audio being decoded, silence without a client
+	PcmLevel GetLevel() const noexcept;
+
 	static int SendDacpCommand(const DacpID& dacpID, const std::string& cmd) noexcept;
 
 	SharedPtr<IValueCollection> GetClient(const std::string& remoteAddr);
@@ -76,6 +83,14 @@ private:
 	SharedPtr<IValueCollection> GetClient(const std::string& remoteAddr, bool create);
 	void RemoveClient(const std::string& remoteAddr) noexcept;
 
+	// makes the resources of the next session in the background
+	void Prewarm(const std::string& peer) noexcept;
+	std::unique_ptr<SessionResources> TakePrewarmed() noexcept;
+
+	// flushes and destroys a session off the request thread
+	void Retire(std::unique_ptr<HairTunes>&& decoder) noexcept;
+	void WaitForRetired() noexcept;
+
 public:
 	const bool								m_metaInfo;
 
@@ -88,6 +103,10 @@ private:
 	const std::unique_ptr<Crypto::Rsa> 		m_rsa;
 	std::unique_ptr<HairTunes>				m_decoder;
 	mutable std::shared_mutex				m_mtxDecoder;
+	std::future<std::unique_ptr<SessionResources>> m_prewarmed;
+	std::mutex								m_mtxPrewarmed;
+	std::vector<std::future<void>>			m_retired;
+	std::mutex								m_mtxRetired;
 	std::atomic_bool						m_serviceDisabled;
 	const SharedPtr<IValueCollection>  		m_clients;
 	IRaopEvents* const						m_raopEvents;
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "definitions.h"
+
+// changes the rate of interleaved 16-bit frames by a ratio close to one:
+// each output frame is interpolated by a Kaiser windowed sinc, its
+// coefficients are taken from a table of phases between two input frames
+//
+// the output is aligned to the input, the last RESAMPLER_TAPS / 2 frames
+// are held back until the frames following them are known
+class Resampler
+{
+public:
+    explicit Resampler(unsigned int channels = NUM_CHANNELS);
+
+    Resampler(const Resampler&) = delete;
+    Resampler& operator=(const Resampler&) = delete;
+
+    // output frames per input frame, a ratio of one passes the frames unchanged
+    void SetRatio(double ratio);
+    double GetRatio() const noexcept;
+
+    // resamples the frames and appends them to out, returns the number of frames appended
+    size_t Process(const int16_t* in, size_t frames, std::vector<int16_t>& out);
+
+    // drops the frames held back, the next input starts over
+    void Reset() noexcept;
+
+    // frames held back from the output
+    static constexpr size_t GetDelay() noexcept
+    {
+        return RESAMPLER_TAPS / 2;
+    }
+
+private:
+    static_assert(RESAMPLER_TAPS % 2 == 0);
+    static_assert((RESAMPLER_PHASES & (RESAMPLER_PHASES - 1)) == 0);
+
+    static const std::vector<float>& GetKernel();
+
+private:
+    const unsigned int      m_channels;
+
+    double                  m_ratio;
+
+    // the input frames per output frame and the position of the
+    // next output frame in the history, both 32.32 fixed point
+    uint64_t                m_step;
+    uint64_t                m_position;
+
+    std::vector<int16_t>    m_history;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Condition.h"
+#include "definitions.h"
+
+// schedules the resend requests of a session on a single worker thread:
+// adjacent missing sequences are coalesced into one request, the requests
+// are rate limited and retried with a backoff derived from the measured
+// round trip time until the packets arrive or their play deadline passes
+class ResendScheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // sends a resend request for [seq, seq + count), returns false on failure
+    using SendRequest = std::function<bool(uint16_t seq, uint16_t count)>;
+
+    struct Stats
+    {
+        uint64_t requested; // sequences scheduled for a resend
+        uint64_t sent;      // request datagrams sent (including retries)
+        uint64_t retried;   // request datagrams which have been retries
+        uint64_t recovered; // sequences which arrived while pending
+        uint64_t tooLate;   // resent sequences which arrived when they weren't needed anymore
+        uint64_t abandoned; // sequences given up without arrival
+    };
+
+    explicit ResendScheduler(SendRequest send, unsigned int maxAttempts = RESEND_MAX_ATTEMPTS,
+        unsigned int maxRequestsPerSecond = RESEND_RATE_LIMIT);
+    ~ResendScheduler();
+
+    ResendScheduler(const ResendScheduler&) = delete;
+    ResendScheduler& operator=(const ResendScheduler&) = delete;
+
+    // schedules [seq, seq + count) which has to arrive before the deadline,
+    // returns the number of sequences which haven't been pending yet
+    size_t Request(uint16_t seq, uint16_t count, clock::time_point deadline);
+
+    // a packet arrived, returns true if its sequence has been pending
+    bool OnArrival(uint16_t seq, bool isResendPacket) noexcept;
+
+    // a resent packet arrived which isn't needed anymore
+    void OnTooLate(uint16_t seq) noexcept;
+
+    // gives up [seq, seq + count), e.g. after the player skipped them
+    void Cancel(uint16_t seq, uint16_t count) noexcept;
+
+    // drops all pending sequences without counting them
+    void Clear() noexcept;
+
+    // stops the worker thread, requests are ignored afterwards
+    void Stop() noexcept;
+
+    bool IsPending(uint16_t seq) const noexcept;
+    size_t GetPendingCount() const noexcept;
+
+    Stats GetStats() const noexcept;
+
+    // smoothed round trip time of the resend requests
+    std::chrono::microseconds GetRoundTripTime() const noexcept;
+
+    // current timeout of a resend request (before backoff)
+    std::chrono::microseconds GetRetransmissionTimeout() const noexcept;
+
+private:
+    struct Entry
+    {
+        clock::time_point   deadline;
+        clock::time_point   nextSend;
+        clock::time_point   lastSent;
+        unsigned int        attempts;
+    };
+    using SeqRun = std::pair<uint16_t, uint16_t>;
+
+    void Run() noexcept;
+
+    // collects the due runs and updates their entries, returns the next point in time to wake up
+    clock::time_point Schedule(clock::time_point now, std::vector<SeqRun>& runs);
+
+    void UpdateRoundTripTime(std::chrono::microseconds sample) noexcept;
+
+private:
+    const SendRequest                       m_send;
+    const unsigned int                      m_maxAttempts;
+    const unsigned int                      m_maxRequestsPerSecond;
+
+    mutable std::mutex                      m_mtx;
+    Condition                               m_cond;
+    std::unordered_map<uint16_t, Entry>     m_pending;
+    std::vector<uint16_t>                   m_due;
+    bool                                    m_stop;
+
+    // token bucket of request datagrams
+    double                                  m_tokens;
+    clock::time_point                       m_lastRefill;
+
+    std::chrono::microseconds               m_srtt;
+    std::chrono::microseconds               m_rttVar;
+    std::chrono::microseconds               m_rto;
+
+    Stats                                   m_stats;
+    std::thread                             m_thread;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <optional>
+#include <string_view>
+
+// the parsers of the RTSP headers and bodies the RAOP server reads: SDP,
+// text/parameters, Transport and the digest authorization, they work on views
+// into the request and allocate nothing, each view passed back points into the text
+//
+// the Next functions take the item off the front of the text, false at its end
+namespace RtspParser
+{
+    // white space as the RTSP headers and bodies have it
+    bool IsSpace(char c) noexcept;
+
+    std::string_view Trim(std::string_view s, std::string_view trimSet = " \t\r\n") noexcept;
+
+    bool EqualsNoCase(std::string_view a, std::string_view b) noexcept;
+
+    // a line without its end, which is "\r\n", "\n" or "\r"
+    bool NextLine(std::string_view& text, std::string_view& line) noexcept;
+
+    // a run of characters other than white space
+    bool NextToken(std::string_view& text, std::string_view& token) noexcept;
+
+    // a run of decimal digits, a number which runs out of 64 bits is skipped
+    bool NextNumber(std::string_view& text, uint64_t& number) noexcept;
+
+    // "key: value" of text/parameters, lines without a key and a colon are skipped
+    bool NextParameter(std::string_view& text, std::string_view& key, std::string_view& value) noexcept;
+
+    // "a=key:value" of SDP, lines of other types are skipped
+    bool NextAttribute(std::string_view& text, std::string_view& key, std::string_view& value) noexcept;
+
+    // key="value" of the digest authorization, separated by commas or white space
+    bool NextQuotedPair(std::string_view& text, std::string_view& key, std::string_view& value) noexcept;
+
+    // the trimmed value of the first SDP line of the type, like 'i' for "i=value"
+    std::optional<std::string_view> FindLine(std::string_view sdp, char type) noexcept;
+
+    // the number of "name=value" in a list separated by semicolons like the Transport header
+    std::optional<int> FindNumber(std::string_view list, std::string_view name) noexcept;
+
+    // the text as a number without anything else around it
+    std::optional<int> ToInt(std::string_view s) noexcept;
+    std::optional<double> ToDouble(std::string_view s) noexcept;
+}
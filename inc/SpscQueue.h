@@ -0,0 +1,172 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// a bounded queue from a single producer to a single consumer, the stages of the
+// audio pipeline hand their packets over by it: both sides only share the atomic
+// read and write positions, the mutex is taken only by a side which has to wait
+//
+// after Close the consumer gets the items which are left, a push fails
+template<class T>
+class SpscQueue
+{
+public:
+    // the capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity)
+        : m_capacity{ RoundUp(capacity) }
+        , m_mask{ m_capacity - 1 }
+        , m_items{ std::make_unique<T[]>(m_capacity) }
+        , m_readPos{ 0 }
+        , m_writePos{ 0 }
+        , m_closed{ false }
+        , m_consumerWaits{ false }
+        , m_producerWaits{ false }
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t GetCapacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    // the items pushed but not popped yet
+    size_t Size() const noexcept
+    {
+        return static_cast<size_t>(m_writePos.load() - m_readPos.load());
+    }
+
+    // never blocks, the value is moved only if there was room for it
+    bool TryPush(T& value)
+    {
+        const uint64_t writePos = m_writePos.load(std::memory_order_relaxed);
+
+        if (m_closed.load(std::memory_order_relaxed) || writePos - m_readPos.load() == m_capacity)
+        {
+            return false;
+        }
+        m_items[writePos & m_mask] = std::move(value);
+        m_writePos.store(writePos + 1);
+
+        // the waiting side publishes that it waits before it checks the level
+        // the last time, the other side checks it after it has changed the level
+        if (m_consumerWaits.load())
+        {
+            std::lock_guard<std::mutex> guard(m_mtx);
+            m_notEmpty.notify_one();
+        }
+        return true;
+    }
+
+    // waits while the queue is full, false if it has been closed, the value is left as it is then
+    bool Push(T&& value)
+    {
+        while (!TryPush(value))
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+
+            if (m_closed)
+            {
+                return false;
+            }
+            m_producerWaits = true;
+            m_notFull.wait(lock, [this]() { return m_closed || Size() < m_capacity; });
+            m_producerWaits = false;
+        }
+        return true;
+    }
+
+    // never blocks
+    bool TryPop(T& value)
+    {
+        const uint64_t readPos = m_readPos.load(std::memory_order_relaxed);
+
+        if (readPos == m_writePos.load())
+        {
+            return false;
+        }
+        value = std::move(m_items[readPos & m_mask]);
+        m_readPos.store(readPos + 1);
+
+        if (m_producerWaits.load())
+        {
+            std::lock_guard<std::mutex> guard(m_mtx);
+            m_notFull.notify_one();
+        }
+        return true;
+    }
+
+    // waits while the queue is empty, false once it has been closed and emptied
+    bool Pop(T& value)
+    {
+        while (!TryPop(value))
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+
+            if (m_closed)
+            {
+                // the items pushed before it was closed
+                lock.unlock();
+                return TryPop(value);
+            }
+            m_consumerWaits = true;
+            m_notEmpty.wait(lock, [this]() { return m_closed || Size() != 0; });
+            m_consumerWaits = false;
+        }
+        return true;
+    }
+
+    // wakes up both sides, either side may close the queue
+    void Close() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mtx);
+            m_closed = true;
+        }
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    bool IsClosed() const noexcept
+    {
+        return m_closed;
+    }
+
+private:
+    static size_t RoundUp(size_t capacity) noexcept
+    {
+        size_t n = 1;
+
+        while (n < capacity)
+        {
+            n <<= 1;
+        }
+        return n;
+    }
+
+private:
+    const size_t                    m_capacity;
+    const size_t                    m_mask;
+    std::unique_ptr<T[]>            m_items;
+
+    alignas(64) std::atomic<uint64_t> m_readPos;
+    alignas(64) std::atomic<uint64_t> m_writePos;
+
+    std::atomic_bool                m_closed;
+
+    // a side which waits for the other one
+    std::atomic_bool                m_consumerWaits;
+    std::atomic_bool                m_producerWaits;
+
+    std::mutex                      m_mtx;
+    std::condition_variable         m_notEmpty;
+    std::condition_variable         m_notFull;
+};
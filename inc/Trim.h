@@ -1,7 +1,6 @@
 #pragma once
 
 #include <string>
-#include <regex>
 #include <algorithm>
 #include <locale>
 
@@ -82,27 +81,4 @@ T ToUpper(T&& s)
             return std::toupper(c);
         });
     return s;
-}
-
-template<class _Pr>
-bool ParseRegEx(const std::string& strToParse, const std::string& strRegExp, _Pr _Pred)
-{
-    const std::regex e(strRegExp);
-
-    std::sregex_token_iterator i(strToParse.cbegin(), strToParse.cend(), e);
-    const std::sregex_token_iterator end;
-
-    if (i != end)
-    {
-        do
-        {
-            if (!_Pred(*i))
-            {
-                break;
-            }
-        } while (++i != end);
-
-        return true;
-    }
-    return false;
 }
\ No newline at end of file
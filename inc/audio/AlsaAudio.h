@@ -9,6 +9,12 @@
 #include <assert.h>
 
 #include <memory>
+#include <functional>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <iostream>
 #include <vector>
 #include <sstream>
@@ -22,6 +28,7 @@
 #include <cmath>
 
 #include "WaveHeader.h"
+#include "PlaySound.h"
 
 namespace AlsaAudio
 {
@@ -53,6 +60,13 @@ namespace AlsaAudio
         double mute();
         double unmute();
 
+        // the control device of the card a PCM device belongs to
+        static std::string card_of(const std::string& pcm_device);
+
+        // sets the volume in dB, on the element's dB scale if it has one and
+        // on the raw range taken as amplitude otherwise, mutes below the range
+        bool set_vol_db(double db);
+
         private:
         int                   err;
         std::string           device_name;
@@ -73,8 +87,12 @@ namespace AlsaAudio
     public:
         HwParams()
         {
-            access_type = SND_PCM_ACCESS_RW_INTERLEAVED;
-            bufsize     = 0;
+            access_type     = SND_PCM_ACCESS_RW_INTERLEAVED;
+            period_time_us  = 0;
+            period_frames   = 0;
+            buffer_time_us  = 0;
+            buffer_frames   = 0;
+            bufsize         = 0;
         }
 
         inline size_t GetBufSize() const
@@ -88,6 +106,15 @@ namespace AlsaAudio
             bufsize = n;
         }
 
+        // the format a device has been asked for, regardless of what has been negotiated
+        inline bool IsSameFormat(const HwParams& other) const
+        {
+            return access_type == other.access_type && format_type == other.format_type && 
+                sample_rate_hz == other.sample_rate_hz && channels == other.channels &&
+                period_frames == other.period_frames && period_time_us == other.period_time_us &&
+                buffer_frames == other.buffer_frames && buffer_time_us == other.buffer_time_us;
+        }
+
         inline void InitFrom(const WaveHeader& wav_hdr)
         {
             // WAV data is always stored in Little-Endian byte order so we choose
@@ -117,6 +144,9 @@ namespace AlsaAudio
             byteRate        = wav_hdr.myData.byteRate;
             bitsPerSample   = wav_hdr.myData.bitsPerSample;
             period_time_us  = 0;
+            period_frames   = 0;
+            buffer_time_us  = 0;
+            buffer_frames   = 0;
         }
 
     public:
@@ -124,7 +154,13 @@ namespace AlsaAudio
         snd_pcm_format_t    format_type;
         unsigned int        sample_rate_hz;
         AudioChannels       channels;
+
+        // requested sizes, zero for the defaults, the negotiated ones after set_hardware_params
         unsigned int        period_time_us;
+        snd_pcm_uframes_t   period_frames;
+        unsigned int        buffer_time_us;
+        snd_pcm_uframes_t   buffer_frames;
+
         unsigned int        byteRate;
         unsigned int        bitsPerSample;
 
@@ -140,12 +176,33 @@ namespace AlsaAudio
 
       int set_hardware_params(HwParams& params);
 
+      const std::string& get_device_name() const;
+
+      // the parameters passed to and returned by set_hardware_params
+      const HwParams& get_requested_params() const;
+      const HwParams& get_hardware_params() const;
+
+      // the interruptions since the last reset
+      const XrunStats& get_xrun_stats() const;
+      void reset_xrun_stats();
+
     protected:
       int xrun_recovery();
 
+      // ends the silence after an interruption once the device runs again,
+      // called after each write
+      void on_running();
+
       int                   err;
+      XrunStats             xrun_stats;
+      std::optional<XrunStats::clock::time_point> interrupted;
+      std::optional<XrunStats::clock::time_point> running_until;   // the device runs dry without further writes
+      HwParams              requested_params;
+      HwParams              negotiated_params;
+      snd_pcm_access_t      access_type;
       unsigned long         frame_size_bytes;
       snd_pcm_uframes_t     period_size_in_frames; // number of frames between interrupts
+      snd_pcm_uframes_t     buffer_size_in_frames;
       std::string           device_name;
       snd_pcm_t*            pcm_handle;
       snd_pcm_hw_params_t*  hw_params;
@@ -156,9 +213,79 @@ namespace AlsaAudio
     public:
       PCMPlayer(std::string hw_device);
 
-    void play_interleaved(const char* buffer, size_t buf_size);
+    // returns the number of frames written
+    size_t play_interleaved(const char* buffer, size_t buf_size);
+
+    // the device buffer is mapped, see play_mmap
+    bool is_mmap() const;
+
+    // fills up to a period of the mapped device buffer with the bytes the callback reads into it,
+    // the callback completes the last frame, returns the frames read and zero at the end,
+    // frames dropped after an underrun are counted in the xrun stats
+    size_t play_mmap(const std::function<size_t(uint8_t* dest, size_t bytes)>& read);
+
+    // how the device restarts after an underrun, zero refill frames for the whole buffer
+    int set_xrun_policy(XrunPolicy policy, snd_pcm_uframes_t refill_frames = 0);
+
     void flush();
 
+    // frames written but not played yet
+    snd_pcm_uframes_t delay();
+
+    // ready for the next stream after a flush
+    bool prepare();
+
+    private:
+      XrunPolicy            xrun_policy;
+      snd_pcm_uframes_t     start_frames;   // buffered before the device starts
+  };
+
+  // keeps the player of the last stream open and prepared after the stream has ended,
+  // the next stream on the same device in the same format takes it over without opening
+  // and configuring the device again; a player which stays idle for too long is closed
+  class DeviceManager
+  {
+  public:
+      struct Stats
+      {
+          uint64_t opened;    // players opened and configured
+          uint64_t reused;    // players taken over from a previous stream
+          uint64_t expired;   // players closed after the idle timeout
+      };
+
+      static DeviceManager& Instance();
+
+      DeviceManager(const DeviceManager&) = delete;
+      DeviceManager& operator=(const DeviceManager&) = delete;
+      ~DeviceManager();
+
+      // a prepared player for the device, params returns what has been negotiated
+      int Acquire(const std::string& device, HwParams& params, std::unique_ptr<PCMPlayer>& player);
+
+      // plays what is left and keeps the player for the next stream
+      void Release(std::unique_ptr<PCMPlayer>&& player);
+
+      void SetIdleTimeout(std::chrono::milliseconds timeout);
+
+      // closes the idle player
+      void Close();
+
+      Stats GetStats() const;
+
+  private:
+      DeviceManager();
+
+      void RunCloser();
+
+  private:
+      mutable std::mutex                      m_mtx;
+      std::condition_variable                 m_cond;
+      std::unique_ptr<PCMPlayer>              m_idle;
+      std::chrono::steady_clock::time_point   m_idleSince;
+      std::chrono::milliseconds               m_idleTimeout;
+      bool                                    m_stop;
+      std::thread                             m_closer;
+      Stats                                   m_stats;
   };
 } 
 
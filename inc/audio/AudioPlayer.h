@@ -38,5 +38,6 @@ public:
 protected:
 	IStream*						m_pAudioData;
 	std::shared_ptr<WavePlayThread>	m_threadWavePlay;
+	unsigned long					m_frameSize;	// bytes per frame, known after Init
 };
 
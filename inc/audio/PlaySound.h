@@ -4,14 +4,119 @@
 #include <string>
 #include <map>
 #include <utility>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdint.h>
 
 struct IStream;
 
 namespace AlsaAudio
 {
+	// what happens after the device ran out of data
+	enum class XrunPolicy
+	{
+		drop,		// the data which couldn't be written is dropped, the device restarts with the next period
+		refill,		// nothing is dropped, the device restarts once the refill watermark is buffered
+	};
+
+	// the buffer sizes asked for from the device, zero leaves the choice to the device
+	struct BufferRequest
+	{
+		uint32_t	periodFrames	= 0;
+		uint32_t	periodTimeUs	= 0;	// if no frames are given
+		uint32_t	bufferFrames	= 0;
+		uint32_t	bufferTimeUs	= 0;	// if no frames are given
+		XrunPolicy	xrunPolicy		= XrunPolicy::refill;
+		uint32_t	refillFrames	= 0;	// zero for the whole buffer
+	};
+
+	// the interruptions of the playback
+	struct XrunStats
+	{
+		using clock = std::chrono::steady_clock;
+
+		uint64_t							underruns		= 0;
+		uint64_t							suspends		= 0;
+		uint64_t							droppedFrames	= 0;	// by the drop policy
+		std::chrono::microseconds			silence{ 0 };			// until the device played again
+		std::optional<clock::time_point>	lastUnderrun;
+		std::optional<clock::time_point>	lastSuspend;
+	};
+
+	// the frames a device has played so far, updated by the player after each write
+	class PlaybackPosition
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		struct Position
+		{
+			uint64_t			played;		// frames written minus the frames still queued in the device
+			uint64_t			delay;		// frames still queued in the device
+			clock::time_point	time;
+		};
+
+		// the sizes the device has chosen
+		struct Buffer
+		{
+			uint64_t			period;		// frames
+			uint64_t			buffer;		// frames
+		};
+
+		void Update(uint64_t written, uint64_t delay) noexcept
+		{
+			std::lock_guard<std::mutex> guard(m_mtx);
+
+			m_position = Position{ written > delay ? written - delay : 0, delay, clock::now() };
+		}
+
+		std::optional<Position> Get() const noexcept
+		{
+			std::lock_guard<std::mutex> guard(m_mtx);
+
+			return m_position;
+		}
+
+		void SetBuffer(uint64_t period, uint64_t buffer) noexcept
+		{
+			std::lock_guard<std::mutex> guard(m_mtx);
+
+			m_buffer = Buffer{ period, buffer };
+		}
+
+		std::optional<Buffer> GetBuffer() const noexcept
+		{
+			std::lock_guard<std::mutex> guard(m_mtx);
+
+			return m_buffer;
+		}
+
+		void SetXruns(const XrunStats& xruns) noexcept
+		{
+			std::lock_guard<std::mutex> guard(m_mtx);
+
+			m_xruns = xruns;
+		}
+
+		XrunStats GetXruns() const noexcept
+		{
+			std::lock_guard<std::mutex> guard(m_mtx);
+
+			return m_xruns;
+		}
+
+	private:
+		mutable std::mutex		m_mtx;
+		std::optional<Position>	m_position;
+		std::optional<Buffer>	m_buffer;
+		XrunStats				m_xruns;
+	};
+
 	std::future<int> Play(std::string file_path, std::string device = "default");
 	std::future<int> Play(const void* buf, size_t bufsize, std::string device = "default");
-	std::future<int> Play(IStream* stream, std::string device = "default");
+	std::future<int> Play(IStream* stream, std::string device = "default", std::shared_ptr<PlaybackPosition> position = nullptr, BufferRequest request = {});
 
 	std::map<std::string, std::string> ListDevices();
 }
\ No newline at end of file
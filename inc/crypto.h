@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
 #include <vector>
 #include <mutex>
 
@@ -19,16 +21,24 @@ namespace Crypto
         mutable std::mutex m_mtx;
     };
 
+    // AES-CBC decryption of the audio packets of one session, it is used by the thread
+    // which decodes the stream only, so it takes no lock, and it runs on AES-NI
+    // or the ARMv8 crypto extension where the CPU has them
     class Aes
     {
     public:
-        Aes(const std::vector<uint8_t>& key);
+        Aes(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
         ~Aes();
 
-        void Decrypt(const unsigned char* in, unsigned char* out, size_t size, uint8_t* iv, size_t ivLen);
-    
+        Aes(const Aes&) = delete;
+        Aes& operator=(const Aes&) = delete;
+
+        // decrypts whole blocks, each call starts over from the initialization vector,
+        // in and out may be the same buffer
+        void Decrypt(const unsigned char* in, unsigned char* out, size_t size);
+
     private:
         void* m_handle;
-        mutable std::mutex m_mtx;
+        uint8_t m_iv[16];
     };
 } // namespace Crypto
\ No newline at end of file
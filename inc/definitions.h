@@ -13,7 +13,50 @@
 #define MAX_DB_VOLUME           0
 #define MIN_DB_VOLUME           (-144)
 
+// capacity of the PCM buffer in front of the player
+#define PCM_BUFFER_MS           (2 * MAX_FILL_MS)
+
 #define LOW_LEVEL_RTP_QUEUE     64
 #define MIN_RTP_LEVEL_OFFSET    64
 
+// minimum number of RTP packets a session can hold (power of two)
+#define JITTER_BUFFER_CAPACITY  1024
+
+// RTP packets decrypted and decoded per lock of the queue and written to the PCM buffer at once
+#define DECODE_BATCH_SIZE       8
+
+// RTP packets between two stages of the pipeline: jitter buffer, decoder and output
+#define PIPELINE_QUEUE_SIZE     64
+
+// frames per packet the decoder of a pre-warmed session is allocated for, the one of AirPlay senders
+#define PREWARM_FRAMES_PER_PACKET   352
+
+// resend requests
+#define RESEND_MAX_ATTEMPTS     3
+#define RESEND_RATE_LIMIT       200     // request datagrams per second
+#define RESEND_BURST            16      // request datagrams sent at once
+#define RESEND_COALESCE_MS      2       // delay to coalesce adjacent gaps
+#define RESEND_INITIAL_RTO_MS   100
+#define RESEND_MIN_RTO_MS       20
+#define RESEND_MAX_RTO_MS       1000
+
+// timing exchange with the sender
+#define PLAYOUT_CLOCK_FILTER_SIZE   8       // timing samples to select the offset from
+#define TIMING_MAX_RTT_MS           1000    // timing samples above are discarded
+#define TIMING_INITIAL_REQUESTS     3       // requests sent quickly at session start
+#define TIMING_INITIAL_INTERVAL_MS  100
+#define TIMING_INTERVAL_MS          3000
+
+// clock drift compensation
+#define DRIFT_MAX_PPM               500     // limit of the rate correction
+#define DRIFT_WINDOW_MS             120000  // observations the drift is estimated from
+#define DRIFT_MIN_WINDOW_MS         10000   // observations needed for a first estimate
+#define DRIFT_SAMPLE_INTERVAL_MS    250
+#define DRIFT_MAX_GAP_MS            1000    // the estimation starts over after a pause
+#define DRIFT_CORRECTION_MS         30000   // time to correct a latency error
+#define RESAMPLER_TAPS              32      // filter length in frames (even)
+#define RESAMPLER_PHASES            256     // filter phases between two frames (power of two)
+#define LOW_LATENCY_PERIOD_FRAMES   256     // output device sizes of the low latency profile
+#define LOW_LATENCY_BUFFER_FRAMES   1024
+
 #define	LOG_FILE_NAME			"ShairportQt.log"
\ No newline at end of file
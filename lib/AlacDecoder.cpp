@@ -0,0 +1,842 @@
+#include "AlacDecoder.h"
+#include "BitReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+
+namespace alac
+{
+/*
+ * ALAC (Apple Lossless Audio Codec) decoder
+ * Copyright (c) 2005 David Hammerton
+ * All rights reserved.
+ *
+ * This is the actual decoder.
+ *
+ * http://crazney.net/programs/itunes/alac.html
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+static const int host_bigendian = 0;
+
+#define _Swap32(v) do { \
+                   v = (((v) & 0x000000FF) << 0x18) | \
+                       (((v) & 0x0000FF00) << 0x08) | \
+                       (((v) & 0x00FF0000) >> 0x08) | \
+                       (((v) & 0xFF000000) >> 0x18); } while(0)
+
+#define _Swap16(v) do { \
+                   v = (((v) & 0x00FF) << 0x08) | \
+                       (((v) & 0xFF00) >> 0x08); } while (0)
+
+struct {signed int x:24;} se_struct_24;
+#define SignExtend24(val) (se_struct_24.x = val)
+
+void allocate_buffers(alac_file *alac)
+{
+    alac->predicterror_buffer_a = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+    alac->predicterror_buffer_b = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+
+    alac->outputsamples_buffer_a = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+    alac->outputsamples_buffer_b = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+
+    alac->uncompressed_bytes_buffer_a = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+    alac->uncompressed_bytes_buffer_b = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+}
+
+static void deallocate_buffers(alac_file *alac) noexcept
+{
+    free(alac->predicterror_buffer_a);
+    free(alac->predicterror_buffer_b);
+
+    free(alac->outputsamples_buffer_a);
+    free(alac->outputsamples_buffer_b);
+
+    free(alac->uncompressed_bytes_buffer_a);
+    free(alac->uncompressed_bytes_buffer_b);
+}
+
+void alac_set_info(alac_file *alac, char *inputbuffer)
+{
+  char *ptr = inputbuffer;
+  ptr += 4; /* size */
+  ptr += 4; /* frma */
+  ptr += 4; /* alac */
+  ptr += 4; /* size */
+  ptr += 4; /* alac */
+
+  ptr += 4; /* 0 ? */
+
+  alac->setinfo_max_samples_per_frame = *(uint32_t*)ptr; /* buffer size / 2 ? */
+  if (!host_bigendian)
+      _Swap32(alac->setinfo_max_samples_per_frame);
+  ptr += 4;
+  alac->setinfo_7a = *(uint8_t*)ptr;
+  ptr += 1;
+  alac->setinfo_sample_size = *(uint8_t*)ptr;
+  ptr += 1;
+  alac->setinfo_rice_historymult = *(uint8_t*)ptr;
+  ptr += 1;
+  alac->setinfo_rice_initialhistory = *(uint8_t*)ptr;
+  ptr += 1;
+  alac->setinfo_rice_kmodifier = *(uint8_t*)ptr;
+  ptr += 1;
+  alac->setinfo_7f = *(uint8_t*)ptr;
+  ptr += 1;
+  alac->setinfo_80 = *(uint16_t*)ptr;
+  if (!host_bigendian)
+      _Swap16(alac->setinfo_80);
+  ptr += 2;
+  alac->setinfo_82 = *(uint32_t*)ptr;
+  if (!host_bigendian)
+      _Swap32(alac->setinfo_82);
+  ptr += 4;
+  alac->setinfo_86 = *(uint32_t*)ptr;
+  if (!host_bigendian)
+      _Swap32(alac->setinfo_86);
+  ptr += 4;
+  alac->setinfo_8a_rate = *(uint32_t*)ptr;
+  if (!host_bigendian)
+      _Swap32(alac->setinfo_8a_rate);
+
+  allocate_buffers(alac);
+
+}
+
+/* stream reading, see BitReader */
+
+/* the count of leading zeros of a 32-bit value, 32 for zero */
+static inline int count_leading_zeros(uint32_t input)
+{
+    return BitReader::CountLeadingZeros((uint64_t{ input } << 32) | 0x80000000u);
+}
+
+#define RICE_THRESHOLD 8 // maximum number of bits for a rice prefix.
+
+static inline int32_t entropy_decode_value(BitReader& bits,
+                             int readSampleSize,
+                             int k,
+                             int rice_kmodifier_mask)
+{
+    // only a corrupt stream leaves this range, it mustn't take the reader past its cache
+    k = clamp(k, 1, 32);
+
+    // the prefix, the raw value or the remainder fit into one refill
+    static_assert(RICE_THRESHOLD + 1 + 32 <= BitReader::MIN_BITS_AFTER_REFILL);
+    bits.Refill();
+
+    // read x, number of 1s before 0 represent the rice value.
+    const int ones = bits.PeekOnes(RICE_THRESHOLD + 1);
+    int32_t x = ones;
+
+    if (ones > RICE_THRESHOLD)
+    {
+        // read the number from the bit stream (raw value)
+        x = bits.Peek(ones, readSampleSize);
+        bits.Skip(ones + readSampleSize);
+    }
+    else if (k == 1)
+    {
+        // the ones and the terminating zero
+        bits.Skip(ones + 1);
+    }
+    else
+    {
+        // the k bits which follow the terminating zero
+        const int extraBits = bits.Peek(ones + 1, k);
+
+        // x = x * (2^k - 1)
+        x *= (((1 << k) - 1) & rice_kmodifier_mask);
+
+        // the lowest bit belongs to the next value unless extraBits > 1
+        const int more = extraBits > 1;
+
+        x += (extraBits - 1) & -more;
+        bits.Skip(ones + k + more);
+    }
+
+    return x;
+}
+
+static void entropy_rice_decode(BitReader& reader,
+                         int32_t* outputBuffer,
+                         int outputSize,
+                         int readSampleSize,
+                         int rice_initialhistory,
+                         int rice_kmodifier,
+                         int rice_historymult,
+                         int rice_kmodifier_mask)
+{
+    int             outputCount;
+    int             history = rice_initialhistory;
+    int             signModifier = 0;
+
+    // a local copy, the stores to the output may alias the reader otherwise
+    BitReader       bits = reader;
+
+    for (outputCount = 0; outputCount < outputSize; outputCount++)
+    {
+        int32_t     decodedValue;
+        int32_t     finalValue;
+        int32_t     k;
+
+        k = 31 - rice_kmodifier - count_leading_zeros((history >> 9) + 3);
+
+        if (k < 0) k += rice_kmodifier;
+        else k = rice_kmodifier;
+
+        // note: don't use rice_kmodifier_mask here (set mask to 0xFFFFFFFF)
+        decodedValue = entropy_decode_value(bits, readSampleSize, k, 0xFFFFFFFF);
+
+        decodedValue += signModifier;
+        finalValue = (decodedValue + 1) / 2; // inc by 1 and shift out sign bit
+        if (decodedValue & 1) // the sign is stored in the low bit
+            finalValue *= -1;
+
+        outputBuffer[outputCount] = finalValue;
+
+        signModifier = 0;
+
+        // update history
+        history += (decodedValue * rice_historymult)
+                - ((history * rice_historymult) >> 9);
+
+        if (decodedValue > 0xFFFF)
+            history = 0xFFFF;
+
+        // special case, for compressed blocks of 0
+        if ((history < 128) && (outputCount + 1 < outputSize))
+        {
+            int32_t     blockSize;
+
+            signModifier = 1;
+
+            k = count_leading_zeros(history) + ((history + 16) / 64) - 24;
+
+            // note: blockSize is always 16bit
+            blockSize = entropy_decode_value(bits, 16, k, rice_kmodifier_mask);
+
+            // got blockSize 0s, no more than fit into the frame
+            blockSize = min(blockSize, outputSize - outputCount - 1);
+
+            if (blockSize > 0)
+            {
+                memset(&outputBuffer[outputCount + 1], 0, blockSize * sizeof(*outputBuffer));
+                outputCount += blockSize;
+            }
+
+            if (blockSize > 0xFFFF)
+                signModifier = 0;
+
+            history = 0;
+        }
+    }
+    reader = bits;
+}
+
+#define SIGN_EXTENDED32(val, bits) ((val << (32 - bits)) >> (32 - bits))
+
+static void deinterlace_24(int32_t *buffer_a, int32_t *buffer_b,
+                    int uncompressed_bytes,
+                    int32_t *uncompressed_bytes_buffer_a, int32_t *uncompressed_bytes_buffer_b,
+                    void *buffer_out,
+                    int numchannels, int numsamples,
+                    uint8_t interlacing_shift,
+                    uint8_t interlacing_leftweight)
+{
+    int i;
+    if (numsamples <= 0) return;
+
+    /* weighted interlacing */
+    if (interlacing_leftweight)
+    {
+        for (i = 0; i < numsamples; i++)
+        {
+            int32_t difference, midright;
+            int32_t left;
+            int32_t right;
+
+            midright = buffer_a[i];
+            difference = buffer_b[i];
+
+            right = midright - ((difference * interlacing_leftweight) >> interlacing_shift);
+            left = right + difference;
+
+            if (uncompressed_bytes)
+            {
+                uint32_t mask = ~(0xFFFFFFFF << (uncompressed_bytes * 8));
+                left <<= (uncompressed_bytes * 8);
+                right <<= (uncompressed_bytes * 8);
+
+                left |= uncompressed_bytes_buffer_a[i] & mask;
+                right |= uncompressed_bytes_buffer_b[i] & mask;
+            }
+
+            ((uint8_t*)buffer_out)[i * numchannels * 3] = (left) & 0xFF;
+            ((uint8_t*)buffer_out)[i * numchannels * 3 + 1] = (left >> 8) & 0xFF;
+            ((uint8_t*)buffer_out)[i * numchannels * 3 + 2] = (left >> 16) & 0xFF;
+
+            ((uint8_t*)buffer_out)[i * numchannels * 3 + 3] = (right) & 0xFF;
+            ((uint8_t*)buffer_out)[i * numchannels * 3 + 4] = (right >> 8) & 0xFF;
+            ((uint8_t*)buffer_out)[i * numchannels * 3 + 5] = (right >> 16) & 0xFF;
+        }
+
+        return;
+    }
+
+    /* otherwise basic interlacing took place */
+    for (i = 0; i < numsamples; i++)
+    {
+        int32_t left, right;
+
+        left = buffer_a[i];
+        right = buffer_b[i];
+
+        if (uncompressed_bytes)
+        {
+            uint32_t mask = ~(0xFFFFFFFF << (uncompressed_bytes * 8));
+            left <<= (uncompressed_bytes * 8);
+            right <<= (uncompressed_bytes * 8);
+
+            left |= uncompressed_bytes_buffer_a[i] & mask;
+            right |= uncompressed_bytes_buffer_b[i] & mask;
+        }
+
+        ((uint8_t*)buffer_out)[i * numchannels * 3] = (left) & 0xFF;
+        ((uint8_t*)buffer_out)[i * numchannels * 3 + 1] = (left >> 8) & 0xFF;
+        ((uint8_t*)buffer_out)[i * numchannels * 3 + 2] = (left >> 16) & 0xFF;
+
+        ((uint8_t*)buffer_out)[i * numchannels * 3 + 3] = (right) & 0xFF;
+        ((uint8_t*)buffer_out)[i * numchannels * 3 + 4] = (right >> 8) & 0xFF;
+        ((uint8_t*)buffer_out)[i * numchannels * 3 + 5] = (right >> 16) & 0xFF;
+
+    }
+
+}
+
+void decode_frame(alac_file *alac,
+                  const unsigned char *inbuffer, size_t insize,
+                  void *outbuffer, int *outputsize)
+{
+    int channels;
+    int32_t outputsamples = alac->setinfo_max_samples_per_frame;
+
+    /* setup the stream */
+    BitReader bits(inbuffer, insize);
+
+    const AlacDsp::Kernels& kernels = *alac->kernels;
+
+    // a rejected frame leaves no output, whatever has been written to the buffer
+    *outputsize = 0;
+
+    // the samples which can be written
+    if (alac->setinfo_sample_size != 16 && alac->setinfo_sample_size != 24)
+    {
+        spdlog::debug("unimplemented sample size {}", alac->setinfo_sample_size);
+        return;
+    }
+
+    channels = bits.Read(3);
+
+    *outputsize = outputsamples * alac->bytespersample;
+
+    switch(channels)
+    {
+    case 0: /* 1 channel */
+    {
+        int hassize;
+        int isnotcompressed;
+        int readsamplesize;
+
+        int uncompressed_bytes;
+        int ricemodifier;
+
+        /* 2^result = something to do with output waiting.
+         * perhaps matters if we read > 1 frame in a pass?
+         */
+        bits.Read(4);
+
+        bits.Read(12); /* unknown, skip 12 bits */
+
+        hassize = bits.Read(1); /* the output sample size is stored soon */
+
+        uncompressed_bytes = bits.Read(2); /* number of bytes in the (compressed) stream that are not compressed */
+
+        isnotcompressed = bits.Read(1); /* whether the frame is compressed */
+
+        if (hassize)
+        {
+            /* now read the number of samples,
+             * as a 32bit integer */
+            outputsamples = bits.Read(32);
+
+            // a corrupt count mustn't take the decoder past its buffers or the output
+            if (outputsamples <= 0 || static_cast<uint32_t>(outputsamples) > alac->setinfo_max_samples_per_frame)
+            {
+                *outputsize = 0;
+                return;
+            }
+            *outputsize = outputsamples * alac->bytespersample;
+        }
+
+        readsamplesize = alac->setinfo_sample_size - (uncompressed_bytes * 8);
+
+        // not a bit of the samples left to be coded
+        if (!isnotcompressed && readsamplesize <= 0)
+        {
+            *outputsize = 0;
+            return;
+        }
+
+        if (!isnotcompressed)
+        { /* so it is compressed */
+            int16_t predictor_coef_table[32];
+            int predictor_coef_num;
+            int prediction_type;
+            int prediction_quantitization;
+            int i;
+
+            /* skip 16 bits, not sure what they are. seem to be used in
+             * two channel case */
+            bits.Read(8);
+            bits.Read(8);
+
+            prediction_type = bits.Read(4);
+            prediction_quantitization = bits.Read(4);
+
+            ricemodifier = bits.Read(3);
+            predictor_coef_num = bits.Read(5);
+
+            /* read the predictor table */
+            for (i = 0; i < predictor_coef_num; i++)
+            {
+                predictor_coef_table[i] = (int16_t)bits.Read(16);
+            }
+
+            if (uncompressed_bytes)
+            {
+                int i;
+                for (i = 0; i < outputsamples; i++)
+                {
+                    alac->uncompressed_bytes_buffer_a[i] = bits.Read(uncompressed_bytes * 8);
+                }
+            }
+
+            entropy_rice_decode(bits,
+                                alac->predicterror_buffer_a,
+                                outputsamples,
+                                readsamplesize,
+                                alac->setinfo_rice_initialhistory,
+                                alac->setinfo_rice_kmodifier,
+                                ricemodifier * alac->setinfo_rice_historymult / 4,
+                                (1 << alac->setinfo_rice_kmodifier) - 1);
+
+            if (prediction_type == 0)
+            { /* adaptive fir */
+                kernels.predict(alac->predicterror_buffer_a,
+                                               alac->outputsamples_buffer_a,
+                                               outputsamples,
+                                               readsamplesize,
+                                               predictor_coef_table,
+                                               predictor_coef_num,
+                                               prediction_quantitization);
+            }
+            else
+            {
+                spdlog::debug( "FIXME: unhandled predicition type: %i\n", prediction_type);
+                /* i think the only other prediction type (or perhaps this is just a
+                 * boolean?) runs adaptive fir twice.. like:
+                 * predictor_decompress_fir_adapt(predictor_error, tempout, ...)
+                 * predictor_decompress_fir_adapt(predictor_error, outputsamples ...)
+                 * little strange..
+                 */
+
+                // the output buffer holds nothing of this frame
+                *outputsize = 0;
+                return;
+            }
+
+        }
+        else
+        { /* not compressed, easy case */
+            if (alac->setinfo_sample_size <= 16)
+            {
+                int i;
+                for (i = 0; i < outputsamples; i++)
+                {
+                    int32_t audiobits = bits.Read(alac->setinfo_sample_size);
+
+                    audiobits = SIGN_EXTENDED32(audiobits, alac->setinfo_sample_size);
+
+                    alac->outputsamples_buffer_a[i] = audiobits;
+                }
+            }
+            else
+            {
+                int i;
+                for (i = 0; i < outputsamples; i++)
+                {
+                    int32_t audiobits;
+
+                    audiobits = bits.Read(16);
+                    /* special case of sign extension..
+                     * as we'll be ORing the low 16bits into this */
+                    audiobits = audiobits << (alac->setinfo_sample_size - 16);
+                    audiobits |= bits.Read(alac->setinfo_sample_size - 16);
+                    audiobits = SignExtend24(audiobits);
+
+                    alac->outputsamples_buffer_a[i] = audiobits;
+                }
+            }
+            uncompressed_bytes = 0; // always 0 for uncompressed
+        }
+
+        switch(alac->setinfo_sample_size)
+        {
+        case 16:
+        {
+            int i;
+            for (i = 0; i < outputsamples; i++)
+            {
+                int16_t sample = alac->outputsamples_buffer_a[i];
+                if (host_bigendian)
+                    _Swap16(sample);
+                ((int16_t*)outbuffer)[i * alac->numchannels] = sample;
+            }
+            break;
+        }
+        case 24:
+        {
+            int i;
+            for (i = 0; i < outputsamples; i++)
+            {
+                int32_t sample = alac->outputsamples_buffer_a[i];
+
+                if (uncompressed_bytes)
+                {
+                    uint32_t mask;
+                    sample = sample << (uncompressed_bytes * 8);
+                    mask = ~(0xFFFFFFFF << (uncompressed_bytes * 8));
+                    sample |= alac->uncompressed_bytes_buffer_a[i] & mask;
+                }
+
+                ((uint8_t*)outbuffer)[i * alac->numchannels * 3] = (sample) & 0xFF;
+                ((uint8_t*)outbuffer)[i * alac->numchannels * 3 + 1] = (sample >> 8) & 0xFF;
+                ((uint8_t*)outbuffer)[i * alac->numchannels * 3 + 2] = (sample >> 16) & 0xFF;
+            }
+            break;
+        }
+        case 20:
+        case 32:
+            spdlog::debug( "FIXME: unimplemented sample size %i\n", alac->setinfo_sample_size);
+            break;
+        default:
+            break;
+        }
+        break;
+    }
+    case 1: /* 2 channels */
+    {
+        // the samples of both channels are interleaved into the output
+        if (alac->numchannels < 2)
+        {
+            *outputsize = 0;
+            return;
+        }
+
+        int hassize;
+        int isnotcompressed;
+        int readsamplesize;
+
+        int uncompressed_bytes;
+
+        uint8_t interlacing_shift;
+        uint8_t interlacing_leftweight;
+
+        /* 2^result = something to do with output waiting.
+         * perhaps matters if we read > 1 frame in a pass?
+         */
+        bits.Read(4);
+
+        bits.Read(12); /* unknown, skip 12 bits */
+
+        hassize = bits.Read(1); /* the output sample size is stored soon */
+
+        uncompressed_bytes = bits.Read(2); /* the number of bytes in the (compressed) stream that are not compressed */
+
+        isnotcompressed = bits.Read(1); /* whether the frame is compressed */
+
+        if (hassize)
+        {
+            /* now read the number of samples,
+             * as a 32bit integer */
+            outputsamples = bits.Read(32);
+
+            // a corrupt count mustn't take the decoder past its buffers or the output
+            if (outputsamples <= 0 || static_cast<uint32_t>(outputsamples) > alac->setinfo_max_samples_per_frame)
+            {
+                *outputsize = 0;
+                return;
+            }
+            *outputsize = outputsamples * alac->bytespersample;
+        }
+
+        readsamplesize = alac->setinfo_sample_size - (uncompressed_bytes * 8) + 1;
+
+        if (!isnotcompressed && readsamplesize <= 0)
+        {
+            *outputsize = 0;
+            return;
+        }
+
+        if (!isnotcompressed)
+        { /* compressed */
+            int16_t predictor_coef_table_a[32];
+            int predictor_coef_num_a;
+            int prediction_type_a;
+            int prediction_quantitization_a;
+            int ricemodifier_a;
+
+            int16_t predictor_coef_table_b[32];
+            int predictor_coef_num_b;
+            int prediction_type_b;
+            int prediction_quantitization_b;
+            int ricemodifier_b;
+
+            int i;
+
+            interlacing_shift = bits.Read(8);
+            interlacing_leftweight = bits.Read(8);
+
+            /******** channel 1 ***********/
+            prediction_type_a = bits.Read(4);
+            prediction_quantitization_a = bits.Read(4);
+
+            ricemodifier_a = bits.Read(3);
+            predictor_coef_num_a = bits.Read(5);
+
+            /* read the predictor table */
+            for (i = 0; i < predictor_coef_num_a; i++)
+            {
+                predictor_coef_table_a[i] = (int16_t)bits.Read(16);
+            }
+
+            /******** channel 2 *********/
+            prediction_type_b = bits.Read(4);
+            prediction_quantitization_b = bits.Read(4);
+
+            ricemodifier_b = bits.Read(3);
+            predictor_coef_num_b = bits.Read(5);
+
+            /* read the predictor table */
+            for (i = 0; i < predictor_coef_num_b; i++)
+            {
+                predictor_coef_table_b[i] = (int16_t)bits.Read(16);
+            }
+
+            /*********************/
+            if (uncompressed_bytes)
+            { /* see mono case */
+                int i;
+                for (i = 0; i < outputsamples; i++)
+                {
+                    alac->uncompressed_bytes_buffer_a[i] = bits.Read(uncompressed_bytes * 8);
+                    alac->uncompressed_bytes_buffer_b[i] = bits.Read(uncompressed_bytes * 8);
+                }
+            }
+
+            /* channel 1 */
+            entropy_rice_decode(bits,
+                                alac->predicterror_buffer_a,
+                                outputsamples,
+                                readsamplesize,
+                                alac->setinfo_rice_initialhistory,
+                                alac->setinfo_rice_kmodifier,
+                                ricemodifier_a * alac->setinfo_rice_historymult / 4,
+                                (1 << alac->setinfo_rice_kmodifier) - 1);
+
+            if (prediction_type_a == 0)
+            { /* adaptive fir */
+                kernels.predict(alac->predicterror_buffer_a,
+                                               alac->outputsamples_buffer_a,
+                                               outputsamples,
+                                               readsamplesize,
+                                               predictor_coef_table_a,
+                                               predictor_coef_num_a,
+                                               prediction_quantitization_a);
+            }
+            else
+            { /* see mono case */
+                spdlog::debug( "FIXME: unhandled predicition type: %i\n", prediction_type_a);
+                *outputsize = 0;
+                return;
+            }
+
+            /* channel 2 */
+            entropy_rice_decode(bits,
+                                alac->predicterror_buffer_b,
+                                outputsamples,
+                                readsamplesize,
+                                alac->setinfo_rice_initialhistory,
+                                alac->setinfo_rice_kmodifier,
+                                ricemodifier_b * alac->setinfo_rice_historymult / 4,
+                                (1 << alac->setinfo_rice_kmodifier) - 1);
+
+            if (prediction_type_b == 0)
+            { /* adaptive fir */
+                kernels.predict(alac->predicterror_buffer_b,
+                                               alac->outputsamples_buffer_b,
+                                               outputsamples,
+                                               readsamplesize,
+                                               predictor_coef_table_b,
+                                               predictor_coef_num_b,
+                                               prediction_quantitization_b);
+            }
+            else
+            {
+                spdlog::debug( "FIXME: unhandled predicition type: %i\n", prediction_type_b);
+                *outputsize = 0;
+                return;
+            }
+        }
+        else
+        { /* not compressed, easy case */
+            if (alac->setinfo_sample_size <= 16)
+            {
+                int i;
+                for (i = 0; i < outputsamples; i++)
+                {
+                    int32_t audiobits_a, audiobits_b;
+
+                    audiobits_a = bits.Read(alac->setinfo_sample_size);
+                    audiobits_b = bits.Read(alac->setinfo_sample_size);
+
+                    audiobits_a = SIGN_EXTENDED32(audiobits_a, alac->setinfo_sample_size);
+                    audiobits_b = SIGN_EXTENDED32(audiobits_b, alac->setinfo_sample_size);
+
+                    alac->outputsamples_buffer_a[i] = audiobits_a;
+                    alac->outputsamples_buffer_b[i] = audiobits_b;
+                }
+            }
+            else
+            {
+                int i;
+                for (i = 0; i < outputsamples; i++)
+                {
+                    int32_t audiobits_a, audiobits_b;
+
+                    audiobits_a = bits.Read(16);
+                    audiobits_a = audiobits_a << (alac->setinfo_sample_size - 16);
+                    audiobits_a |= bits.Read(alac->setinfo_sample_size - 16);
+                    audiobits_a = SignExtend24(audiobits_a);
+
+                    audiobits_b = bits.Read(16);
+                    audiobits_b = audiobits_b << (alac->setinfo_sample_size - 16);
+                    audiobits_b |= bits.Read(alac->setinfo_sample_size - 16);
+                    audiobits_b = SignExtend24(audiobits_b);
+
+                    alac->outputsamples_buffer_a[i] = audiobits_a;
+                    alac->outputsamples_buffer_b[i] = audiobits_b;
+                }
+            }
+            uncompressed_bytes = 0; // always 0 for uncompressed
+            interlacing_shift = 0;
+            interlacing_leftweight = 0;
+        }
+
+        switch(alac->setinfo_sample_size)
+        {
+        case 16:
+        {
+            kernels.deinterlace16(alac->outputsamples_buffer_a,
+                           alac->outputsamples_buffer_b,
+                           (int16_t*)outbuffer,
+                           alac->numchannels,
+                           outputsamples,
+                           interlacing_shift,
+                           interlacing_leftweight);
+            break;
+        }
+        case 24:
+        {
+            deinterlace_24(alac->outputsamples_buffer_a,
+                           alac->outputsamples_buffer_b,
+                           uncompressed_bytes,
+                           alac->uncompressed_bytes_buffer_a,
+                           alac->uncompressed_bytes_buffer_b,
+                           (int16_t*)outbuffer,
+                           alac->numchannels,
+                           outputsamples,
+                           interlacing_shift,
+                           interlacing_leftweight);
+            break;
+        }
+        case 20:
+        case 32:
+            spdlog::debug( "FIXME: unimplemented sample size %i\n", alac->setinfo_sample_size);
+            break;
+        default:
+            break;
+        }
+
+        break;
+    }
+    default:
+        // more channels than an AirPlay stream has
+        *outputsize = 0;
+        return;
+    }
+
+    // a truncated packet has been read on with zeros
+    if (bits.GetPosition() > insize * 8)
+    {
+        *outputsize = 0;
+    }
+}
+
+alac_file *create_alac(int samplesize, int numchannels)
+{
+    alac_file *newfile = (alac_file*)malloc(sizeof(alac_file));
+
+    if (!newfile)
+    {
+        throw bad_alloc();
+    }
+    newfile->samplesize = samplesize;
+    newfile->numchannels = numchannels;
+    newfile->bytespersample = (samplesize / 8) * numchannels;
+    newfile->kernels = &AlacDsp::GetKernels();
+
+    return newfile;
+}
+
+void destroy_alac(alac_file* alac) noexcept
+{
+	deallocate_buffers(alac);
+	free(alac);
+}
+} // namespace alac
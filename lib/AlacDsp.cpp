@@ -0,0 +1,426 @@
+#include "AlacDsp.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <smmintrin.h>
+#define ALAC_DSP_SSE41
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <smmintrin.h>
+#define ALAC_DSP_SSE41
+#define TARGET_SSE41
+#endif
+
+/*
+ * the scalar kernels are taken from the ALAC decoder in AlacDecoder.cpp:
+ *
+ * ALAC (Apple Lossless Audio Codec) decoder
+ * Copyright (c) 2005 David Hammerton
+ * All rights reserved.
+ *
+ * http://crazney.net/programs/itunes/alac.html
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#define SIGN_EXTENDED32(val, bits) ((val << (32 - bits)) >> (32 - bits))
+
+#define SIGN_ONLY(v) \
+                     ((v < 0) ? (-1) : \
+                                ((v > 0) ? (1) : \
+                                           (0)))
+
+static void predictor_decompress_fir_adapt(const int32_t *error_buffer,
+                                           int32_t *buffer_out,
+                                           int output_size,
+                                           int readsamplesize,
+                                           int16_t *predictor_coef_table,
+                                           int predictor_coef_num,
+                                           int predictor_quantitization)
+{
+    int i;
+
+    /* first sample always copies */
+    *buffer_out = *error_buffer;
+
+    if (!predictor_coef_num)
+    {
+        if (output_size <= 1) return;
+        memcpy(buffer_out+1, error_buffer+1, (output_size-1) * 4);
+        return;
+    }
+
+    if (predictor_coef_num == 0x1f) /* 11111 - max value of predictor_coef_num */
+    { /* second-best case scenario for fir decompression,
+       * error describes a small difference from the previous sample only
+       */
+        if (output_size <= 1) return;
+        for (i = 0; i < output_size - 1; i++)
+        {
+            int32_t prev_value;
+            int32_t error_value;
+
+            prev_value = buffer_out[i];
+            error_value = error_buffer[i+1];
+            buffer_out[i+1] = SIGN_EXTENDED32((prev_value + error_value), readsamplesize);
+        }
+        return;
+    }
+
+    /* read warm-up samples */
+    if (predictor_coef_num > 0)
+    {
+        int i;
+        for (i = 0; i < predictor_coef_num; i++)
+        {
+            int32_t val;
+
+            val = buffer_out[i] + error_buffer[i+1];
+
+            val = SIGN_EXTENDED32(val, readsamplesize);
+
+            buffer_out[i+1] = val;
+        }
+    }
+
+    /* general case */
+    if (predictor_coef_num > 0)
+    {
+        for (i = predictor_coef_num + 1;
+             i < output_size;
+             i++)
+        {
+            int j;
+            int sum = 0;
+            int outval;
+            int error_val = error_buffer[i];
+
+            for (j = 0; j < predictor_coef_num; j++)
+            {
+                sum += (buffer_out[predictor_coef_num-j] - buffer_out[0]) *
+                       predictor_coef_table[j];
+            }
+
+            outval = (1 << (predictor_quantitization-1)) + sum;
+            outval = outval >> predictor_quantitization;
+            outval = outval + buffer_out[0] + error_val;
+            outval = SIGN_EXTENDED32(outval, readsamplesize);
+
+            buffer_out[predictor_coef_num+1] = outval;
+
+            if (error_val > 0)
+            {
+                int predictor_num = predictor_coef_num - 1;
+
+                while (predictor_num >= 0 && error_val > 0)
+                {
+                    int val = buffer_out[0] - buffer_out[predictor_coef_num - predictor_num];
+                    int sign = SIGN_ONLY(val);
+
+                    predictor_coef_table[predictor_num] -= sign;
+
+                    val *= sign; /* absolute value */
+
+                    error_val -= ((val >> predictor_quantitization) *
+                                  (predictor_coef_num - predictor_num));
+
+                    predictor_num--;
+                }
+            }
+            else if (error_val < 0)
+            {
+                int predictor_num = predictor_coef_num - 1;
+
+                while (predictor_num >= 0 && error_val < 0)
+                {
+                    int val = buffer_out[0] - buffer_out[predictor_coef_num - predictor_num];
+                    int sign = - SIGN_ONLY(val);
+
+                    predictor_coef_table[predictor_num] -= sign;
+
+                    val *= sign; /* neg value */
+
+                    error_val -= ((val >> predictor_quantitization) *
+                                  (predictor_coef_num - predictor_num));
+
+                    predictor_num--;
+                }
+            }
+
+            buffer_out++;
+        }
+    }
+}
+
+static void deinterlace_16(const int32_t *buffer_a, const int32_t *buffer_b,
+                    int16_t *buffer_out,
+                    int numchannels, int numsamples,
+                    uint8_t interlacing_shift,
+                    uint8_t interlacing_leftweight)
+{
+    int i;
+    if (numsamples <= 0) return;
+
+    /* weighted interlacing */
+    if (interlacing_leftweight)
+    {
+        for (i = 0; i < numsamples; i++)
+        {
+            int32_t difference, midright;
+            int16_t left;
+            int16_t right;
+
+            midright = buffer_a[i];
+            difference = buffer_b[i];
+
+
+            right = midright - ((difference * interlacing_leftweight) >> interlacing_shift);
+            left = right + difference;
+
+            /* output is always little endian */
+            buffer_out[i*numchannels] = left;
+            buffer_out[i*numchannels + 1] = right;
+        }
+
+        return;
+    }
+
+    /* otherwise basic interlacing took place */
+    for (i = 0; i < numsamples; i++)
+    {
+        int16_t left, right;
+
+        left = buffer_a[i];
+        right = buffer_b[i];
+
+        /* output is always little endian */
+        buffer_out[i*numchannels] = left;
+        buffer_out[i*numchannels + 1] = right;
+    }
+}
+
+static const AlacDsp::Kernels SCALAR_KERNELS = { "scalar", predictor_decompress_fir_adapt, deinterlace_16 };
+
+#ifdef ALAC_DSP_SSE41
+
+static bool HasSse41() noexcept
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+// the general case of the predictor for an order which is a multiple of 4: the last samples
+// stay in registers and are shifted by one lane per sample, the coefficients are kept reversed
+// so lane t meets the sample t + 1 after the oldest one, which is also the order the scalar
+// loop adapts them in, the adaption is done by masks: the error left before each lane is
+// a prefix sum, the coefficients are adapted up to the first lane where its sign flips
+template<int ORDER>
+static TARGET_SSE41 void PredictGeneralSse41(const int32_t* error, int32_t* out, int size, int sampleSize,
+    int16_t* coefs, int quantization) noexcept
+{
+    constexpr int GROUPS = ORDER / 4;
+
+    alignas(16) int32_t reversedCoefs[ORDER];
+
+    for (int t = 0; t < ORDER; ++t)
+    {
+        reversedCoefs[t] = coefs[ORDER - 1 - t];
+    }
+    __m128i window[GROUPS];
+    __m128i reversed[GROUPS];
+
+    for (int g = 0; g < GROUPS; ++g)
+    {
+        window[g] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + 1 + g * 4));
+        reversed[g] = _mm_load_si128(reinterpret_cast<const __m128i*>(reversedCoefs + g * 4));
+    }
+    const __m128i ones = _mm_set1_epi32(1);
+    const __m128i allSet = _mm_set1_epi32(-1);
+    const __m128i count = _mm_cvtsi32_si128(quantization);
+    const __m128i extension = _mm_cvtsi32_si128(32 - sampleSize);
+    const __m128i round = _mm_set1_epi32(1 << (quantization - 1));
+
+    // the value stays in the vector unit, it is shifted into the window right away
+    __m128i oldest = _mm_set1_epi32(out[0]);
+
+    for (int i = ORDER + 1; i < size; ++i)
+    {
+        const __m128i errorValue = _mm_set1_epi32(error[i]);
+
+        // the scalar sum of (newer - oldest) * coef is the negated sum of the differences
+        __m128i differences[GROUPS];
+        __m128i products = _mm_setzero_si128();
+
+        for (int g = 0; g < GROUPS; ++g)
+        {
+            differences[g] = _mm_sub_epi32(oldest, window[g]);
+            products = _mm_add_epi32(products, _mm_mullo_epi32(differences[g], reversed[g]));
+        }
+        products = _mm_add_epi32(products, _mm_shuffle_epi32(products, _MM_SHUFFLE(1, 0, 3, 2)));
+        products = _mm_add_epi32(products, _mm_shuffle_epi32(products, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        __m128i value = _mm_sra_epi32(_mm_sub_epi32(round, products), count);
+        value = _mm_add_epi32(value, _mm_add_epi32(oldest, errorValue));
+        value = _mm_sra_epi32(_mm_sll_epi32(value, extension), extension);
+
+        out[i] = _mm_cvtsi128_si32(value);
+
+        // the adaption: a lane is active while the error left has the sign of the error,
+        // that is before > 0 or ~before > -1, nothing is adapted for an error of zero
+        const __m128i negative = _mm_cmpgt_epi32(_mm_setzero_si128(), errorValue);
+        const __m128i sign = _mm_or_si128(negative, ones);
+
+        __m128i remaining = errorValue;
+
+        for (int g = 0; g < GROUPS; ++g)
+        {
+            const __m128i delta = _mm_sign_epi32(_mm_sign_epi32(ones, differences[g]), sign);
+            const __m128i magnitude = _mm_sign_epi32(_mm_abs_epi32(differences[g]), sign);
+            const __m128i multipliers = _mm_setr_epi32(g * 4 + 1, g * 4 + 2, g * 4 + 3, g * 4 + 4);
+            const __m128i step = _mm_mullo_epi32(_mm_sra_epi32(magnitude, count), multipliers);
+
+            __m128i inclusive = _mm_add_epi32(step, _mm_slli_si128(step, 4));
+            inclusive = _mm_add_epi32(inclusive, _mm_slli_si128(inclusive, 8));
+
+            const __m128i before = _mm_sub_epi32(remaining, _mm_sub_epi32(inclusive, step));
+            const __m128i active = _mm_cmpgt_epi32(_mm_xor_si128(before, negative), negative);
+
+            // the scalar loop stops at the first lane which is not active
+            __m128i stopped = _mm_andnot_si128(active, allSet);
+            stopped = _mm_or_si128(stopped, _mm_slli_si128(stopped, 4));
+            stopped = _mm_or_si128(stopped, _mm_slli_si128(stopped, 8));
+
+            // the coefficients wrap around like the 16-bit table does
+            const __m128i adapted = _mm_sub_epi32(reversed[g], _mm_andnot_si128(stopped, delta));
+            reversed[g] = _mm_srai_epi32(_mm_slli_epi32(adapted, 16), 16);
+
+            if (g + 1 == GROUPS || !_mm_testz_si128(stopped, stopped))
+            {
+                break;
+            }
+            remaining = _mm_sub_epi32(remaining, _mm_shuffle_epi32(inclusive, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+        oldest = _mm_shuffle_epi32(window[0], _MM_SHUFFLE(0, 0, 0, 0));
+
+        for (int g = 0; g < GROUPS - 1; ++g)
+        {
+            window[g] = _mm_alignr_epi8(window[g + 1], window[g], 4);
+        }
+        window[GROUPS - 1] = _mm_alignr_epi8(value, window[GROUPS - 1], 4);
+    }
+    for (int g = 0; g < GROUPS; ++g)
+    {
+        _mm_store_si128(reinterpret_cast<__m128i*>(reversedCoefs + g * 4), reversed[g]);
+    }
+    for (int t = 0; t < ORDER; ++t)
+    {
+        coefs[ORDER - 1 - t] = static_cast<int16_t>(reversedCoefs[t]);
+    }
+}
+
+static TARGET_SSE41 void PredictSse41(const int32_t* error, int32_t* out, int size, int sampleSize,
+    int16_t* coefs, int order, int quantization)
+{
+    // the other orders are rare, they take the scalar loop
+    if (order == 0 || order % 4 != 0 || quantization == 0 || size <= order + 1)
+    {
+        predictor_decompress_fir_adapt(error, out, size, sampleSize, coefs, order, quantization);
+        return;
+    }
+    out[0] = error[0];
+
+    for (int i = 0; i < order; ++i)
+    {
+        const int32_t value = static_cast<int32_t>(static_cast<uint32_t>(out[i]) + static_cast<uint32_t>(error[i + 1]));
+        out[i + 1] = static_cast<int32_t>(static_cast<uint32_t>(value) << (32 - sampleSize)) >> (32 - sampleSize);
+    }
+    switch (order)
+    {
+    case 4:  PredictGeneralSse41<4>(error, out, size, sampleSize, coefs, quantization); break;
+    case 8:  PredictGeneralSse41<8>(error, out, size, sampleSize, coefs, quantization); break;
+    case 12: PredictGeneralSse41<12>(error, out, size, sampleSize, coefs, quantization); break;
+    case 16: PredictGeneralSse41<16>(error, out, size, sampleSize, coefs, quantization); break;
+    case 20: PredictGeneralSse41<20>(error, out, size, sampleSize, coefs, quantization); break;
+    case 24: PredictGeneralSse41<24>(error, out, size, sampleSize, coefs, quantization); break;
+    case 28: PredictGeneralSse41<28>(error, out, size, sampleSize, coefs, quantization); break;
+    }
+}
+
+// four frames at a time: the right channel is rebuilt from mid and side, both are
+// interleaved, truncated to 16 bits like the scalar cast and packed
+static TARGET_SSE41 void Deinterlace16Sse41(const int32_t* a, const int32_t* b, int16_t* out,
+    int channels, int frames, uint8_t shift, uint8_t leftWeight)
+{
+    int i = 0;
+
+    if (channels == 2 && shift < 32)
+    {
+        const __m128i weight = _mm_set1_epi32(leftWeight);
+        const __m128i count = _mm_cvtsi32_si128(shift);
+
+        for (; i + 4 <= frames; i += 4)
+        {
+            __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+            if (leftWeight)
+            {
+                const __m128i difference = right;
+
+                right = _mm_sub_epi32(left, _mm_sra_epi32(_mm_mullo_epi32(difference, weight), count));
+                left = _mm_add_epi32(right, difference);
+            }
+            const __m128i low = _mm_unpacklo_epi32(left, right);
+            const __m128i high = _mm_unpackhi_epi32(left, right);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_packs_epi32(
+                _mm_srai_epi32(_mm_slli_epi32(low, 16), 16),
+                _mm_srai_epi32(_mm_slli_epi32(high, 16), 16)));
+        }
+    }
+    deinterlace_16(a + i, b + i, out + i * channels, channels, frames - i, shift, leftWeight);
+}
+
+static const AlacDsp::Kernels SSE41_KERNELS = { "sse4.1", PredictSse41, Deinterlace16Sse41 };
+
+#endif
+
+const AlacDsp::Kernels& AlacDsp::GetScalarKernels() noexcept
+{
+    return SCALAR_KERNELS;
+}
+
+const AlacDsp::Kernels& AlacDsp::GetKernels() noexcept
+{
+#ifdef ALAC_DSP_SSE41
+    static const Kernels& kernels = HasSse41() ? SSE41_KERNELS : SCALAR_KERNELS;
+    return kernels;
+#else
+    return SCALAR_KERNELS;
+#endif
+}
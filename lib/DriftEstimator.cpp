@@ -0,0 +1,189 @@
+#include "DriftEstimator.h"
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr double PPM = 1e6;
+
+// the buffered frames change with every write and every period, their mean is taken
+static constexpr double LEVEL_SMOOTHING_S = 2.;
+
+DriftEstimator::DriftEstimator(uint32_t sampleRate)
+    : m_sampleRate{ sampleRate }
+    , m_lastRtp{ 0 }
+    , m_sourceFrames{ 0 }
+    , m_ratio{ 1. }
+    , m_restarts{ 0 }
+{
+    assert(m_sampleRate > 0);
+}
+
+void DriftEstimator::OnSource(clock::time_point t, uint32_t rtpTimestamp) noexcept
+{
+    if (m_lastSource && t - *m_lastSource > milliseconds(DRIFT_MAX_GAP_MS))
+    {
+        Restart();
+    }
+    if (m_lastSource)
+    {
+        const int64_t frames = static_cast<int32_t>(rtpTimestamp - m_lastRtp);
+
+        if (frames < 0 || frames > static_cast<int64_t>(m_sampleRate) * DRIFT_MAX_GAP_MS / 1000)
+        {
+            // the sender skipped to another position
+            Restart();
+        }
+        else
+        {
+            m_sourceFrames += frames;
+        }
+    }
+    if (!m_lastSource)
+    {
+        m_sourceFrames = 0;
+    }
+    m_lastSource    = t;
+    m_lastRtp       = rtpTimestamp;
+
+    Add(m_source, ToSeconds(t), static_cast<double>(m_sourceFrames));
+}
+
+void DriftEstimator::OnDevice(clock::time_point t, uint64_t consumed, int64_t buffered) noexcept
+{
+    if (m_lastDevice && (t - *m_lastDevice > milliseconds(DRIFT_MAX_GAP_MS) || consumed < *m_firstConsumed))
+    {
+        Restart();
+    }
+    if (m_lastDevice && m_level)
+    {
+        const double dt = duration<double>(t - *m_lastDevice).count();
+        *m_level += (dt / (dt + LEVEL_SMOOTHING_S)) * (static_cast<double>(buffered) - *m_level);
+    }
+    else
+    {
+        m_firstConsumed = consumed;
+        m_level         = static_cast<double>(buffered);
+    }
+    m_lastDevice = t;
+
+    Add(m_device, ToSeconds(t), static_cast<double>(consumed - *m_firstConsumed));
+}
+
+double DriftEstimator::ToSeconds(clock::time_point t) noexcept
+{
+    if (!m_base)
+    {
+        m_base = t;
+    }
+    return duration<double>(t - *m_base).count();
+}
+
+void DriftEstimator::Add(deque<Observation>& observations, double seconds, double frames) noexcept
+{
+    // the observations are thinned out, their spacing doesn't matter for the fit
+    if (!observations.empty() && seconds - observations.back().seconds < DRIFT_SAMPLE_INTERVAL_MS / 1000.)
+    {
+        return;
+    }
+    observations.push_back(Observation{ seconds, frames });
+
+    while (seconds - observations.front().seconds > DRIFT_WINDOW_MS / 1000.)
+    {
+        observations.pop_front();
+    }
+    Update();
+}
+
+optional<double> DriftEstimator::GetRate(const deque<Observation>& observations) noexcept
+{
+    if (observations.size() < 2 || observations.back().seconds - observations.front().seconds < DRIFT_MIN_WINDOW_MS / 1000.)
+    {
+        return nullopt;
+    }
+    double meanSeconds = 0.;
+    double meanFrames = 0.;
+
+    for (const auto& o : observations)
+    {
+        meanSeconds += o.seconds;
+        meanFrames += o.frames;
+    }
+    meanSeconds /= observations.size();
+    meanFrames /= observations.size();
+
+    double sxx = 0.;
+    double sxy = 0.;
+
+    for (const auto& o : observations)
+    {
+        sxx += (o.seconds - meanSeconds) * (o.seconds - meanSeconds);
+        sxy += (o.seconds - meanSeconds) * (o.frames - meanFrames);
+    }
+    if (sxx <= 0.)
+    {
+        return nullopt;
+    }
+    return sxy / sxx;
+}
+
+void DriftEstimator::Update() noexcept
+{
+    const auto sourceRate = GetRate(m_source);
+    const auto deviceRate = GetRate(m_device);
+
+    if (sourceRate && deviceRate && *sourceRate > 0.)
+    {
+        m_drift = (*deviceRate / *sourceRate - 1.) * PPM;
+
+        // the latency at the first estimate is kept from now on
+        if (!m_target)
+        {
+            m_target = m_level;
+        }
+    }
+    double correction = 0.;
+
+    if (m_target && m_level)
+    {
+        correction = ((*m_target - *m_level) / (m_sampleRate * (DRIFT_CORRECTION_MS / 1000.))) * PPM;
+    }
+    m_ratio = 1. + clamp(m_drift.value_or(0.) + correction, -1. * DRIFT_MAX_PPM, 1. * DRIFT_MAX_PPM) / PPM;
+}
+
+double DriftEstimator::GetRatio() const noexcept
+{
+    return m_ratio;
+}
+
+optional<double> DriftEstimator::GetDrift() const noexcept
+{
+    return m_drift;
+}
+
+void DriftEstimator::Restart() noexcept
+{
+    m_source.clear();
+    m_device.clear();
+    m_lastSource.reset();
+    m_lastDevice.reset();
+    m_firstConsumed.reset();
+    m_level.reset();
+    m_target.reset();
+    ++m_restarts;
+
+    Update();
+}
+
+DriftEstimator::Stats DriftEstimator::GetStats() const noexcept
+{
+    int64_t latencyError = 0;
+
+    if (m_target && m_level)
+    {
+        latencyError = llround(*m_level - *m_target);
+    }
+    return Stats{ m_drift.value_or(0.), m_ratio, latencyError, m_restarts };
+}
@@ -0,0 +1,321 @@
+#include "GainStage.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GAIN_STAGE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GAIN_STAGE_NEON
+#endif
+
+using namespace std;
+
+// any seed but zero, one per lane
+static constexpr uint32_t SEEDS[8] = { 0x9e3779b9, 0x7f4a7c15, 0x85ebca6b, 0xc2b2ae35, 0x27d4eb2f, 0x165667b1, 0xd3a2646c, 0xfd7046c5 };
+
+static inline uint32_t XorShift(uint32_t& x) noexcept
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// the upper 23 bits as mantissa of a float between 1 and 2
+static inline float ToUniform(uint32_t x) noexcept
+{
+    const uint32_t bits = (x >> 9) | 0x3f800000;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f - 1.f;
+}
+
+static inline int16_t Quantize(float v) noexcept
+{
+    return static_cast<int16_t>(clamp<long>(lrintf(v), INT16_MIN, INT16_MAX));
+}
+
+GainStage::GainStage(Dither dither /*= Dither::tpdf*/, unsigned int channels /*= NUM_CHANNELS*/)
+    : m_channels{ channels }
+    , m_dither{ dither }
+    , m_db{ 0. }
+    , m_gain{ 1.f }
+    , m_target{ 1.f }
+    , m_error(channels, 0.f)
+{
+    if (m_channels == 0)
+    {
+        throw invalid_argument("gain stage needs one channel at least");
+    }
+    copy(begin(SEEDS), end(SEEDS), m_random);
+}
+
+void GainStage::SetGain(double db)
+{
+    if (!(db <= 0.))
+    {
+        throw invalid_argument("gain must not exceed 0 dB");
+    }
+    m_db = db;
+    m_target = static_cast<float>(pow(10., db / 20.));
+
+    // no sample reaches half an LSB, the output is digital silence instead of dither
+    if (m_target * -static_cast<float>(INT16_MIN) < 0.5f)
+    {
+        m_target = 0.f;
+    }
+}
+
+double GainStage::GetGain() const noexcept
+{
+    return m_db;
+}
+
+void GainStage::SetDither(Dither dither) noexcept
+{
+    m_dither = dither;
+}
+
+GainStage::Dither GainStage::GetDither() const noexcept
+{
+    return m_dither;
+}
+
+void GainStage::Reset() noexcept
+{
+    m_gain = m_target;
+    fill(m_error.begin(), m_error.end(), 0.f);
+}
+
+float GainStage::NextDither() noexcept
+{
+    return ToUniform(XorShift(m_random[0])) - ToUniform(XorShift(m_random[4]));
+}
+
+void GainStage::Process(int16_t* samples, size_t frames) noexcept
+{
+    assert(samples || frames == 0);
+
+    if (frames == 0 || (m_gain == 1.f && m_target == 1.f))
+    {
+        return;
+    }
+    if (m_gain == 0.f && m_target == 0.f)
+    {
+        fill_n(samples, frames * m_channels, int16_t(0));
+        fill(m_error.begin(), m_error.end(), 0.f);
+        return;
+    }
+    // the last frame of the buffer is scaled by the target
+    const float step = (m_target - m_gain) / static_cast<float>(frames);
+
+    if (m_dither == Dither::shaped)
+    {
+        ProcessShaped(samples, frames, step);
+    }
+    else if (m_dither == Dither::tpdf)
+    {
+        const size_t done = ProcessVector<true>(samples, frames, step);
+        ProcessScalar<true>(samples, frames, done, step);
+    }
+    else
+    {
+        const size_t done = ProcessVector<false>(samples, frames, step);
+        ProcessScalar<false>(samples, frames, done, step);
+    }
+    m_gain = m_target;
+}
+
+template<bool dither>
+void GainStage::ProcessScalar(int16_t* samples, size_t frames, size_t first, float step) noexcept
+{
+    for (size_t frame = first; frame < frames; ++frame)
+    {
+        const float gain = m_gain + step * static_cast<float>(frame + 1);
+        int16_t* p = samples + frame * m_channels;
+
+        for (unsigned int channel = 0; channel < m_channels; ++channel)
+        {
+            float v = static_cast<float>(p[channel]) * gain;
+
+            if constexpr (dither)
+            {
+                v += NextDither();
+            }
+            p[channel] = Quantize(v);
+        }
+    }
+}
+
+void GainStage::ProcessShaped(int16_t* samples, size_t frames, float step) noexcept
+{
+    // kept in registers, the stores to the samples may alias the members
+    uint32_t random1 = m_random[0];
+    uint32_t random2 = m_random[4];
+    float* error = m_error.data();
+
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        const float gain = m_gain + step * static_cast<float>(frame + 1);
+        int16_t* p = samples + frame * m_channels;
+
+        for (unsigned int channel = 0; channel < m_channels; ++channel)
+        {
+            // the error of the previous sample is added, which moves the noise to high frequencies
+            const float v = static_cast<float>(p[channel]) * gain + error[channel];
+            const float noise = ToUniform(XorShift(random1)) - ToUniform(XorShift(random2));
+            const int16_t out = Quantize(v + noise);
+
+            error[channel] = clamp(v - static_cast<float>(out), -1.f, 1.f);
+            p[channel] = out;
+        }
+    }
+    m_random[0] = random1;
+    m_random[4] = random2;
+}
+
+#if defined(GAIN_STAGE_SSE2)
+
+static inline __m128i XorShift(__m128i x) noexcept
+{
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+static inline __m128 ToUniform(__m128i x) noexcept
+{
+    const __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.f));
+}
+
+template<bool dither>
+size_t GainStage::ProcessVector(int16_t* samples, size_t frames, float step) noexcept
+{
+    if (m_channels != 2)
+    {
+        return 0;
+    }
+    __m128i random1 = _mm_load_si128(reinterpret_cast<const __m128i*>(m_random));
+    __m128i random2 = _mm_load_si128(reinterpret_cast<const __m128i*>(m_random + 4));
+
+    // the gains of four frames, each for both channels
+    const __m128 steps = _mm_set1_ps(step);
+    const __m128 offsetLow = _mm_mul_ps(steps, _mm_setr_ps(1.f, 1.f, 2.f, 2.f));
+    const __m128 offsetHigh = _mm_mul_ps(steps, _mm_setr_ps(3.f, 3.f, 4.f, 4.f));
+
+    size_t frame = 0;
+
+    for (; frame + 4 <= frames; frame += 4)
+    {
+        __m128i* p = reinterpret_cast<__m128i*>(samples + frame * 2);
+        const __m128i in = _mm_loadu_si128(p);
+
+        // sign extended to 32 bits
+        __m128 low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+        __m128 high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+
+        const __m128 base = _mm_set1_ps(m_gain + step * static_cast<float>(frame));
+
+        low = _mm_mul_ps(low, _mm_add_ps(base, offsetLow));
+        high = _mm_mul_ps(high, _mm_add_ps(base, offsetHigh));
+
+        if constexpr (dither)
+        {
+            random1 = XorShift(random1);
+            random2 = XorShift(random2);
+            low = _mm_add_ps(low, _mm_sub_ps(ToUniform(random1), ToUniform(random2)));
+
+            random1 = XorShift(random1);
+            random2 = XorShift(random2);
+            high = _mm_add_ps(high, _mm_sub_ps(ToUniform(random1), ToUniform(random2)));
+        }
+        // rounded to nearest, saturated to 16 bits
+        _mm_storeu_si128(p, _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high)));
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(m_random), random1);
+    _mm_store_si128(reinterpret_cast<__m128i*>(m_random + 4), random2);
+
+    return frame;
+}
+
+#elif defined(GAIN_STAGE_NEON)
+
+static inline uint32x4_t XorShift(uint32x4_t x) noexcept
+{
+    x = veorq_u32(x, vshlq_n_u32(x, 13));
+    x = veorq_u32(x, vshrq_n_u32(x, 17));
+    return veorq_u32(x, vshlq_n_u32(x, 5));
+}
+
+static inline float32x4_t ToUniform(uint32x4_t x) noexcept
+{
+    const uint32x4_t bits = vorrq_u32(vshrq_n_u32(x, 9), vdupq_n_u32(0x3f800000));
+    return vsubq_f32(vreinterpretq_f32_u32(bits), vdupq_n_f32(1.f));
+}
+
+template<bool dither>
+size_t GainStage::ProcessVector(int16_t* samples, size_t frames, float step) noexcept
+{
+    if (m_channels != 2)
+    {
+        return 0;
+    }
+    uint32x4_t random1 = vld1q_u32(m_random);
+    uint32x4_t random2 = vld1q_u32(m_random + 4);
+
+    // the gains of four frames, each for both channels
+    static const float FRAMES_LOW[4] = { 1.f, 1.f, 2.f, 2.f };
+    static const float FRAMES_HIGH[4] = { 3.f, 3.f, 4.f, 4.f };
+
+    const float32x4_t offsetLow = vmulq_n_f32(vld1q_f32(FRAMES_LOW), step);
+    const float32x4_t offsetHigh = vmulq_n_f32(vld1q_f32(FRAMES_HIGH), step);
+
+    size_t frame = 0;
+
+    for (; frame + 4 <= frames; frame += 4)
+    {
+        int16_t* p = samples + frame * 2;
+        const int16x8_t in = vld1q_s16(p);
+
+        float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(in)));
+        float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(in)));
+
+        const float32x4_t base = vdupq_n_f32(m_gain + step * static_cast<float>(frame));
+
+        low = vmulq_f32(low, vaddq_f32(base, offsetLow));
+        high = vmulq_f32(high, vaddq_f32(base, offsetHigh));
+
+        if constexpr (dither)
+        {
+            random1 = XorShift(random1);
+            random2 = XorShift(random2);
+            low = vaddq_f32(low, vsubq_f32(ToUniform(random1), ToUniform(random2)));
+
+            random1 = XorShift(random1);
+            random2 = XorShift(random2);
+            high = vaddq_f32(high, vsubq_f32(ToUniform(random1), ToUniform(random2)));
+        }
+        // rounded to nearest, saturated to 16 bits
+        vst1q_s16(p, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(low)), vqmovn_s32(vcvtnq_s32_f32(high))));
+    }
+    vst1q_u32(m_random, random1);
+    vst1q_u32(m_random + 4, random2);
+
+    return frame;
+}
+
+#else
+
+template<bool dither>
+size_t GainStage::ProcessVector(int16_t*, size_t, float) noexcept
+{
+    return 0;
+}
+
+#endif
@@ -1,98 +1,186 @@
 #include "HairTunes.h"
-#include "Trim.h"
+#include "RtspParser.h"
 #include "definitions.h"
 #include <spdlog/spdlog.h>
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <functional>
 #include "audio/PlaySound.h"
+#ifndef _WIN32
+#include "audio/AlsaAudio.h"
+#endif
 #include "audio/WaveHeader.h"
 #include "SuspendInhibitor.h"
+#include "DriftEstimator.h"
+#include "Resampler.h"
+#include "PcmRingBuffer.h"
+#include "GainStage.h"
+#include "PcmLevel.h"
+#include "AlacDecoder.h"
 
 using namespace std;
 using namespace string_literals;
 
-namespace alac
+#ifndef _WIN32
+// the mixer element to set the volume on instead of scaling the samples, if configured and present
+static unique_ptr<AlsaAudio::Mixer> OpenMixer(const SharedPtr<IValueCollection>& config, const string& audioDevice) noexcept
 {
-    typedef struct alac_file alac_file;
-
-    alac_file *create_alac(int samplesize, int numchannels);
-    void destroy_alac(alac_file* alac) noexcept;
-
-    void decode_frame(alac_file *alac,
-                    unsigned char *inbuffer,
-                    void *outbuffer, int *outputsize);
-    void alac_set_info(alac_file *alac, char *inputbuffer);
-    void allocate_buffers(alac_file *alac);
-
-    struct alac_file
-    {
-        unsigned char *input_buffer;
-        int input_buffer_bitaccumulator; /* used so we can do arbitary
-                                            bit reads */
-
-        int samplesize;
-        int numchannels;
-        int bytespersample;
-
-        /* buffers */
-        int32_t *predicterror_buffer_a;
-        int32_t *predicterror_buffer_b;
-
-        int32_t *outputsamples_buffer_a;
-        int32_t *outputsamples_buffer_b;
-
-        int32_t *uncompressed_bytes_buffer_a;
-        int32_t *uncompressed_bytes_buffer_b;
-
-        /* stuff from setinfo */
-        uint32_t setinfo_max_samples_per_frame; /* 0x1000 = 4096 */    /* max samples per frame? */
-        uint8_t setinfo_7a; /* 0x00 */
-        uint8_t setinfo_sample_size; /* 0x10 */
-        uint8_t setinfo_rice_historymult; /* 0x28 */
-        uint8_t setinfo_rice_initialhistory; /* 0x0a */
-        uint8_t setinfo_rice_kmodifier; /* 0x0e */
-        uint8_t setinfo_7f; /* 0x02 */
-        uint16_t setinfo_80; /* 0x00ff */
-        uint32_t setinfo_82; /* 0x000020e7 */ /* max sample size?? */
-        uint32_t setinfo_86; /* 0x00069fe4 */ /* bit rate (avarge)?? */
-        uint32_t setinfo_8a_rate; /* 0x0000ac44 */
-        /* end setinfo stuff */
-    };
-} // namespace alac
+    const auto element = VariantValue::Key("MixerElement").TryGet<string>(config).value_or(""s);
+
+    if (element.empty())
+    {
+        return nullptr;
+    }
+    const auto device = VariantValue::Key("MixerDevice").TryGet<string>(config).value_or(AlsaAudio::Mixer::card_of(audioDevice));
+
+    try
+    {
+        auto mixer = make_unique<AlsaAudio::Mixer>(device, element);
 
-static int16_t ApplyVolumeToChannel(const int16_t in, const double lfVolume, double& e)
+        spdlog::info("volume is set on mixer element \"{}\" of \"{}\"", element, device);
+        return mixer;
+    }
+    catch (...)
+    {
+        spdlog::warn("mixer element \"{}\" of \"{}\" is not available, volume is applied to the samples", element, device);
+    }
+    return nullptr;
+}
+#endif
+
+// the buffer of the output device, explicit sizes take precedence over the profile
+static AlsaAudio::BufferRequest GetBufferRequest(const SharedPtr<IValueCollection>& config)
 {
-    if (0 == in)
+    AlsaAudio::BufferRequest request;
+
+    if (VariantValue::Key("LatencyProfile").TryGet<string>(config).value_or(""s) == "low"s)
     {
-        e = 0;
-        return 0;
+        request.periodFrames = LOW_LATENCY_PERIOD_FRAMES;
+        request.bufferFrames = LOW_LATENCY_BUFFER_FRAMES;
+    }
+    if (const int us = VariantValue::Key("PeriodTimeUs").TryGet<int>(config).value_or(0); us > 0)
+    {
+        request.periodFrames = 0;
+        request.periodTimeUs = static_cast<uint32_t>(us);
+    }
+    if (const int frames = VariantValue::Key("PeriodFrames").TryGet<int>(config).value_or(0); frames > 0)
+    {
+        request.periodFrames = static_cast<uint32_t>(frames);
+    }
+    if (const int us = VariantValue::Key("BufferTimeUs").TryGet<int>(config).value_or(0); us > 0)
+    {
+        request.bufferFrames = 0;
+        request.bufferTimeUs = static_cast<uint32_t>(us);
+    }
+    if (const int frames = VariantValue::Key("BufferFrames").TryGet<int>(config).value_or(0); frames > 0)
+    {
+        request.bufferFrames = static_cast<uint32_t>(frames);
+    }
+    if (VariantValue::Key("XrunPolicy").TryGet<string>(config).value_or(""s) == "drop"s)
+    {
+        request.xrunPolicy = AlsaAudio::XrunPolicy::drop;
+    }
+    if (const int frames = VariantValue::Key("RefillFrames").TryGet<int>(config).value_or(0); frames > 0)
+    {
+        request.refillFrames = static_cast<uint32_t>(frames);
+    }
+    return request;
+}
+
+// the dither of the software volume, triangular noise unless configured otherwise
+static GainStage::Dither GetDither(const SharedPtr<IValueCollection>& config)
+{
+    const auto dither = VariantValue::Key("Dither").TryGet<string>(config).value_or(""s);
+
+    if (dither == "none"s)
+    {
+        return GainStage::Dither::none;
+    }
+    if (dither == "shaped"s)
+    {
+        return GainStage::Dither::shaped;
+    }
+    return GainStage::Dither::tpdf;
+}
+
+// the jitter buffer has to hold twice the high level at least
+static size_t GetJitterBufferCapacity(const size_t highLevelQueue) noexcept
+{
+    size_t capacity = JITTER_BUFFER_CAPACITY;
+
+    while (capacity < 2 * highLevelQueue && capacity < 0x8000)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+static void JoinThread(unique_ptr<thread>& t) noexcept
+{
+    if (t)
+    {
+        if (t->joinable())
+        {
+            try
+            {
+                t->join();
+            }
+            catch (...)
+            {
+                assert(false);
+            }
+        }
+        t.reset();
+    }
+}
+
+// the output of the session made last, the next session's output waits for it
+static mutex s_mtxLastOutput;
+static shared_future<void> s_lastOutput;
+
+SessionResources::SessionResources(const string& peer)
+    : controlEndpoint{ make_unique<RtpEndpoint>(nullptr, peer) }
+    , dataEndpoint{ make_unique<RtpEndpoint>(nullptr, peer) }
+    , timingEndpoint{ make_unique<RtpEndpoint>(nullptr, peer) }
+{
+    decoder = alac::create_alac(SAMPLE_SIZE, NUM_CHANNELS);
+
+    decoder->setinfo_max_samples_per_frame = PREWARM_FRAMES_PER_PACKET;
+    alac::allocate_buffers(decoder);
+}
+
+SessionResources::~SessionResources()
+{
+    if (decoder)
+    {
+        alac::destroy_alac(decoder);
+        decoder = nullptr;
     }
-    const double qOut = (static_cast<double>(in) * lfVolume) + e;
-    const int16_t out = static_cast<int16_t>(floor(qOut+0.5));
-    e = qOut - static_cast<double>(out);
-    return out;
 }
 
-HairTunes::HairTunes(const SharedPtr<IValueCollection> config, const SharedPtr<IValueCollection>& client)
+HairTunes::HairTunes(const SharedPtr<IValueCollection> config, const SharedPtr<IValueCollection>& client,
+    unique_ptr<SessionResources> resources /*= nullptr*/)
     : m_config{ move(config) }
     , m_client{ client }
     , m_lowLevelQueue{ VariantValue::Key("LowLevelRTP").Get<size_t>(config) } 
     , m_highLevelQueue{ VariantValue::Key("LowLevelRTP").Get<size_t>(config) +
                         VariantValue::Key("LevelOffsetRTP").Get<size_t>(config) } 
+    , m_jitterBuffer{ GetJitterBufferCapacity(m_highLevelQueue) }
+    , m_resendScheduler{ [this](const USHORT seq, const USHORT count) { return RequestResend(seq, count); } }
     , m_remoteControlPort{ VariantValue::Key("control_port").Get<int>(client) }
+    , m_remoteTimingPort{ VariantValue::Key("timing_port").TryGet<int>(client).value_or(0) }
+    , m_msStartFill{ VariantValue::Key("StartFill").Get<size_t>(config) }
     , m_clientID{ VariantValue::Key("ID").Get<string>(client) }
     , m_decoder{ nullptr }
     , m_stopThread{ false }
     , m_flush{ 0 }
-    , m_aes{ VariantValue::Key("rsaaeskey").Get<vector<uint8_t>>(client) }
-    , m_iv{ VariantValue::Key("aesiv").Get<vector<uint8_t>>(client) }
+    , m_aes{ VariantValue::Key("rsaaeskey").Get<vector<uint8_t>>(client),
+             VariantValue::Key("aesiv").Get<vector<uint8_t>>(client) }
+    , m_decodeQueue{ PIPELINE_QUEUE_SIZE }
+    , m_outputQueue{ PIPELINE_QUEUE_SIZE }
     , m_progressData{ 0 }
     , m_pendingData{ 0 }
 {
-    if (m_iv.size() != 16)
-    {
-        throw runtime_error("intialization vector has wrong format");
-    }
     assert(m_lowLevelQueue);
     assert(m_lowLevelQueue < m_highLevelQueue);
 
@@ -104,11 +192,19 @@ HairTunes::HairTunes(const SharedPtr<IValueCollection> config, const SharedPtr<I
     vector<int> fmtpList;
     fmtpList.reserve(12);
 
-    ParseRegEx(fmtp, "[^[:space:]]+"s, [&fmtpList](string s)
+    string_view items(fmtp);
+    string_view item;
+
+    while (RtspParser::NextToken(items, item))
     {
-        fmtpList.push_back(stoi(s));
-        return true;
-    });
+        const auto value = RtspParser::ToInt(item);
+
+        if (!value)
+        {
+            throw runtime_error("fmtp has wrong format");
+        }
+        fmtpList.push_back(*value);
+    }
 
     if (fmtpList.size() != 12)
     {
@@ -124,10 +220,35 @@ HairTunes::HairTunes(const SharedPtr<IValueCollection> config, const SharedPtr<I
 
     m_frameBytes	= fmtpList[1] << 2; 
     m_samplingRate  = fmtpList[11];
+
+    // the decoded frame replaces the content of its packet
+    if (m_frameBytes <= 0 || static_cast<size_t>(m_frameBytes) > RtpPacket::capacity())
+    {
+        throw runtime_error("frame size exceeds packet capacity");
+    }
     m_mute          = false;
 
-    m_decoder = alac::create_alac(SAMPLE_SIZE, NUM_CHANNELS);
+    m_playoutClock = make_unique<PlayoutClock>(static_cast<uint32_t>(m_samplingRate));
+
+    // the client ID equals the "peer" address
+    assert(!m_clientID.empty());
+
+    if (!resources || resources->dataEndpoint->IsV4() != RtpEndpoint::IsV4(m_clientID))
+    {
+        resources = make_unique<SessionResources>(m_clientID);
+    }
+
+    // only frames larger than the pre-warmed ones need buffers of their own
+    const bool prewarmedDecoder = fmtpList[1] <= PREWARM_FRAMES_PER_PACKET;
 
+    if (prewarmedDecoder)
+    {
+        m_decoder = exchange(resources->decoder, nullptr);
+    }
+    else
+    {
+        m_decoder = alac::create_alac(SAMPLE_SIZE, NUM_CHANNELS);
+    }
     m_decoder->setinfo_max_samples_per_frame = fmtpList[1];
     m_decoder->setinfo_7a					= fmtpList[2];
     m_decoder->setinfo_sample_size			= SAMPLE_SIZE;
@@ -140,48 +261,118 @@ HairTunes::HairTunes(const SharedPtr<IValueCollection> config, const SharedPtr<I
     m_decoder->setinfo_86					= fmtpList[10];
     m_decoder->setinfo_8a_rate				= m_samplingRate;
 
-    alac::allocate_buffers(m_decoder);	
+    if (!prewarmedDecoder)
+    {
+        alac::allocate_buffers(m_decoder);
+    }
+    {
+        lock_guard<mutex> guard(s_mtxLastOutput);
+        m_previousOutput = exchange(s_lastOutput, m_outputDone.get_future().share());
+    }
 
+    // the stages of the pipeline, the last one first
+    m_outputThread = make_unique<thread>([this]()
+    {
+        {
+            const SuspendInhibitor suspendInhibitor{ "ShairportQt", "Playing" };
+            RunOutput();
+        }
+        // the device is free for the next session
+        m_outputDone.set_value();
+    });
+    m_decodeThread = make_unique<thread>([this]()
+    {
+        RunDecode();
+    });
     m_queueThread = make_unique<thread>([this]()
     {
-        const SuspendInhibitor suspendInhibitor{ "ShairportQt", "Playing" };
         RunQueue();
     });
     
-    // the client ID equals the "peer" address
-    assert(!m_clientID.empty());
+    m_controlEndpoint   = move(resources->controlEndpoint);
+    m_dataEndpoint      = move(resources->dataEndpoint);
+    m_timingEndpoint    = move(resources->timingEndpoint);
 
-    m_controlEndpoint   = make_unique<RtpEndpoint>(this, m_clientID);
-    m_dataEndpoint      = make_unique<RtpEndpoint>(this, m_clientID);
-    m_timingEndpoint    = make_unique<RtpEndpoint>(this, m_clientID);
+    m_controlEndpoint->Attach(this, m_clientID);
+    m_dataEndpoint->Attach(this, m_clientID);
+    m_timingEndpoint->Attach(this, m_clientID);
+
+    // the timing exchange tells the offset to the sender's clock
+    if (m_remoteTimingPort)
+    {
+        m_timingThread = make_unique<thread>([this]()
+        {
+            RunTiming();
+        });
+    }
 }
 
 HairTunes::~HairTunes()
 {
-    m_dataEndpoint.reset();
-    m_controlEndpoint.reset();
-    m_timingEndpoint.reset();
-
-    ++m_flush;
-    m_stopThread = true;
-
-    m_condQueue.NotifyAll();
+    if (m_dataEndpoint)
+    {
+        spdlog::debug("received {} audio packets with an average batch size of {:.2f}", 
+            m_dataEndpoint->GetReceivedPackets(), m_dataEndpoint->GetAverageBatchSize());
+    }
+    // no more resend or timing requests while the endpoints go away
+    m_resendScheduler.Stop();
 
-    if (m_queueThread)
+    if (m_timingThread)
     {
-        if (m_queueThread->joinable())
+        {
+            lock_guard<mutex> guard(m_mtxTiming);
+            m_stopTiming = true;
+        }
+        m_condTiming.NotifyAll();
+
+        if (m_timingThread->joinable())
         {
             try
             {
-                m_queueThread->join();
+                m_timingThread->join();
             }
             catch (...)
             {
                 assert(false);
             }
         }
-        m_queueThread.reset();
+        m_timingThread.reset();
     }
+    const auto clockStats = m_playoutClock->GetStats();
+    spdlog::debug("timing: {} samples, rtt {} us, {} sync packets, sender latency {} frames",
+        clockStats.timingSamples, chrono::duration_cast<chrono::microseconds>(clockStats.rtt).count(),
+        clockStats.syncs, clockStats.latency);
+
+    const auto resendStats = m_resendScheduler.GetStats();
+    spdlog::debug("resend: {} requested, {} sent ({} retries), {} recovered, {} too late, {} abandoned, rtt {} us",
+        resendStats.requested, resendStats.sent, resendStats.retried, resendStats.recovered,
+        resendStats.tooLate, resendStats.abandoned, m_resendScheduler.GetRoundTripTime().count());
+
+    const auto poolStats = GetPacketPoolStats();
+    spdlog::debug("packet pool: {} hits, {} misses, {} outstanding, high-water mark {}", 
+        poolStats.hits, poolStats.misses, poolStats.outstanding, poolStats.highWaterMark);
+
+    m_dataEndpoint.reset();
+    m_controlEndpoint.reset();
+    m_timingEndpoint.reset();
+
+    ++m_flush;
+    m_stopThread = true;
+
+    m_condQueue.NotifyAll();
+
+    // each stage closes the queue to the next one when it is done
+    JoinThread(m_queueThread);
+    JoinThread(m_decodeThread);
+    JoinThread(m_outputThread);
+
+    spdlog::debug("decode stage: {} packets, {} us waiting ({} us max), {} us decoding ({} us max) on average",
+        m_decodeLatency.packets, m_decodeLatency.GetWaiting().count(), chrono::duration_cast<chrono::microseconds>(m_decodeLatency.maxWaiting).count(),
+        m_decodeLatency.GetProcessing().count(), chrono::duration_cast<chrono::microseconds>(m_decodeLatency.maxProcessing).count());
+    spdlog::debug("output stage: {} packets, {} us waiting ({} us max), {} us processing ({} us max) on average",
+        m_outputLatency.packets, m_outputLatency.GetWaiting().count(), chrono::duration_cast<chrono::microseconds>(m_outputLatency.maxWaiting).count(),
+        m_outputLatency.GetProcessing().count(), chrono::duration_cast<chrono::microseconds>(m_outputLatency.maxProcessing).count());
+
     if (m_decoder)
     {
         alac::destroy_alac(m_decoder);
@@ -189,30 +380,43 @@ HairTunes::~HairTunes()
     }
 }
 
-void HairTunes::AlacDecode(unique_ptr<RtpPacket>& packet)
+void HairTunes::DecryptPacket(RtpPacket& packet)
 {
-    const unsigned char* pBuf = packet->getData();
-    const int len = packet->getDataLen();
-
-	unsigned char dest[RAOP_PACKET_MAX_SIZE];
+    // the blocks are decrypted where they are, the tail which is no block is sent in the clear
+    m_aes.Decrypt(packet.getData(), packet.getData(), packet.getDataLen() & ~0xf);
+}
 
-	assert (len <= RAOP_PACKET_MAX_SIZE);
-    const int aeslen = len & ~0xf;
+void HairTunes::AlacDecode(RtpPacket& packet)
+{
+    const int len = packet.getDataLen();
 
-    uint8_t iv[16];
+    // the decoder has read the packet before it writes the samples over it
+    packet.resize(m_frameBytes);
 
-    memcpy(iv, m_iv.data(), 16);
-    m_aes.Decrypt(pBuf, dest, aeslen, iv, 16);
+	int outsize = 0;
+    alac::decode_frame(m_decoder, packet.getData(), len, packet.data(), &outsize);
 
-    memcpy(dest+aeslen, pBuf+aeslen, len-aeslen);  
+    assert(outsize <= m_frameBytes);
+    packet.resize(outsize);
+}
 
-    packet->resize(m_frameBytes);
+void HairTunes::StageLatency::Add(const chrono::nanoseconds waited, const chrono::nanoseconds processed) noexcept
+{
+    ++packets;
+    waiting += waited;
+    processing += processed;
+    maxWaiting = max(maxWaiting, waited);
+    maxProcessing = max(maxProcessing, processed);
+}
 
-	int outsize = 0;
-    alac::decode_frame(m_decoder, dest, packet->data(), &outsize);
+chrono::microseconds HairTunes::StageLatency::GetWaiting() const noexcept
+{
+    return packets ? chrono::duration_cast<chrono::microseconds>(waiting / packets) : chrono::microseconds(0);
+}
 
-    assert(outsize <= m_frameBytes);
-    packet->resize(outsize);
+chrono::microseconds HairTunes::StageLatency::GetProcessing() const noexcept
+{
+    return packets ? chrono::duration_cast<chrono::microseconds>(processing / packets) : chrono::microseconds(0);
 }
 
 void HairTunes::ResetProgess() noexcept
@@ -227,7 +431,13 @@ bool HairTunes::IsPlaying() const noexcept
 
 int HairTunes::GetProgressTime() const noexcept
 {
-    const int64_t d = m_progressData.load() - m_pendingData.load();
+    int64_t d = m_progressData.load() - m_pendingData.load();
+
+    // the frames queued in the output device haven't been heard either
+    if (const auto played = m_position->Get())
+    {
+        d -= static_cast<int64_t>(played->delay * SAMPLE_FACTOR);
+    }
 
     if (d <= 0)
     {
@@ -241,191 +451,418 @@ uint64_t HairTunes::GetSamplingFreq() const noexcept
     return m_samplingRate;
 }
 
-bool HairTunes::AsyncRequestResend(const unique_lock<mutex>& sync, const USHORT nSeq, const short nCount) noexcept
+optional<HairTunes::OutputLatency> HairTunes::GetOutputLatency() const noexcept
 {
-    if (sync.owns_lock())
+    const auto played = m_position->Get();
+
+    if (!played)
     {
-        try
-        {
-            for (const auto& item : m_asyncResend)
-            {
-                if (item->seq == nSeq && item->count == nCount)
-                {
-                    return false;
-                }
-            }
+        return nullopt;
+    }
+    const auto buffer = m_position->GetBuffer().value_or(AlsaAudio::PlaybackPosition::Buffer{ 0, 0 });
 
-            m_asyncResend.emplace_back(make_unique<ResendRequest>(nSeq, nCount,
-                async(launch::async, [this](const USHORT seq, const short n)
-                    {
-                        RequestResend(seq, n);
-                    }, nSeq, nCount)));
-            return true;
-        }
-        catch(...)
+    return OutputLatency{ buffer.period, buffer.buffer, played->delay };
+}
+
+AlsaAudio::XrunStats HairTunes::GetXrunStats() const noexcept
+{
+    return m_position->GetXruns();
+}
+
+PcmLevel HairTunes::GetLevel() const noexcept
+{
+    return m_level;
+}
+
+optional<chrono::milliseconds> HairTunes::GetTimeToFirstAudio() const noexcept
+{
+    const int64_t ms = m_msFirstAudio;
+
+    if (ms < 0)
+    {
+        return nullopt;
+    }
+    return chrono::milliseconds(ms);
+}
+
+optional<PlayoutClock::clock::time_point> HairTunes::GetReleaseTime(const unique_lock<mutex>& sync, const USHORT nSeq) const noexcept
+{
+    assert(sync.owns_lock());
+
+    if (m_jitterBuffer.Empty())
+    {
+        return nullopt;
+    }
+    uint32_t timestamp = 0;
+
+    if (const RtpPacket* packet = m_jitterBuffer.Get(nSeq))
+    {
+        timestamp = packet->getTimeStamp();
+    }
+    else
+    {
+        // a missing packet is extrapolated from the newest one
+        const USHORT newestSeqNo = m_jitterBuffer.GetEndSeqNo() - 1;
+        const RtpPacket* newest = m_jitterBuffer.Get(newestSeqNo);
+
+        if (!newest)
         {
+            return nullopt;
         }
+        const uint32_t framesPerPacket = static_cast<uint32_t>(m_frameBytes / SAMPLE_FACTOR);
+        timestamp = newest->getTimeStamp() - JitterBuffer::Distance(nSeq, newestSeqNo) * framesPerPacket;
     }
-    else
+    const auto playoutTime = m_playoutClock->GetPlayoutTime(timestamp);
+
+    if (!playoutTime)
     {
-        assert(false);
+        return nullopt;
     }
-    return false;
+    // the PCM buffer holds the start fill in front of the playout
+    return *playoutTime - chrono::milliseconds(m_msStartFill);
 }
 
-void HairTunes::RunQueue() noexcept
+ResendScheduler::clock::time_point HairTunes::GetPlayDeadline(const unique_lock<mutex>& sync, const USHORT nSeq) const noexcept
 {
-    // start fill in [ms]
-    const size_t msStartFill = VariantValue::Key("StartFill").Get<size_t>(m_config);
-    const auto audioDevice = VariantValue::Key("AudioDevice").TryGet<string>(m_config).value_or("default"s);
+    assert(sync.owns_lock());
 
-    spdlog::debug("starting Hairtunes with a buffer of {} ms and output to \"{}\"", msStartFill, audioDevice);
+    // the packet is needed as soon as it is scheduled to be released
+    if (const auto releaseTime = GetReleaseTime(sync, nSeq))
+    {
+        return *releaseTime;
+    }
 
-    const VariantValue::Key keyVolume("Volume");
+    // the packet is played after the pending PCM data and all packets in front of it
+    const int64_t bytesPerSecond = static_cast<int64_t>(m_samplingRate) * SAMPLE_FACTOR;
+    const int64_t queuedPackets = max(JitterBuffer::Distance(m_jitterBuffer.GetHeadSeqNo(), nSeq), 0) + m_decodeQueue.Size() + m_outputQueue.Size();
+    const int64_t queuedBytes = queuedPackets * m_frameBytes;
+    const int64_t pendingBytes = m_pendingData + queuedBytes;
 
-    // volume db (factored 1000)
-    int64_t volumeDb = keyVolume.Get<int64_t>(m_config);
-   
-    double lfVolume = pow(10.0, volumeDb * 0.00005);
-    assert(lfVolume > 0. && lfVolume <= 1.);
-    double eChannelOne = 0.;
-    double eChannelTwo = 0.;
+    return ResendScheduler::clock::now() + chrono::microseconds((pendingBytes * 1000000) / bytesPerSecond);
+}
 
-    future<int> playAudio;
-    SharedPtr<BlobStream> streamPCM;
+void HairTunes::ScheduleResend(const unique_lock<mutex>& sync, const USHORT nSeq, const USHORT nCount) noexcept
+{
+    assert(sync.owns_lock());
 
     try
     {
-        streamPCM = MakeShared<BlobStream>();
-
-        streamPCM->SetMode(BlobStream::Mode::pipeOpen);
-
-        AlsaAudio::WaveHeader hdrWav;
-
-        // prepare the audio paramaters
-        hdrWav.init(m_samplingRate, SAMPLE_SIZE, NUM_CHANNELS);
-        streamPCM->Write(&hdrWav, hdrWav.mySize(), nullptr);
+        m_resendScheduler.Request(nSeq, nCount, GetPlayDeadline(sync, nSeq));
     }
-    catch(...)
+    catch (...)
     {
-        spdlog::error("failed to set up Audio");
-        return;
     }
+}
+
+void HairTunes::RunQueue() noexcept
+{
+    // the packets released at once
+    vector<unique_ptr<RtpPacket>> batch;
+    batch.reserve(DECODE_BATCH_SIZE);
+
+    const auto packetDuration = chrono::microseconds((static_cast<int64_t>(m_frameBytes / SAMPLE_FACTOR) * 1000000) / m_samplingRate);
 
     unique_lock<mutex> sync(m_mtxQueue);
 
+    uint32_t msWait = INFINITE;
+    bool timed = false;
+
+    const auto release = [&]()
+    {
+        return (m_flush || timed) ? !m_jitterBuffer.Empty() : m_jitterBuffer.Size() > m_lowLevelQueue;
+    };
+
     while (!m_stopThread)
     {
-        m_condQueue.WaitAndLock(sync);
+        m_condQueue.WaitAndLock(sync, msWait);
+        msWait = INFINITE;
 
-        if (m_packetQueue.empty())
+        if (m_jitterBuffer.Empty())
         {
             continue;
         }
-        
-        do
+        bool more = true;
+
+        while (more)
         {
-            if (!m_flush && m_packetQueue.size() > 1)
+            // once playing, a batch is released up to its length ahead of time,
+            // the device plays from the PCM buffer at its own pace anyway
+            const auto lead = m_outputPlaying ? packetDuration * (DECODE_BATCH_SIZE - 1) : chrono::microseconds(0);
+
+            do
             {
-                // navigate to 2nd item in queue
-                auto secondItem = m_packetQueue.begin();
-                ++secondItem;
+                const USHORT headSeqNo = m_jitterBuffer.GetHeadSeqNo();
+                const bool present = m_jitterBuffer.IsPresent(headSeqNo);
+
+                // packets are released by time as soon as the stream is synchronized,
+                // otherwise by the queue levels
+                const auto releaseTime = m_flush ? nullopt : GetReleaseTime(sync, headSeqNo);
+                const auto now = PlayoutClock::clock::now();
 
-                const short diffSeq = (secondItem->get()->getSeqNo() - m_packetQueue.front()->getSeqNo());
+                timed = releaseTime.has_value();
+
+                // a missing packet is given up at its own release time only
+                if (timed && *releaseTime > now + (present ? lead : chrono::microseconds(0)))
+                {
+                    const auto wait = *releaseTime - (present ? lead : chrono::microseconds(0)) - now;
+                    msWait = static_cast<uint32_t>(chrono::duration_cast<chrono::milliseconds>(wait).count()) + 1;
+                    more = false;
+                    break;
+                }
 
-                // try to request packets again, if lost
-                if (diffSeq > 1)
+                if (!present)
                 {
-                    if (AsyncRequestResend(sync, m_packetQueue.front()->getSeqNo() + 1, diffSeq - 1))
+                    // wait as long as the scheduler hasn't given up on the packet
+                    if (!m_flush && !timed && m_resendScheduler.IsPending(headSeqNo))
                     {
-                        spdlog::debug("wait until packet {} will arrive", m_packetQueue.front()->getSeqNo() + 1);
+                        spdlog::debug("wait until packet {} will arrive", headSeqNo);
+                        more = false;
                         break;
                     }
+                    const auto skipped = m_jitterBuffer.SkipMissing();
+                    m_resendScheduler.Cancel(headSeqNo, skipped);
+                    spdlog::debug("skipping {} lost packets {} -> {}", skipped, headSeqNo, (USHORT)(headSeqNo + skipped - 1));
+
+                    if (timed)
+                    {
+                        // the next packet may not be due yet
+                        continue;
+                    }
                 }
+                // dequeue packet
+                auto packet = m_jitterBuffer.Pop();
+
+                if (timed && now > *releaseTime + chrono::milliseconds(m_msStartFill))
+                {
+                    // its playout time has passed already
+                    spdlog::debug("packet {} is late by {} ms and is being discarded", headSeqNo,
+                        chrono::duration_cast<chrono::milliseconds>(now - *releaseTime).count() - static_cast<int64_t>(m_msStartFill));
+                    PutPacketToPool(move(packet));
+                    continue;
+                }
+                batch.push_back(move(packet));
+            } while ((more = release()) && batch.size() < DECODE_BATCH_SIZE);
+
+            if (batch.empty())
+            {
+                break;
             }
-            // dequeue packet
-            auto packet = move(m_packetQueue.front());
-            m_packetQueue.pop_front();
-    	    
-            // unlock the queue
+
+            // unlock the queue, the decoder makes it wait only if it is far behind
             sync.unlock();
 
-            try
+            const auto queued = chrono::steady_clock::now();
+
+            for (auto& packet : batch)
             {
-                AlacDecode(packet);
+                StagedPacket staged{ move(packet), 0, queued };
 
-                if (packet->size() >= 4 && packet->size() <= m_frameBytes)
+                if (!m_decodeQueue.Push(move(staged)))
                 {
-                    bool mute = m_mute;
+                    PutPacketToPool(move(staged.packet));
+                }
+            }
+            batch.clear();
 
-                    if (!playAudio.valid() && !mute)
-                    {
-                        // optimistic mute as long as we're not playing
-                        mute = true;
+            // lock before we loop
+            sync.lock();
 
-                        // empty packets will be muted in this case
-                        static_assert(4 / sizeof(uint32_t) == 4 >> NUM_CHANNELS);
-                        const size_t sampleCount = packet->size() >> NUM_CHANNELS;
+            more = more && release();
+        }
+    }
+    assert(m_jitterBuffer.Empty());
+    sync.unlock();
 
-                        const uint32_t* inptr = (const uint32_t*) packet->data();
+    m_decodeQueue.Close();
+}
 
-                        for (size_t i = 0; i < sampleCount; i++) 
-                        {
-                            if (*inptr++)
-                            {
-                                // we got some sound -> unmute
-                                mute = false;
-                                break;
-                            }
-                        }
-                    }
-                    bool hasSoundData = false;
+void HairTunes::RunDecode() noexcept
+{
+    StagedPacket batch[DECODE_BATCH_SIZE];
 
-                    const size_t sampleCount = packet->size() >> NUM_CHANNELS;
-                    const int16_t* inptr = (const int16_t*) packet->data();
+    while (m_decodeQueue.Pop(batch[0]))
+    {
+        size_t count = 1;
 
-                    // 0 db doesn't need to be applied
-                    if (volumeDb != 0)
-                    {
-                        int16_t* outptr = (int16_t*)packet->data();
+        // the packets queued already are decrypted back to back
+        while (count < DECODE_BATCH_SIZE && m_decodeQueue.TryPop(batch[count]))
+        {
+            ++count;
+        }
+        const auto start = chrono::steady_clock::now();
 
-                        for (size_t i = 0; i < sampleCount; i++)
-                        {
-                            if (!hasSoundData)
-                            {
-                                if (*inptr || *(inptr+1))
-                                {
-                                    hasSoundData = true;
-                                }
-                            }
-                            *outptr++ = ApplyVolumeToChannel(*inptr++, lfVolume, eChannelOne);
-                            *outptr++ = ApplyVolumeToChannel(*inptr++, lfVolume, eChannelTwo);
-                        }
-                    }
-                    else
-                    {
-                        for (size_t i = 0; i < sampleCount; i++)
-                        {
-                            if (*inptr++ || *inptr++)
-                            {
-                                hasSoundData = true;
-                                break;
-                            }
-                        }
-                    }
+        for (size_t i = 0; i < count; ++i)
+        {
+            try
+            {
+                DecryptPacket(*batch[i].packet);
+            }
+            catch (...)
+            {
+                PutPacketToPool(move(batch[i].packet));
+            }
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto& staged = batch[i];
+
+            if (!staged.packet)
+            {
+                continue;
+            }
+            const auto waited = start - staged.queued;
+
+            try
+            {
+                // the samples take the place of the header
+                staged.timestamp = staged.packet->getTimeStamp();
+                AlacDecode(*staged.packet);
+            }
+            catch (...)
+            {
+                PutPacketToPool(move(staged.packet));
+                continue;
+            }
+            staged.queued = chrono::steady_clock::now();
+            m_decodeLatency.Add(waited, staged.queued - start);
+
+            if (!m_outputQueue.Push(move(staged)))
+            {
+                PutPacketToPool(move(staged.packet));
+            }
+        }
+    }
+    m_outputQueue.Close();
+}
+
+void HairTunes::RunOutput() noexcept
+{
+    const auto audioDevice = VariantValue::Key("AudioDevice").TryGet<string>(m_config).value_or("default"s);
+
+    spdlog::debug("starting Hairtunes with a buffer of {} ms and output to \"{}\"", m_msStartFill, audioDevice);
+
+    const VariantValue::Key keyVolume("Volume");
+
+    // volume db (factored 1000)
+    int64_t volumeDb = keyVolume.Get<int64_t>(m_config);
+
+    // sets the volume on the mixer, false if it has to be applied to the samples
+    function<bool(int64_t)> setMixerVolume = [](int64_t) { return false; };
+
+#ifndef _WIN32
+    if (auto mixer = OpenMixer(m_config, audioDevice))
+    {
+        setMixerVolume = [mixer = shared_ptr<AlsaAudio::Mixer>(move(mixer))](int64_t volumeDb)
+        {
+            return mixer->set_vol_db(volumeDb / 1000.);
+        };
+    }
+#endif
+    // the samples pass unchanged as long as the mixer takes care of the volume
+    bool mixerVolume = setMixerVolume(volumeDb);
+
+    // the first packet starts at the volume, later changes are ramped
+    GainStage gain(GetDither(m_config));
+    gain.SetGain(min<int64_t>(volumeDb, 0) / 1000.);
+    gain.Reset();
+
+    future<int> playAudio;
+    SharedPtr<PcmRingBuffer> streamPCM;
+
+    const auto bufferRequest = GetBufferRequest(m_config);
+
+    // the device position tells the drift to the sender's clock
+    const auto& position = m_position;
+    optional<AlsaAudio::PlaybackPosition::clock::time_point> positionTime;
+    uint64_t interruptions = 0;
+    DriftEstimator drift(static_cast<uint32_t>(m_samplingRate));
+    Resampler resampler;
+    vector<int16_t> resampled;
+    uint64_t framesWritten = 0;
+
+    // the time the packets of a block have waited for the stage
+    chrono::nanoseconds waited[DECODE_BATCH_SIZE];
+
+    try
+    {
+        // room for the start fill and the queue above it
+        streamPCM = MakeShared<PcmRingBuffer>((static_cast<size_t>(PCM_BUFFER_MS) * m_samplingRate * SAMPLE_FACTOR) / 1000);
+
+        // the player wakes up once per packet at most
+        streamPCM->SetReadWatermark(m_frameBytes);
+
+        // the packets of a batch in one block
+        resampled.reserve(DECODE_BATCH_SIZE * m_frameBytes);
+
+        AlsaAudio::WaveHeader hdrWav;
+
+        // prepare the audio paramaters
+        hdrWav.init(m_samplingRate, SAMPLE_SIZE, NUM_CHANNELS);
+        streamPCM->Write(&hdrWav, hdrWav.mySize(), nullptr);
+    }
+    catch(...)
+    {
+        spdlog::error("failed to set up Audio");
 
-                    ULONG written = static_cast<ULONG>(packet->size());
+        // the decoder drops the rest
+        m_outputQueue.Close();
+        return;
+    }
+    StagedPacket staged;
+
+    while (m_outputQueue.Pop(staged))
+    {
+        const auto start = chrono::steady_clock::now();
+        size_t count = 0;
+
+        try
+        {
+            // the packets decoded already go to the output in one block
+            optional<uint32_t> timestamp;
+
+            resampled.clear();
+
+            // the rate follows the device's clock
+            resampler.SetRatio(drift.GetRatio());
+
+            do
+            {
+                waited[count++] = start - staged.queued;
+
+                const RtpPacket& packet = *staged.packet;
+
+                if (packet.size() >= 4 && packet.size() <= m_frameBytes)
+                {
+                    // a single pass for the level meter, the mute and the progress
+                    static_assert(4 / sizeof(uint32_t) == 4 >> NUM_CHANNELS);
+                    const size_t sampleCount = packet.size() >> NUM_CHANNELS;
+
+                    int16_t* samples = (int16_t*)staged.packet->data();
+
+                    const PcmLevel level = MeasureLevel(samples, packet.size() / sizeof(int16_t));
+                    m_level = level;
+
+                    const bool hasSoundData = !level.silent;
+
+                    // optimistic mute of empty packets as long as we're not playing
+                    const bool mute = m_mute || (!playAudio.valid() && !hasSoundData);
+
+                    // 0 db passes unchanged
+                    if (hasSoundData && !mixerVolume)
+                    {
+                        gain.Process(samples, sampleCount);
+                    }
 
                     if (!mute)
                     {
-                        // write PCM data to sound-buffer, finally
-                        streamPCM->Write(packet->data(), written, &written);
+                        resampler.Process(samples, packet.size() / SAMPLE_FACTOR, resampled);
+                        timestamp = staged.timestamp;
                     }
                     if (hasSoundData)
                     {
                         // update the progress information
                         // (we need to do this even during mute)
-                        m_progressData += written;
+                        m_progressData += packet.size();
 
                         if (!m_isPlaying)
                         {
@@ -439,68 +876,122 @@ void HairTunes::RunQueue() noexcept
                 }
                 else
                 {
-                    // unexpected
-                    assert(false);
+                    // a corrupt frame the decoder has rejected
+                    assert(packet.size() == 0);
                 }
-                PutPacketToPool(move(packet));
+                PutPacketToPool(move(staged.packet));
+            } while (count < DECODE_BATCH_SIZE && m_outputQueue.TryPop(staged));
+
+            if (timestamp)
+            {
+                ULONG resampledBytes = static_cast<ULONG>(resampled.size() * sizeof(int16_t));
+
+                // write PCM data to sound-buffer, finally
+                streamPCM->Write(resampled.data(), resampledBytes, &resampledBytes);
+                framesWritten += resampledBytes / SAMPLE_FACTOR;
 
-                const size_t sizeStreamPCM = streamPCM->GetSize();
-                m_pendingData = sizeStreamPCM;
+                drift.OnSource(DriftEstimator::clock::now(), *timestamp);
 
-                // wait for PCM buffer to fill [ms] before we start playing
-                if (!playAudio.valid() && 
-                    ((sizeStreamPCM > ((msStartFill * m_samplingRate * SAMPLE_FACTOR) / 1000)) || m_stopThread))
+                if (const auto played = position->Get(); played && played->time != positionTime)
                 {
-                    // start playing after the sound buffer had been filled
-                    playAudio = AlsaAudio::Play(streamPCM, audioDevice);
+                    positionTime = played->time;
+                    drift.OnDevice(played->time, played->played, static_cast<int64_t>(framesWritten - played->played));
+
+                    if (m_msFirstAudio < 0 && played->played > 0)
+                    {
+                        m_msFirstAudio = chrono::duration_cast<chrono::milliseconds>(played->time - m_setupTime).count();
+                        spdlog::debug("time to first audio after SETUP: {} ms", m_msFirstAudio.load());
+
+                        if (const auto buffer = position->GetBuffer())
+                        {
+                            spdlog::info("output device buffer of {} frames ({} ms) in periods of {} frames, {} frames delay",
+                                buffer->buffer, (buffer->buffer * 1000) / m_samplingRate, buffer->period, played->delay);
+                        }
+                    }
+                    if (const auto xruns = position->GetXruns(); xruns.underruns + xruns.suspends != interruptions)
+                    {
+                        interruptions = xruns.underruns + xruns.suspends;
+                        spdlog::warn("output device of {} interrupted: {} underruns, {} suspends",
+                            m_clientID, xruns.underruns, xruns.suspends);
+                    }
                 }
             }
-            catch(...)
+            const size_t sizeStreamPCM = streamPCM->GetSize();
+            m_pendingData = sizeStreamPCM;
+
+            // wait for PCM buffer to fill [ms] before we start playing
+            if (!playAudio.valid() && 
+                ((sizeStreamPCM > ((m_msStartFill * m_samplingRate * SAMPLE_FACTOR) / 1000)) || m_stopThread))
             {
-            }
+                // the session before may still play what it has left
+                if (m_previousOutput.valid() && m_previousOutput.wait_for(0s) != future_status::ready)
+                {
+                    spdlog::debug("waiting for the output of the previous session");
 
-            // calculate volume as long as we're unlocked
-            const int64_t volumeDbNew = keyVolume.Get<int64_t>(m_config);
+                    while (m_previousOutput.wait_for(100ms) != future_status::ready && !m_stopThread)
+                    {
+                    }
+                }
+                m_previousOutput = {};
 
-            if (volumeDb != volumeDbNew)
+                // start playing after the sound buffer had been filled
+                playAudio = AlsaAudio::Play(streamPCM, audioDevice, position, bufferRequest);
+                m_outputPlaying = playAudio.valid();
+            }
+        }
+        catch(...)
+        {
+            if (staged.packet)
             {
-                volumeDb = volumeDbNew;
-                lfVolume = pow(10.0, volumeDb * 0.00005);
-                assert(lfVolume > 0. && lfVolume <= 1.);
+                PutPacketToPool(move(staged.packet));
             }
+        }
+        const auto processed = chrono::steady_clock::now() - start;
 
-            // lock before we loop
-            sync.lock();
-        } while (m_flush ? !m_packetQueue.empty() : m_packetQueue.size() > m_lowLevelQueue);
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_outputLatency.Add(waited[i], processed);
+        }
+
+        // calculate volume while no packet waits for us
+        const int64_t volumeDbNew = keyVolume.Get<int64_t>(m_config);
 
-        // garbage out the asynchronous resend requests
-        for (auto asyncResend = m_asyncResend.begin(); asyncResend != m_asyncResend.end(); )
+        if (volumeDb != volumeDbNew)
         {
-            if ((*asyncResend)->async.wait_for(0ms) == future_status::ready)
-            {
-                asyncResend = m_asyncResend.erase(asyncResend);
-            }
-            else
-            {
-                ++asyncResend;
-            }
+            volumeDb = volumeDbNew;
+            mixerVolume = setMixerVolume(volumeDb);
+            gain.SetGain(min<int64_t>(volumeDb, 0) / 1000.);
         }
     }
-    assert(m_packetQueue.empty());
 
-    streamPCM->SetMode(BlobStream::Mode::pipeClosed);
-    m_asyncResend.clear();
+    if (const auto played = position->Get())
+    {
+        spdlog::debug("output device delay: {} frames", played->delay);
+    }
+    if (const auto xruns = position->GetXruns(); xruns.underruns || xruns.suspends)
+    {
+        spdlog::info("output device of {} had {} underruns and {} suspends, {} ms silence, {} frames dropped",
+            m_clientID, xruns.underruns, xruns.suspends, xruns.silence.count() / 1000, xruns.droppedFrames);
+    }
+    const auto driftStats = drift.GetStats();
+    spdlog::debug("drift: {:.1f} ppm, resampling ratio {:.6f}, latency error {} frames, {} restarts",
+        driftStats.drift, driftStats.ratio, driftStats.latencyError, driftStats.restarts);
+
+    streamPCM->Close();
 
     if (playAudio.valid())
     {
-        while (streamPCM->GetSize())
+        // the player reads up to the end of the stream unless it failed
+        while (!streamPCM->WaitForSize(0, 100ms) && playAudio.wait_for(0s) != future_status::ready)
         {
-            this_thread::sleep_for(5ms);
         }
     }
+    const auto pcmStats = streamPCM->GetStats();
+    spdlog::debug("PCM buffer: {} bytes written, {} bytes read, {} bytes dropped, {} waits of the player",
+        pcmStats.written, pcmStats.read, pcmStats.dropped, pcmStats.waits);
 }
 
-void HairTunes::RequestResend(const USHORT nSeq, const short nCount) noexcept
+bool HairTunes::RequestResend(const USHORT nSeq, const USHORT nCount) noexcept
 {
 	// *not* a standard RTCP NACK
 	unsigned char req[8] = { 0 };						
@@ -518,1354 +1009,344 @@ void HairTunes::RequestResend(const USHORT nSeq, const short nCount) noexcept
 
     spdlog::debug("try to send resend request for seq: {} -> {}", nSeq, nSeq+nCount-1);
 	
-    if (!m_controlEndpoint->SendTo(req, sizeof(req), m_remoteControlPort))
-    {
-        spdlog::debug("failed to send resend request for seq: {} -> {}", nSeq, nSeq+nCount-1);
-    }
+    return m_controlEndpoint->SendTo(req, sizeof(req), m_remoteControlPort);
 }
 
-void HairTunes::Flush()
+void HairTunes::RunTiming() noexcept
 {
-    unique_lock<mutex> sync(m_mtxQueue);
-    ++m_flush;
-    spdlog::info("flushing while {} packets are queued", m_packetQueue.size());
+    unique_lock<mutex> sync(m_mtxTiming);
 
-    while(!m_packetQueue.empty())
+    for (unsigned int i = 1; !m_stopTiming; ++i)
     {
-        m_condQueue.NotifyAndUnlock(sync);
-        this_thread::sleep_for(5ms);
+        sync.unlock();
+        RequestTiming();
         sync.lock();
-    }
-    --m_flush;
-    spdlog::info("flushing done: {}", m_flush.load());
-}
 
-const std::string& HairTunes::GetClientID() const noexcept
-{
-    return m_clientID;
+        // a few quick requests at the beginning let the clock filter settle
+        const uint32_t ms = (i < TIMING_INITIAL_REQUESTS) ? TIMING_INITIAL_INTERVAL_MS : TIMING_INTERVAL_MS;
+
+        m_condTiming.WaitAndLock(sync, [this]() { return m_stopTiming; }, ms);
+    }
 }
 
-void HairTunes::QueuePacket(unique_ptr<RtpPacket>&& p, bool isResendPacket)
+void HairTunes::RequestTiming() noexcept
 {
-    // the endpoints are being destroyed already
-    // so there must no new packets arrive
-    // after stop-request
-    assert(!m_stopThread);
-
-	if (p->getDataLen() >= 16)
-	{
-		const USHORT nCurSeq = p->getSeqNo();
-
-		unique_lock<mutex> sync(m_mtxQueue);
+    try
+    {
+        auto packet = GetNewPacketFromPool();
 
-		if (!m_packetQueue.empty())
-		{
-			// check for lacking packets
-            const USHORT backSeqNo = m_packetQueue.back()->getSeqNo();
-			short nSeqDiff = nCurSeq - backSeqNo;
-
-			switch(nSeqDiff)
-			{
-				case 0:
-				{
-					spdlog::debug("packet {} already queued\n", (long)nCurSeq);
-				}
-				break;
-
-				case 1:
-				{
-                    if (!isResendPacket)
-                    {
-                        // expected sequence
-                        m_packetQueue.emplace_back(move(p));
+        packet->InitHeader(PAYLOAD_TYPE_TIMING_REQUEST, 32);
+        packet->setMarker();
+        packet->setSeqNo(7);
+        packet->setReferenceTime(0);
+        packet->setReceivedTime(0);
+        packet->setSendTime(PlayoutClock::NowNtp());
 
-                        if (m_packetQueue.size() > m_highLevelQueue)
-                        {
-                            m_condQueue.NotifyAndUnlock(sync);
-                        }
-                    }
-                    else
-                    {
-                        spdlog::debug("resend packet {} arrived too late and is being discarded\n", (long)nCurSeq);
-                    }
-                    return;
-				}
-				break;
-
-				default:
-				{
-					if (nSeqDiff > 1)
-					{
-                        if (!isResendPacket)
-                        {
-                            AsyncRequestResend(sync, backSeqNo+1, nSeqDiff-1);
-
-                            m_packetQueue.emplace_back(move(p));
-                            spdlog::debug("requested resend {} -> {}", backSeqNo+1, nCurSeq-1);
-                            
-                            if (m_packetQueue.size() > m_highLevelQueue)
-                            {
-                                m_condQueue.NotifyAndUnlock(sync);
-                            }                        
-                        }
-                        else
-                        {
-                            spdlog::debug("resend packet {} arrived too late and is being discarded\n", (long)nCurSeq);
-                        }
-                        return;
-					}
-					else
-					{
-						assert(nSeqDiff < 0);
-
-						for (auto i = m_packetQueue.begin(); i != m_packetQueue.end(); ++i)
-						{
-                            nSeqDiff = nCurSeq - i->get()->getSeqNo();
-
-							if (nSeqDiff > 0)
-                            {
-                                continue;
-                            }
-							if (nSeqDiff == 0)
-							{
-								return;
-							}
-                            spdlog::debug("insert seq {} before seq {}", nCurSeq, i->get()->getSeqNo());
-                            m_packetQueue.emplace(i, move(p));
-                            
-                            if (m_packetQueue.size() > m_highLevelQueue)
-                            {
-                                m_condQueue.NotifyAndUnlock(sync);
-                            }
-                            return;
-						}
-
-                        // we must not get here because
-                        // the initial nSeqDiff proved
-                        // that there has to be at least
-                        // the back item which has a later
-                        // sequence
-                        assert(false);
-					}
-				}
-				break;
-			}
-		}
-		else
-		{
-			// expected sequence (initial packet)
-            // we don't notify the worker thread yet
-            // because the queue has to be filled 
-            // with more than one packet
-			m_packetQueue.emplace_back(move(p));
-		}
-	}
-    else
+        if (!m_timingEndpoint->SendTo(packet->data(), packet->size(), m_remoteTimingPort))
+        {
+            spdlog::debug("failed to send timing request");
+        }
+        PutPacketToPool(move(packet));
+    }
+    catch (...)
     {
-        // unexpected data size
-        assert(false);
     }
 }
 
-void HairTunes::OnRequest(RtpEndpoint*, unique_ptr<RtpPacket>&& packet)
+void HairTunes::AnswerTiming(const RtpPacket& request) noexcept
 {
-	const uint8_t type = packet->getPayloadType();
-
-	switch (type)
-	{
-		case PAYLOAD_TYPE_RESEND_RESPONSE:
-		{
-            if (packet->size() > RTP_BASE_HEADER_SIZE)
-            {
-                const size_t szNew = packet->size() - RTP_BASE_HEADER_SIZE;
-
-                // shift data 4 bytes left
-                memmove(packet->data(), packet->data() + RTP_BASE_HEADER_SIZE, szNew);
-                
-                // resize to new size
-                packet->resize(szNew);
-
-                spdlog::debug("got resend response {}", packet->getSeqNo());
-                QueuePacket(move(packet), true);
-            }
-            else
-            {
-                assert(false);
-            }
-		}
-		break;
-
-		case PAYLOAD_TYPE_STREAM_DATA:
-		{
-			QueuePacket(move(packet), false);
-		}
-		break;
+    if (request.size() != 32 || !m_remoteTimingPort)
+    {
+        return;
+    }
+    try
+    {
+        const uint64_t received = PlayoutClock::NowNtp();
 
-		case PAYLOAD_TYPE_TIMING_RESPONSE:
-		case PAYLOAD_TYPE_TIMING_REQUEST:
-		{
-			assert(packet->size() == 32);
-		}
-		break;
+        auto packet = GetNewPacketFromPool();
 
-		case PAYLOAD_TYPE_STREAM_SYNC:
-		{
-		}
-		break;
+        packet->InitHeader(PAYLOAD_TYPE_TIMING_RESPONSE, 32);
+        packet->setMarker();
+        packet->setSeqNo(7);
+        packet->setReferenceTime(request.getSendTime());
+        packet->setReceivedTime(received);
+        packet->setSendTime(PlayoutClock::NowNtp());
 
-		default:
-		{
-		}
-		break;
-	}
-    if (packet)
+        m_timingEndpoint->SendTo(packet->data(), packet->size(), m_remoteTimingPort);
+        PutPacketToPool(move(packet));
+    }
+    catch (...)
     {
-	    PutPacketToPool(move(packet));
     }
 }
 
-unsigned int HairTunes::GetServerPort() const noexcept
-{
-    return m_dataEndpoint->GetPort();
-}
-    
-unsigned int HairTunes::GetControlPort() const noexcept
+void HairTunes::OnTimingResponse(const RtpPacket& response) noexcept
 {
-    return m_controlEndpoint->GetPort();
+    const uint64_t arrival = PlayoutClock::NowNtp();
+
+    if (response.size() != 32)
+    {
+        assert(false);
+        return;
+    }
+    if (!m_playoutClock->OnTimingResponse(response.getReferenceTime(), response.getReceivedTime(), response.getSendTime(), arrival))
+    {
+        spdlog::debug("discarding inconsistent timing response");
+    }
 }
 
-unsigned int HairTunes::GetTimingPort() const noexcept
+void HairTunes::OnSync(const RtpPacket& packet) noexcept
 {
-     return m_timingEndpoint->GetPort();
+    if (packet.size() < 20)
+    {
+        assert(false);
+        return;
+    }
+    m_playoutClock->OnSync(packet.getTimeLessLatency(), packet.getReferenceTime(), packet.getRtpSync());
 }
 
-namespace alac
-{
-/*
- * ALAC (Apple Lossless Audio Codec) decoder
- * Copyright (c) 2005 David Hammerton
- * All rights reserved.
- *
- * This is the actual decoder.
- *
- * http://crazney.net/programs/itunes/alac.html
- *
- * Permission is hereby granted, free of charge, to any person
- * obtaining a copy of this software and associated documentation
- * files (the "Software"), to deal in the Software without
- * restriction, including without limitation the rights to use,
- * copy, modify, merge, publish, distribute, sublicense, and/or
- * sell copies of the Software, and to permit persons to whom the
- * Software is furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be
- * included in all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
- * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
- * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
- * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
- * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
- * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
- * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
- * OTHER DEALINGS IN THE SOFTWARE.
- *
- */
-
-static const int host_bigendian = 0;
-
-#define _Swap32(v) do { \
-                   v = (((v) & 0x000000FF) << 0x18) | \
-                       (((v) & 0x0000FF00) << 0x08) | \
-                       (((v) & 0x00FF0000) >> 0x08) | \
-                       (((v) & 0xFF000000) >> 0x18); } while(0)
-
-#define _Swap16(v) do { \
-                   v = (((v) & 0x00FF) << 0x08) | \
-                       (((v) & 0xFF00) >> 0x08); } while (0)
-
-struct {signed int x:24;} se_struct_24;
-#define SignExtend24(val) (se_struct_24.x = val)
-
-void allocate_buffers(alac_file *alac)
+void HairTunes::Flush()
 {
-    alac->predicterror_buffer_a = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
-    alac->predicterror_buffer_b = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
-
-    alac->outputsamples_buffer_a = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
-    alac->outputsamples_buffer_b = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+    unique_lock<mutex> sync(m_mtxQueue);
+    ++m_flush;
+    spdlog::info("flushing while {} packets are queued", m_jitterBuffer.Size());
 
-    alac->uncompressed_bytes_buffer_a = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
-    alac->uncompressed_bytes_buffer_b = (int32_t *)malloc(alac->setinfo_max_samples_per_frame * 4);
+    while(!m_jitterBuffer.Empty())
+    {
+        m_condQueue.NotifyAndUnlock(sync);
+        this_thread::sleep_for(5ms);
+        sync.lock();
+    }
+    // the stream may continue with any sequence number
+    m_jitterBuffer.Reset();
+    m_resendScheduler.Clear();
+    m_playoutClock->ResetSync();
+    --m_flush;
+    spdlog::info("flushing done: {}", m_flush.load());
 }
 
-static void deallocate_buffers(alac_file *alac) noexcept
+const std::string& HairTunes::GetClientID() const noexcept
 {
-    free(alac->predicterror_buffer_a);
-    free(alac->predicterror_buffer_b);
-
-    free(alac->outputsamples_buffer_a);
-    free(alac->outputsamples_buffer_b);
-
-    free(alac->uncompressed_bytes_buffer_a);
-    free(alac->uncompressed_bytes_buffer_b);
+    return m_clientID;
 }
 
-void alac_set_info(alac_file *alac, char *inputbuffer)
+void HairTunes::QueuePacket(unique_ptr<RtpPacket>&& p, bool isResendPacket)
 {
-  char *ptr = inputbuffer;
-  ptr += 4; /* size */
-  ptr += 4; /* frma */
-  ptr += 4; /* alac */
-  ptr += 4; /* size */
-  ptr += 4; /* alac */
-
-  ptr += 4; /* 0 ? */
-
-  alac->setinfo_max_samples_per_frame = *(uint32_t*)ptr; /* buffer size / 2 ? */
-  if (!host_bigendian)
-      _Swap32(alac->setinfo_max_samples_per_frame);
-  ptr += 4;
-  alac->setinfo_7a = *(uint8_t*)ptr;
-  ptr += 1;
-  alac->setinfo_sample_size = *(uint8_t*)ptr;
-  ptr += 1;
-  alac->setinfo_rice_historymult = *(uint8_t*)ptr;
-  ptr += 1;
-  alac->setinfo_rice_initialhistory = *(uint8_t*)ptr;
-  ptr += 1;
-  alac->setinfo_rice_kmodifier = *(uint8_t*)ptr;
-  ptr += 1;
-  alac->setinfo_7f = *(uint8_t*)ptr;
-  ptr += 1;
-  alac->setinfo_80 = *(uint16_t*)ptr;
-  if (!host_bigendian)
-      _Swap16(alac->setinfo_80);
-  ptr += 2;
-  alac->setinfo_82 = *(uint32_t*)ptr;
-  if (!host_bigendian)
-      _Swap32(alac->setinfo_82);
-  ptr += 4;
-  alac->setinfo_86 = *(uint32_t*)ptr;
-  if (!host_bigendian)
-      _Swap32(alac->setinfo_86);
-  ptr += 4;
-  alac->setinfo_8a_rate = *(uint32_t*)ptr;
-  if (!host_bigendian)
-      _Swap32(alac->setinfo_8a_rate);
-
-  allocate_buffers(alac);
+    unique_lock<mutex> sync(m_mtxQueue);
 
+    QueuePacket(sync, move(p), isResendPacket);
+    NotifyQueue(sync);
 }
 
-/* stream reading */
-
-/* supports reading 1 to 16 bits, in big endian format */
-static uint32_t readbits_16(alac_file *alac, int bits)
+void HairTunes::NotifyQueue(unique_lock<mutex>& sync) noexcept
 {
-    uint32_t result;
-    int new_accumulator;
+    assert(sync.owns_lock());
 
-    result = (alac->input_buffer[0] << 16) |
-             (alac->input_buffer[1] << 8) |
-             (alac->input_buffer[2]);
+    // a synchronized stream lets the worker thread decide by time
+    if (m_jitterBuffer.Size() > m_highLevelQueue || m_playoutClock->IsSynchronized())
+    {
+        m_condQueue.NotifyAndUnlock(sync);
+    }
+}
 
-    /* shift left by the number of bits we've already read,
-     * so that the top 'n' bits of the 24 bits we read will
-     * be the return bits */
-    result = result << alac->input_buffer_bitaccumulator;
-
-    result = result & 0x00ffffff;
-
-    /* and then only want the top 'n' bits from that, where
-     * n is 'bits' */
-    result = result >> (24 - bits);
-
-    new_accumulator = (alac->input_buffer_bitaccumulator + bits);
-
-    /* increase the buffer pointer if we've read over n bytes. */
-    alac->input_buffer += (new_accumulator >> 3);
-
-    /* and the remainder goes back into the bit accumulator */
-    alac->input_buffer_bitaccumulator = (new_accumulator & 7);
-
-    return result;
-}
-
-/* supports reading 1 to 32 bits, in big endian format */
-static uint32_t readbits(alac_file *alac, int bits)
-{
-    int32_t result = 0;
-
-    if (bits > 16)
-    {
-        bits -= 16;
-        result = readbits_16(alac, 16) << bits;
-    }
-
-    result |= readbits_16(alac, bits);
-
-    return result;
-}
-
-/* reads a single bit */
-static int readbit(alac_file *alac)
-{
-    int result;
-    int new_accumulator;
-
-    result = alac->input_buffer[0];
-
-    result = result << alac->input_buffer_bitaccumulator;
-
-    result = result >> 7 & 1;
-
-    new_accumulator = (alac->input_buffer_bitaccumulator + 1);
-
-    alac->input_buffer += (new_accumulator / 8);
-
-    alac->input_buffer_bitaccumulator = (new_accumulator % 8);
-
-    return result;
-}
-
-static void unreadbits(alac_file *alac, int bits)
-{
-    int new_accumulator = (alac->input_buffer_bitaccumulator - bits);
-
-    alac->input_buffer += (new_accumulator >> 3);
-
-    alac->input_buffer_bitaccumulator = (new_accumulator & 7);
-    if (alac->input_buffer_bitaccumulator < 0)
-        alac->input_buffer_bitaccumulator *= -1;
-}
-
-/* various implementations of count_leading_zero:
- * the first one is the original one, the simplest and most
- * obvious for what it's doing. never use this.
- * then there are the asm ones. fill in as necessary
- * and finally an unrolled and optimised c version
- * to fall back to
- */
-#if 0
-/* hideously inefficient. could use a bitmask search,
- * alternatively bsr on x86,
- */
-static int count_leading_zeros(int32_t input)
-{
-    int i = 0;
-    while (!(0x80000000 & input) && i < 32)
-    {
-        i++;
-        input = input << 1;
-    }
-    return i;
-}
-#elif defined(__GNUC__)
-/* for some reason the unrolled version (below) is
- * actually faster than this. yay intel!
- */
-static int count_leading_zeros(int input)
-{
-    return __builtin_clz(input);
-}
-#elif defined(_MSC_VER) && defined(_M_IX86)
-static int count_leading_zeros(int input)
-{
-    int output = 0;
-    if (!input) return 32;
-    __asm
-    {
-        mov eax, input;
-        mov edx, 0x1f;
-        bsr ecx, eax;
-        sub edx, ecx;
-        mov output, edx;
-    }
-    return output;
-}
-#else
-
-static int count_leading_zeros(int input)
-{
-    int output = 0;
-    int curbyte = 0;
-
-    curbyte = input >> 24;
-    if (curbyte) goto found;
-    output += 8;
-
-    curbyte = input >> 16;
-    if (curbyte & 0xff) goto found;
-    output += 8;
-
-    curbyte = input >> 8;
-    if (curbyte & 0xff) goto found;
-    output += 8;
-
-    curbyte = input;
-    if (curbyte & 0xff) goto found;
-    output += 8;
-
-    return output;
-
-found:
-    if (!(curbyte & 0xf0))
-    {
-        output += 4;
-    }
-    else
-        curbyte >>= 4;
-
-    if (curbyte & 0x8)
-        return output;
-    if (curbyte & 0x4)
-        return output + 1;
-    if (curbyte & 0x2)
-        return output + 2;
-    if (curbyte & 0x1)
-        return output + 3;
-
-    /* shouldn't get here: */
-    return output + 4;
-}
-#endif
-
-#define RICE_THRESHOLD 8 // maximum number of bits for a rice prefix.
-
-static int32_t entropy_decode_value(alac_file* alac,
-                             int readSampleSize,
-                             int k,
-                             int rice_kmodifier_mask)
+// the caller holds m_mtxQueue and is in charge of notifying the worker thread
+void HairTunes::QueuePacket(const unique_lock<mutex>& sync, unique_ptr<RtpPacket>&& p, bool isResendPacket)
 {
-    int32_t x = 0; // decoded value
-
-    // read x, number of 1s before 0 represent the rice value.
-    while (x <= RICE_THRESHOLD && readbit(alac))
-    {
-        x++;
-    }
-
-    if (x > RICE_THRESHOLD)
-    {
-        // read the number from the bit stream (raw value)
-        int32_t value;
-
-        value = readbits(alac, readSampleSize);
+    // the endpoints are being destroyed already
+    // so there must no new packets arrive
+    // after stop-request
+    assert(!m_stopThread);
+    assert(sync.owns_lock());
 
-        // mask value
-        value &= (((uint32_t)0xffffffff) >> (32 - readSampleSize));
+	if (p->getDataLen() < 16)
+	{
+        // unexpected data size
+        assert(false);
+        return;
+	}
+	const USHORT nCurSeq = p->getSeqNo();
 
-        x = value;
-    }
-    else
+    if (m_jitterBuffer.IsMissing(nCurSeq))
     {
-        if (k != 1)
-        {
-            int extraBits = readbits(alac, k);
-
-            // x = x * (2^k - 1)
-            x *= (((1 << k) - 1) & rice_kmodifier_mask);
-
-            if (extraBits > 1)
-                x += extraBits - 1;
-            else
-                unreadbits(alac, 1);
-        }
+        // the gap is closed, either by a resent or a reordered packet
+        m_resendScheduler.OnArrival(nCurSeq, isResendPacket);
     }
-
-    return x;
-}
-
-static void entropy_rice_decode(alac_file* alac,
-                         int32_t* outputBuffer,
-                         int outputSize,
-                         int readSampleSize,
-                         int rice_initialhistory,
-                         int rice_kmodifier,
-                         int rice_historymult,
-                         int rice_kmodifier_mask)
-{
-    int             outputCount;
-    int             history = rice_initialhistory;
-    int             signModifier = 0;
-
-    for (outputCount = 0; outputCount < outputSize; outputCount++)
+    else if (isResendPacket)
     {
-        int32_t     decodedValue;
-        int32_t     finalValue;
-        int32_t     k;
-
-        k = 31 - rice_kmodifier - count_leading_zeros((history >> 9) + 3);
-
-        if (k < 0) k += rice_kmodifier;
-        else k = rice_kmodifier;
-
-        // note: don't use rice_kmodifier_mask here (set mask to 0xFFFFFFFF)
-        decodedValue = entropy_decode_value(alac, readSampleSize, k, 0xFFFFFFFF);
-
-        decodedValue += signModifier;
-        finalValue = (decodedValue + 1) / 2; // inc by 1 and shift out sign bit
-        if (decodedValue & 1) // the sign is stored in the low bit
-            finalValue *= -1;
-
-        outputBuffer[outputCount] = finalValue;
-
-        signModifier = 0;
-
-        // update history
-        history += (decodedValue * rice_historymult)
-                - ((history * rice_historymult) >> 9);
-
-        if (decodedValue > 0xFFFF)
-            history = 0xFFFF;
-
-        // special case, for compressed blocks of 0
-        if ((history < 128) && (outputCount + 1 < outputSize))
-        {
-            int32_t     blockSize;
-
-            signModifier = 1;
-
-            k = count_leading_zeros(history) + ((history + 16) / 64) - 24;
-
-            // note: blockSize is always 16bit
-            blockSize = entropy_decode_value(alac, 16, k, rice_kmodifier_mask);
-
-            // got blockSize 0s
-            if (blockSize > 0)
-            {
-                memset(&outputBuffer[outputCount + 1], 0, blockSize * sizeof(*outputBuffer));
-                outputCount += blockSize;
-            }
-
-            if (blockSize > 0xFFFF)
-                signModifier = 0;
-
-            history = 0;
-        }
-    }
-}
-
-#define SIGN_EXTENDED32(val, bits) ((val << (32 - bits)) >> (32 - bits))
-
-#define SIGN_ONLY(v) \
-                     ((v < 0) ? (-1) : \
-                                ((v > 0) ? (1) : \
-                                           (0)))
-
-static void predictor_decompress_fir_adapt(int32_t *error_buffer,
-                                           int32_t *buffer_out,
-                                           int output_size,
-                                           int readsamplesize,
-                                           int16_t *predictor_coef_table,
-                                           int predictor_coef_num,
-                                           int predictor_quantitization)
-{
-    int i;
-
-    /* first sample always copies */
-    *buffer_out = *error_buffer;
-
-    if (!predictor_coef_num)
-    {
-        if (output_size <= 1) return;
-        memcpy(buffer_out+1, error_buffer+1, (output_size-1) * 4);
+        m_resendScheduler.OnTooLate(nCurSeq);
+        spdlog::debug("resend packet {} arrived too late and is being discarded", nCurSeq);
         return;
     }
+    if (!isResendPacket && m_jitterBuffer.IsStarted())
+    {
+        // check for lacking packets
+        const USHORT endSeqNo = m_jitterBuffer.GetEndSeqNo();
+        const int nSeqDiff = JitterBuffer::Distance(endSeqNo, nCurSeq);
 
-    if (predictor_coef_num == 0x1f) /* 11111 - max value of predictor_coef_num */
-    { /* second-best case scenario for fir decompression,
-       * error describes a small difference from the previous sample only
-       */
-        if (output_size <= 1) return;
-        for (i = 0; i < output_size - 1; i++)
+        if (nSeqDiff > 0 && nSeqDiff < static_cast<int>(m_jitterBuffer.Capacity()))
         {
-            int32_t prev_value;
-            int32_t error_value;
-
-            prev_value = buffer_out[i];
-            error_value = error_buffer[i+1];
-            buffer_out[i+1] = SIGN_EXTENDED32((prev_value + error_value), readsamplesize);
+            ScheduleResend(sync, endSeqNo, static_cast<USHORT>(nSeqDiff));
+            spdlog::debug("requested resend {} -> {}", endSeqNo, (USHORT)(nCurSeq - 1));
         }
-        return;
     }
 
-    /* read warm-up samples */
-    if (predictor_coef_num > 0)
+    switch (m_jitterBuffer.Insert(move(p)))
     {
-        int i;
-        for (i = 0; i < predictor_coef_num; i++)
+        case JitterBuffer::InsertResult::duplicate:
         {
-            int32_t val;
-
-            val = buffer_out[i] + error_buffer[i+1];
-
-            val = SIGN_EXTENDED32(val, readsamplesize);
-
-            buffer_out[i+1] = val;
+            spdlog::debug("packet {} already queued", nCurSeq);
         }
-    }
-
-#if 0
-    /* 4 and 8 are very common cases (the only ones i've seen). these
-     * should be unrolled and optimised
-     */
-    if (predictor_coef_num == 4)
-    {
-        /* FIXME: optimised general case */
-        return;
-    }
-
-    if (predictor_coef_table == 8)
-    {
-        /* FIXME: optimised general case */
-        return;
-    }
-#endif
-
+        break;
 
-    /* general case */
-    if (predictor_coef_num > 0)
-    {
-        for (i = predictor_coef_num + 1;
-             i < output_size;
-             i++)
+        case JitterBuffer::InsertResult::late:
         {
-            int j;
-            int sum = 0;
-            int outval;
-            int error_val = error_buffer[i];
-
-            for (j = 0; j < predictor_coef_num; j++)
-            {
-                sum += (buffer_out[predictor_coef_num-j] - buffer_out[0]) *
-                       predictor_coef_table[j];
-            }
-
-            outval = (1 << (predictor_quantitization-1)) + sum;
-            outval = outval >> predictor_quantitization;
-            outval = outval + buffer_out[0] + error_val;
-            outval = SIGN_EXTENDED32(outval, readsamplesize);
-
-            buffer_out[predictor_coef_num+1] = outval;
-
-            if (error_val > 0)
-            {
-                int predictor_num = predictor_coef_num - 1;
-
-                while (predictor_num >= 0 && error_val > 0)
-                {
-                    int val = buffer_out[0] - buffer_out[predictor_coef_num - predictor_num];
-                    int sign = SIGN_ONLY(val);
-
-                    predictor_coef_table[predictor_num] -= sign;
-
-                    val *= sign; /* absolute value */
-
-                    error_val -= ((val >> predictor_quantitization) *
-                                  (predictor_coef_num - predictor_num));
-
-                    predictor_num--;
-                }
-            }
-            else if (error_val < 0)
-            {
-                int predictor_num = predictor_coef_num - 1;
-
-                while (predictor_num >= 0 && error_val < 0)
-                {
-                    int val = buffer_out[0] - buffer_out[predictor_coef_num - predictor_num];
-                    int sign = - SIGN_ONLY(val);
-
-                    predictor_coef_table[predictor_num] -= sign;
-
-                    val *= sign; /* neg value */
-
-                    error_val -= ((val >> predictor_quantitization) *
-                                  (predictor_coef_num - predictor_num));
-
-                    predictor_num--;
-                }
-            }
-
-            buffer_out++;
+            spdlog::debug("packet {} arrived too late and is being discarded", nCurSeq);
         }
-    }
-}
-
-static void deinterlace_16(int32_t *buffer_a, int32_t *buffer_b,
-                    int16_t *buffer_out,
-                    int numchannels, int numsamples,
-                    uint8_t interlacing_shift,
-                    uint8_t interlacing_leftweight)
-{
-    int i;
-    if (numsamples <= 0) return;
+        break;
 
-    /* weighted interlacing */
-    if (interlacing_leftweight)
-    {
-        for (i = 0; i < numsamples; i++)
+        case JitterBuffer::InsertResult::resynced:
         {
-            int32_t difference, midright;
-            int16_t left;
-            int16_t right;
-
-            midright = buffer_a[i];
-            difference = buffer_b[i];
+            spdlog::info("stream resynchronized at packet {}", nCurSeq);
 
-
-            right = midright - ((difference * interlacing_leftweight) >> interlacing_shift);
-            left = right + difference;
-
-            /* output is always little endian */
-            if (host_bigendian)
-            {
-                _Swap16(left);
-                _Swap16(right);
-            }
-
-            buffer_out[i*numchannels] = left;
-            buffer_out[i*numchannels + 1] = right;
+            // none of the pending sequences will be played
+            m_resendScheduler.Clear();
         }
+        break;
 
-        return;
-    }
-
-    /* otherwise basic interlacing took place */
-    for (i = 0; i < numsamples; i++)
-    {
-        int16_t left, right;
-
-        left = buffer_a[i];
-        right = buffer_b[i];
-
-        /* output is always little endian */
-        if (host_bigendian)
+        default:
         {
-            _Swap16(left);
-            _Swap16(right);
         }
-
-        buffer_out[i*numchannels] = left;
-        buffer_out[i*numchannels + 1] = right;
+        break;
     }
 }
 
-static void deinterlace_24(int32_t *buffer_a, int32_t *buffer_b,
-                    int uncompressed_bytes,
-                    int32_t *uncompressed_bytes_buffer_a, int32_t *uncompressed_bytes_buffer_b,
-                    void *buffer_out,
-                    int numchannels, int numsamples,
-                    uint8_t interlacing_shift,
-                    uint8_t interlacing_leftweight)
+bool HairTunes::UnwrapResendResponse(RtpPacket& packet) noexcept
 {
-    int i;
-    if (numsamples <= 0) return;
-
-    /* weighted interlacing */
-    if (interlacing_leftweight)
-    {
-        for (i = 0; i < numsamples; i++)
-        {
-            int32_t difference, midright;
-            int32_t left;
-            int32_t right;
-
-            midright = buffer_a[i];
-            difference = buffer_b[i];
-
-            right = midright - ((difference * interlacing_leftweight) >> interlacing_shift);
-            left = right + difference;
-
-            if (uncompressed_bytes)
-            {
-                uint32_t mask = ~(0xFFFFFFFF << (uncompressed_bytes * 8));
-                left <<= (uncompressed_bytes * 8);
-                right <<= (uncompressed_bytes * 8);
-
-                left |= uncompressed_bytes_buffer_a[i] & mask;
-                right |= uncompressed_bytes_buffer_b[i] & mask;
-            }
-
-            ((uint8_t*)buffer_out)[i * numchannels * 3] = (left) & 0xFF;
-            ((uint8_t*)buffer_out)[i * numchannels * 3 + 1] = (left >> 8) & 0xFF;
-            ((uint8_t*)buffer_out)[i * numchannels * 3 + 2] = (left >> 16) & 0xFF;
-
-            ((uint8_t*)buffer_out)[i * numchannels * 3 + 3] = (right) & 0xFF;
-            ((uint8_t*)buffer_out)[i * numchannels * 3 + 4] = (right >> 8) & 0xFF;
-            ((uint8_t*)buffer_out)[i * numchannels * 3 + 5] = (right >> 16) & 0xFF;
-        }
-
-        return;
-    }
-
-    /* otherwise basic interlacing took place */
-    for (i = 0; i < numsamples; i++)
+    if (packet.size() > RTP_BASE_HEADER_SIZE)
     {
-        int32_t left, right;
-
-        left = buffer_a[i];
-        right = buffer_b[i];
-
-        if (uncompressed_bytes)
-        {
-            uint32_t mask = ~(0xFFFFFFFF << (uncompressed_bytes * 8));
-            left <<= (uncompressed_bytes * 8);
-            right <<= (uncompressed_bytes * 8);
+        const size_t szNew = packet.size() - RTP_BASE_HEADER_SIZE;
 
-            left |= uncompressed_bytes_buffer_a[i] & mask;
-            right |= uncompressed_bytes_buffer_b[i] & mask;
-        }
-
-        ((uint8_t*)buffer_out)[i * numchannels * 3] = (left) & 0xFF;
-        ((uint8_t*)buffer_out)[i * numchannels * 3 + 1] = (left >> 8) & 0xFF;
-        ((uint8_t*)buffer_out)[i * numchannels * 3 + 2] = (left >> 16) & 0xFF;
-
-        ((uint8_t*)buffer_out)[i * numchannels * 3 + 3] = (right) & 0xFF;
-        ((uint8_t*)buffer_out)[i * numchannels * 3 + 4] = (right >> 8) & 0xFF;
-        ((uint8_t*)buffer_out)[i * numchannels * 3 + 5] = (right >> 16) & 0xFF;
+        // shift data 4 bytes left
+        memmove(packet.data(), packet.data() + RTP_BASE_HEADER_SIZE, szNew);
+        
+        // resize to new size
+        packet.resize(szNew);
 
+        spdlog::debug("got resend response {}", packet.getSeqNo());
+        return true;
     }
-
+    assert(false);
+    return false;
 }
 
-void decode_frame(alac_file *alac,
-                  unsigned char *inbuffer,
-                  void *outbuffer, int *outputsize)
+void HairTunes::OnBatchRequest(RtpEndpoint* endpoint, RtpPacketBatch& packets)
 {
-    int channels;
-    int32_t outputsamples = alac->setinfo_max_samples_per_frame;
-
-    /* setup the stream */
-    alac->input_buffer = inbuffer;
-    alac->input_buffer_bitaccumulator = 0;
-
-    channels = readbits(alac, 3);
+    // audio packets of a batch are queued under a single lock
+    // and the worker thread is notified once per batch
+    unique_lock<mutex> sync(m_mtxQueue, defer_lock);
 
-    *outputsize = outputsamples * alac->bytespersample;
-
-    switch(channels)
-    {
-    case 0: /* 1 channel */
+    for (auto& packet : packets)
     {
-        int hassize;
-        int isnotcompressed;
-        int readsamplesize;
-
-        int uncompressed_bytes;
-        int ricemodifier;
-
-        /* 2^result = something to do with output waiting.
-         * perhaps matters if we read > 1 frame in a pass?
-         */
-        readbits(alac, 4);
-
-        readbits(alac, 12); /* unknown, skip 12 bits */
-
-        hassize = readbits(alac, 1); /* the output sample size is stored soon */
-
-        uncompressed_bytes = readbits(alac, 2); /* number of bytes in the (compressed) stream that are not compressed */
-
-        isnotcompressed = readbits(alac, 1); /* whether the frame is compressed */
-
-        if (hassize)
+        switch (packet->getPayloadType())
         {
-            /* now read the number of samples,
-             * as a 32bit integer */
-            outputsamples = readbits(alac, 32);
-            *outputsize = outputsamples * alac->bytespersample;
-        }
-
-        readsamplesize = alac->setinfo_sample_size - (uncompressed_bytes * 8);
-
-        if (!isnotcompressed)
-        { /* so it is compressed */
-            int16_t predictor_coef_table[32];
-            int predictor_coef_num;
-            int prediction_type;
-            int prediction_quantitization;
-            int i;
-
-            /* skip 16 bits, not sure what they are. seem to be used in
-             * two channel case */
-            readbits(alac, 8);
-            readbits(alac, 8);
-
-            prediction_type = readbits(alac, 4);
-            prediction_quantitization = readbits(alac, 4);
-
-            ricemodifier = readbits(alac, 3);
-            predictor_coef_num = readbits(alac, 5);
-
-            /* read the predictor table */
-            for (i = 0; i < predictor_coef_num; i++)
-            {
-                predictor_coef_table[i] = (int16_t)readbits(alac, 16);
-            }
-
-            if (uncompressed_bytes)
+            case PAYLOAD_TYPE_RESEND_RESPONSE:
             {
-                int i;
-                for (i = 0; i < outputsamples; i++)
+                if (UnwrapResendResponse(*packet))
                 {
-                    alac->uncompressed_bytes_buffer_a[i] = readbits(alac, uncompressed_bytes * 8);
+                    if (!sync.owns_lock())
+                    {
+                        sync.lock();
+                    }
+                    QueuePacket(sync, move(packet), true);
                 }
             }
+            break;
 
-            entropy_rice_decode(alac,
-                                alac->predicterror_buffer_a,
-                                outputsamples,
-                                readsamplesize,
-                                alac->setinfo_rice_initialhistory,
-                                alac->setinfo_rice_kmodifier,
-                                ricemodifier * alac->setinfo_rice_historymult / 4,
-                                (1 << alac->setinfo_rice_kmodifier) - 1);
-
-            if (prediction_type == 0)
-            { /* adaptive fir */
-                predictor_decompress_fir_adapt(alac->predicterror_buffer_a,
-                                               alac->outputsamples_buffer_a,
-                                               outputsamples,
-                                               readsamplesize,
-                                               predictor_coef_table,
-                                               predictor_coef_num,
-                                               prediction_quantitization);
-            }
-            else
-            {
-                spdlog::debug( "FIXME: unhandled predicition type: %i\n", prediction_type);
-                /* i think the only other prediction type (or perhaps this is just a
-                 * boolean?) runs adaptive fir twice.. like:
-                 * predictor_decompress_fir_adapt(predictor_error, tempout, ...)
-                 * predictor_decompress_fir_adapt(predictor_error, outputsamples ...)
-                 * little strange..
-                 */
-            }
-
-        }
-        else
-        { /* not compressed, easy case */
-            if (alac->setinfo_sample_size <= 16)
-            {
-                int i;
-                for (i = 0; i < outputsamples; i++)
-                {
-                    int32_t audiobits = readbits(alac, alac->setinfo_sample_size);
-
-                    audiobits = SIGN_EXTENDED32(audiobits, alac->setinfo_sample_size);
-
-                    alac->outputsamples_buffer_a[i] = audiobits;
-                }
-            }
-            else
+            case PAYLOAD_TYPE_STREAM_DATA:
             {
-                int i;
-                for (i = 0; i < outputsamples; i++)
+                if (!sync.owns_lock())
                 {
-                    int32_t audiobits;
-
-                    audiobits = readbits(alac, 16);
-                    /* special case of sign extension..
-                     * as we'll be ORing the low 16bits into this */
-                    audiobits = audiobits << (alac->setinfo_sample_size - 16);
-                    audiobits |= readbits(alac, alac->setinfo_sample_size - 16);
-                    audiobits = SignExtend24(audiobits);
-
-                    alac->outputsamples_buffer_a[i] = audiobits;
+                    sync.lock();
                 }
-            }
-            uncompressed_bytes = 0; // always 0 for uncompressed
-        }
-
-        switch(alac->setinfo_sample_size)
-        {
-        case 16:
-        {
-            int i;
-            for (i = 0; i < outputsamples; i++)
-            {
-                int16_t sample = alac->outputsamples_buffer_a[i];
-                if (host_bigendian)
-                    _Swap16(sample);
-                ((int16_t*)outbuffer)[i * alac->numchannels] = sample;
+                QueuePacket(sync, move(packet), false);
             }
             break;
-        }
-        case 24:
-        {
-            int i;
-            for (i = 0; i < outputsamples; i++)
-            {
-                int32_t sample = alac->outputsamples_buffer_a[i];
 
-                if (uncompressed_bytes)
-                {
-                    uint32_t mask;
-                    sample = sample << (uncompressed_bytes * 8);
-                    mask = ~(0xFFFFFFFF << (uncompressed_bytes * 8));
-                    sample |= alac->uncompressed_bytes_buffer_a[i] & mask;
-                }
-
-                ((uint8_t*)outbuffer)[i * alac->numchannels * 3] = (sample) & 0xFF;
-                ((uint8_t*)outbuffer)[i * alac->numchannels * 3 + 1] = (sample >> 8) & 0xFF;
-                ((uint8_t*)outbuffer)[i * alac->numchannels * 3 + 2] = (sample >> 16) & 0xFF;
+            default:
+            {
+                // none of the remaining types touches the queue
+                OnRequest(endpoint, move(packet));
             }
             break;
         }
-        case 20:
-        case 32:
-            spdlog::debug( "FIXME: unimplemented sample size %i\n", alac->setinfo_sample_size);
-            break;
-        default:
-            break;
-        }
-        break;
     }
-    case 1: /* 2 channels */
+    if (sync.owns_lock())
     {
-        int hassize;
-        int isnotcompressed;
-        int readsamplesize;
-
-        int uncompressed_bytes;
-
-        uint8_t interlacing_shift;
-        uint8_t interlacing_leftweight;
-
-        /* 2^result = something to do with output waiting.
-         * perhaps matters if we read > 1 frame in a pass?
-         */
-        readbits(alac, 4);
-
-        readbits(alac, 12); /* unknown, skip 12 bits */
-
-        hassize = readbits(alac, 1); /* the output sample size is stored soon */
-
-        uncompressed_bytes = readbits(alac, 2); /* the number of bytes in the (compressed) stream that are not compressed */
-
-        isnotcompressed = readbits(alac, 1); /* whether the frame is compressed */
-
-        if (hassize)
-        {
-            /* now read the number of samples,
-             * as a 32bit integer */
-            outputsamples = readbits(alac, 32);
-            *outputsize = outputsamples * alac->bytespersample;
-        }
-
-        readsamplesize = alac->setinfo_sample_size - (uncompressed_bytes * 8) + 1;
-
-        if (!isnotcompressed)
-        { /* compressed */
-            int16_t predictor_coef_table_a[32];
-            int predictor_coef_num_a;
-            int prediction_type_a;
-            int prediction_quantitization_a;
-            int ricemodifier_a;
-
-            int16_t predictor_coef_table_b[32];
-            int predictor_coef_num_b;
-            int prediction_type_b;
-            int prediction_quantitization_b;
-            int ricemodifier_b;
-
-            int i;
-
-            interlacing_shift = readbits(alac, 8);
-            interlacing_leftweight = readbits(alac, 8);
-
-            /******** channel 1 ***********/
-            prediction_type_a = readbits(alac, 4);
-            prediction_quantitization_a = readbits(alac, 4);
-
-            ricemodifier_a = readbits(alac, 3);
-            predictor_coef_num_a = readbits(alac, 5);
-
-            /* read the predictor table */
-            for (i = 0; i < predictor_coef_num_a; i++)
-            {
-                predictor_coef_table_a[i] = (int16_t)readbits(alac, 16);
-            }
-
-            /******** channel 2 *********/
-            prediction_type_b = readbits(alac, 4);
-            prediction_quantitization_b = readbits(alac, 4);
-
-            ricemodifier_b = readbits(alac, 3);
-            predictor_coef_num_b = readbits(alac, 5);
-
-            /* read the predictor table */
-            for (i = 0; i < predictor_coef_num_b; i++)
-            {
-                predictor_coef_table_b[i] = (int16_t)readbits(alac, 16);
-            }
-
-            /*********************/
-            if (uncompressed_bytes)
-            { /* see mono case */
-                int i;
-                for (i = 0; i < outputsamples; i++)
-                {
-                    alac->uncompressed_bytes_buffer_a[i] = readbits(alac, uncompressed_bytes * 8);
-                    alac->uncompressed_bytes_buffer_b[i] = readbits(alac, uncompressed_bytes * 8);
-                }
-            }
+        NotifyQueue(sync);
+    }
+}
 
-            /* channel 1 */
-            entropy_rice_decode(alac,
-                                alac->predicterror_buffer_a,
-                                outputsamples,
-                                readsamplesize,
-                                alac->setinfo_rice_initialhistory,
-                                alac->setinfo_rice_kmodifier,
-                                ricemodifier_a * alac->setinfo_rice_historymult / 4,
-                                (1 << alac->setinfo_rice_kmodifier) - 1);
-
-            if (prediction_type_a == 0)
-            { /* adaptive fir */
-                predictor_decompress_fir_adapt(alac->predicterror_buffer_a,
-                                               alac->outputsamples_buffer_a,
-                                               outputsamples,
-                                               readsamplesize,
-                                               predictor_coef_table_a,
-                                               predictor_coef_num_a,
-                                               prediction_quantitization_a);
-            }
-            else
-            { /* see mono case */
-                spdlog::debug( "FIXME: unhandled predicition type: %i\n", prediction_type_a);
-            }
+void HairTunes::OnRequest(RtpEndpoint*, unique_ptr<RtpPacket>&& packet)
+{
+	const uint8_t type = packet->getPayloadType();
 
-            /* channel 2 */
-            entropy_rice_decode(alac,
-                                alac->predicterror_buffer_b,
-                                outputsamples,
-                                readsamplesize,
-                                alac->setinfo_rice_initialhistory,
-                                alac->setinfo_rice_kmodifier,
-                                ricemodifier_b * alac->setinfo_rice_historymult / 4,
-                                (1 << alac->setinfo_rice_kmodifier) - 1);
-
-            if (prediction_type_b == 0)
-            { /* adaptive fir */
-                predictor_decompress_fir_adapt(alac->predicterror_buffer_b,
-                                               alac->outputsamples_buffer_b,
-                                               outputsamples,
-                                               readsamplesize,
-                                               predictor_coef_table_b,
-                                               predictor_coef_num_b,
-                                               prediction_quantitization_b);
-            }
-            else
-            {
-                spdlog::debug( "FIXME: unhandled predicition type: %i\n", prediction_type_b);
-            }
-        }
-        else
-        { /* not compressed, easy case */
-            if (alac->setinfo_sample_size <= 16)
+	switch (type)
+	{
+		case PAYLOAD_TYPE_RESEND_RESPONSE:
+		{
+            if (UnwrapResendResponse(*packet))
             {
-                int i;
-                for (i = 0; i < outputsamples; i++)
-                {
-                    int32_t audiobits_a, audiobits_b;
-
-                    audiobits_a = readbits(alac, alac->setinfo_sample_size);
-                    audiobits_b = readbits(alac, alac->setinfo_sample_size);
-
-                    audiobits_a = SIGN_EXTENDED32(audiobits_a, alac->setinfo_sample_size);
-                    audiobits_b = SIGN_EXTENDED32(audiobits_b, alac->setinfo_sample_size);
-
-                    alac->outputsamples_buffer_a[i] = audiobits_a;
-                    alac->outputsamples_buffer_b[i] = audiobits_b;
-                }
+                QueuePacket(move(packet), true);
             }
-            else
-            {
-                int i;
-                for (i = 0; i < outputsamples; i++)
-                {
-                    int32_t audiobits_a, audiobits_b;
+		}
+		break;
 
-                    audiobits_a = readbits(alac, 16);
-                    audiobits_a = audiobits_a << (alac->setinfo_sample_size - 16);
-                    audiobits_a |= readbits(alac, alac->setinfo_sample_size - 16);
-                    audiobits_a = SignExtend24(audiobits_a);
+		case PAYLOAD_TYPE_STREAM_DATA:
+		{
+			QueuePacket(move(packet), false);
+		}
+		break;
 
-                    audiobits_b = readbits(alac, 16);
-                    audiobits_b = audiobits_b << (alac->setinfo_sample_size - 16);
-                    audiobits_b |= readbits(alac, alac->setinfo_sample_size - 16);
-                    audiobits_b = SignExtend24(audiobits_b);
+		case PAYLOAD_TYPE_TIMING_RESPONSE:
+		{
+			OnTimingResponse(*packet);
+		}
+		break;
 
-                    alac->outputsamples_buffer_a[i] = audiobits_a;
-                    alac->outputsamples_buffer_b[i] = audiobits_b;
-                }
-            }
-            uncompressed_bytes = 0; // always 0 for uncompressed
-            interlacing_shift = 0;
-            interlacing_leftweight = 0;
-        }
+		case PAYLOAD_TYPE_TIMING_REQUEST:
+		{
+			AnswerTiming(*packet);
+		}
+		break;
 
-        switch(alac->setinfo_sample_size)
-        {
-        case 16:
-        {
-            deinterlace_16(alac->outputsamples_buffer_a,
-                           alac->outputsamples_buffer_b,
-                           (int16_t*)outbuffer,
-                           alac->numchannels,
-                           outputsamples,
-                           interlacing_shift,
-                           interlacing_leftweight);
-            break;
-        }
-        case 24:
-        {
-            deinterlace_24(alac->outputsamples_buffer_a,
-                           alac->outputsamples_buffer_b,
-                           uncompressed_bytes,
-                           alac->uncompressed_bytes_buffer_a,
-                           alac->uncompressed_bytes_buffer_b,
-                           (int16_t*)outbuffer,
-                           alac->numchannels,
-                           outputsamples,
-                           interlacing_shift,
-                           interlacing_leftweight);
-            break;
-        }
-        case 20:
-        case 32:
-            spdlog::debug( "FIXME: unimplemented sample size %i\n", alac->setinfo_sample_size);
-            break;
-        default:
-            break;
-        }
+		case PAYLOAD_TYPE_STREAM_SYNC:
+		{
+			OnSync(*packet);
+		}
+		break;
 
-        break;
-    }
+		default:
+		{
+		}
+		break;
+	}
+    if (packet)
+    {
+	    PutPacketToPool(move(packet));
     }
 }
 
-alac_file *create_alac(int samplesize, int numchannels)
+unsigned int HairTunes::GetServerPort() const noexcept
 {
-    alac_file *newfile = (alac_file*)malloc(sizeof(alac_file));
-
-    if (!newfile)
-    {
-        throw bad_alloc();
-    }
-    newfile->samplesize = samplesize;
-    newfile->numchannels = numchannels;
-    newfile->bytespersample = (samplesize / 8) * numchannels;
-
-    return newfile;
+    return m_dataEndpoint->GetPort();
+}
+    
+unsigned int HairTunes::GetControlPort() const noexcept
+{
+    return m_controlEndpoint->GetPort();
 }
 
-void destroy_alac(alac_file* alac) noexcept
+unsigned int HairTunes::GetTimingPort() const noexcept
 {
-	deallocate_buffers(alac);
-	free(alac);
+     return m_timingEndpoint->GetPort();
 }
-} // namespace alac
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "JitterBuffer.h"
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+static inline int CountTrailingZeros(uint64_t value) noexcept
+{
+    assert(value != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+JitterBuffer::JitterBuffer(size_t capacity)
+    : m_slots(capacity)
+    , m_present((capacity + 63) / 64, 0)
+    , m_mask{ capacity - 1 }
+    , m_head{ 0 }
+    , m_end{ 0 }
+    , m_count{ 0 }
+    , m_started{ false }
+{
+    // the capacity has to divide the sequence space and has
+    // to leave room to distinguish late from early packets
+    if (capacity < 2 || (capacity & m_mask) != 0 || capacity > 0x8000)
+    {
+        throw invalid_argument("jitter buffer capacity must be a power of two up to 32768");
+    }
+}
+
+JitterBuffer::~JitterBuffer()
+{
+    Reset();
+}
+
+JitterBuffer::InsertResult JitterBuffer::Insert(unique_ptr<RtpPacket>&& packet)
+{
+    assert(packet);
+
+    const uint16_t seq = packet->getSeqNo();
+
+    if (!m_started)
+    {
+        Restart(seq);
+    }
+    const int fromHead = Distance(m_head, seq);
+    InsertResult result = InsertResult::queued;
+
+    if (fromHead < 0)
+    {
+        if (-fromHead <= static_cast<int>(Capacity()))
+        {
+            return InsertResult::late;
+        }
+        // far behind the head: the sender has restarted its sequence
+        Reset();
+        Restart(seq);
+        result = InsertResult::resynced;
+    }
+    else if (fromHead >= static_cast<int>(Capacity()))
+    {
+        // far ahead: there's nothing worth to wait for anymore
+        Reset();
+        Restart(seq);
+        result = InsertResult::resynced;
+    }
+    const size_t index = Index(seq);
+
+    if (m_slots[index])
+    {
+        return InsertResult::duplicate;
+    }
+    m_slots[index] = move(packet);
+    m_present[index >> 6] |= (uint64_t{ 1 } << (index & 63));
+    ++m_count;
+
+    if (Distance(m_end, seq) >= 0)
+    {
+        m_end = seq + 1;
+    }
+    return result;
+}
+
+unique_ptr<RtpPacket> JitterBuffer::Pop() noexcept
+{
+    const size_t index = Index(m_head);
+
+    auto result = move(m_slots[index]);
+
+    if (result)
+    {
+        m_present[index >> 6] &= ~(uint64_t{ 1 } << (index & 63));
+        --m_count;
+    }
+    else
+    {
+        assert(false);
+    }
+    if (m_head != m_end)
+    {
+        ++m_head;
+    }
+    return result;
+}
+
+uint16_t JitterBuffer::SkipMissing() noexcept
+{
+    const uint16_t count = GetMissingCount(m_head);
+    m_head += count;
+    return count;
+}
+
+void JitterBuffer::Reset() noexcept
+{
+    if (m_count > 0)
+    {
+        for (auto& packet : m_slots)
+        {
+            if (packet)
+            {
+                PutPacketToPool(move(packet));
+            }
+        }
+        fill(m_present.begin(), m_present.end(), 0);
+        m_count = 0;
+    }
+    m_started = false;
+}
+
+bool JitterBuffer::IsMissing(uint16_t seq) const noexcept
+{
+    if (Distance(m_head, seq) < 0 || Distance(seq, m_end) <= 0)
+    {
+        return false;
+    }
+    return !IsPresent(seq);
+}
+
+bool JitterBuffer::IsPresent(uint16_t seq) const noexcept
+{
+    const size_t index = Index(seq);
+
+    if ((m_present[index >> 6] & (uint64_t{ 1 } << (index & 63))) == 0)
+    {
+        return false;
+    }
+    return m_slots[index]->getSeqNo() == seq;
+}
+
+uint16_t JitterBuffer::GetMissingCount(uint16_t seq) const noexcept
+{
+    const int available = Distance(seq, m_end);
+
+    if (Distance(m_head, seq) < 0 || available <= 0)
+    {
+        return 0;
+    }
+    uint16_t count = 0;
+
+    while (count < available)
+    {
+        const size_t index = Index(static_cast<uint16_t>(seq + count));
+        const uint64_t word = m_present[index >> 6] >> (index & 63);
+
+        if (word & 1)
+        {
+            break;
+        }
+        // skip all missing slots of this word at once
+        // (but never beyond the end of the ring)
+        int bits = word ? CountTrailingZeros(word) : 64 - static_cast<int>(index & 63);
+        bits = min(bits, static_cast<int>(Capacity() - index));
+
+        count = static_cast<uint16_t>(min(count + bits, available));
+    }
+    return count;
+}
+
+void JitterBuffer::Restart(uint16_t seq) noexcept
+{
+    assert(m_count == 0);
+
+    m_head    = seq;
+    m_end     = seq;
+    m_started = true;
+}
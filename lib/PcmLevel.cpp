@@ -0,0 +1,127 @@
+#include "PcmLevel.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PCM_LEVEL_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PCM_LEVEL_NEON
+#endif
+
+using namespace std;
+
+double PcmLevel::GetPeakDb() const noexcept
+{
+    return 20. * log10(peak / 32767.);
+}
+
+double PcmLevel::GetRmsDb() const noexcept
+{
+    return 20. * log10(rms / 32767.);
+}
+
+#if defined(PCM_LEVEL_SSE2)
+
+// the largest magnitude and the sum of squares of a multiple of eight samples
+static size_t MeasureVector(const int16_t* samples, size_t count, uint16_t& peak, uint64_t& squares) noexcept
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i maximum = zero;
+    __m128i sum = zero;
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+
+        // the saturated negation keeps -32768 at 32767
+        maximum = _mm_max_epi16(maximum, _mm_max_epi16(in, _mm_subs_epi16(zero, in)));
+
+        // two squares each, 2^31 at most fits unsigned 32 bits
+        const __m128i pairs = _mm_madd_epi16(in, in);
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(pairs, zero));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(pairs, zero));
+    }
+    maximum = _mm_max_epi16(maximum, _mm_srli_si128(maximum, 8));
+    maximum = _mm_max_epi16(maximum, _mm_srli_si128(maximum, 4));
+    maximum = _mm_max_epi16(maximum, _mm_srli_si128(maximum, 2));
+    peak = static_cast<uint16_t>(_mm_cvtsi128_si32(maximum) & 0xffff);
+
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+    squares = lanes[0] + lanes[1];
+
+    return i;
+}
+
+#elif defined(PCM_LEVEL_NEON)
+
+// the largest magnitude and the sum of squares of a multiple of eight samples
+static size_t MeasureVector(const int16_t* samples, size_t count, uint16_t& peak, uint64_t& squares) noexcept
+{
+    int16x8_t maximum = vdupq_n_s16(0);
+    uint64x2_t sum = vdupq_n_u64(0);
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        const int16x8_t in = vld1q_s16(samples + i);
+
+        // the saturated absolute value keeps -32768 at 32767
+        maximum = vmaxq_s16(maximum, vqabsq_s16(in));
+
+        const int32x4_t low = vmull_s16(vget_low_s16(in), vget_low_s16(in));
+        const int32x4_t high = vmull_high_s16(in, in);
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(low));
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(high));
+    }
+    peak = static_cast<uint16_t>(vmaxvq_s16(maximum));
+    squares = vaddvq_u64(sum);
+
+    return i;
+}
+
+#else
+
+static size_t MeasureVector(const int16_t*, size_t, uint16_t& peak, uint64_t& squares) noexcept
+{
+    peak = 0;
+    squares = 0;
+    return 0;
+}
+
+#endif
+
+PcmLevel MeasureLevel(const int16_t* samples, size_t count) noexcept
+{
+    assert(samples || count == 0);
+
+    PcmLevel level;
+
+    if (count == 0)
+    {
+        return level;
+    }
+    uint16_t peak = 0;
+    uint64_t squares = 0;
+
+    for (size_t i = MeasureVector(samples, count, peak, squares); i < count; ++i)
+    {
+        const int32_t sample = samples[i];
+
+        peak = max(peak, static_cast<uint16_t>(min(abs(sample), 32767)));
+        squares += static_cast<uint64_t>(sample * sample);
+    }
+    level.peak = peak;
+    level.silent = squares == 0;
+    level.rms = static_cast<float>(sqrt(static_cast<double>(squares) / count));
+
+    return level;
+}
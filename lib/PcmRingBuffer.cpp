@@ -0,0 +1,299 @@
+#include "PcmRingBuffer.h"
+#include <assert.h>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+static size_t RoundUpToPowerOfTwo(size_t n) noexcept
+{
+    size_t result = 1;
+
+    while (result < n)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+PcmRingBuffer::PcmRingBuffer(size_t capacity)
+    : m_capacity{ RoundUpToPowerOfTwo(capacity) }
+    , m_mask{ m_capacity - 1 }
+    , m_readPos{ 0 }
+    , m_writePos{ 0 }
+    , m_closed{ false }
+    , m_readWatermark{ 1 }
+    , m_readerWaitsFor{ 0 }
+    , m_writerWaitsFor{ 0 }
+    , m_dropped{ 0 }
+    , m_waits{ 0 }
+{
+    if (capacity == 0 || capacity > (size_t{ 1 } << 30))
+    {
+        throw invalid_argument("PCM ring buffer capacity must be between 1 byte and 1 GB");
+    }
+    m_buffer = make_unique<uint8_t[]>(m_capacity);
+}
+
+PcmRingBuffer::~PcmRingBuffer()
+{
+}
+
+size_t PcmRingBuffer::GetCapacity() const noexcept
+{
+    return m_capacity;
+}
+
+size_t PcmRingBuffer::GetSize() const noexcept
+{
+    // the read position first, so the difference can't be negative,
+    // sequentially consistent for the wake up protocol of the waiting sides
+    const uint64_t readPos = m_readPos.load();
+    const uint64_t writePos = m_writePos.load();
+
+    return static_cast<size_t>(writePos - readPos);
+}
+
+void PcmRingBuffer::SetReadWatermark(size_t bytes) noexcept
+{
+    m_readWatermark = clamp<size_t>(bytes, 1, m_capacity);
+}
+
+bool PcmRingBuffer::WaitForSize(size_t size, chrono::milliseconds timeout) noexcept
+{
+    if (GetSize() <= size)
+    {
+        return true;
+    }
+    unique_lock<mutex> sync(m_mtx);
+
+    // offset by one, zero stands for no waiting writer
+    m_writerWaitsFor = size + 1;
+
+    const bool result = m_writable.wait_for(sync, timeout, [this, size]()
+    {
+        return GetSize() <= size;
+    });
+    m_writerWaitsFor = 0;
+
+    return result;
+}
+
+void PcmRingBuffer::Close() noexcept
+{
+    {
+        lock_guard<mutex> guard(m_mtx);
+        m_closed = true;
+    }
+    m_readable.notify_all();
+}
+
+bool PcmRingBuffer::IsClosed() const noexcept
+{
+    return m_closed;
+}
+
+PcmRingBuffer::Stats PcmRingBuffer::GetStats() const noexcept
+{
+    return Stats{ m_writePos.load(), m_readPos.load(), m_dropped.load(), m_waits.load() };
+}
+
+void PcmRingBuffer::NotifyReader() noexcept
+{
+    // the waiting side publishes what it waits for before it checks the level
+    // the last time, the other side checks it after it has changed the level
+    const size_t waitsFor = m_readerWaitsFor.load();
+
+    if (waitsFor && GetSize() >= waitsFor)
+    {
+        lock_guard<mutex> guard(m_mtx);
+        m_readable.notify_one();
+    }
+}
+
+void PcmRingBuffer::NotifyWriter() noexcept
+{
+    const size_t waitsFor = m_writerWaitsFor.load();
+
+    if (waitsFor && GetSize() < waitsFor)
+    {
+        lock_guard<mutex> guard(m_mtx);
+        m_writable.notify_one();
+    }
+}
+
+HRESULT PcmRingBuffer::QueryInterface(const IID& iid, void** ppv)
+{
+    assert(ppv);
+    *ppv = nullptr;
+
+    if (::InlineIsEqualGUID(iid, IID_IStream))
+    {
+        *ppv = this;
+    }
+    if (*ppv)
+    {
+        ((IUnknown*)*ppv)->AddRef();
+        return S_OK;
+    }
+    return RefCount<IStream>::QueryInterface(iid, ppv);
+}
+
+HRESULT PcmRingBuffer::Read(void* pv, ULONG cb, ULONG* pcbRead)
+{
+    if (pcbRead)
+    {
+        *pcbRead = 0;
+    }
+    if (0 == cb)
+    {
+        return S_OK;
+    }
+    if (!pv)
+    {
+        return STG_E_INVALIDPOINTER;
+    }
+    size_t available = GetSize();
+    const size_t need = min<size_t>(cb, m_readWatermark);
+
+    if (available < need)
+    {
+        ++m_waits;
+
+        unique_lock<mutex> sync(m_mtx);
+        m_readerWaitsFor = need;
+
+        m_readable.wait(sync, [this, need, &available]()
+        {
+            available = GetSize();
+            return available >= need || m_closed;
+        });
+        m_readerWaitsFor = 0;
+
+        if (available == 0)
+        {
+            return STG_E_NOMOREFILES;
+        }
+    }
+    const size_t n = min<size_t>(cb, available);
+    const uint64_t readPos = m_readPos.load(memory_order_relaxed);
+    const size_t offset = static_cast<size_t>(readPos) & m_mask;
+    const size_t first = min(n, m_capacity - offset);
+
+    memcpy(pv, m_buffer.get() + offset, first);
+    memcpy(static_cast<uint8_t*>(pv) + first, m_buffer.get(), n - first);
+
+    m_readPos.store(readPos + n);
+    NotifyWriter();
+
+    if (pcbRead)
+    {
+        *pcbRead = static_cast<ULONG>(n);
+    }
+    return S_OK;
+}
+
+HRESULT PcmRingBuffer::Write(const void* pv, ULONG cb, ULONG* pcbWritten)
+{
+    if (pcbWritten)
+    {
+        *pcbWritten = 0;
+    }
+    if (0 == cb)
+    {
+        return S_OK;
+    }
+    if (!pv)
+    {
+        return STG_E_INVALIDPOINTER;
+    }
+    if (m_closed)
+    {
+        return STG_E_WRITEFAULT;
+    }
+    const uint64_t writePos = m_writePos.load(memory_order_relaxed);
+    const size_t space = m_capacity - static_cast<size_t>(writePos - m_readPos.load(memory_order_acquire));
+    const size_t n = min<size_t>(cb, space);
+    const size_t offset = static_cast<size_t>(writePos) & m_mask;
+    const size_t first = min(n, m_capacity - offset);
+
+    memcpy(m_buffer.get() + offset, pv, first);
+    memcpy(m_buffer.get(), static_cast<const uint8_t*>(pv) + first, n - first);
+
+    m_writePos.store(writePos + n);
+    NotifyReader();
+
+    if (pcbWritten)
+    {
+        *pcbWritten = static_cast<ULONG>(n);
+    }
+    if (n < cb)
+    {
+        m_dropped += cb - n;
+        return S_FALSE;
+    }
+    return S_OK;
+}
+
+HRESULT PcmRingBuffer::Seek(LARGE_INTEGER dlibMove, DWORD, ULARGE_INTEGER* plibNewPosition)
+{
+    if (dlibMove.QuadPart != 0)
+    {
+        return STG_E_SEEKERROR;
+    }
+    if (plibNewPosition)
+    {
+        plibNewPosition->QuadPart = m_readPos.load();
+    }
+    return S_OK;
+}
+
+HRESULT PcmRingBuffer::SetSize(ULARGE_INTEGER)
+{
+    return STG_E_WRITEFAULT;
+}
+
+HRESULT PcmRingBuffer::CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten)
+{
+    return BlobStream::CopyTo(this, pstm, cb, pcbRead, pcbWritten);
+}
+
+HRESULT PcmRingBuffer::Commit(DWORD)
+{
+    return E_NOTIMPL;
+}
+
+HRESULT PcmRingBuffer::Revert(void)
+{
+    return E_NOTIMPL;
+}
+
+HRESULT PcmRingBuffer::LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD)
+{
+    return E_NOTIMPL;
+}
+
+HRESULT PcmRingBuffer::UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD)
+{
+    return E_NOTIMPL;
+}
+
+HRESULT PcmRingBuffer::Stat(STATSTG* pstatstg, DWORD)
+{
+    if (pstatstg == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    memset(pstatstg, 0, sizeof(STATSTG));
+
+    pstatstg->type = STGTY_STREAM;
+    pstatstg->cbSize.QuadPart = GetSize();
+    pstatstg->grfMode = STGM_READWRITE;
+
+    return S_OK;
+}
+
+HRESULT PcmRingBuffer::Clone(IStream**)
+{
+    return E_NOTIMPL;
+}
@@ -0,0 +1,155 @@
+#include "PlayoutClock.h"
+#include <assert.h>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr int64_t NS_PER_SECOND = 1000000000;
+
+PlayoutClock::PlayoutClock(uint32_t sampleRate)
+    : m_sampleRate{ sampleRate }
+    , m_nextSample{ 0 }
+    , m_hasAnchor{ false }
+    , m_anchorRtp{ 0 }
+    , m_anchorRemoteNtp{ 0 }
+    , m_stats{ nanoseconds(0), 0, 0, 0 }
+{
+    assert(m_sampleRate > 0);
+
+    for (auto& sample : m_samples)
+    {
+        sample = Sample{ 0, 0, false };
+    }
+}
+
+uint64_t PlayoutClock::ToNtp(clock::time_point t) noexcept
+{
+    const int64_t ns = duration_cast<nanoseconds>(t.time_since_epoch()).count();
+    assert(ns >= 0);
+
+    const uint64_t seconds  = static_cast<uint64_t>(ns / NS_PER_SECOND);
+    const uint64_t fraction = (static_cast<uint64_t>(ns % NS_PER_SECOND) << 32) / NS_PER_SECOND;
+
+    return (seconds << 32) | fraction;
+}
+
+PlayoutClock::clock::time_point PlayoutClock::FromNtp(uint64_t ntp) noexcept
+{
+    const int64_t seconds  = static_cast<int64_t>(ntp >> 32);
+    const int64_t fraction = static_cast<int64_t>(((ntp & 0xffffffff) * NS_PER_SECOND) >> 32);
+
+    return clock::time_point(duration_cast<clock::duration>(nanoseconds(seconds * NS_PER_SECOND + fraction)));
+}
+
+bool PlayoutClock::OnTimingResponse(uint64_t reference, uint64_t received, uint64_t send, uint64_t arrival) noexcept
+{
+    // the time on the wire, without the time the sender took to answer
+    const int64_t rtt = static_cast<int64_t>(arrival - reference) - static_cast<int64_t>(send - received);
+
+    if (rtt < 0 || rtt > (int64_t{ TIMING_MAX_RTT_MS } << 32) / 1000)
+    {
+        return false;
+    }
+    // both differences are close to the offset, the mean of them is taken
+    // without leaving the modular arithmetic of the 64-bit timestamps
+    const uint64_t forward  = received - reference;
+    const uint64_t backward = send - arrival;
+    const uint64_t offset   = forward + static_cast<uint64_t>(static_cast<int64_t>(backward - forward) / 2);
+
+    lock_guard<mutex> guard(m_mtx);
+
+    m_samples[m_nextSample] = Sample{ offset, rtt, true };
+    m_nextSample = (m_nextSample + 1) % m_samples.size();
+    ++m_stats.timingSamples;
+
+    return true;
+}
+
+void PlayoutClock::OnSync(uint32_t rtpLessLatency, uint64_t remoteNtp, uint32_t rtpNow) noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    m_hasAnchor         = true;
+    m_anchorRtp         = rtpLessLatency;
+    m_anchorRemoteNtp   = remoteNtp;
+    m_stats.latency     = rtpNow - rtpLessLatency;
+    ++m_stats.syncs;
+}
+
+void PlayoutClock::ResetSync() noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    m_hasAnchor = false;
+}
+
+bool PlayoutClock::IsSynchronized() const noexcept
+{
+    unique_lock<mutex> sync(m_mtx);
+
+    return m_hasAnchor && GetOffset(sync).has_value();
+}
+
+optional<PlayoutClock::clock::time_point> PlayoutClock::GetPlayoutTime(uint32_t rtpTimestamp) const noexcept
+{
+    unique_lock<mutex> sync(m_mtx);
+
+    const auto offset = GetOffset(sync);
+
+    if (!m_hasAnchor || !offset)
+    {
+        return nullopt;
+    }
+    // frames relative to the anchor, aware of the 32-bit wraparound
+    const int64_t frames = static_cast<int32_t>(rtpTimestamp - m_anchorRtp);
+    const int64_t ns     = (frames * NS_PER_SECOND) / m_sampleRate;
+
+    return FromNtp(m_anchorRemoteNtp - *offset) + duration_cast<clock::duration>(nanoseconds(ns));
+}
+
+optional<uint64_t> PlayoutClock::GetOffset() const noexcept
+{
+    unique_lock<mutex> sync(m_mtx);
+
+    return GetOffset(sync);
+}
+
+optional<uint64_t> PlayoutClock::GetOffset(const unique_lock<mutex>& sync) const noexcept
+{
+    const Sample* best = GetBestSample(sync);
+
+    if (!best)
+    {
+        return nullopt;
+    }
+    return best->offset;
+}
+
+const PlayoutClock::Sample* PlayoutClock::GetBestSample(const unique_lock<mutex>& sync) const noexcept
+{
+    assert(sync.owns_lock());
+
+    const Sample* best = nullptr;
+
+    for (const auto& sample : m_samples)
+    {
+        if (sample.valid && (!best || sample.rtt < best->rtt))
+        {
+            best = &sample;
+        }
+    }
+    return best;
+}
+
+PlayoutClock::Stats PlayoutClock::GetStats() const noexcept
+{
+    unique_lock<mutex> sync(m_mtx);
+
+    Stats stats = m_stats;
+
+    if (const Sample* best = GetBestSample(sync))
+    {
+        stats.rtt = nanoseconds((best->rtt * NS_PER_SECOND) >> 32);
+    }
+    return stats;
+}
@@ -7,34 +7,228 @@
 #include "sockpp/socket.h"
 #include "sockpp/sock_address.h"
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <set>
+#include <condition_variable>
+#endif
+
 using namespace std;
 using namespace string_literals;
 
-static mutex mtxPacketPool;
-static list<unique_ptr<RtpPacket>> packetPool;
+// bounded lock-free MPMC queue of recycled packets (D. Vyukov), every cell
+// carries a sequence number which tells producers and consumers whether
+// the cell is free to be written or ready to be read
+class RtpPacketPool
+{
+public:
+    RtpPacketPool(size_t capacity, size_t prealloc)
+        : m_cells(capacity)
+        , m_mask{ capacity - 1 }
+        , m_enqueuePos{ 0 }
+        , m_dequeuePos{ 0 }
+        , m_hits{ 0 }
+        , m_misses{ 0 }
+        , m_outstanding{ 0 }
+        , m_highWaterMark{ 0 }
+    {
+        assert(capacity >= 2 && (capacity & m_mask) == 0);
+        assert(prealloc <= capacity);
+
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            m_cells[i].sequence.store(i, memory_order_relaxed);
+        }
+        for (size_t i = 0; i < prealloc; ++i)
+        {
+            Push(new RtpPacket);
+        }
+    }
+
+    ~RtpPacketPool()
+    {
+        while (auto p = Pop())
+        {
+            delete p;
+        }
+    }
+
+    unique_ptr<RtpPacket> Get()
+    {
+        const auto outstanding = ++m_outstanding;
+        auto highWaterMark = m_highWaterMark.load(memory_order_relaxed);
+
+        while (outstanding > highWaterMark 
+            && !m_highWaterMark.compare_exchange_weak(highWaterMark, outstanding, memory_order_relaxed))
+        {
+        }
+        if (auto p = Pop())
+        {
+            m_hits.fetch_add(1, memory_order_relaxed);
+            return unique_ptr<RtpPacket>(p);
+        }
+        m_misses.fetch_add(1, memory_order_relaxed);
+        return make_unique<RtpPacket>();
+    }
+
+    void Put(unique_ptr<RtpPacket>&& p) noexcept
+    {
+        --m_outstanding;
+
+        if (Push(p.get()))
+        {
+            p.release();
+        }
+        else
+        {
+            // the pool is full, the packet gets freed
+            p.reset();
+        }
+    }
+
+    RtpPacketPoolStats GetStats() const noexcept
+    {
+        RtpPacketPoolStats stats;
+
+        stats.hits          = m_hits.load(memory_order_relaxed);
+        stats.misses        = m_misses.load(memory_order_relaxed);
+        stats.outstanding   = m_outstanding.load(memory_order_relaxed);
+        stats.highWaterMark = m_highWaterMark.load(memory_order_relaxed);
+
+        // the consumer position has to be read first, so it can't overtake the producer position
+        const size_t dequeuePos = m_dequeuePos.load(memory_order_acquire);
+        stats.available     = m_enqueuePos.load(memory_order_acquire) - dequeuePos;
+
+        return stats;
+    }
+
+private:
+    bool Push(RtpPacket* p) noexcept
+    {
+        Cell* cell;
+        size_t pos = m_enqueuePos.load(memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+
+            const size_t seq = cell->sequence.load(memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0)
+            {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // a consumer which claimed the cell a lap ago may not have released it yet
+                if (pos - m_dequeuePos.load(memory_order_relaxed) < m_cells.size())
+                {
+                    this_thread::yield();
+                    pos = m_enqueuePos.load(memory_order_relaxed);
+                    continue;
+                }
+                return false;
+            }
+            else
+            {
+                pos = m_enqueuePos.load(memory_order_relaxed);
+            }
+        }
+        cell->data = p;
+        cell->sequence.store(pos + 1, memory_order_release);
+        return true;
+    }
+
+    RtpPacket* Pop() noexcept
+    {
+        Cell* cell;
+        size_t pos = m_dequeuePos.load(memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+
+            const size_t seq = cell->sequence.load(memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0)
+            {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // a producer may have claimed the cell without having published it yet,
+                // this must not be mistaken for an empty pool
+                if (m_enqueuePos.load(memory_order_relaxed) != pos)
+                {
+                    this_thread::yield();
+                    pos = m_dequeuePos.load(memory_order_relaxed);
+                    continue;
+                }
+                return nullptr;
+            }
+            else
+            {
+                pos = m_dequeuePos.load(memory_order_relaxed);
+            }
+        }
+        RtpPacket* result = cell->data;
+        cell->sequence.store(pos + m_mask + 1, memory_order_release);
+        return result;
+    }
+
+private:
+    struct Cell
+    {
+        atomic<size_t>  sequence;
+        RtpPacket*      data = nullptr;
+    };
+
+    vector<Cell>                m_cells;
+    const size_t                m_mask;
+
+    alignas(64) atomic<size_t>  m_enqueuePos;
+    alignas(64) atomic<size_t>  m_dequeuePos;
+
+    alignas(64) atomic_uint64_t m_hits;
+    atomic_uint64_t             m_misses;
+    atomic<int64_t>             m_outstanding;
+    atomic<int64_t>             m_highWaterMark;
+};
+
+static RtpPacketPool& GetPacketPool()
+{
+    static RtpPacketPool pool(RTP_PACKET_POOL_CAPACITY, RTP_PACKET_POOL_PREALLOC);
+    return pool;
+}
 
 void PutPacketToPool(unique_ptr<RtpPacket>&& p)
 {
     assert(p);
     p->Init();
 
-    const lock_guard<mutex> guard(mtxPacketPool);
-    packetPool.emplace_back(move(p));
+    GetPacketPool().Put(move(p));
 }
 
-static unique_ptr<RtpPacket> GetNewPacketFromPool()
+unique_ptr<RtpPacket> GetNewPacketFromPool()
 {
-    {
-        const lock_guard<mutex> guard(mtxPacketPool);
+    return GetPacketPool().Get();
+}
 
-        if (!packetPool.empty())
-        {
-            unique_ptr<RtpPacket> result = move(packetPool.front());
-            packetPool.pop_front();
-            return result;
-        }
-    }
-    return make_unique<RtpPacket>();
+RtpPacketPoolStats GetPacketPoolStats() noexcept
+{
+    return GetPacketPool().GetStats();
 }
 
 static USHORT GetUniquePortNumber()
@@ -50,26 +244,246 @@ static USHORT GetUniquePortNumber()
 	return result;
 }
 
-RtpEndpoint::RtpEndpoint(IRtpRequestHandler* requestHandler, const string& peer)
+#ifdef __linux__
+// one epoll thread serves the sockets of all endpoints, it lives as long
+// as there is at least one endpoint registered
+class RtpReactor
+{
+public:
+    static shared_ptr<RtpReactor> GetInstance()
+    {
+        static mutex mtxInstance;
+        static weak_ptr<RtpReactor> instance;
+
+        const lock_guard<mutex> guard(mtxInstance);
+
+        auto result = instance.lock();
+
+        if (!result)
+        {
+            result = make_shared<RtpReactor>();
+            instance = result;
+        }
+        return result;
+    }
+
+    RtpReactor()
+        : m_loop{ make_shared<Loop>() }
+    {
+        // the thread keeps the loop alive, the last endpoint might be released by a request handler
+        m_thread = thread([loop = m_loop]()
+        {
+            loop->Run();
+        });
+        m_loop->SetThreadId(m_thread.get_id());
+    }
+
+    ~RtpReactor()
+    {
+        m_loop->Stop();
+
+        if (m_thread.joinable())
+        {
+            // a request handler on the reactor thread has released the last endpoint,
+            // the loop ends after its dispatch
+            if (m_thread.get_id() == this_thread::get_id())
+            {
+                m_thread.detach();
+            }
+            else
+            {
+                m_thread.join();
+            }
+        }
+    }
+
+    void Add(RtpEndpoint* endpoint, int fd)
+    {
+        m_loop->Add(endpoint, fd);
+    }
+
+    // after returning the endpoint won't be dispatched anymore
+    void Remove(RtpEndpoint* endpoint, int fd) noexcept
+    {
+        m_loop->Remove(endpoint, fd);
+    }
+
+private:
+    // the epoll instance and the endpoints, shared by the reactor and its thread
+    class Loop
+    {
+    public:
+        Loop()
+            : m_epoll{ ::epoll_create1(EPOLL_CLOEXEC) }
+            , m_wakeup{ ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) }
+            , m_stop{ false }
+        {
+            if (m_epoll < 0 || m_wakeup < 0)
+            {
+                Close();
+                throw runtime_error("could not create epoll reactor");
+            }
+            epoll_event ev{};
+            ev.events   = EPOLLIN;
+            ev.data.ptr = nullptr;
+
+            if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &ev) != 0)
+            {
+                Close();
+                throw runtime_error("could not register wakeup event");
+            }
+        }
+
+        ~Loop()
+        {
+            Close();
+        }
+
+        void SetThreadId(thread::id threadId) noexcept
+        {
+            const lock_guard<mutex> guard(m_mtx);
+            m_threadId = threadId;
+        }
+
+        void Stop() noexcept
+        {
+            m_stop = true;
+
+            const uint64_t one = 1;
+            [[maybe_unused]] const auto written = ::write(m_wakeup, &one, sizeof(one));
+        }
+
+        void Add(RtpEndpoint* endpoint, int fd)
+        {
+            const lock_guard<mutex> guard(m_mtx);
+
+            epoll_event ev{};
+            ev.events   = EPOLLIN;
+            ev.data.ptr = endpoint;
+
+            if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) != 0)
+            {
+                throw runtime_error("could not register udp socket");
+            }
+            m_endpoints.insert(endpoint);
+        }
+
+        void Remove(RtpEndpoint* endpoint, int fd) noexcept
+        {
+            unique_lock<mutex> sync(m_mtx);
+
+            ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+            m_endpoints.erase(endpoint);
+
+            // waits for a dispatch of this endpoint only, on the reactor thread there is none going on
+            // but the one of the calling handler
+            if (this_thread::get_id() != m_threadId)
+            {
+                m_condDispatch.wait(sync, [this, endpoint]()
+                {
+                    return m_dispatching != endpoint;
+                });
+            }
+        }
+
+        void Run() noexcept
+        {
+            epoll_event events[64];
+
+            while (!m_stop)
+            {
+                const int count = ::epoll_wait(m_epoll, events, static_cast<int>(size(events)), -1);
+
+                if (count < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    assert(false);
+                    break;
+                }
+                for (int i = 0; i < count && !m_stop; ++i)
+                {
+                    if (events[i].data.ptr == nullptr)
+                    {
+                        uint64_t value = 0;
+                        [[maybe_unused]] const auto read = ::read(m_wakeup, &value, sizeof(value));
+                        continue;
+                    }
+                    auto endpoint = static_cast<RtpEndpoint*>(events[i].data.ptr);
+                    {
+                        const lock_guard<mutex> guard(m_mtx);
+
+                        // the endpoint may have been removed by a previous dispatch
+                        if (m_endpoints.count(endpoint) == 0)
+                        {
+                            continue;
+                        }
+                        m_dispatching = endpoint;
+                    }
+                    // the handlers of the sessions run without the lock
+                    endpoint->Dispatch(false);
+                    {
+                        const lock_guard<mutex> guard(m_mtx);
+                        m_dispatching = nullptr;
+                    }
+                    m_condDispatch.notify_all();
+                }
+            }
+        }
+
+    private:
+        void Close() noexcept
+        {
+            if (m_wakeup >= 0)
+            {
+                ::close(m_wakeup);
+                m_wakeup = -1;
+            }
+            if (m_epoll >= 0)
+            {
+                ::close(m_epoll);
+                m_epoll = -1;
+            }
+        }
+
+    private:
+        int                     m_epoll;
+        int                     m_wakeup;
+        atomic_bool             m_stop;
+        mutex                   m_mtx;
+        condition_variable      m_condDispatch;
+        thread::id              m_threadId;
+        set<RtpEndpoint*>       m_endpoints;
+        RtpEndpoint*            m_dispatching{ nullptr };
+    };
+
+private:
+    const shared_ptr<Loop>      m_loop;
+    thread                      m_thread;
+};
+#endif
+
+RtpEndpoint::RtpEndpoint(IRtpRequestHandler* requestHandler, const string& peer, size_t batchSize)
     : m_requestHandler{ requestHandler }
     , m_peer(peer)
+    , m_batchSize{ max<size_t>(batchSize, 1) }
     , m_isV4{ true }
     , m_port { 0 }
+    , m_peerAddrPort{ 0 }
     , m_stop{ false }
+    , m_receivedPackets{ 0 }
+    , m_receivedBatches{ 0 }
 {
-    assert(m_requestHandler);
     assert(!m_peer.empty());
 
+    m_slots.resize(m_batchSize);
+    m_batch.reserve(m_batchSize);
+
     USHORT port = GetUniquePortNumber();
 
-    try
-    {
-        const sockpp::inet_address addrPeer(m_peer, 1024);
-    }
-    catch(...)
-    {
-        m_isV4 = false;
-    }
+    m_isV4 = IsV4(m_peer);
 
     for (int i = 0; i < 1024; ++i, port = GetUniquePortNumber())
     {
@@ -96,10 +510,15 @@ RtpEndpoint::RtpEndpoint(IRtpRequestHandler* requestHandler, const string& peer)
             continue;
         }
         m_port   = port;
+#ifdef __linux__
+        m_reactor = RtpReactor::GetInstance();
+        m_reactor->Add(this, m_socket->handle());
+#else
         m_thread = make_unique<thread>([this]()
         {
             Run();
         });
+#endif
         return;
     }
     throw runtime_error("could not acquire port for udp socket");
@@ -109,6 +528,14 @@ RtpEndpoint::~RtpEndpoint()
 {
     m_stop = true;
 
+#ifdef __linux__
+    if (m_reactor)
+    {
+        assert(m_socket);
+        m_reactor->Remove(this, m_socket->handle());
+        m_reactor.reset();
+    }
+#endif
     if (m_socket)
     {
         try
@@ -134,56 +561,175 @@ RtpEndpoint::~RtpEndpoint()
             }
         }
     }
+    for (auto& packet : m_slots)
+    {
+        if (packet)
+        {
+            PutPacketToPool(move(packet));
+        }
+    }
+}
+
+bool RtpEndpoint::IsV4(const string& peer) noexcept
+{
+    try
+    {
+        const sockpp::inet_address addrPeer(peer, 1024);
+    }
+    catch(...)
+    {
+        return false;
+    }
+    return true;
+}
+
+void RtpEndpoint::Attach(IRtpRequestHandler* requestHandler, const string& peer)
+{
+    assert(requestHandler);
+    assert(IsV4(peer) == m_isV4);
+    {
+        lock_guard<mutex> guard(m_mtxSend);
+
+        m_peer = peer;
+        m_peerAddr.reset();
+    }
+    m_requestHandler = requestHandler;
 }
 
 void RtpEndpoint::Run() noexcept
+{
+    while (!m_stop)
+    {
+        Dispatch(true);
+    }
+}
+
+// receives one batch of datagrams and passes it to the request handler
+bool RtpEndpoint::Dispatch(bool wait) noexcept
 {
     try
     {
-        while (!m_stop)
+        const size_t received = Receive(wait);
+
+        if (received == 0)
+        {
+            return false;
+        }
+        m_receivedPackets += received;
+        m_receivedBatches++;
+
+        if (IRtpRequestHandler* requestHandler = m_requestHandler)
         {
-            auto packet = GetNewPacketFromPool();
-            assert(packet->size() == RAOP_PACKET_MAX_SIZE);
-            
-            sockpp::sock_address_any addr;
-            const auto size = m_socket->recv_from(packet->data(), packet->size(), &addr);
+            requestHandler->OnBatchRequest(this, m_batch);
+        }
 
-            if (size <= 0)
+        // recycle packets which have not been taken by the handler
+        auto slot = m_slots.begin();
+
+        for (auto& packet : m_batch)
+        {
+            if (packet)
             {
-                PutPacketToPool(move(packet));
-                continue;
-            }
-            packet->resize(size);
+                packet->Init();
 
-            m_requestHandler->OnRequest(this, move(packet));
+                slot = find(slot, m_slots.end(), nullptr);
+                assert(slot != m_slots.end());
+                *slot = move(packet);
+            }
         }
+        m_batch.clear();
+        return true;
     }
     catch(...)
     {
+        m_batch.clear();
     }
+    return false;
 }
 
-bool RtpEndpoint::SendTo(const void* buf, size_t len, USHORT port) noexcept
+// fills empty slots from the pool, receives up to m_batchSize datagrams and
+// moves the received packets from their slots into m_batch
+size_t RtpEndpoint::Receive(bool wait)
 {
-    try
+    for (auto& packet : m_slots)
     {
-        if (m_isV4)
+        if (!packet)
         {
-            sockpp::udp_socket sock;
+            packet = GetNewPacketFromPool();
+        }
+        assert(packet->size() == RAOP_PACKET_MAX_SIZE);
+    }
+#ifdef __linux__
+    thread_local vector<mmsghdr> msgs;
+    thread_local vector<iovec> iovecs;
 
-            if (!sock.connect(sockpp::inet_address(m_peer, port))) 
-            {
-                return FALSE;
-            }
-            return sock.send(buf, len) == len;
+    msgs.resize(m_slots.size());
+    iovecs.resize(m_slots.size());
+
+    for (size_t i = 0; i < m_slots.size(); ++i)
+    {
+        iovecs[i].iov_base = m_slots[i]->data();
+        iovecs[i].iov_len  = m_slots[i]->size();
+
+        memset(&msgs[i], 0, sizeof(mmsghdr));
+        msgs[i].msg_hdr.msg_iov    = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // either block for the first datagram only or take 
+    // whatever is already queued if called by the reactor
+    const int flags = wait ? MSG_WAITFORONE : MSG_DONTWAIT;
+    const int count = ::recvmmsg(m_socket->handle(), msgs.data(), static_cast<unsigned int>(msgs.size()), flags, nullptr);
+
+    if (count <= 0)
+    {
+        return 0;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        const size_t size = msgs[i].msg_len;
+
+        if (size > 0)
+        {
+            m_slots[i]->resize(size);
+            m_batch.emplace_back(move(m_slots[i]));
         }
-        sockpp::udp6_socket sock;
+    }
+#else
+    assert(wait);
 
-        if (!sock.connect(sockpp::inet6_address(m_peer, port))) 
+    sockpp::sock_address_any addr;
+    const auto size = m_socket->recv_from(m_slots.front()->data(), m_slots.front()->size(), &addr);
+
+    if (size > 0)
+    {
+        m_slots.front()->resize(size);
+        m_batch.emplace_back(move(m_slots.front()));
+    }
+#endif
+    return m_batch.size();
+}
+
+bool RtpEndpoint::SendTo(const void* buf, size_t len, USHORT port) noexcept
+{
+    try
+    {
+        lock_guard<mutex> guard(m_mtxSend);
+
+        // the peer address is resolved once per port
+        if (!m_peerAddr || m_peerAddrPort != port)
         {
-            return FALSE;
+            if (m_isV4)
+            {
+                m_peerAddr = make_unique<sockpp::inet_address>(m_peer, port);
+            }
+            else
+            {
+                m_peerAddr = make_unique<sockpp::inet6_address>(m_peer, port);
+            }
+            m_peerAddrPort = port;
         }
-        return sock.send(buf, len) == len;
+        return m_socket->send_to(buf, len, *m_peerAddr) == static_cast<ssize_t>(len);
     }
     catch(...)
     {
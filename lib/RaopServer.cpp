@@ -2,6 +2,7 @@
 #include "base64.h"
 #include "crypto.h"
 #include "Trim.h"
+#include "RtspParser.h"
 #include "HairTunes.h"
 #include <spdlog/spdlog.h>
 #include "libutils.h"
@@ -13,6 +14,7 @@
 #include "httplib/httplib_raop.h"
 
 #include <future>
+#include <algorithm>
 #include "dnssd.h"
 
 using namespace std;
@@ -104,6 +106,87 @@ void RaopServer::RemoveClient(const string& remoteAddr) noexcept
 	m_clients->Remove(VariantValue::Key(remoteAddr));
 }
 
+void RaopServer::Prewarm(const string& peer) noexcept
+{
+	const lock_guard<mutex> guard(m_mtxPrewarmed);
+
+	// one session at a time needs one in reserve
+	if (m_prewarmed.valid())
+	{
+		return;
+	}
+	try
+	{
+		m_prewarmed = async(launch::async, [peer]()
+			{
+				return make_unique<SessionResources>(peer);
+			});
+	}
+	catch (...)
+	{
+		spdlog::warn("failed to pre-warm a session");
+	}
+}
+
+unique_ptr<SessionResources> RaopServer::TakePrewarmed() noexcept
+{
+	const lock_guard<mutex> guard(m_mtxPrewarmed);
+
+	if (m_prewarmed.valid())
+	{
+		try
+		{
+			return m_prewarmed.get();
+		}
+		catch (...)
+		{
+			spdlog::warn("failed to pre-warm a session");
+		}
+	}
+	return nullptr;
+}
+
+void RaopServer::Retire(unique_ptr<HairTunes>&& decoder) noexcept
+{
+	if (!decoder)
+	{
+		return;
+	}
+	const lock_guard<mutex> guard(m_mtxRetired);
+
+	m_retired.erase(remove_if(m_retired.begin(), m_retired.end(), [](const future<void>& retired)
+		{
+			return retired.wait_for(0s) == future_status::ready;
+		}), m_retired.end());
+
+	try
+	{
+		m_retired.push_back(async(launch::async, [decoder = move(decoder)]() mutable
+			{
+				decoder->Flush();
+				decoder.reset();
+			}));
+	}
+	catch (...)
+	{
+		// without a thread of its own the session has been destroyed here
+		spdlog::warn("failed to tear down a session in the background");
+	}
+}
+
+void RaopServer::WaitForRetired() noexcept
+{
+	vector<future<void>> retired;
+	{
+		const lock_guard<mutex> guard(m_mtxRetired);
+		retired.swap(m_retired);
+	}
+	for (auto& session : retired)
+	{
+		session.wait();
+	}
+}
+
 bool RaopServer::IsPlaying() const noexcept
 {
 	const shared_lock<shared_mutex> guard(m_mtxDecoder);
@@ -115,6 +198,17 @@ bool RaopServer::IsPlaying() const noexcept
 	return false;
 }
 
+PcmLevel RaopServer::GetLevel() const noexcept
+{
+	const shared_lock<shared_mutex> guard(m_mtxDecoder);
+
+	if (m_decoder)
+	{
+		return m_decoder->GetLevel();
+	}
+	return PcmLevel{};
+}
+
 bool RaopServer::GetProgress(int& duration, int& position, string& clientID) const noexcept
 {
 	const shared_lock<shared_mutex> guard(m_mtxDecoder);
@@ -149,6 +243,9 @@ void RaopServer::Run() noexcept
 		// keep alive forever (lifetime is being controled by client)
 		m_srvHttp->set_keep_alive_max_count(numeric_limits<size_t>::max());
 
+		// the server listens on IPv4, so do its clients
+		Prewarm("0.0.0.0"s);
+
 		// setup "get" handler for http
 		m_srvHttp->Get(".+", [&](const httplib::Request& request, httplib::Response& response)
 			{
@@ -288,88 +385,69 @@ void RaopServer::Run() noexcept
 								// progress- and/or volume-information
 								if (!request.body.empty())
 								{
-									map<string, string, httplib::detail::ci> mapKeyValue;
+									optional<string_view> volumeValue;
+									optional<string_view> progressValue;
 
-									ParseRegEx(request.body, "[^[:space:]:]+[:space:]*:[^\r\n]+[\r\n]*"s
-										, [&mapKeyValue](string s) -> bool
-										{
-											string strLeft;
-											string strRight;
+									string_view body(request.body);
+									string_view key;
+									string_view value;
 
-											if (!ParseRegEx(s, "[^[:space:]:]+"s, [&strLeft](string t) -> bool
-												{
-													strLeft = move(t);
-													return false;
-												}))
-											{
-												return false;
-											}
-											if (!ParseRegEx(s, ":[^\r\n]+"s, [&strRight](string t) -> bool
-												{
-													Trim(t, " \t\r\n:"s);
-													strRight = move(t);
-													return false;
-												}))
-											{
-												return false;
-											}
-											mapKeyValue[strLeft] = move(strRight);
-											return true;
-										});
-
-									if (!mapKeyValue.empty())
+									while (RtspParser::NextParameter(body, key, value))
 									{
-										auto i = mapKeyValue.find("volume"s);
+										if (RtspParser::EqualsNoCase(key, "volume"sv))
+										{
+											volumeValue = value;
+										}
+										else if (RtspParser::EqualsNoCase(key, "progress"sv))
+										{
+											progressValue = value;
+										}
+									}
 
-										if (i != mapKeyValue.end())
+									if (volumeValue)
+									{
+										if (const auto volume = RtspParser::ToDouble(*volumeValue))
 										{
-											const Variant varVolume = i->second;
-											const int64_t volume = static_cast<uint64_t>(VariantValue::Get<double>(varVolume) * 1000.);
+											VariantValue::Key("Volume").Set(m_config, static_cast<int64_t>(*volume * 1000.));
+										}
+									}
+									else if (progressValue)
+									{
+										uint64_t listProgressValues[3];
+										size_t progressValues = 0;
 
-											VariantValue::Key("Volume").Set(m_config, volume);
+										string_view progress(*progressValue);
+
+										while (progressValues < 3 && RtspParser::NextNumber(progress, listProgressValues[progressValues]))
+										{
+											++progressValues;
 										}
-										else
+
+										if (progressValues == 3)
 										{
-											i = mapKeyValue.find("progress"s);
+											uint64_t start = listProgressValues[0];
+											uint64_t curr = listProgressValues[1];
+											uint64_t end = listProgressValues[2];
 
-											if (i != mapKeyValue.end())
+											if (end >= start)
 											{
-												vector<uint64_t> listProgressValues;
-												listProgressValues.reserve(3);
+												// obviously set wrongly by some Apps (e.g. Soundcloud) 
+												if (start > curr)
+												{
+													std::swap(start, curr);
+												}
+												if (curr <= end)
+												{
+													const lock_guard<shared_mutex> guard(m_mtxDecoder);
 
-												ParseRegEx(i->second, "[\\d]+"s, [&listProgressValues](const string& s) -> bool
+													if (m_decoder)
 													{
-														listProgressValues.emplace_back(std::strtoull(s.c_str(), nullptr, 10));
-														return true;
-													});
+														const uint64_t samplingFreq = m_decoder->GetSamplingFreq();
 
-												if (listProgressValues.size() >= 3)
-												{
-													uint64_t start = listProgressValues[0];
-													uint64_t curr = listProgressValues[1];
-													uint64_t end = listProgressValues[2];
+														m_duration = (int)((end - start) / samplingFreq);
+														m_position = (int)((curr - start) / samplingFreq);
 
-													if (end >= start)
-													{
-														// obviously set wrongly by some Apps (e.g. Soundcloud) 
-														if (start > curr)
-														{
-															std::swap(start, curr);
-														}
-														if (curr <= end)
-														{
-															const lock_guard<shared_mutex> guard(m_mtxDecoder);
-
-															if (m_decoder)
-															{
-																const uint64_t samplingFreq = m_decoder->GetSamplingFreq();
-
-																m_duration = (int)((end - start) / samplingFreq);
-																m_position = (int)((curr - start) / samplingFreq);
-
-																m_decoder->ResetProgess();
-															}
-														}
+														m_decoder->ResetProgess();
 													}
 												}
 											}
@@ -413,56 +491,30 @@ void RaopServer::Run() noexcept
 					}
 					else if (request.method == "ANNOUNCE"s)
 					{
-						map<string, string, httplib::detail::ci> mapKeyValue;
-
-						ParseRegEx(request.body, "a[:space:]*=[:space:]*[^[:space:]:]+[:space:]*:[^\r\n]+[\r\n]+"s
-							, [&mapKeyValue](string s) -> bool
-							{
-								string strLeft;
-								string strRight;
+						string_view fmtp;
+						string_view aesiv;
+						string_view rsaaeskey;
 
-								const auto eq = s.find('=');
+						string_view sdp(request.body);
+						string_view key;
+						string_view value;
 
-								if (eq == string::npos)
-								{
-									return false;
-								}
-								const auto item = s.substr(eq + 1);
-
-								if (!ParseRegEx(item, "[^[:space:]:]+"s, [&strLeft](string t) -> bool
-									{
-										strLeft = move(t);
-										return false;
-									}))
-								{
-									return false;
-								}
-								if (!ParseRegEx(item, ":[^\r\n]+"s, [&strRight](string t) -> bool
-									{
-										Trim(t, " \t\r\n:"s);
-										strRight = move(t);
-										return false;
-									}))
-								{
-									return false;
-								}
-								mapKeyValue[strLeft] = move(strRight);
-								return true;
-							});
-
-						string clientInfo;
-						ParseRegEx(request.body, "i[:space:]*=[^\r\n]+"s
-							, [&clientInfo](string s) -> bool
+						while (RtspParser::NextAttribute(sdp, key, value))
+						{
+							if (RtspParser::EqualsNoCase(key, "fmtp"sv))
 							{
-								const auto eq = s.find('=');
-
-								if (eq != string::npos)
-								{
-									clientInfo = s.substr(eq + 1);
-									Trim(clientInfo, " \t\r\n"s);
-								}
-								return false;
-							});
+								fmtp = value;
+							}
+							else if (RtspParser::EqualsNoCase(key, "aesiv"sv))
+							{
+								aesiv = value;
+							}
+							else if (RtspParser::EqualsNoCase(key, "rsaaeskey"sv))
+							{
+								rsaaeskey = value;
+							}
+						}
+						const string clientInfo(RtspParser::FindLine(request.body, 'i').value_or(""sv));
 
 						auto client = GetClient(request.remote_addr, true);
 
@@ -479,9 +531,9 @@ void RaopServer::Run() noexcept
 
 									}, request.remote_addr)));
 						}
-						VariantValue::Key("fmtp").Set(client, mapKeyValue["fmtp"s]);
-						VariantValue::Key("aesiv").Set(client, Base64::Decode(mapKeyValue["aesiv"s]));
-						VariantValue::Key("rsaaeskey").Set(client, m_rsa->Decrypt(Base64::Decode(mapKeyValue["rsaaeskey"s])));
+						VariantValue::Key("fmtp").Set(client, string(fmtp));
+						VariantValue::Key("aesiv").Set(client, Base64::Decode(string(aesiv)));
+						VariantValue::Key("rsaaeskey").Set(client, m_rsa->Decrypt(Base64::Decode(string(rsaaeskey))));
 
 						if (request.has_header("Active-Remote"s))
 						{
@@ -500,16 +552,14 @@ void RaopServer::Run() noexcept
 						{
 							const string transportRequested = request.get_header_value("transport"s);
 
-							ParseRegEx(transportRequested, "control_port=[\\d]+"s, [&](string s) -> bool
-								{
-									VariantValue::Key("control_port").Set(client, stoi(s.substr(strlen("control_port="))));
-									return false;
-								});
-							ParseRegEx(transportRequested, "timing_port=[\\d]+"s, [&](string s) -> bool
-								{
-									VariantValue::Key("timing_port").Set(client, stoi(s.substr(strlen("timing_port="))));
-									return false;
-								});
+							if (const auto port = RtspParser::FindNumber(transportRequested, "control_port"sv))
+							{
+								VariantValue::Key("control_port").Set(client, *port);
+							}
+							if (const auto port = RtspParser::FindNumber(transportRequested, "timing_port"sv))
+							{
+								VariantValue::Key("timing_port").Set(client, *port);
+							}
 
 							if (m_serviceDisabled)
 							{
@@ -535,11 +585,13 @@ void RaopServer::Run() noexcept
 							}
 							const lock_guard<shared_mutex> guard(m_mtxDecoder);
 
-							m_decoder.reset();
+							// the previous session plays out what it has left meanwhile
+							Retire(move(m_decoder));
 
 							try
 							{
-								m_decoder = make_unique<HairTunes>(m_config, move(client));
+								// only the keys and the format of the client are left to set up
+								m_decoder = make_unique<HairTunes>(m_config, move(client), TakePrewarmed());
 
 								const unsigned int serverPort = m_decoder->GetServerPort();
 								const unsigned int controlPort = m_decoder->GetControlPort();
@@ -555,6 +607,8 @@ void RaopServer::Run() noexcept
 
 								response.set_header("Transport"s, transportResponse);
 								response.set_header("Session"s, "DEADBEEF"s);
+
+								Prewarm(request.remote_addr);
 							}
 							catch (...)
 							{
@@ -585,11 +639,7 @@ void RaopServer::Run() noexcept
 								decoder.swap(m_decoder);
 							}
 						}
-						if (decoder)
-						{
-							decoder->Flush();
-							decoder.reset();
-						}
+						Retire(move(decoder));
 					}
 					else if (request.method == "RECORD"s)
 					{
@@ -704,6 +754,10 @@ void RaopServer::Run() noexcept
 		decoder->Flush();
 		decoder.reset();
 	}
+	WaitForRetired();
+
+	// unbinds the ports kept in reserve
+	TakePrewarmed();
 }
 
 static bool DigestOk(const httplib::Request& request, const string& password)
@@ -714,32 +768,16 @@ static bool DigestOk(const httplib::Request& request, const string& password)
 	{
 		map<string, string> mapAuth;
 
-		ParseRegEx(strAuth.c_str() + 7, "[^\\s=]+[\\s]*=[\\s]*\"[^\"]+\""s
-			, [&mapAuth](string s) -> bool
-			{
-				string strLeft;
-				string strRight;
+		string_view auth(strAuth);
+		auth.remove_prefix(7);
 
-				if (!ParseRegEx(s, "[^\\s\"=]+"s, [&strLeft](string t) -> bool
-					{
-						strLeft = move(t);
-						return false;
-					}))
-				{
-					return false;
-				}
-				if (!ParseRegEx(s, "\"[^\"]+\""s, [&strRight](string t) -> bool
-					{
-						Trim(t, "\""s);
-						strRight = move(t);
-						return false;
-					}))
-				{
-					return false;
-				}
-				mapAuth.emplace(ToLower(move(strLeft)), move(strRight));
-				return true;
-			});
+		string_view key;
+		string_view value;
+
+		while (RtspParser::NextQuotedPair(auth, key, value))
+		{
+			mapAuth.emplace(ToLower(string(key)), string(value));
+		}
 
 		const string str1 = mapAuth["username"s] + ":"s + mapAuth["realm"s] + ":"s + password;
 		const string str2 = request.method + ":"s + mapAuth["uri"s];
@@ -0,0 +1,182 @@
+#include "Resampler.h"
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+static constexpr int TAPS           = RESAMPLER_TAPS;
+static constexpr int PHASES         = RESAMPLER_PHASES;
+static constexpr int CENTER         = TAPS / 2 - 1;     // the tap in front of the interpolated point
+static constexpr double KAISER_BETA = 8.0;              // about 80 dB stop band attenuation
+
+static constexpr int Log2(int n)
+{
+    return n > 1 ? 1 + Log2(n >> 1) : 0;
+}
+
+static constexpr int PHASE_SHIFT        = 32 - Log2(PHASES);
+static constexpr uint32_t PHASE_MASK    = (uint32_t{ 1 } << PHASE_SHIFT) - 1;
+static constexpr uint64_t ONE           = uint64_t{ 1 } << 32;
+
+// the ratio is limited to where the cut-off at the input's Nyquist frequency is fine
+static constexpr double MIN_RATIO = 0.9;
+static constexpr double MAX_RATIO = 1.1;
+
+// modified Bessel function of the first kind, order zero
+static double BesselI0(double x)
+{
+    double sum = 1.;
+    double term = 1.;
+
+    for (int k = 1; k < 32; ++k)
+    {
+        term *= (x / (2. * k)) * (x / (2. * k));
+        sum += term;
+
+        if (term < sum * 1e-12)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+const vector<float>& Resampler::GetKernel()
+{
+    // one row of coefficients per phase, the last row is the first shifted by one frame
+    static const vector<float> kernel = []()
+    {
+        vector<float> result((PHASES + 1) * TAPS);
+
+        const double pi = acos(-1.);
+        const double norm = BesselI0(KAISER_BETA);
+
+        for (int phase = 0; phase <= PHASES; ++phase)
+        {
+            const double frac = static_cast<double>(phase) / PHASES;
+
+            vector<double> row(TAPS);
+            double sum = 0.;
+
+            for (int k = 0; k < TAPS; ++k)
+            {
+                const double x = k - CENTER - frac;
+                const double w = x / (TAPS / 2);
+
+                double h = 0.;
+
+                if (x == 0.)
+                {
+                    h = 1.;
+                }
+                else if (x != floor(x) && abs(w) < 1.)
+                {
+                    h = (sin(pi * x) / (pi * x)) * BesselI0(KAISER_BETA * sqrt(1. - w * w)) / norm;
+                }
+                row[k] = h;
+                sum += h;
+            }
+            // unity gain for every phase
+            for (int k = 0; k < TAPS; ++k)
+            {
+                result[phase * TAPS + k] = static_cast<float>(row[k] / sum);
+            }
+        }
+        return result;
+    }();
+
+    return kernel;
+}
+
+Resampler::Resampler(unsigned int channels /*= NUM_CHANNELS*/)
+    : m_channels{ channels }
+    , m_ratio{ 1. }
+    , m_step{ ONE }
+    , m_position{ 0 }
+{
+    if (m_channels == 0)
+    {
+        throw invalid_argument("resampler needs at least one channel");
+    }
+    GetKernel();
+    Reset();
+}
+
+void Resampler::SetRatio(double ratio)
+{
+    if (!(ratio >= MIN_RATIO && ratio <= MAX_RATIO))
+    {
+        throw invalid_argument("resampling ratio out of range");
+    }
+    m_ratio = ratio;
+    m_step  = static_cast<uint64_t>(llround(static_cast<double>(ONE) / ratio));
+}
+
+double Resampler::GetRatio() const noexcept
+{
+    return m_ratio;
+}
+
+void Resampler::Reset() noexcept
+{
+    // the frames in front of the first one are silent
+    m_history.assign(CENTER * m_channels, 0);
+    m_position = 0;
+}
+
+size_t Resampler::Process(const int16_t* in, size_t frames, vector<int16_t>& out)
+{
+    assert(in || frames == 0);
+
+    m_history.insert(m_history.end(), in, in + frames * m_channels);
+
+    const size_t available = m_history.size() / m_channels;
+    const float* kernel = GetKernel().data();
+
+    size_t produced = 0;
+
+    while ((m_position >> 32) + TAPS <= available)
+    {
+        const int16_t* src = m_history.data() + (m_position >> 32) * m_channels;
+        const uint32_t frac = static_cast<uint32_t>(m_position);
+
+        if (frac == 0)
+        {
+            // exactly on an input frame
+            out.insert(out.end(), src + CENTER * m_channels, src + (CENTER + 1) * m_channels);
+        }
+        else
+        {
+            const float* h0 = kernel + (frac >> PHASE_SHIFT) * TAPS;
+            const float* h1 = h0 + TAPS;
+            const float alpha = static_cast<float>(frac & PHASE_MASK) / static_cast<float>(PHASE_MASK + 1);
+
+            for (unsigned int channel = 0; channel < m_channels; ++channel)
+            {
+                float y0 = 0.f;
+                float y1 = 0.f;
+
+                for (int k = 0; k < TAPS; ++k)
+                {
+                    const float x = src[k * m_channels + channel];
+                    y0 += x * h0[k];
+                    y1 += x * h1[k];
+                }
+                const float y = y0 + alpha * (y1 - y0);
+
+                out.push_back(static_cast<int16_t>(clamp<long>(lrintf(y), INT16_MIN, INT16_MAX)));
+            }
+        }
+        m_position += m_step;
+        ++produced;
+    }
+    // the frames in front of the next output aren't needed anymore
+    const size_t consumed = min<size_t>(m_position >> 32, available);
+
+    m_history.erase(m_history.begin(), m_history.begin() + consumed * m_channels);
+    m_position -= static_cast<uint64_t>(consumed) << 32;
+
+    return produced;
+}
@@ -0,0 +1,338 @@
+#include "ResendScheduler.h"
+#include <algorithm>
+#include <assert.h>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+using namespace std::chrono;
+
+// signed distance from a to b within the 16-bit sequence space
+static inline int Distance(uint16_t a, uint16_t b) noexcept
+{
+    return static_cast<int16_t>(static_cast<uint16_t>(b - a));
+}
+
+ResendScheduler::ResendScheduler(SendRequest send, unsigned int maxAttempts, unsigned int maxRequestsPerSecond)
+    : m_send{ move(send) }
+    , m_maxAttempts{ max(maxAttempts, 1u) }
+    , m_maxRequestsPerSecond{ max(maxRequestsPerSecond, 1u) }
+    , m_stop{ false }
+    , m_tokens{ RESEND_BURST }
+    , m_lastRefill{ clock::now() }
+    , m_srtt{ 0 }
+    , m_rttVar{ 0 }
+    , m_rto{ milliseconds(RESEND_INITIAL_RTO_MS) }
+    , m_stats{ 0, 0, 0, 0, 0, 0 }
+{
+    assert(m_send);
+    m_thread = thread([this]()
+    {
+        Run();
+    });
+}
+
+ResendScheduler::~ResendScheduler()
+{
+    Stop();
+}
+
+void ResendScheduler::Stop() noexcept
+{
+    {
+        lock_guard<mutex> guard(m_mtx);
+
+        m_stop = true;
+        m_pending.clear();
+    }
+    m_cond.NotifyAll();
+
+    if (m_thread.joinable() && m_thread.get_id() != this_thread::get_id())
+    {
+        try
+        {
+            m_thread.join();
+        }
+        catch (...)
+        {
+            assert(false);
+        }
+    }
+}
+
+size_t ResendScheduler::Request(uint16_t seq, uint16_t count, clock::time_point deadline)
+{
+    size_t added = 0;
+    {
+        lock_guard<mutex> guard(m_mtx);
+
+        if (m_stop)
+        {
+            return 0;
+        }
+        // wait a moment for adjacent gaps of the same receive batch
+        const auto nextSend = clock::now() + milliseconds(RESEND_COALESCE_MS);
+
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            if (m_pending.try_emplace(static_cast<uint16_t>(seq + i), Entry{ deadline, nextSend, clock::time_point{}, 0 }).second)
+            {
+                ++added;
+            }
+        }
+        m_stats.requested += added;
+    }
+    if (added > 0)
+    {
+        m_cond.NotifyOne();
+    }
+    return added;
+}
+
+bool ResendScheduler::OnArrival(uint16_t seq, bool isResendPacket) noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    const auto i = m_pending.find(seq);
+
+    if (i == m_pending.end())
+    {
+        return false;
+    }
+    // only answers to a single request tell the round trip time (Karn)
+    if (isResendPacket && i->second.attempts == 1)
+    {
+        UpdateRoundTripTime(duration_cast<microseconds>(clock::now() - i->second.lastSent));
+    }
+    m_pending.erase(i);
+    ++m_stats.recovered;
+
+    return true;
+}
+
+void ResendScheduler::OnTooLate(uint16_t seq) noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    m_pending.erase(seq);
+    ++m_stats.tooLate;
+}
+
+void ResendScheduler::Cancel(uint16_t seq, uint16_t count) noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    for (uint16_t i = 0; i < count && !m_pending.empty(); ++i)
+    {
+        m_stats.abandoned += m_pending.erase(static_cast<uint16_t>(seq + i));
+    }
+}
+
+void ResendScheduler::Clear() noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    m_pending.clear();
+}
+
+bool ResendScheduler::IsPending(uint16_t seq) const noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    return m_pending.count(seq) > 0;
+}
+
+size_t ResendScheduler::GetPendingCount() const noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    return m_pending.size();
+}
+
+ResendScheduler::Stats ResendScheduler::GetStats() const noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    return m_stats;
+}
+
+microseconds ResendScheduler::GetRoundTripTime() const noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    return m_srtt;
+}
+
+microseconds ResendScheduler::GetRetransmissionTimeout() const noexcept
+{
+    lock_guard<mutex> guard(m_mtx);
+
+    return m_rto;
+}
+
+// RFC 6298 estimator, the caller holds the lock
+void ResendScheduler::UpdateRoundTripTime(microseconds sample) noexcept
+{
+    if (m_srtt.count() == 0)
+    {
+        m_srtt   = sample;
+        m_rttVar = sample / 2;
+    }
+    else
+    {
+        const auto delta = m_srtt > sample ? m_srtt - sample : sample - m_srtt;
+
+        m_rttVar = (3 * m_rttVar + delta) / 4;
+        m_srtt   = (7 * m_srtt + sample) / 8;
+    }
+    m_rto = clamp(duration_cast<microseconds>(m_srtt + 4 * m_rttVar),
+        duration_cast<microseconds>(milliseconds(RESEND_MIN_RTO_MS)),
+        duration_cast<microseconds>(milliseconds(RESEND_MAX_RTO_MS)));
+}
+
+ResendScheduler::clock::time_point ResendScheduler::Schedule(clock::time_point now, vector<SeqRun>& runs)
+{
+    assert(runs.empty());
+
+    m_due.clear();
+
+    size_t abandoned = 0;
+
+    for (auto i = m_pending.begin(); i != m_pending.end(); )
+    {
+        const Entry& entry = i->second;
+
+        // either the packet would be played already or the last attempt timed out
+        if (entry.deadline <= now || (entry.attempts >= m_maxAttempts && entry.nextSend <= now))
+        {
+            i = m_pending.erase(i);
+            ++abandoned;
+            continue;
+        }
+        if (entry.nextSend <= now)
+        {
+            m_due.push_back(i->first);
+        }
+        ++i;
+    }
+    if (abandoned > 0)
+    {
+        m_stats.abandoned += abandoned;
+        spdlog::debug("gave up {} missing packets", abandoned);
+    }
+
+    // refill the token bucket
+    const double elapsed = duration<double>(now - m_lastRefill).count();
+    m_tokens = min<double>(RESEND_BURST, m_tokens + elapsed * m_maxRequestsPerSecond);
+    m_lastRefill = now;
+
+    if (!m_due.empty())
+    {
+        // order by the distance to any of them, which is wraparound safe
+        const uint16_t ref = m_due.front();
+
+        sort(m_due.begin(), m_due.end(), [ref](uint16_t a, uint16_t b)
+        {
+            return Distance(ref, a) < Distance(ref, b);
+        });
+
+        for (size_t first = 0; first < m_due.size() && m_tokens >= 1.; )
+        {
+            size_t last = first + 1;
+
+            while (last < m_due.size() && static_cast<uint16_t>(m_due[last - 1] + 1) == m_due[last])
+            {
+                ++last;
+            }
+            bool isRetry = false;
+
+            for (size_t k = first; k < last; ++k)
+            {
+                Entry& entry = m_pending[m_due[k]];
+
+                isRetry = isRetry || entry.attempts > 0;
+
+                // exponential backoff
+                const auto timeout = min(m_rto * (1 << entry.attempts),
+                    duration_cast<microseconds>(milliseconds(RESEND_MAX_RTO_MS)));
+
+                ++entry.attempts;
+                entry.lastSent = now;
+                entry.nextSend = now + timeout;
+            }
+            runs.emplace_back(m_due[first], static_cast<uint16_t>(last - first));
+
+            m_tokens -= 1.;
+            ++m_stats.sent;
+
+            if (isRetry)
+            {
+                ++m_stats.retried;
+            }
+            first = last;
+        }
+    }
+    clock::time_point wakeUp = clock::time_point::max();
+
+    for (const auto& item : m_pending)
+    {
+        if (item.second.nextSend <= now)
+        {
+            // out of tokens
+            wakeUp = min(wakeUp, now + duration_cast<clock::duration>(duration<double>((1. - m_tokens) / m_maxRequestsPerSecond)));
+        }
+        else
+        {
+            wakeUp = min({ wakeUp, item.second.nextSend, item.second.deadline });
+        }
+    }
+    return wakeUp;
+}
+
+void ResendScheduler::Run() noexcept
+{
+    vector<SeqRun> runs;
+    unique_lock<mutex> sync(m_mtx);
+
+    while (!m_stop)
+    {
+        const auto now = clock::now();
+        clock::time_point wakeUp;
+
+        try
+        {
+            wakeUp = Schedule(now, runs);
+        }
+        catch (...)
+        {
+            wakeUp = now + milliseconds(RESEND_MIN_RTO_MS);
+        }
+
+        if (!runs.empty())
+        {
+            // don't block the receivers while sending
+            sync.unlock();
+
+            for (const auto& run : runs)
+            {
+                if (!m_send(run.first, run.second))
+                {
+                    spdlog::debug("failed to send resend request for seq: {} -> {}", run.first,
+                        static_cast<uint16_t>(run.first + run.second - 1));
+                }
+            }
+            runs.clear();
+            sync.lock();
+            continue;
+        }
+
+        if (wakeUp == clock::time_point::max())
+        {
+            m_cond.WaitAndLock(sync);
+        }
+        else if (wakeUp > now)
+        {
+            const auto ms = duration_cast<milliseconds>(wakeUp - now).count() + 1;
+            m_cond.WaitAndLock(sync, static_cast<uint32_t>(ms));
+        }
+    }
+}
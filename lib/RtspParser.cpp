@@ -0,0 +1,306 @@
+#include "RtspParser.h"
+#include <charconv>
+#include <algorithm>
+
+using namespace std;
+
+namespace RtspParser
+{
+
+bool IsSpace(const char c) noexcept
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+static inline char ToLower(const char c) noexcept
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static inline bool IsDigit(const char c) noexcept
+{
+    return c >= '0' && c <= '9';
+}
+
+string_view Trim(string_view s, const string_view trimSet) noexcept
+{
+    const auto first = s.find_first_not_of(trimSet);
+
+    if (first == string_view::npos)
+    {
+        return {};
+    }
+    s.remove_prefix(first);
+    s.remove_suffix(s.size() - s.find_last_not_of(trimSet) - 1);
+
+    return s;
+}
+
+bool EqualsNoCase(const string_view a, const string_view b) noexcept
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (ToLower(a[i]) != ToLower(b[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NextLine(string_view& text, string_view& line) noexcept
+{
+    if (text.empty())
+    {
+        return false;
+    }
+    const auto end = text.find_first_of("\r\n");
+
+    if (end == string_view::npos)
+    {
+        line = text;
+        text = {};
+        return true;
+    }
+    line = text.substr(0, end);
+
+    // "\r\n" is one line end
+    const size_t skip = (text[end] == '\r' && end + 1 < text.size() && text[end + 1] == '\n') ? 2 : 1;
+    text.remove_prefix(end + skip);
+
+    return true;
+}
+
+bool NextToken(string_view& text, string_view& token) noexcept
+{
+    size_t i = 0;
+
+    while (i < text.size() && IsSpace(text[i]))
+    {
+        ++i;
+    }
+    if (i == text.size())
+    {
+        text = {};
+        return false;
+    }
+    size_t end = i;
+
+    while (end < text.size() && !IsSpace(text[end]))
+    {
+        ++end;
+    }
+    token = text.substr(i, end - i);
+    text.remove_prefix(end);
+
+    return true;
+}
+
+bool NextNumber(string_view& text, uint64_t& number) noexcept
+{
+    for (;;)
+    {
+        size_t i = 0;
+
+        while (i < text.size() && !IsDigit(text[i]))
+        {
+            ++i;
+        }
+        if (i == text.size())
+        {
+            text = {};
+            return false;
+        }
+        size_t end = i;
+
+        while (end < text.size() && IsDigit(text[end]))
+        {
+            ++end;
+        }
+        const auto result = from_chars(text.data() + i, text.data() + end, number);
+        text.remove_prefix(end);
+
+        if (result.ec == errc())
+        {
+            return true;
+        }
+    }
+}
+
+bool NextParameter(string_view& text, string_view& key, string_view& value) noexcept
+{
+    string_view line;
+
+    while (NextLine(text, line))
+    {
+        const auto colon = line.find(':');
+
+        if (colon == string_view::npos)
+        {
+            continue;
+        }
+        key = Trim(line.substr(0, colon));
+
+        if (key.empty() || any_of(key.begin(), key.end(), IsSpace))
+        {
+            continue;
+        }
+        value = Trim(line.substr(colon + 1), " \t\r\n:");
+        return true;
+    }
+    return false;
+}
+
+bool NextAttribute(string_view& text, string_view& key, string_view& value) noexcept
+{
+    string_view line;
+
+    while (NextLine(text, line))
+    {
+        line = Trim(line);
+
+        if (line.size() < 2 || line[0] != 'a' || line[1] != '=')
+        {
+            continue;
+        }
+        line.remove_prefix(2);
+
+        const auto colon = line.find(':');
+
+        if (colon == string_view::npos)
+        {
+            // a flag like "a=recvonly"
+            continue;
+        }
+        key = Trim(line.substr(0, colon));
+
+        if (key.empty())
+        {
+            continue;
+        }
+        value = Trim(line.substr(colon + 1));
+        return true;
+    }
+    return false;
+}
+
+bool NextQuotedPair(string_view& text, string_view& key, string_view& value) noexcept
+{
+    while (!text.empty())
+    {
+        // the key runs up to the equal sign or white space
+        size_t i = 0;
+
+        while (i < text.size() && (IsSpace(text[i]) || text[i] == ','))
+        {
+            ++i;
+        }
+        size_t end = i;
+
+        while (end < text.size() && !IsSpace(text[end]) && text[end] != '=' && text[end] != '"' && text[end] != ',')
+        {
+            ++end;
+        }
+        const auto candidate = text.substr(i, end - i);
+
+        while (end < text.size() && IsSpace(text[end]))
+        {
+            ++end;
+        }
+        if (candidate.empty() || end == text.size() || text[end] != '=')
+        {
+            // no pair here, go on after it
+            text.remove_prefix(min(text.size(), max(end, i + 1)));
+            continue;
+        }
+        ++end;
+
+        while (end < text.size() && IsSpace(text[end]))
+        {
+            ++end;
+        }
+        if (end == text.size() || text[end] != '"')
+        {
+            text.remove_prefix(end);
+            continue;
+        }
+        const auto closing = text.find('"', end + 1);
+
+        if (closing == string_view::npos)
+        {
+            text = {};
+            return false;
+        }
+        key = candidate;
+        value = text.substr(end + 1, closing - end - 1);
+        text.remove_prefix(closing + 1);
+
+        return true;
+    }
+    return false;
+}
+
+optional<string_view> FindLine(string_view sdp, const char type) noexcept
+{
+    string_view line;
+
+    while (NextLine(sdp, line))
+    {
+        line = Trim(line);
+
+        if (line.size() >= 2 && line[0] == type && line[1] == '=')
+        {
+            return Trim(line.substr(2));
+        }
+    }
+    return nullopt;
+}
+
+optional<int> FindNumber(string_view list, const string_view name) noexcept
+{
+    while (!list.empty())
+    {
+        const auto end = list.find(';');
+        const auto item = Trim(list.substr(0, end));
+
+        list = end == string_view::npos ? string_view() : list.substr(end + 1);
+
+        const auto eq = item.find('=');
+
+        if (eq != string_view::npos && Trim(item.substr(0, eq)) == name)
+        {
+            return ToInt(Trim(item.substr(eq + 1)));
+        }
+    }
+    return nullopt;
+}
+
+optional<int> ToInt(const string_view s) noexcept
+{
+    int value = 0;
+    const auto result = from_chars(s.data(), s.data() + s.size(), value);
+
+    if (s.empty() || result.ec != errc() || result.ptr != s.data() + s.size())
+    {
+        return nullopt;
+    }
+    return value;
+}
+
+optional<double> ToDouble(const string_view s) noexcept
+{
+    double value = 0.;
+    const auto result = from_chars(s.data(), s.data() + s.size(), value);
+
+    if (s.empty() || result.ec != errc() || result.ptr != s.data() + s.size())
+    {
+        return nullopt;
+    }
+    return value;
+}
+
+} // namespace RtspParser
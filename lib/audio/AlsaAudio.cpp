@@ -2,11 +2,13 @@
 #include <errno.h>
 #include <fstream>
 #include <vector>
+#include <cstring>
 #include "audio/AlsaAudio.h"
 #include "audio/PlaySound.h"
 #include "LayerCake.h"
 #include <thread>
 #include <chrono>
+#include <mutex>
 
 using namespace std;
 using namespace chrono_literals;
@@ -30,8 +32,10 @@ using namespace AlsaAudio;
 
 PCMDevice::PCMDevice(string hw_device, snd_pcm_stream_t stream_type) :
     err(0),
+    access_type(SND_PCM_ACCESS_RW_INTERLEAVED),
     frame_size_bytes(0),
     period_size_in_frames(0),
+    buffer_size_in_frames(0),
     device_name(hw_device),
     pcm_handle(nullptr),
     hw_params(nullptr)
@@ -61,6 +65,8 @@ int PCMDevice::set_hardware_params(HwParams& params)
 
     if (hw_state == SND_PCM_STATE_OPEN)
     {
+        requested_params = params;
+
         frame_size_bytes = (snd_pcm_format_physical_width(params.format_type) * static_cast<int>(params.channels)) >> 3;
         assert(frame_size_bytes);
 
@@ -80,9 +86,21 @@ int PCMDevice::set_hardware_params(HwParams& params)
 
         if ((err = snd_pcm_hw_params_set_access(pcm_handle, hw_params, params.access_type)) < 0)
         {
-            handle_error_code(err, false, "Cannot set access type for PCM object.");
-            return err;
+            if (params.access_type != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+            {
+                handle_error_code(err, false, "Cannot set access type for PCM object.");
+                return err;
+            }
+            // the device refuses mmap, the frames are written instead
+            params.access_type = SND_PCM_ACCESS_RW_INTERLEAVED;
+
+            if ((err = snd_pcm_hw_params_set_access(pcm_handle, hw_params, params.access_type)) < 0)
+            {
+                handle_error_code(err, false, "Cannot set access type for PCM object.");
+                return err;
+            }
         }
+        access_type = params.access_type;
 
         if ((err = snd_pcm_hw_params_set_format(pcm_handle, hw_params, params.format_type)) < 0)
         {
@@ -108,43 +126,81 @@ int PCMDevice::set_hardware_params(HwParams& params)
             assert(req_rate == params.sample_rate_hz);
         }
 
-        // To calculate the period time in microseconds, we take the source
-        // bytes per second divided by the size of the buffer (in bytes) to get the number
-        // of buffer fills (periods) required per second. We then divide 1,000,000
-        // (number of microseconds in a second) by the periods per second to get the
-        // number of microseconds for each period (approximate)
-        const double periods_per_sec = ((double)params.byteRate / (((double)(frame_size_bytes * 1024)) / (((double)params.bitsPerSample) / 8.0)));
+        if (params.period_frames)
+        {
+            if ((err = snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params, &params.period_frames, 0)) < 0)
+            {
+                handle_error_code(err, false, "Cannot set period size for PCM object.");
+                return err;
+            }
+        }
+        else
+        {
+            if (!params.period_time_us)
+            {
+                // To calculate the period time in microseconds, we take the source
+                // bytes per second divided by the size of the buffer (in bytes) to get the number
+                // of buffer fills (periods) required per second. We then divide 1,000,000
+                // (number of microseconds in a second) by the periods per second to get the
+                // number of microseconds for each period (approximate)
+                const double periods_per_sec = ((double)params.byteRate / (((double)(frame_size_bytes * 1024)) / (((double)params.bitsPerSample) / 8.0)));
+
+                // Microseconds per period (requested)
+                params.period_time_us = static_cast<unsigned int>(1000000.0l / periods_per_sec);
+            }
+            if ((err = snd_pcm_hw_params_set_period_time_near(pcm_handle, hw_params, &params.period_time_us, 0)) < 0)
+            {
+                handle_error_code(err, false, "Cannot set period time for PCM object.");
+                return err;
+            }
+        }
 
-        // Microseconds per period (requested)
-        params.period_time_us = static_cast<unsigned int>(1000000.0l / periods_per_sec);
+        // the device chooses the buffer size if none is requested
+        if (params.buffer_frames)
+        {
+            if ((err = snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params, &params.buffer_frames)) < 0)
+            {
+                handle_error_code(err, false, "Cannot set buffer size for PCM object.");
+                return err;
+            }
+        }
+        else if (params.buffer_time_us)
+        {
+            if ((err = snd_pcm_hw_params_set_buffer_time_near(pcm_handle, hw_params, &params.buffer_time_us, 0)) < 0)
+            {
+                handle_error_code(err, false, "Cannot set buffer time for PCM object.");
+                return err;
+            }
+        }
 
-        if ((err = snd_pcm_hw_params_set_period_time_near(pcm_handle, hw_params, &params.period_time_us, 0)) < 0)
+        if ((err = snd_pcm_hw_params(pcm_handle, hw_params)) < 0)
         {
-            handle_error_code(err, false, "Cannot set period time for PCM object.");
+            handle_error_code(err, false, "Cannot apply hardware parameters to PCM device.");
             return err;
         }
 
-        snd_pcm_uframes_t psize;
-
-        if ((err = snd_pcm_hw_params_get_period_size(hw_params, &psize, 0)) < 0)
+        if ((err = snd_pcm_hw_params_get_period_size(hw_params, &params.period_frames, 0)) < 0)
         {
             handle_error_code(err, false, "Could not get period size for PCM object.");
             return err;
         }
-        else
-        {
-            period_size_in_frames = psize;
-        }
+        period_size_in_frames = params.period_frames;
 
-        if ((err = snd_pcm_hw_params(pcm_handle, hw_params)) < 0)
+        if ((err = snd_pcm_hw_params_get_buffer_size(hw_params, &params.buffer_frames)) < 0)
         {
-            handle_error_code(err, false, "Cannot apply hardware parameters to PCM device.");
+            handle_error_code(err, false, "Could not get buffer size for PCM object.");
             return err;
         }
+        buffer_size_in_frames = params.buffer_frames;
+        params.period_time_us = static_cast<unsigned int>((params.period_frames * 1000000ull) / params.sample_rate_hz);
+        params.buffer_time_us = static_cast<unsigned int>((params.buffer_frames * 1000000ull) / params.sample_rate_hz);
+
         params.SetBufSize(period_size_in_frames * frame_size_bytes * 2);
         
         // the buffer size has to be aligned to the frame size
         assert(params.GetBufSize() % frame_size_bytes == 0);
+
+        negotiated_params = params;
     }
     else
     {
@@ -156,8 +212,79 @@ int PCMDevice::set_hardware_params(HwParams& params)
     return EXIT_SUCCESS;
 }
 
+const string& PCMDevice::get_device_name() const
+{
+    return device_name;
+}
+
+const HwParams& PCMDevice::get_requested_params() const
+{
+    return requested_params;
+}
+
+const HwParams& PCMDevice::get_hardware_params() const
+{
+    return negotiated_params;
+}
+
+const XrunStats& PCMDevice::get_xrun_stats() const
+{
+    return xrun_stats;
+}
+
+void PCMDevice::reset_xrun_stats()
+{
+    xrun_stats = XrunStats();
+    interrupted.reset();
+    running_until.reset();
+}
+
+void PCMDevice::on_running()
+{
+    if (snd_pcm_state(pcm_handle) != SND_PCM_STATE_RUNNING)
+    {
+        return;
+    }
+    const auto now = XrunStats::clock::now();
+
+    if (interrupted)
+    {
+        xrun_stats.silence += chrono::duration_cast<chrono::microseconds>(now - *interrupted);
+        interrupted.reset();
+    }
+    snd_pcm_sframes_t frames = 0;
+
+    if (snd_pcm_delay(pcm_handle, &frames) == 0 && frames > 0 && negotiated_params.sample_rate_hz)
+    {
+        running_until = now + chrono::microseconds((frames * 1000000ll) / negotiated_params.sample_rate_hz);
+    }
+}
+
 int PCMDevice::xrun_recovery()
 {
+    if (err == -EPIPE || err == -ESTRPIPE)
+    {
+        const auto now = XrunStats::clock::now();
+
+        // the device went silent when it ran dry, which is noticed only by the next write
+        const auto since = running_until ? min(*running_until, now) : now;
+
+        if (err == -EPIPE)
+        {
+            ++xrun_stats.underruns;
+            xrun_stats.lastUnderrun = since;
+        }
+        else
+        {
+            ++xrun_stats.suspends;
+            xrun_stats.lastSuspend = now;
+        }
+        if (!interrupted)
+        {
+            interrupted = err == -EPIPE ? since : now;
+        }
+        running_until.reset();
+    }
     if (err == -EPIPE)
     {
         err = snd_pcm_prepare(pcm_handle);
@@ -189,8 +316,162 @@ int PCMDevice::xrun_recovery()
     return err;
 }
 
-PCMPlayer::PCMPlayer(string hw_device) : PCMDevice(hw_device, SND_PCM_STREAM_PLAYBACK)
+PCMPlayer::PCMPlayer(string hw_device) : PCMDevice(hw_device, SND_PCM_STREAM_PLAYBACK),
+    xrun_policy(XrunPolicy::drop),
+    start_frames(0)
+{
+}
+
+int PCMPlayer::set_xrun_policy(XrunPolicy policy, snd_pcm_uframes_t refill_frames /*= 0*/)
+{
+    assert(period_size_in_frames && buffer_size_in_frames);
+
+    xrun_policy = policy;
+
+    if (policy == XrunPolicy::drop)
+    {
+        start_frames = period_size_in_frames;
+    }
+    else
+    {
+        start_frames = refill_frames ? min(max(refill_frames, period_size_in_frames), buffer_size_in_frames) : buffer_size_in_frames;
+    }
+    snd_pcm_sw_params_t* sw_params = nullptr;
+
+    if ((err = snd_pcm_sw_params_malloc(&sw_params)) < 0)
+    {
+        handle_error_code(err, false, "Cannot allocate software parameter structure for PCM object.");
+        return err;
+    }
+    if ((err = snd_pcm_sw_params_current(pcm_handle, sw_params)) < 0)
+    {
+        handle_error_code(err, false, "Cannot get software parameters for PCM object.");
+    }
+    // a device started by a write waits for the same level
+    else if ((err = snd_pcm_sw_params_set_start_threshold(pcm_handle, sw_params, start_frames)) < 0)
+    {
+        handle_error_code(err, false, "Cannot set start threshold for PCM object.");
+    }
+    else if ((err = snd_pcm_sw_params(pcm_handle, sw_params)) < 0)
+    {
+        handle_error_code(err, false, "Cannot apply software parameters to PCM device.");
+    }
+    snd_pcm_sw_params_free(sw_params);
+
+    return err < 0 ? err : EXIT_SUCCESS;
+}
+
+bool PCMPlayer::is_mmap() const
 {
+    return access_type == SND_PCM_ACCESS_MMAP_INTERLEAVED;
+}
+
+size_t PCMPlayer::play_mmap(const function<size_t(uint8_t* dest, size_t bytes)>& read)
+{
+    assert(is_mmap());
+
+    for (;;)
+    {
+        const snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_handle);
+
+        if (avail < 0)
+        {
+            err = static_cast<int>(avail);
+
+            if (xrun_recovery() < 0)
+            {
+                handle_error_code(err, false, "Cannot recover from underrun.");
+                return 0;
+            }
+            // the buffer is filled again before playback restarts
+            continue;
+        }
+        if (static_cast<snd_pcm_uframes_t>(avail) < period_size_in_frames)
+        {
+            const snd_pcm_state_t hw_state = snd_pcm_state(pcm_handle);
+
+            if (hw_state == SND_PCM_STATE_PREPARED)
+            {
+                // the buffer is full, the playback starts
+                if ((err = snd_pcm_start(pcm_handle)) < 0)
+                {
+                    handle_error_code(err, false, "Cannot start PCM device.");
+                    return 0;
+                }
+            }
+            else if (hw_state != SND_PCM_STATE_RUNNING && hw_state != SND_PCM_STATE_XRUN)
+            {
+                handle_error_code(static_cast<int>(errc::bad_file_descriptor), false, "PCM device isn't ready to play.");
+                return 0;
+            }
+            else if ((err = snd_pcm_wait(pcm_handle, 1000)) < 0 && xrun_recovery() < 0)
+            {
+                handle_error_code(err, false, "Cannot recover from underrun.");
+                return 0;
+            }
+            continue;
+        }
+        const snd_pcm_channel_area_t* areas = nullptr;
+        snd_pcm_uframes_t offset = 0;
+        snd_pcm_uframes_t frames = period_size_in_frames;
+
+        if ((err = snd_pcm_mmap_begin(pcm_handle, &areas, &offset, &frames)) < 0)
+        {
+            if (xrun_recovery() < 0)
+            {
+                handle_error_code(err, false, "Cannot map PCM buffer.");
+                return 0;
+            }
+            continue;
+        }
+        // interleaved: all channels start in the area of the first one
+        uint8_t* dest = static_cast<uint8_t*>(areas[0].addr) + (areas[0].first >> 3) + offset * frame_size_bytes;
+
+        const size_t bytes = read(dest, frames * frame_size_bytes);
+        assert(bytes % frame_size_bytes == 0);
+
+        const snd_pcm_uframes_t filled = bytes / frame_size_bytes;
+        const snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm_handle, offset, filled);
+
+        if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != filled)
+        {
+            // the device ran dry while the frames were read, the area is gone after the recovery
+            vector<uint8_t> pending;
+
+            if (xrun_policy == XrunPolicy::refill)
+            {
+                pending.assign(dest, dest + bytes);
+            }
+            err = committed < 0 ? static_cast<int>(committed) : -EPIPE;
+
+            if (xrun_recovery() < 0)
+            {
+                handle_error_code(err, false, "Cannot commit PCM buffer.");
+                return 0;
+            }
+            if (xrun_policy == XrunPolicy::drop)
+            {
+                xrun_stats.droppedFrames += filled;
+            }
+            else if ((err = static_cast<int>(snd_pcm_mmap_writei(pcm_handle, pending.data(), filled))) < 0)
+            {
+                handle_error_code(err, false, "Cannot write PCM buffer.");
+                return 0;
+            }
+        }
+        else if (filled && snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED &&
+            buffer_size_in_frames - static_cast<snd_pcm_uframes_t>(avail) + filled >= start_frames)
+        {
+            if ((err = snd_pcm_start(pcm_handle)) < 0)
+            {
+                handle_error_code(err, false, "Cannot start PCM device.");
+                return 0;
+            }
+        }
+        on_running();
+
+        return filled;
+    }
 }
 
 void PCMPlayer::flush()
@@ -198,15 +479,39 @@ void PCMPlayer::flush()
     snd_pcm_drain(pcm_handle);
 }
 
-void PCMPlayer::play_interleaved(const char* buffer, size_t buf_size)
+bool PCMPlayer::prepare()
+{
+    if ((err = snd_pcm_prepare(pcm_handle)) < 0)
+    {
+        handle_error_code(err, false, "Cannot prepare PCM device.");
+        return false;
+    }
+    return true;
+}
+
+snd_pcm_uframes_t PCMPlayer::delay()
+{
+    snd_pcm_sframes_t frames = 0;
+
+    if (snd_pcm_delay(pcm_handle, &frames) < 0 || frames < 0)
+    {
+        return 0;
+    }
+    return static_cast<snd_pcm_uframes_t>(frames);
+}
+
+size_t PCMPlayer::play_interleaved(const char* buffer, size_t buf_size)
 {
     assert(buffer);
 
     const snd_pcm_state_t hw_state = snd_pcm_state(pcm_handle);
 
-    if (hw_state == SND_PCM_STATE_PREPARED || hw_state == SND_PCM_STATE_RUNNING)
+    unsigned long current_frames_written = 0;
+
+    // an interrupted device is recovered by the write
+    if (hw_state == SND_PCM_STATE_PREPARED || hw_state == SND_PCM_STATE_RUNNING ||
+        hw_state == SND_PCM_STATE_XRUN || hw_state == SND_PCM_STATE_SUSPENDED)
     {
-        unsigned long current_frames_written = 0;
         const auto frames_to_write = buf_size / frame_size_bytes;
 
         while (current_frames_written < frames_to_write)
@@ -227,20 +532,25 @@ void PCMPlayer::play_interleaved(const char* buffer, size_t buf_size)
                 if ((xrun_err = xrun_recovery()) < 0)
                 {
                     handle_error_code(xrun_err, false, "Read error");
-                    return;
+                    return current_frames_written;
                 }
-                else
+                else if (xrun_policy == XrunPolicy::drop)
                 {
                     // Recovered - skip period
+                    xrun_stats.droppedFrames += frames_to_write - current_frames_written;
                     break;
                 }
+                // Recovered - the device restarts at the start threshold
+                continue;
             }
             current_frames_written += err;
         }
+        on_running();
     }
+    return current_frames_written;
 }
 
-future<int> AlsaAudio::Play(IStream* stream, string device /*= "default"*/)
+future<int> AlsaAudio::Play(IStream* stream, string device /*= "default"*/, shared_ptr<PlaybackPosition> position /*= nullptr*/, BufferRequest request /*= {}*/)
 {
     assert(stream);
 
@@ -264,18 +574,82 @@ future<int> AlsaAudio::Play(IStream* stream, string device /*= "default"*/)
                 }
                 try
                 {
-                    PCMPlayer player(device);
+                    unique_ptr<PCMPlayer> player;
                     HwParams params;
 
                     params.InitFrom(wav_hdr);
 
-                    int error = player.set_hardware_params(params);
+                    // the stream is read straight into the device buffer if it can be mapped
+                    params.access_type      = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+                    params.period_frames    = request.periodFrames;
+                    params.period_time_us   = request.periodTimeUs;
+                    params.buffer_frames    = request.bufferFrames;
+                    params.buffer_time_us   = request.bufferTimeUs;
+
+                    int error = DeviceManager::Instance().Acquire(device, params, player);
 
                     if (error != EXIT_SUCCESS)
                     {
                         stream->Release();
                         return error;
                     }
+                    if ((error = player->set_xrun_policy(request.xrunPolicy, request.refillFrames)) != EXIT_SUCCESS)
+                    {
+                        stream->Release();
+                        return error;
+                    }
+                    player->reset_xrun_stats();
+
+                    if (position)
+                    {
+                        position->SetBuffer(params.period_frames, params.buffer_frames);
+                    }
+                    uint64_t written = 0;
+
+                    if (player->is_mmap())
+                    {
+                        const size_t frameSize = wav_hdr.myData.blockAlign;
+                        assert(frameSize);
+
+                        const auto readStream = [stream, frameSize](uint8_t* dest, size_t bytes) -> size_t
+                        {
+                            size_t total = 0;
+                            ULONG n = 0;
+
+                            // whatever is there, but whole frames
+                            while (total < bytes && SUCCEEDED(stream->Read(dest + total, static_cast<ULONG>(bytes - total), &n)) && n > 0)
+                            {
+                                total += n;
+
+                                if (total % frameSize == 0)
+                                {
+                                    break;
+                                }
+                            }
+                            if (const size_t partial = total % frameSize)
+                            {
+                                // the stream ended within a frame
+                                memset(dest + total, 0, frameSize - partial);
+                                total += frameSize - partial;
+                            }
+                            return total;
+                        };
+                        size_t frames = 0;
+
+                        while ((frames = player->play_mmap(readStream)) > 0)
+                        {
+                            written += frames;
+
+                            if (position)
+                            {
+                                position->Update(written - player->get_xrun_stats().droppedFrames, player->delay());
+                                position->SetXruns(player->get_xrun_stats());
+                            }
+                        }
+                        DeviceManager::Instance().Release(move(player));
+                        stream->Release();
+                        return 0;
+                    }
                     const ULONG bufSize = static_cast<ULONG>(params.GetBufSize());
                     assert(bufSize);
 
@@ -288,15 +662,21 @@ future<int> AlsaAudio::Play(IStream* stream, string device /*= "default"*/)
 
                         if (fill == bufSize)
                         {
-                            player.play_interleaved((const char*)buffer.data(), bufSize);
+                            written += player->play_interleaved((const char*)buffer.data(), bufSize);
                             fill = 0;
+
+                            if (position)
+                            {
+                                position->Update(written, player->delay());
+                                position->SetXruns(player->get_xrun_stats());
+                            }
                         }
                     }
                     if (fill)
                     {
-                        player.play_interleaved((const char*)buffer.data(), fill);
+                        player->play_interleaved((const char*)buffer.data(), fill);
                     }
-                    player.flush();
+                    DeviceManager::Instance().Release(move(player));
                 }
                 catch (...)
                 {
@@ -324,12 +704,12 @@ future<int> AlsaAudio::Play(const void* buf, size_t bufsize, string device /*= "
 
                 try
                 {
-                    PCMPlayer player(device);
+                    unique_ptr<PCMPlayer> player;
                     HwParams params;
 
                     params.InitFrom(*wav_hdr);
 
-                    int error = player.set_hardware_params(params);
+                    int error = DeviceManager::Instance().Acquire(device, params, player);
 
                     if (error != EXIT_SUCCESS)
                     {
@@ -340,7 +720,7 @@ future<int> AlsaAudio::Play(const void* buf, size_t bufsize, string device /*= "
 
                     while (total > 0)
                     {
-                        player.play_interleaved(buffer, total > params.GetBufSize() ? params.GetBufSize() : total);
+                        player->play_interleaved(buffer, total > params.GetBufSize() ? params.GetBufSize() : total);
 
                         if (total <= params.GetBufSize())
                             break;
@@ -348,7 +728,7 @@ future<int> AlsaAudio::Play(const void* buf, size_t bufsize, string device /*= "
                         total -= params.GetBufSize();
                         buffer += params.GetBufSize();
                     }
-                    player.flush();
+                    DeviceManager::Instance().Release(move(player));
                 }
                 catch (...)
                 {
@@ -382,12 +762,12 @@ future<int> AlsaAudio::Play(string file_path, string device /*= "default"*/)
 
             try
             {
-                PCMPlayer player(device);
+                unique_ptr<PCMPlayer> player;
                 HwParams params;
 
                 params.InitFrom(wav_hdr);
 
-                int error = player.set_hardware_params(params);
+                int error = DeviceManager::Instance().Acquire(device, params, player);
 
                 if (error != EXIT_SUCCESS)
                 {
@@ -403,11 +783,11 @@ future<int> AlsaAudio::Play(string file_path, string device /*= "default"*/)
                     memset(buffer.data(), 0, params.GetBufSize());
                     wav_file.read(buffer.data(), params.GetBufSize());
 
-                    player.play_interleaved(buffer.data(), params.GetBufSize());
+                    player->play_interleaved(buffer.data(), params.GetBufSize());
                 }
 
                 wav_file.close();
-                player.flush();
+                DeviceManager::Instance().Release(move(player));
             }
             catch (...)
             {
@@ -417,6 +797,156 @@ future<int> AlsaAudio::Play(string file_path, string device /*= "default"*/)
         }));
 }
 
+// an idle player keeps the device from other applications
+constexpr auto DEFAULT_IDLE_TIMEOUT = 30s;
+
+DeviceManager& DeviceManager::Instance()
+{
+    static DeviceManager instance;
+    return instance;
+}
+
+DeviceManager::DeviceManager() :
+    m_idleTimeout(DEFAULT_IDLE_TIMEOUT),
+    m_stop(false),
+    m_stats{ 0, 0, 0 }
+{
+}
+
+DeviceManager::~DeviceManager()
+{
+    {
+        lock_guard<mutex> guard(m_mtx);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+
+    if (m_closer.joinable())
+    {
+        m_closer.join();
+    }
+}
+
+int DeviceManager::Acquire(const string& device, HwParams& params, unique_ptr<PCMPlayer>& player)
+{
+    unique_ptr<PCMPlayer> idle;
+    {
+        lock_guard<mutex> guard(m_mtx);
+        idle = move(m_idle);
+    }
+    if (idle)
+    {
+        if (idle->get_device_name() == device && idle->get_requested_params().IsSameFormat(params))
+        {
+            params = idle->get_hardware_params();
+            player = move(idle);
+
+            lock_guard<mutex> guard(m_mtx);
+            ++m_stats.reused;
+
+            return EXIT_SUCCESS;
+        }
+        // a hardware device can't be opened twice
+        idle.reset();
+    }
+    player = make_unique<PCMPlayer>(device);
+
+    const int error = player->set_hardware_params(params);
+
+    if (error != EXIT_SUCCESS)
+    {
+        player.reset();
+        return error;
+    }
+    lock_guard<mutex> guard(m_mtx);
+    ++m_stats.opened;
+
+    return EXIT_SUCCESS;
+}
+
+void DeviceManager::Release(unique_ptr<PCMPlayer>&& player)
+{
+    unique_ptr<PCMPlayer> released = move(player);
+    assert(released);
+
+    released->flush();
+
+    if (!released->prepare())
+    {
+        return;
+    }
+    unique_ptr<PCMPlayer> previous;
+    {
+        lock_guard<mutex> guard(m_mtx);
+
+        // the most recent one is kept if streams overlapped
+        previous = move(m_idle);
+        m_idle = move(released);
+        m_idleSince = chrono::steady_clock::now();
+
+        if (!m_closer.joinable())
+        {
+            m_closer = thread([this]()
+            {
+                RunCloser();
+            });
+        }
+    }
+    m_cond.notify_all();
+}
+
+void DeviceManager::SetIdleTimeout(chrono::milliseconds timeout)
+{
+    {
+        lock_guard<mutex> guard(m_mtx);
+        m_idleTimeout = timeout;
+    }
+    m_cond.notify_all();
+}
+
+void DeviceManager::Close()
+{
+    unique_ptr<PCMPlayer> idle;
+    {
+        lock_guard<mutex> guard(m_mtx);
+        idle = move(m_idle);
+    }
+}
+
+DeviceManager::Stats DeviceManager::GetStats() const
+{
+    lock_guard<mutex> guard(m_mtx);
+    return m_stats;
+}
+
+void DeviceManager::RunCloser()
+{
+    unique_lock<mutex> sync(m_mtx);
+
+    while (!m_stop)
+    {
+        if (!m_idle)
+        {
+            m_cond.wait(sync);
+            continue;
+        }
+        const auto expiry = m_idleSince + m_idleTimeout;
+
+        if (chrono::steady_clock::now() < expiry)
+        {
+            m_cond.wait_until(sync, expiry);
+            continue;
+        }
+        unique_ptr<PCMPlayer> expired = move(m_idle);
+        ++m_stats.expired;
+
+        // the device is closed without holding the lock
+        sync.unlock();
+        expired.reset();
+        sync.lock();
+    }
+}
+
 constexpr long MINIMAL_VOLUME = 0;
 constexpr long MAXIMUM_VOLUME = 65535;
 
@@ -571,6 +1101,65 @@ double Mixer::unmute()
     return get_cur_vol_pct();
 }
 
+string Mixer::card_of(const string& pcm_device)
+{
+    // hw:0,0 or plughw:CARD=Device,DEV=0 and the like
+    const auto colon = pcm_device.find(':');
+
+    if (colon == string::npos)
+    {
+        return "default";
+    }
+    const string plugin = pcm_device.substr(0, colon);
+
+    if (plugin != "hw" && plugin != "plughw" && plugin != "sysdefault" && plugin != "front")
+    {
+        return "default";
+    }
+    return "hw:" + pcm_device.substr(colon + 1, pcm_device.find(',', colon) - colon - 1);
+}
+
+bool Mixer::set_vol_db(double db)
+{
+    long min_db = 0;
+    long max_db = 0;
+
+    // 1/100 dB
+    const long centi_db = lround(db * 100.);
+    bool muted = false;
+
+    if (snd_mixer_selem_get_playback_dB_range(element_handle, &min_db, &max_db) == 0 && min_db < max_db)
+    {
+        muted = centi_db < min_db;
+
+        // never louder than requested
+        err = snd_mixer_selem_set_playback_dB_all(element_handle, max(min_db, min(max_db, centi_db)), -1);
+    }
+    else
+    {
+        long min_vol, max_vol;
+        get_vol_range(&min_vol, &max_vol);
+
+        const double amplitude = pow(10., db / 20.);
+        muted = amplitude * (max_vol - min_vol) < 1.;
+
+        err = snd_mixer_selem_set_playback_volume_all(element_handle, min_vol + lround(min(1., amplitude) * (max_vol - min_vol)));
+    }
+    if (err < 0)
+    {
+        handle_error_code(err, false, "Cannot set volume to requested value.");
+        return false;
+    }
+    if (snd_mixer_selem_has_playback_switch(element_handle))
+    {
+        if ((err = snd_mixer_selem_set_playback_switch_all(element_handle, muted ? 0 : 1)) < 0)
+        {
+            handle_error_code(err, false, "Cannot switch element.");
+        }
+    }
+    return true;
+}
+
 void Mixer::trim_pct(double& pct)
 {
     pct = (pct < 0) ? 0 : pct;
@@ -478,6 +478,7 @@ WORD WavePlayThread::GetVolume()
 AudioPlayer::AudioPlayer()
 {
 	m_pAudioData = NULL;
+	m_frameSize = 0;
 }
 
 AudioPlayer::~AudioPlayer()
@@ -533,6 +534,7 @@ bool AudioPlayer::Init(IStream* pStream, bool isRawStream /*= false*/)
 				return false;
 			}
 			m_threadWavePlay->Init(wav_hdr.myData.sampleRate, wav_hdr.myData.numChannels, wav_hdr.myData.bitsPerSample);
+			m_frameSize = wav_hdr.myData.blockAlign;
 		}
 		else
 		{
@@ -623,12 +625,42 @@ bool AudioPlayer::OnPlayAudio(unsigned char* pData, ULONG dwLen)
 	return true;
 }
 
+// reports the frames handed to the wave device, the number of wave buffers
+// in flight is fixed, so the delay to the actual playback is constant
+class PositionAudioPlayer : public AudioPlayer
+{
+public:
+	explicit PositionAudioPlayer(std::shared_ptr<AlsaAudio::PlaybackPosition> position)
+		: m_position{ std::move(position) }
+	{
+	}
+
+	bool OnPlayAudio(unsigned char* pData, unsigned long dwLen) override
+	{
+		const bool result = AudioPlayer::OnPlayAudio(pData, dwLen);
+
+		if (result && m_position && m_frameSize)
+		{
+			m_written += dwLen / m_frameSize;
+			m_position->Update(m_written, 0);
+		}
+		return result;
+	}
+
+private:
+	const std::shared_ptr<AlsaAudio::PlaybackPosition>	m_position;
+	uint64_t											m_written = 0;
+};
+
 namespace AlsaAudio
 {
-	std::future<int> Play(IStream* stream, std::string device /*= "default"*/)
+	std::future<int> Play(IStream* stream, std::string device /*= "default"*/, std::shared_ptr<PlaybackPosition> position /*= nullptr*/, BufferRequest request /*= {}*/)
 	{
 		UNREFERENCED_PARAMETER(device);
 
+		// the wave buffers have a fixed size
+		UNREFERENCED_PARAMETER(request);
+
 		std::future<int> result;
 
 		if (stream)
@@ -637,7 +669,7 @@ namespace AlsaAudio
 
 			try
 			{
-				result = std::async(std::launch::async, [](IStream* stream, std::string device) -> int
+				result = std::async(std::launch::async, [](IStream* stream, std::string device, std::shared_ptr<PlaybackPosition> position) -> int
 					{
 						UNREFERENCED_PARAMETER(device);
 
@@ -645,7 +677,7 @@ namespace AlsaAudio
 
 						_stream.Attach(stream);
 
-						AudioPlayer player;
+						PositionAudioPlayer player(std::move(position));
 
 						if (player.Init(_stream))
 						{
@@ -654,7 +686,7 @@ namespace AlsaAudio
 							return 0;
 						}
 						return -1;
-					}, stream, device);
+					}, stream, device, std::move(position));
 			}
 			catch (...)
 			{
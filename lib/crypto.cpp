@@ -3,6 +3,8 @@
 #include "crypto.h"
 #include <vector>
 #include <stdexcept>
+#include <cstring>
+#include <cassert>
 
 #ifdef _WIN32
 
@@ -258,10 +260,16 @@ std::vector<uint8_t> Rsa::Decrypt(const std::vector<uint8_t>& input) const
     return output;
 }
 
-Aes::Aes(const std::vector<uint8_t>& key)
+Aes::Aes(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv)
 {
     m_handle = nullptr;
 
+    if (iv.size() != sizeof(m_iv))
+    {
+        throw std::runtime_error("intialization vector has wrong format");
+    }
+    memcpy(m_iv, iv.data(), sizeof(m_iv));
+
     std::vector<uint8_t> keyBlob;
     keyBlob.resize(sizeof(BCRYPT_KEY_DATA_BLOB_HEADER) + key.size());
     memset(keyBlob.data(), 0, sizeof(BCRYPT_KEY_DATA_BLOB_HEADER) + key.size());
@@ -306,16 +314,18 @@ Aes::~Aes()
     }
 }
 
-void Aes::Decrypt(const unsigned char* in, unsigned char* out, size_t size, uint8_t* iv, size_t ivLen)
+void Aes::Decrypt(const unsigned char* in, unsigned char* out, size_t size)
 {
-    const std::lock_guard<std::mutex> guard(m_mtx);
-
     std::pair<BCRYPT_ALG_HANDLE, BCRYPT_KEY_HANDLE>* ph = static_cast<std::pair<BCRYPT_ALG_HANDLE, BCRYPT_KEY_HANDLE>*>(m_handle);
 
+    // BCrypt leaves the last block of the cipher text in the vector
+    uint8_t iv[sizeof(m_iv)];
+    memcpy(iv, m_iv, sizeof(iv));
+
     ULONG r = 0;
 
     if (0 != ::BCryptDecrypt(ph->second, (PUCHAR)in, static_cast<ULONG>(size), NULL, iv,
-                static_cast<ULONG>(ivLen), out, static_cast<ULONG>(size), &r, 0))
+                static_cast<ULONG>(sizeof(iv)), out, static_cast<ULONG>(size), &r, 0))
     {
         throw std::runtime_error("failed to BCryptDecrypt");                    
     }
@@ -395,31 +405,64 @@ std::vector<uint8_t> Rsa::Decrypt(const std::vector<uint8_t>& input) const
     return output;
 }
 
-Aes::Aes(const std::vector<uint8_t>& key)
+Aes::Aes(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv)
 {
-    m_handle = malloc(sizeof(AES_KEY));
+    if (iv.size() != sizeof(m_iv))
+    {
+        throw std::runtime_error("intialization vector has wrong format");
+    }
+    memcpy(m_iv, iv.data(), sizeof(m_iv));
 
-    if (!m_handle)
+    const EVP_CIPHER* cipher = nullptr;
+
+    switch (key.size())
     {
-        throw std::bad_alloc();
+    case 16:
+        cipher = EVP_aes_128_cbc();
+        break;
+    case 24:
+        cipher = EVP_aes_192_cbc();
+        break;
+    case 32:
+        cipher = EVP_aes_256_cbc();
+        break;
+    default:
+        throw std::runtime_error("failed to create AES key");
     }
-    const int result = AES_set_decrypt_key(key.data(), key.size() * 8, static_cast<AES_KEY*>(m_handle));
+    // EVP picks the AES-NI or ARMv8 implementation, the low level AES functions never do
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
 
-    if (0 != result)
+    if (!ctx)
+    {
+        throw std::bad_alloc();
+    }
+    if (1 != EVP_DecryptInit_ex(ctx, cipher, nullptr, key.data(), m_iv)
+        || 1 != EVP_CIPHER_CTX_set_padding(ctx, 0))
     {
+        EVP_CIPHER_CTX_free(ctx);
         throw std::runtime_error("failed to create AES key");
     }
+    m_handle = ctx;
 }
 
 Aes::~Aes()
 {
-    free(m_handle);
+    EVP_CIPHER_CTX_free(static_cast<EVP_CIPHER_CTX*>(m_handle));
 }
 
-void Aes::Decrypt(const unsigned char* in, unsigned char* out, size_t size, uint8_t* iv, size_t)
+void Aes::Decrypt(const unsigned char* in, unsigned char* out, size_t size)
 {
-    const std::lock_guard<std::mutex> guard(m_mtx);
-    AES_cbc_encrypt(in, out, size, static_cast<AES_KEY*>(m_handle), iv, AES_DECRYPT);
+    assert(size % AES_BLOCK_SIZE == 0);
+
+    EVP_CIPHER_CTX* ctx = static_cast<EVP_CIPHER_CTX*>(m_handle);
+    int outLen = 0;
+
+    // setting the vector only keeps the expanded key
+    if (1 != EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, m_iv)
+        || 1 != EVP_DecryptUpdate(ctx, out, &outLen, in, static_cast<int>(size)))
+    {
+        throw std::runtime_error("failed to decrypt AES");
+    }
 }
 
 #endif
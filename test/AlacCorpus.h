@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "AlacDecoder.h"
+
+// a stored corpus of ALAC packets for the conformance test and the decoder benchmark,
+// each record is the size of the packet, the count of its frames and the FNV-1a hash
+// of the PCM it decodes to, little endian, followed by the packet
+namespace AlacCorpus
+{
+    struct Packet
+    {
+        std::vector<uint8_t>    data;
+        uint32_t                frames;
+        uint64_t                hash;
+    };
+
+    // the setup of the AirPlay stream the corpus is encoded for
+    static constexpr uint32_t MAX_FRAMES = 352;
+    static constexpr uint8_t HISTORY_MULT = 40;
+    static constexpr uint8_t INITIAL_HISTORY = 10;
+    static constexpr uint8_t K_MODIFIER = 14;
+
+    inline uint64_t Hash(const void* data, size_t size) noexcept
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<const uint8_t*>(data)[i];
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+    inline alac::alac_file* CreateDecoder()
+    {
+        alac::alac_file* decoder = alac::create_alac(16, 2);
+
+        decoder->setinfo_max_samples_per_frame = MAX_FRAMES;
+        decoder->setinfo_7a = 0;
+        decoder->setinfo_sample_size = 16;
+        decoder->setinfo_rice_historymult = HISTORY_MULT;
+        decoder->setinfo_rice_initialhistory = INITIAL_HISTORY;
+        decoder->setinfo_rice_kmodifier = K_MODIFIER;
+        decoder->setinfo_7f = 2;
+        decoder->setinfo_80 = 255;
+        decoder->setinfo_82 = 0;
+        decoder->setinfo_86 = 0;
+        decoder->setinfo_8a_rate = 44100;
+
+        alac::allocate_buffers(decoder);
+        return decoder;
+    }
+
+    inline std::vector<Packet> Read(const std::string& path)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+
+        if (!file)
+        {
+            throw std::runtime_error("failed to open " + path);
+        }
+        std::vector<Packet> packets;
+        uint8_t header[16];
+
+        while (fread(header, 1, sizeof(header), file) == sizeof(header))
+        {
+            uint32_t size = 0;
+            Packet packet;
+
+            for (int i = 3; i >= 0; --i)
+            {
+                size = (size << 8) | header[i];
+            }
+            packet.frames = 0;
+
+            for (int i = 7; i >= 4; --i)
+            {
+                packet.frames = (packet.frames << 8) | header[i];
+            }
+            packet.hash = 0;
+
+            for (int i = 15; i >= 8; --i)
+            {
+                packet.hash = (packet.hash << 8) | header[i];
+            }
+            packet.data.resize(size);
+
+            if (fread(packet.data.data(), 1, size, file) != size || packet.frames > MAX_FRAMES)
+            {
+                fclose(file);
+                throw std::runtime_error("corrupt corpus " + path);
+            }
+            packets.push_back(std::move(packet));
+        }
+        fclose(file);
+
+        return packets;
+    }
+
+    inline void Write(const std::string& path, const std::vector<Packet>& packets)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+
+        if (!file)
+        {
+            throw std::runtime_error("failed to create " + path);
+        }
+        for (const auto& packet : packets)
+        {
+            uint8_t header[16];
+            const uint32_t size = static_cast<uint32_t>(packet.data.size());
+
+            for (int i = 0; i < 4; ++i)
+            {
+                header[i] = static_cast<uint8_t>(size >> (i * 8));
+                header[4 + i] = static_cast<uint8_t>(packet.frames >> (i * 8));
+            }
+            for (int i = 0; i < 8; ++i)
+            {
+                header[8 + i] = static_cast<uint8_t>(packet.hash >> (i * 8));
+            }
+            fwrite(header, 1, sizeof(header), file);
+            fwrite(packet.data.data(), 1, size, file);
+        }
+        fclose(file);
+    }
+}
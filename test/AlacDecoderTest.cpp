@@ -0,0 +1,327 @@
+#define _USE_MATH_DEFINES
+#include <gtest/gtest.h>
+#include "AlacDecoder.h"
+#include "AlacCorpus.h"
+#include "AlacEncoder.h"
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+using namespace string_literals;
+
+static_assert(AlacCorpus::HISTORY_MULT == AlacEncoder::HISTORY_MULT
+    && AlacCorpus::INITIAL_HISTORY == AlacEncoder::INITIAL_HISTORY
+    && AlacCorpus::K_MODIFIER == AlacEncoder::K_MODIFIER, "the corpus is encoded for the decoder setup");
+
+// some tones, a bit of noise and a second voice on the right channel
+static vector<int16_t> MakeMusic(size_t frames, size_t start, double noiseLevel, mt19937& random)
+{
+    normal_distribution<double> noise(0., noiseLevel);
+    vector<int16_t> pcm(frames * 2);
+
+    for (size_t i = 0; i < frames; ++i)
+    {
+        const double t = static_cast<double>(start + i) / 44100.;
+        const double tones = 6000. * sin(2 * M_PI * 220. * t) + 3000. * sin(2 * M_PI * 330. * t) + 1500. * sin(2 * M_PI * 1760. * t);
+
+        const double left = tones + noise(random);
+        const double right = 0.8 * tones + 800. * sin(2 * M_PI * 440. * t) + noise(random);
+
+        pcm[i * 2] = static_cast<int16_t>(clamp(lround(left), -32768l, 32767l));
+        pcm[i * 2 + 1] = static_cast<int16_t>(clamp(lround(right), -32768l, 32767l));
+    }
+    return pcm;
+}
+
+TEST(AlacDecoderTest, Conformance)
+{
+    const auto packets = AlacCorpus::Read(ALAC_CORPUS);
+    ASSERT_FALSE(packets.empty());
+
+    // the same output with the scalar kernels and with the ones of this CPU
+    for (const auto* kernels : { &AlacDsp::GetScalarKernels(), &AlacDsp::GetKernels() })
+    {
+        alac::alac_file* decoder = AlacCorpus::CreateDecoder();
+        decoder->kernels = kernels;
+
+        vector<int16_t> pcm(AlacCorpus::MAX_FRAMES * 2);
+
+        for (size_t i = 0; i < packets.size(); ++i)
+        {
+            int size = 0;
+            alac::decode_frame(decoder, packets[i].data.data(), packets[i].data.size(), pcm.data(), &size);
+
+            ASSERT_EQ(packets[i].frames * 4, static_cast<uint32_t>(size)) << kernels->name << ", packet " << i;
+            EXPECT_EQ(packets[i].hash, AlacCorpus::Hash(pcm.data(), size)) << kernels->name << ", packet " << i;
+        }
+        alac::destroy_alac(decoder);
+    }
+}
+
+TEST(AlacDecoderTest, EncoderRoundTrip)
+{
+    alac::alac_file* decoder = AlacCorpus::CreateDecoder();
+    mt19937 random(20);
+
+    vector<int16_t> pcm(AlacCorpus::MAX_FRAMES * 2);
+
+    for (int order = 0; order < 32; ++order)
+    {
+        AlacEncoder::Params params;
+        params.order = order;
+
+        const auto music = MakeMusic(AlacCorpus::MAX_FRAMES, order * AlacCorpus::MAX_FRAMES, 60., random);
+        const auto packet = AlacEncoder::Encode(music, params);
+
+        int size = 0;
+        alac::decode_frame(decoder, packet.data(), packet.size(), pcm.data(), &size);
+
+        ASSERT_EQ(static_cast<int>(music.size() * 2), size);
+        ASSERT_EQ(music, pcm) << "order " << order;
+    }
+    alac::destroy_alac(decoder);
+}
+
+// the count of frames follows the 23 bits of the header in front of it
+static void SetFrameCount(vector<uint8_t>& packet, uint32_t frames)
+{
+    for (int bit = 0; bit < 32; ++bit)
+    {
+        const size_t pos = 23 + bit;
+        const uint8_t mask = static_cast<uint8_t>(0x80 >> (pos % 8));
+
+        if ((frames >> (31 - bit)) & 1)
+        {
+            packet[pos / 8] |= mask;
+        }
+        else
+        {
+            packet[pos / 8] &= ~mask;
+        }
+    }
+}
+
+TEST(AlacDecoderTest, CorruptFrameCount)
+{
+    alac::alac_file* decoder = AlacCorpus::CreateDecoder();
+    mt19937 random(18);
+
+    // the output the decoder has been set up for and a guard behind it
+    const size_t guard = 1024;
+    vector<int16_t> pcm(AlacCorpus::MAX_FRAMES * 2 + guard, 0x5a5a);
+
+    AlacEncoder::Params params;
+    params.hasSize = true;
+
+    vector<vector<uint8_t>> packets;
+
+    // more frames than the setup takes, compressed and uncompressed
+    packets.push_back(AlacEncoder::Encode(MakeMusic(1000, 0, 60., random), params));
+    params.uncompressed = true;
+    packets.push_back(AlacEncoder::Encode(MakeMusic(1000, 0, 60., random), params));
+
+    // counts which don't fit the packet's frames
+    for (const uint32_t frames : { 0u, AlacCorpus::MAX_FRAMES + 1, 0x80000000u, 0xffffffffu })
+    {
+        auto packet = AlacEncoder::Encode(MakeMusic(100, 0, 60., random), params);
+        SetFrameCount(packet, frames);
+        packets.push_back(move(packet));
+    }
+    for (size_t i = 0; i < packets.size(); ++i)
+    {
+        int size = -1;
+        alac::decode_frame(decoder, packets[i].data(), packets[i].size(), pcm.data(), &size);
+
+        EXPECT_EQ(0, size) << "packet " << i;
+        EXPECT_TRUE(all_of(pcm.end() - guard, pcm.end(), [](int16_t sample) { return sample == 0x5a5a; })) << "packet " << i;
+    }
+    alac::destroy_alac(decoder);
+}
+
+// packets which don't decode: more frames than the setup, cut short, or garbage,
+// none of them may give output or write behind the frames the setup takes
+TEST(AlacDecoderTest, MalformedPackets)
+{
+    const auto corpus = AlacCorpus::Read(ALAC_CORPUS);
+    ASSERT_FALSE(corpus.empty());
+
+    mt19937 random(20);
+    vector<vector<uint8_t>> packets;
+
+    for (const auto& packet : corpus)
+    {
+        // the short packets carry their count of frames
+        if (packet.frames < AlacCorpus::MAX_FRAMES)
+        {
+            for (const uint32_t frames : { AlacCorpus::MAX_FRAMES + 1, 4096u, 0x7fffffffu })
+            {
+                auto oversize = packet.data;
+                SetFrameCount(oversize, frames);
+                packets.push_back(move(oversize));
+            }
+        }
+        // the last byte may hold no more than the end tag and the padding, which aren't read
+        for (const size_t size : { size_t{ 0 }, size_t{ 1 }, size_t{ 3 }, packet.data.size() / 2, packet.data.size() - 2 })
+        {
+            packets.emplace_back(packet.data.begin(), packet.data.begin() + min(size, packet.data.size() - 2));
+        }
+    }
+    // headers of more channels, an unknown prediction type and more uncompressed bytes than the sample has
+    auto packet = corpus.front().data;
+
+    for (uint8_t channels = 2; channels < 8; ++channels)
+    {
+        packet[0] = static_cast<uint8_t>((packet[0] & 0x1f) | (channels << 5));
+        packets.push_back(packet);
+    }
+    packet = corpus.front().data;
+    packet[4] |= 0x01;  // the prediction type of the first channel starts with bit 39
+    packets.push_back(packet);
+
+    packet = corpus.front().data;
+    packet[2] |= 0x0c;  // the uncompressed bytes are bits 20 and 21
+    packets.push_back(packet);
+
+    // random bytes, which are cut short almost always
+    uniform_int_distribution<int> byte(0, 255);
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        vector<uint8_t> garbage(uniform_int_distribution<size_t>(1, 64)(random));
+
+        for (auto& b : garbage)
+        {
+            b = static_cast<uint8_t>(byte(random));
+        }
+        // a frame of two channels, compressed and without a count of its own
+        garbage[0] = static_cast<uint8_t>((garbage[0] & 0x1f) | 0x20);
+
+        if (garbage.size() > 2)
+        {
+            garbage[2] &= ~0x12;
+        }
+        packets.push_back(move(garbage));
+    }
+
+    for (const auto* kernels : { &AlacDsp::GetScalarKernels(), &AlacDsp::GetKernels() })
+    {
+        alac::alac_file* decoder = AlacCorpus::CreateDecoder();
+        decoder->kernels = kernels;
+
+        const size_t guard = 1024;
+        vector<int16_t> pcm(AlacCorpus::MAX_FRAMES * 2 + guard, 0x5a5a);
+
+        for (size_t i = 0; i < packets.size(); ++i)
+        {
+            int size = -1;
+            alac::decode_frame(decoder, packets[i].data(), packets[i].size(), pcm.data(), &size);
+
+            ASSERT_EQ(0, size) << kernels->name << ", packet " << i;
+            ASSERT_TRUE(all_of(pcm.end() - guard, pcm.end(), [](int16_t sample) { return sample == 0x5a5a; }))
+                << kernels->name << ", packet " << i;
+        }
+
+        // the decoder goes on with the stream as before
+        for (const auto& packet : corpus)
+        {
+            int size = 0;
+            alac::decode_frame(decoder, packet.data.data(), packet.data.size(), pcm.data(), &size);
+
+            ASSERT_EQ(packet.frames * 4, static_cast<uint32_t>(size)) << kernels->name;
+            EXPECT_EQ(packet.hash, AlacCorpus::Hash(pcm.data(), size)) << kernels->name;
+        }
+        alac::destroy_alac(decoder);
+    }
+}
+
+// writes the corpus anew, run with --gtest_also_run_disabled_tests --gtest_filter=*WriteCorpus,
+// the hashes are taken from the PCM before encoding, so the decoder has to give it back unchanged
+TEST(AlacDecoderTest, DISABLED_WriteCorpus)
+{
+    mt19937 random(352);
+    size_t start = 0;
+
+    vector<AlacCorpus::Packet> packets;
+
+    const auto add = [&](const vector<int16_t>& pcm, const AlacEncoder::Params& params)
+    {
+        AlacCorpus::Packet packet;
+        packet.data = AlacEncoder::Encode(pcm, params);
+        packet.frames = static_cast<uint32_t>(pcm.size() / 2);
+        packet.hash = AlacCorpus::Hash(pcm.data(), pcm.size() * sizeof(int16_t));
+        packets.push_back(move(packet));
+
+        start += pcm.size() / 2;
+    };
+    const auto music = [&](size_t frames, double noiseLevel = 30.)
+    {
+        return MakeMusic(frames, start, noiseLevel, random);
+    };
+    AlacEncoder::Params params;
+
+    // the usual stream: order 8, mid/side, then the other orders, the vector ones and some scalar ones
+    for (int i = 0; i < 24; ++i)
+    {
+        add(music(AlacCorpus::MAX_FRAMES), params);
+    }
+    for (const int order : { 4, 16, 12, 28, 0, 31, 5, 30 })
+    {
+        params.order = order;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            add(music(AlacCorpus::MAX_FRAMES), params);
+        }
+    }
+    params = {};
+
+    // left and right, other weights, coarse quantization and a higher rice modifier
+    for (const auto& [shift, weight] : { make_pair(0, 0), make_pair(2, 3), make_pair(0, 1) })
+    {
+        params.shift = shift;
+        params.leftWeight = weight;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            add(music(AlacCorpus::MAX_FRAMES), params);
+        }
+    }
+    params = {};
+    params.quantization = 15;
+    add(music(AlacCorpus::MAX_FRAMES), params);
+    params.quantization = 1;
+    add(music(AlacCorpus::MAX_FRAMES), params);
+    params = {};
+    params.riceModifier = 2;
+    add(music(AlacCorpus::MAX_FRAMES), params);
+    params = {};
+
+    // silence takes the blocks of zeros, loud noise the escapes, and an uncompressed packet
+    add(vector<int16_t>(AlacCorpus::MAX_FRAMES * 2, 0), params);
+    add(music(AlacCorpus::MAX_FRAMES, 1.), params);
+    add(music(AlacCorpus::MAX_FRAMES, 12000.), params);
+
+    params.uncompressed = true;
+    add(music(AlacCorpus::MAX_FRAMES, 12000.), params);
+    params = {};
+
+    // short packets with the count of frames in the header
+    params.hasSize = true;
+
+    for (const size_t frames : { 1, 7, 100, 351 })
+    {
+        add(music(frames), params);
+    }
+    AlacCorpus::Write(ALAC_CORPUS, packets);
+
+    // the corpus has to be read back as it was written
+    const auto stored = AlacCorpus::Read(ALAC_CORPUS);
+    ASSERT_EQ(packets.size(), stored.size());
+
+    for (size_t i = 0; i < packets.size(); ++i)
+    {
+        ASSERT_EQ(packets[i].data, stored[i].data);
+        ASSERT_EQ(packets[i].hash, stored[i].hash);
+    }
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "AlacDsp.h"
+#include <random>
+
+using namespace std;
+using namespace string_literals;
+
+// the kernels chosen for this CPU against the scalar reference, the output and the adapted coefficients
+static void ExpectSamePrediction(const vector<int32_t>& error, const vector<int16_t>& coefs,
+    int sampleSize, int order, int quantization)
+{
+    const auto& scalar = AlacDsp::GetScalarKernels();
+    const auto& current = AlacDsp::GetKernels();
+
+    const int size = static_cast<int>(error.size());
+
+    // the warm-up writes order + 1 samples at least
+    vector<int32_t> expected(max(size, 32) + 1, 0x55555555);
+    vector<int32_t> actual(expected);
+    vector<int16_t> expectedCoefs(coefs);
+    vector<int16_t> actualCoefs(coefs);
+
+    scalar.predict(error.data(), expected.data(), size, sampleSize, expectedCoefs.data(), order, quantization);
+    current.predict(error.data(), actual.data(), size, sampleSize, actualCoefs.data(), order, quantization);
+
+    ASSERT_EQ(expected, actual) << current.name << ", order " << order << ", quantization " << quantization << ", size " << size;
+    ASSERT_EQ(expectedCoefs, actualCoefs) << current.name << ", order " << order << ", quantization " << quantization;
+}
+
+TEST(AlacDspTest, PredictorMatchesScalar)
+{
+    mt19937 random(19);
+
+    for (int order = 0; order < 32; ++order)
+    {
+        for (const int quantization : { 1, 9, 15 })
+        {
+            for (const int bits : { 3, 12 })
+            {
+                // small residuals like a predicted signal has and coefficients the adaption moves around
+                uniform_int_distribution<int32_t> residual(-(1 << bits), 1 << bits);
+                uniform_int_distribution<int32_t> coef(-400, 400);
+
+                vector<int32_t> error(352);
+                vector<int16_t> coefs(32);
+
+                for (auto& e : error)
+                {
+                    e = residual(random);
+                }
+                for (auto& c : coefs)
+                {
+                    c = static_cast<int16_t>(coef(random));
+                }
+                ExpectSamePrediction(error, coefs, 17, order, quantization);
+                ExpectSamePrediction(error, coefs, 16, order, quantization);
+            }
+        }
+    }
+}
+
+TEST(AlacDspTest, PredictorShortFrames)
+{
+    mt19937 random(4);
+    uniform_int_distribution<int32_t> residual(-1000, 1000);
+
+    for (const int order : { 4, 8, 16 })
+    {
+        for (int size = order + 1; size < order + 10; ++size)
+        {
+            vector<int32_t> error(size);
+
+            for (auto& e : error)
+            {
+                e = residual(random);
+            }
+            ExpectSamePrediction(error, vector<int16_t>(32, 100), 17, order, 9);
+        }
+    }
+}
+
+TEST(AlacDspTest, PredictorWrapsAround)
+{
+    // values no encoder writes: the sums overflow and the coefficients run out of 16 bits
+    mt19937 random(28);
+    uniform_int_distribution<int32_t> any(INT32_MIN, INT32_MAX);
+
+    for (const int order : { 4, 8, 12, 16, 20, 24, 28 })
+    {
+        for (const int quantization : { 1, 4, 15 })
+        {
+            vector<int32_t> error(352);
+            vector<int16_t> coefs(32);
+
+            for (auto& e : error)
+            {
+                e = any(random);
+            }
+            for (auto& c : coefs)
+            {
+                c = static_cast<int16_t>(any(random));
+            }
+            ExpectSamePrediction(error, coefs, 32, order, quantization);
+            ExpectSamePrediction(error, coefs, 24, order, quantization);
+        }
+    }
+}
+
+TEST(AlacDspTest, DeinterlaceMatchesScalar)
+{
+    const auto& scalar = AlacDsp::GetScalarKernels();
+    const auto& current = AlacDsp::GetKernels();
+
+    mt19937 random(16);
+
+    for (const int range : { 1 << 16, INT32_MAX })
+    {
+        uniform_int_distribution<int32_t> sample(-range, range);
+
+        for (const int frames : { 0, 1, 3, 4, 5, 9, 352 })
+        {
+            vector<int32_t> a(frames);
+            vector<int32_t> b(frames);
+
+            for (int i = 0; i < frames; ++i)
+            {
+                a[i] = sample(random);
+                b[i] = sample(random);
+            }
+            for (const uint8_t leftWeight : { 0, 1, 2, 77, 255 })
+            {
+                for (const uint8_t shift : { 0, 1, 2, 5, 31 })
+                {
+                    vector<int16_t> expected(frames * 2 + 1, 0x5555);
+                    vector<int16_t> actual(expected);
+
+                    scalar.deinterlace16(a.data(), b.data(), expected.data(), 2, frames, shift, leftWeight);
+                    current.deinterlace16(a.data(), b.data(), actual.data(), 2, frames, shift, leftWeight);
+
+                    ASSERT_EQ(expected, actual) << current.name << ", " << frames << " frames, shift " << int{ shift } << ", weight " << int{ leftWeight };
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include "BitReader.h"
+
+// a minimal ALAC encoder for 16-bit stereo, for tests and benchmarks only: it writes
+// compressed frames the way the decoder reads them, with mid/side stereo, the adaptive
+// FIR predictor and the adaptive Rice coder including escapes and blocks of zeros,
+// or uncompressed frames, the decoder has to be set up with the values below
+class AlacEncoder
+{
+public:
+    struct Params
+    {
+        int     order = 8;          // 0 to 30, 31 is the first order difference
+        int     quantization = 9;
+        int     riceModifier = 4;
+        int     shift = 1;          // interlacing shift, 0 for left and right
+        int     leftWeight = 1;
+        bool    hasSize = false;    // the count of frames in the header
+        bool    uncompressed = false;
+    };
+
+    // the values the decoder is set up with
+    static constexpr int HISTORY_MULT = 40;
+    static constexpr int INITIAL_HISTORY = 10;
+    static constexpr int K_MODIFIER = 14;
+
+    static std::vector<uint8_t> Encode(const std::vector<int16_t>& interleaved, const Params& params)
+    {
+        const int frames = static_cast<int>(interleaved.size() / 2);
+
+        BitWriter out;
+        out.Write(1, 3);    // 2 channels
+        out.Write(0, 4);
+        out.Write(0, 12);
+        out.Write(params.hasSize ? 1 : 0, 1);
+        out.Write(0, 2);    // uncompressed bytes
+        out.Write(params.uncompressed ? 1 : 0, 1);
+
+        if (params.hasSize)
+        {
+            out.Write(static_cast<uint32_t>(frames), 32);
+        }
+        if (params.uncompressed)
+        {
+            for (const auto sample : interleaved)
+            {
+                out.Write(static_cast<uint16_t>(sample), 16);
+            }
+            return out.Finish();
+        }
+        std::vector<int32_t> a(frames);
+        std::vector<int32_t> b(frames);
+
+        for (int i = 0; i < frames; ++i)
+        {
+            const int32_t left = interleaved[i * 2];
+            const int32_t right = interleaved[i * 2 + 1];
+
+            if (params.leftWeight)
+            {
+                b[i] = left - right;
+                a[i] = right + ((b[i] * params.leftWeight) >> params.shift);
+            }
+            else
+            {
+                a[i] = left;
+                b[i] = right;
+            }
+        }
+        const int sampleSize = 17;
+
+        std::vector<int16_t> coefs = InitialCoefs(params.order);
+
+        out.Write(static_cast<uint32_t>(params.shift), 8);
+        out.Write(static_cast<uint32_t>(params.leftWeight), 8);
+
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            out.Write(0, 4);    // adaptive FIR
+            out.Write(static_cast<uint32_t>(params.quantization), 4);
+            out.Write(static_cast<uint32_t>(params.riceModifier), 3);
+            out.Write(static_cast<uint32_t>(params.order), 5);
+
+            for (int i = 0; i < params.order; ++i)
+            {
+                out.Write(static_cast<uint16_t>(coefs[i]), 16);
+            }
+        }
+        for (const auto* channel : { &a, &b })
+        {
+            const auto residuals = Predict(*channel, sampleSize, coefs, params.order, params.quantization);
+            EncodeRice(out, residuals, sampleSize, params.riceModifier * HISTORY_MULT / 4);
+        }
+        return out.Finish();
+    }
+
+private:
+    class BitWriter
+    {
+    public:
+        void Write(uint32_t value, int bits)
+        {
+            for (int i = bits - 1; i >= 0; --i)
+            {
+                if (m_bit == 0)
+                {
+                    m_bytes.push_back(0);
+                }
+                m_bytes.back() |= static_cast<uint8_t>(((value >> i) & 1) << (7 - m_bit));
+                m_bit = (m_bit + 1) & 7;
+            }
+        }
+
+        std::vector<uint8_t> Finish()
+        {
+            // the end tag of the frame
+            Write(7, 3);
+            return m_bytes;
+        }
+
+    private:
+        std::vector<uint8_t> m_bytes;
+        int m_bit = 0;
+    };
+
+    static std::vector<int16_t> InitialCoefs(int order)
+    {
+        std::vector<int16_t> coefs(32, 0);
+
+        // the decoder adapts them anyway
+        static const int16_t FIRST[] = { 160, -190, 170, -130, 80, -30 };
+
+        for (int i = 0; i < order && i < 32; ++i)
+        {
+            coefs[i] = i < 6 ? FIRST[i] : static_cast<int16_t>(10 - i);
+        }
+        return coefs;
+    }
+
+    static int32_t SignExtend(int32_t value, int bits)
+    {
+        return static_cast<int32_t>(static_cast<uint32_t>(value) << (32 - bits)) >> (32 - bits);
+    }
+
+    static int Sign(int32_t v)
+    {
+        return v < 0 ? -1 : (v > 0 ? 1 : 0);
+    }
+
+    // the residuals which make the predictor of the decoder reproduce the samples
+    static std::vector<int32_t> Predict(const std::vector<int32_t>& samples, int sampleSize,
+        std::vector<int16_t> coefs, int order, int quantization)
+    {
+        const int n = static_cast<int>(samples.size());
+        std::vector<int32_t> errors(n);
+
+        if (n == 0)
+        {
+            return errors;
+        }
+        errors[0] = samples[0];
+
+        if (order == 0 || order == 31)
+        {
+            for (int i = 1; i < n; ++i)
+            {
+                errors[i] = order ? SignExtend(samples[i] - samples[i - 1], sampleSize) : samples[i];
+            }
+            return errors;
+        }
+        for (int i = 1; i <= order && i < n; ++i)
+        {
+            errors[i] = SignExtend(samples[i] - samples[i - 1], sampleSize);
+        }
+        for (int i = order + 1; i < n; ++i)
+        {
+            const int32_t* out = samples.data() + i - order - 1;
+            int32_t sum = 0;
+
+            for (int j = 0; j < order; ++j)
+            {
+                sum += (out[order - j] - out[0]) * coefs[j];
+            }
+            const int32_t prediction = ((1 << (quantization - 1)) + sum) >> quantization;
+            int32_t error = SignExtend(samples[i] - prediction - out[0], sampleSize);
+            errors[i] = error;
+
+            // the same adaption as the decoder
+            for (int p = order - 1; p >= 0 && error != 0 && Sign(error) == Sign(errors[i]); --p)
+            {
+                int32_t val = out[0] - out[order - p];
+                const int sign = Sign(val) * Sign(errors[i]);
+
+                coefs[p] -= sign;
+                val *= sign;
+                error -= (val >> quantization) * (order - p);
+            }
+        }
+        return errors;
+    }
+
+    static void EncodeValue(BitWriter& out, uint32_t value, int k, int sampleSize, uint32_t mask)
+    {
+        const uint32_t m = ((1u << k) - 1) & mask;
+        const uint32_t q = k == 1 ? value : value / m;
+
+        if (q > 8)
+        {
+            // escape with the raw value
+            out.Write(0x1ff, 9);
+            out.Write(value, sampleSize);
+            return;
+        }
+        out.Write((1u << q) - 1, static_cast<int>(q));
+        out.Write(0, 1);
+
+        if (k != 1)
+        {
+            const uint32_t r = value % m;
+
+            if (r == 0)
+            {
+                out.Write(0, k - 1);
+            }
+            else
+            {
+                out.Write(r + 1, k);
+            }
+        }
+    }
+
+    static int Clz(uint32_t v)
+    {
+        return v ? BitReader::CountLeadingZeros(v) - 32 : 32;
+    }
+
+    static void EncodeRice(BitWriter& out, const std::vector<int32_t>& errors, int sampleSize, int historyMult)
+    {
+        const int n = static_cast<int>(errors.size());
+        int history = INITIAL_HISTORY;
+        int signModifier = 0;
+
+        for (int i = 0; i < n; ++i)
+        {
+            int k = 31 - K_MODIFIER - Clz((history >> 9) + 3);
+            k = k < 0 ? k + K_MODIFIER : K_MODIFIER;
+
+            const int32_t e = errors[i];
+            const uint32_t decoded = e >= 0 ? 2u * e : 2u * -e - 1;
+
+            EncodeValue(out, decoded - signModifier, k, sampleSize, 0xffffffff);
+            signModifier = 0;
+
+            history += (decoded * historyMult) - ((history * historyMult) >> 9);
+
+            if (decoded > 0xffff)
+            {
+                history = 0xffff;
+            }
+            if (history < 128 && i + 1 < n)
+            {
+                int zeros = 0;
+
+                while (i + 1 + zeros < n && errors[i + 1 + zeros] == 0 && zeros < 0xffff)
+                {
+                    ++zeros;
+                }
+                k = Clz(history) + ((history + 16) / 64) - 24;
+                EncodeValue(out, static_cast<uint32_t>(zeros), k, 16, (1u << K_MODIFIER) - 1);
+
+                i += zeros;
+                signModifier = 1;
+                history = 0;
+            }
+        }
+    }
+};
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "BitReader.h"
+#include <random>
+
+using namespace std;
+using namespace string_literals;
+
+// a bit at a time, zeros past the end
+static uint32_t ReadReference(const vector<uint8_t>& data, size_t& position, int bits)
+{
+    uint32_t result = 0;
+
+    for (int i = 0; i < bits; ++i, ++position)
+    {
+        const size_t byte = position / 8;
+        const uint32_t bit = byte < data.size() ? (data[byte] >> (7 - position % 8)) & 1 : 0;
+
+        result = (result << 1) | bit;
+    }
+    return result;
+}
+
+TEST(BitReaderTest, ReadsLikeBitByBit)
+{
+    mt19937 random(7);
+
+    for (const size_t size : { size_t{ 0 }, size_t{ 1 }, size_t{ 7 }, size_t{ 8 }, size_t{ 9 }, size_t{ 1000 } })
+    {
+        vector<uint8_t> data(size);
+
+        for (auto& b : data)
+        {
+            b = static_cast<uint8_t>(random());
+        }
+        BitReader reader(data.data(), data.size());
+        size_t position = 0;
+
+        // on past the end, where zeros are read
+        while (position < size * 8 + 100)
+        {
+            const int bits = 1 + random() % 32;
+
+            ASSERT_EQ(ReadReference(data, position, bits), reader.Read(bits)) << size << ", " << position;
+
+            ASSERT_EQ(position, reader.GetPosition());
+        }
+    }
+}
+
+TEST(BitReaderTest, PeekAndSkip)
+{
+    const uint8_t data[] = { 0xa5, 0x0f, 0xff, 0x00, 0x12, 0x34, 0x56, 0x78, 0x9a };
+    BitReader reader(data, sizeof(data));
+
+    EXPECT_EQ(0xa5u, reader.Peek(8));
+    EXPECT_EQ(0x50fu, reader.Peek(4, 12));
+    EXPECT_EQ(0u, reader.GetPosition());
+
+    reader.Skip(12);
+    EXPECT_EQ(12u, reader.GetPosition());
+    EXPECT_EQ(0xff0u, reader.Peek(4, 12));
+
+    // a bulk read across the refill
+    reader.Skip(4);
+    reader.Refill();
+    EXPECT_EQ(0xff001234u, reader.Read(32));
+    EXPECT_EQ(0x56789au, reader.Read(24));
+    EXPECT_EQ(0u, reader.Read(32));
+}
+
+TEST(BitReaderTest, PeekOnes)
+{
+    const uint8_t data[] = { 0xf0, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f };
+    BitReader reader(data, sizeof(data));
+
+    EXPECT_EQ(4, reader.PeekOnes(9));
+    EXPECT_EQ(2, reader.PeekOnes(2));
+
+    // none before a zero
+    reader.Skip(4);
+    EXPECT_EQ(0, reader.PeekOnes(9));
+
+    // the ones are counted up to the limit
+    reader.Skip(12);
+    reader.Refill();
+    EXPECT_EQ(9, reader.PeekOnes(9));
+    EXPECT_EQ(40, reader.PeekOnes(40));
+
+    reader.Skip(40);
+    reader.Refill();
+    EXPECT_EQ(16, reader.PeekOnes(30));
+}
+
+TEST(BitReaderTest, CountLeadingZeros)
+{
+    EXPECT_EQ(63, BitReader::CountLeadingZeros(1));
+    EXPECT_EQ(0, BitReader::CountLeadingZeros(~uint64_t{ 0 }));
+    EXPECT_EQ(32, BitReader::CountLeadingZeros(0x80000000u));
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include "DriftEstimator.h"
+#include <random>
+
+using namespace std;
+using namespace string_literals;
+
+// plays a stream offline: the sender and the device run at their own rates
+// relative to the local clock, the output is resampled by the estimated ratio
+class DriftSimulation
+{
+public:
+    struct Result
+    {
+        double  drift;          // final estimate [ppm]
+        int64_t minBuffered;    // after the start of the device
+        int64_t maxError;       // buffered frames off the start fill after the first estimate
+    };
+
+    DriftSimulation(double senderPpm, double devicePpm)
+        : m_senderRate{ 44100. * (1. + senderPpm / 1e6) }
+        , m_deviceRate{ 44100. * (1. + devicePpm / 1e6) }
+    {
+    }
+
+    Result Run(DriftEstimator& estimator, chrono::seconds duration)
+    {
+        const auto start = DriftEstimator::clock::now();
+
+        const double framesPerPacket = 352.;
+        const double startFill = 22050.;
+        const double period = 1024.;
+
+        mt19937 random(7);
+        uniform_real_distribution<double> jitter(0., 0.002);
+
+        double nextPacket = 0.;     // sender time in [s]
+        double nextPeriod = 0.;     // device time in [s]
+        double written = 0.;        // resampled frames
+        uint32_t rtp = 12345;
+        double deviceStart = -1.;
+
+        Result result{ 0., INT64_MAX, 0 };
+
+        for (double t = 0.; t < duration.count(); t = min(nextPacket, nextPeriod))
+        {
+            const auto now = start + chrono::duration_cast<DriftEstimator::clock::duration>(chrono::duration<double>(t));
+
+            if (nextPacket <= t)
+            {
+                // the packet is released a little late
+                estimator.OnSource(now + chrono::microseconds(static_cast<int64_t>(jitter(random) * 1e6)), rtp);
+                rtp += static_cast<uint32_t>(framesPerPacket);
+                written += framesPerPacket * estimator.GetRatio();
+                nextPacket += framesPerPacket / m_senderRate;
+
+                if (deviceStart < 0. && written >= startFill)
+                {
+                    deviceStart = t;
+                    nextPeriod = t;
+                }
+            }
+            if (deviceStart >= 0. && nextPeriod <= t)
+            {
+                const double consumed = (t - deviceStart) * m_deviceRate;
+                const int64_t buffered = static_cast<int64_t>(written - consumed);
+
+                estimator.OnDevice(now, static_cast<uint64_t>(consumed), buffered);
+                nextPeriod += period / m_deviceRate;
+
+                result.minBuffered = min(result.minBuffered, buffered);
+
+                if (estimator.GetDrift())
+                {
+                    result.maxError = max(result.maxError, abs(buffered - static_cast<int64_t>(startFill)));
+                }
+            }
+            else if (deviceStart < 0.)
+            {
+                nextPeriod = nextPacket;
+            }
+        }
+        result.drift = estimator.GetDrift().value_or(0.);
+        return result;
+    }
+
+private:
+    const double m_senderRate;
+    const double m_deviceRate;
+};
+
+TEST(DriftEstimatorTest, NoEstimateAtStart)
+{
+    DriftEstimator estimator(44100);
+
+    EXPECT_EQ(1., estimator.GetRatio());
+    EXPECT_FALSE(estimator.GetDrift());
+
+    DriftSimulation simulation(0., 0.);
+    simulation.Run(estimator, chrono::seconds(DRIFT_MIN_WINDOW_MS / 2000));
+
+    EXPECT_FALSE(estimator.GetDrift());
+    EXPECT_EQ(1., estimator.GetRatio());
+}
+
+TEST(DriftEstimatorTest, FastDevice)
+{
+    DriftEstimator estimator(44100);
+    DriftSimulation simulation(0., 200.);
+
+    const auto result = simulation.Run(estimator, 1h);
+
+    EXPECT_NEAR(200., result.drift, 5.);
+    EXPECT_NEAR(1.0002, estimator.GetRatio(), 10e-6);
+
+    // uncompensated the device would have played 31752 frames more than received
+    EXPECT_GT(result.minBuffered, 22050 - 441);
+    EXPECT_LT(result.maxError, 441);
+    EXPECT_EQ(0u, estimator.GetStats().restarts);
+}
+
+TEST(DriftEstimatorTest, SlowDevice)
+{
+    DriftEstimator estimator(44100);
+    DriftSimulation simulation(100., -100.);
+
+    const auto result = simulation.Run(estimator, 1h);
+
+    EXPECT_NEAR(-200., result.drift, 5.);
+    EXPECT_LT(result.maxError, 441);
+    EXPECT_LT(abs(estimator.GetStats().latencyError), 441);
+}
+
+TEST(DriftEstimatorTest, RestartKeepsEstimate)
+{
+    DriftEstimator estimator(44100);
+    DriftSimulation simulation(0., -200.);
+
+    simulation.Run(estimator, 2min);
+    ASSERT_TRUE(estimator.GetDrift());
+    const double ratio = estimator.GetRatio();
+
+    // a pause of the stream
+    const auto later = DriftEstimator::clock::now() + 10min;
+    estimator.OnSource(later, 0);
+
+    EXPECT_EQ(1u, estimator.GetStats().restarts);
+    EXPECT_NEAR(-200., *estimator.GetDrift(), 5.);
+    EXPECT_NEAR(ratio, estimator.GetRatio(), 50e-6);
+}
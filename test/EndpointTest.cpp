@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "RaopEndpoint.h"
+#include "sockpp/udp_socket.h"
 #include <list>
 
 using namespace std;
@@ -58,4 +59,324 @@ TEST(EndpointTest, Sendv6Udp)
     ASSERT_EQ(static_cast<size_t>(1), handler.packetList.size());
     EXPECT_EQ(static_cast<size_t>(5), (*handler.packetList.begin())->size());
     EXPECT_EQ(0, memcmp("hello", (*handler.packetList.begin())->data(), 5));
-}
\ No newline at end of file
+}
+
+class RtpBatchHandler
+    : public IRtpRequestHandler
+{
+public:
+	void OnRequest(RtpEndpoint*, std::unique_ptr<RtpPacket>&& packet) override
+    {
+        packetList.emplace_back(move(packet));
+    }
+
+	void OnBatchRequest(RtpEndpoint* endpoint, RtpPacketBatch& packets) override
+    {
+        // hold the receiving thread until the whole burst is in the socket buffer
+        while (!release)
+        {
+            this_thread::sleep_for(1ms);
+        }
+        batchSizes.push_back(packets.size());
+        IRtpRequestHandler::OnBatchRequest(endpoint, packets);
+    }
+
+public:
+    atomic_bool                         release{ false };
+    vector<size_t>                      batchSizes;
+    list<std::unique_ptr<RtpPacket>>    packetList;
+};
+
+TEST(EndpointTest, BurstReceivev4Udp)
+{
+    RtpBatchHandler batchHandler;
+    RtpEndpoint endpoint(&batchHandler, "127.0.0.1"s);
+
+    const uint16_t count = 64;
+
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        EXPECT_TRUE(endpoint.SendTo(&i, sizeof(i), endpoint.GetPort()));
+    }
+    batchHandler.release = true;
+    this_thread::sleep_for(500ms);
+
+    ASSERT_EQ(static_cast<size_t>(count), batchHandler.packetList.size());
+    EXPECT_EQ(static_cast<uint64_t>(count), endpoint.GetReceivedPackets());
+
+    uint16_t expected = 0;
+
+    for (const auto& packet : batchHandler.packetList)
+    {
+        ASSERT_EQ(sizeof(expected), packet->size());
+        EXPECT_EQ(0, memcmp(&expected, packet->data(), sizeof(expected)));
+        ++expected;
+    }
+#ifdef __linux__
+    EXPECT_EQ(static_cast<size_t>(RTP_RECV_BATCH_SIZE), *max_element(batchHandler.batchSizes.begin(), batchHandler.batchSizes.end()));
+    EXPECT_GT(endpoint.GetAverageBatchSize(), 1.);
+#endif
+}
+
+class RtpCountingHandler
+    : public IRtpRequestHandler
+{
+public:
+	void OnRequest(RtpEndpoint*, std::unique_ptr<RtpPacket>&& packet) override
+    {
+        ++count;
+        PutPacketToPool(move(packet));
+    }
+
+public:
+    atomic_int  count{ 0 };
+};
+
+TEST(EndpointTest, NoDispatchAfterDestruction)
+{
+    RtpCountingHandler countingHandler;
+    RtpEndpoint sender(&countingHandler, "127.0.0.1"s);
+
+    auto receiver = make_unique<RtpEndpoint>(&countingHandler, "127.0.0.1"s);
+    const auto port = receiver->GetPort();
+
+    for (int i = 0; i < 32; ++i)
+    {
+        EXPECT_TRUE(sender.SendTo("hello", 5, port));
+    }
+    receiver.reset();
+
+    const int countAfterDestruction = countingHandler.count;
+    EXPECT_LE(countAfterDestruction, 32);
+
+    for (int i = 0; i < 32; ++i)
+    {
+        sender.SendTo("hello", 5, port);
+    }
+    this_thread::sleep_for(200ms);
+
+    EXPECT_EQ(countAfterDestruction, countingHandler.count.load());
+}
+
+// a handler which takes its time holds up neither the endpoints of other sessions
+// nor their creation and destruction
+TEST(EndpointTest, SlowHandlerBlocksNoOtherEndpoint)
+{
+    atomic_bool release{ false };
+    atomic_int calls{ 0 };
+
+    class SlowHandler
+        : public IRtpRequestHandler
+    {
+    public:
+        SlowHandler(atomic_bool& release, atomic_int& calls)
+            : m_release{ release }
+            , m_calls{ calls }
+        {
+        }
+
+        void OnRequest(RtpEndpoint*, std::unique_ptr<RtpPacket>&& packet) override
+        {
+            ++m_calls;
+
+            for (int i = 0; i < 2000 && !m_release; ++i)
+            {
+                this_thread::sleep_for(1ms);
+            }
+            PutPacketToPool(move(packet));
+        }
+
+    private:
+        atomic_bool&    m_release;
+        atomic_int&     m_calls;
+    } slowHandler(release, calls);
+
+    RtpEndpoint slow(&slowHandler, "127.0.0.1"s);
+    ASSERT_TRUE(slow.SendTo("hello", 5, slow.GetPort()));
+
+    for (int i = 0; i < 100 && calls == 0; ++i)
+    {
+        this_thread::sleep_for(5ms);
+    }
+    ASSERT_EQ(1, calls.load());
+
+    const auto start = chrono::steady_clock::now();
+    {
+        RtpCountingHandler countingHandler;
+        auto other = make_unique<RtpEndpoint>(&countingHandler, "127.0.0.1"s);
+        other.reset();
+    }
+    EXPECT_LT(chrono::steady_clock::now() - start, 500ms);
+
+    release = true;
+}
+
+TEST(EndpointTest, ManyEndpointsv4Udp)
+{
+    RtpCountingHandler countingHandler;
+    list<RtpEndpoint> endpoints;
+
+    for (int i = 0; i < 24; ++i)
+    {
+        endpoints.emplace_back(&countingHandler, "127.0.0.1"s);
+    }
+    for (auto& endpoint : endpoints)
+    {
+        EXPECT_TRUE(endpoint.SendTo("hello", 5, endpoint.GetPort()));
+    }
+    this_thread::sleep_for(500ms);
+
+    EXPECT_EQ(24, countingHandler.count.load());
+}
+
+TEST(EndpointTest, SendFromBoundPort)
+{
+    RtpCountingHandler countingHandler;
+    RtpEndpoint endpoint(&countingHandler, "127.0.0.1"s);
+
+    sockpp::udp_socket peer;
+    ASSERT_TRUE(peer.bind(sockpp::inet_address("127.0.0.1"s, 0)));
+    peer.read_timeout(1s);
+
+    const auto peerPort = sockpp::inet_address(peer.address()).port();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        EXPECT_TRUE(endpoint.SendTo("hello", 5, peerPort));
+
+        // the datagram originates from the endpoint's port
+        char buf[16];
+        sockpp::inet_address from;
+        ASSERT_EQ(5, peer.recv_from(buf, sizeof(buf), &from));
+        EXPECT_EQ(endpoint.GetPort(), from.port());
+
+        // so an answer to the source arrives at the endpoint
+        EXPECT_EQ(5, peer.send_to("reply", 5, from));
+    }
+    this_thread::sleep_for(200ms);
+
+    EXPECT_EQ(2, countingHandler.count.load());
+}
+
+TEST(EndpointTest, AttachBoundEndpoint)
+{
+    RtpCountingHandler countingHandler;
+
+    // bound ahead of its session, for any peer of the address family
+    RtpEndpoint endpoint(nullptr, "0.0.0.0"s);
+    ASSERT_NE(0, endpoint.GetPort());
+    EXPECT_TRUE(endpoint.IsV4());
+    EXPECT_FALSE(RtpEndpoint::IsV4("::1"s));
+
+    sockpp::udp_socket peer;
+    ASSERT_TRUE(peer.bind(sockpp::inet_address("127.0.0.1"s, 0)));
+
+    // nobody to hand it to yet
+    const sockpp::inet_address to("127.0.0.1"s, endpoint.GetPort());
+    EXPECT_EQ(5, peer.send_to("early", 5, to));
+    this_thread::sleep_for(200ms);
+
+    endpoint.Attach(&countingHandler, "127.0.0.1"s);
+
+    EXPECT_EQ(5, peer.send_to("hello", 5, to));
+    this_thread::sleep_for(200ms);
+    EXPECT_EQ(1, countingHandler.count.load());
+
+    // sends to the attached peer
+    peer.read_timeout(1s);
+    EXPECT_TRUE(endpoint.SendTo("reply", 5, sockpp::inet_address(peer.address()).port()));
+
+    char buf[16];
+    EXPECT_EQ(5, peer.recv(buf, sizeof(buf)));
+}
+
+TEST(EndpointTest, PacketPoolRecycles)
+{
+    const auto before = GetPacketPoolStats();
+
+    auto packet = GetNewPacketFromPool();
+    ASSERT_TRUE(packet);
+    EXPECT_EQ(static_cast<size_t>(RAOP_PACKET_MAX_SIZE), packet->size());
+
+    const auto taken = GetPacketPoolStats();
+    EXPECT_EQ(before.outstanding + 1, taken.outstanding);
+    EXPECT_EQ(before.hits + before.misses + 1, taken.hits + taken.misses);
+    EXPECT_GE(taken.highWaterMark, taken.outstanding);
+
+    PutPacketToPool(move(packet));
+    EXPECT_FALSE(packet);
+    EXPECT_EQ(before.outstanding, GetPacketPoolStats().outstanding);
+}
+
+TEST(EndpointTest, PacketPoolConcurrentAccess)
+{
+    const auto before = GetPacketPoolStats();
+    const int threads = 4;
+    const int iterations = 10000;
+
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([t]()
+        {
+            vector<unique_ptr<RtpPacket>> packets;
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                auto packet = GetNewPacketFromPool();
+                packet->setSeqNo(static_cast<uint16_t>(t));
+                packets.emplace_back(move(packet));
+
+                if (packets.size() == 8)
+                {
+                    for (auto& p : packets)
+                    {
+                        EXPECT_EQ(static_cast<uint16_t>(t), p->getSeqNo());
+                        PutPacketToPool(move(p));
+                    }
+                    packets.clear();
+                }
+            }
+            for (auto& p : packets)
+            {
+                PutPacketToPool(move(p));
+            }
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    const auto after = GetPacketPoolStats();
+
+    EXPECT_EQ(before.outstanding, after.outstanding);
+    EXPECT_EQ(static_cast<uint64_t>(threads * iterations), (after.hits + after.misses) - (before.hits + before.misses));
+    EXPECT_LE(after.available, static_cast<size_t>(RTP_PACKET_POOL_CAPACITY));
+
+    // the working set of all threads fits into the preallocated packets
+    EXPECT_EQ(before.misses, after.misses);
+}
+
+TEST(EndpointTest, PacketHeader)
+{
+    RtpPacket packet;
+    EXPECT_EQ(static_cast<size_t>(RAOP_PACKET_MAX_SIZE), packet.size());
+
+    memset(packet.data(), 0xff, packet.size());
+    packet.InitHeader(PAYLOAD_TYPE_RESEND_REQUEST, 8);
+
+    EXPECT_EQ(static_cast<size_t>(8), packet.size());
+    EXPECT_EQ(0x80, packet.data()[0]);
+    EXPECT_EQ(PAYLOAD_TYPE_RESEND_REQUEST, packet.getPayloadType());
+    EXPECT_FALSE(packet.getMarker());
+    EXPECT_EQ(0, packet.getSeqNo());
+    EXPECT_EQ(static_cast<uint32_t>(0), packet.getSSRC());
+
+    packet.resize(16, true);
+    EXPECT_EQ(0, packet.data()[12]);
+    EXPECT_EQ(0, packet.data()[15]);
+
+    packet.Init();
+    EXPECT_EQ(RtpPacket::capacity(), packet.size());
+}
@@ -0,0 +1,144 @@
+#define _USE_MATH_DEFINES
+#include <gtest/gtest.h>
+#include "GainStage.h"
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace string_literals;
+
+// a stereo sine of the given amplitude
+static vector<int16_t> Sine(size_t frames, double amplitude)
+{
+    vector<int16_t> samples(frames * 2);
+
+    for (size_t i = 0; i < frames; ++i)
+    {
+        const double v = amplitude * sin(2. * M_PI * 1000. * i / 44100.);
+
+        samples[i * 2] = static_cast<int16_t>(lround(v));
+        samples[i * 2 + 1] = static_cast<int16_t>(lround(-v));
+    }
+    return samples;
+}
+
+TEST(GainStageTest, BitExactAtZeroDb)
+{
+    for (const auto dither : { GainStage::Dither::none, GainStage::Dither::tpdf, GainStage::Dither::shaped })
+    {
+        GainStage gain(dither);
+        const auto in = Sine(352, 32767.);
+        auto out = in;
+
+        gain.Process(out.data(), 352);
+        EXPECT_EQ(in, out);
+
+        // back from an attenuation, the ramp ends at 0 dB
+        gain.SetGain(-10.);
+        gain.Process(out.data(), 352);
+        gain.SetGain(0.);
+        gain.Process(out.data(), 352);
+
+        out = in;
+        gain.Process(out.data(), 352);
+        EXPECT_EQ(in, out);
+    }
+}
+
+TEST(GainStageTest, Attenuation)
+{
+    for (const auto dither : { GainStage::Dither::none, GainStage::Dither::tpdf, GainStage::Dither::shaped })
+    {
+        GainStage gain(dither);
+        gain.SetGain(-6.);
+        gain.Reset();
+        EXPECT_EQ(-6., gain.GetGain());
+
+        // an odd count of frames leaves a tail to the scalar code
+        const auto in = Sine(4099, 30000.);
+        auto out = in;
+        gain.Process(out.data(), 4099);
+
+        const double factor = pow(10., -6. / 20.);
+        double sum = 0.;
+
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            const double error = out[i] - in[i] * factor;
+
+            // rounding and the triangular noise, the feedback of the shaped dither adds one more
+            ASSERT_LE(fabs(error), dither == GainStage::Dither::shaped ? 2.5 : 1.5) << i;
+            sum += error;
+        }
+        // the dither doesn't add an offset
+        EXPECT_LT(fabs(sum / in.size()), 0.1);
+    }
+}
+
+TEST(GainStageTest, RampWithoutStep)
+{
+    GainStage gain(GainStage::Dither::none);
+
+    vector<int16_t> samples(352 * 2, 20000);
+    gain.SetGain(-20.);
+    gain.Process(samples.data(), 352);
+
+    // falls a little from one frame to the next
+    int16_t previous = 20000;
+
+    for (size_t i = 0; i < samples.size(); i += 2)
+    {
+        ASSERT_EQ(samples[i], samples[i + 1]);
+        ASSERT_LE(samples[i], previous);
+        ASSERT_LE(previous - samples[i], 60);
+        previous = samples[i];
+    }
+    EXPECT_EQ(2000, samples.back());
+
+    // the target has been reached
+    fill(samples.begin(), samples.end(), 20000);
+    gain.Process(samples.data(), 352);
+    EXPECT_EQ(vector<int16_t>(352 * 2, 2000), samples);
+}
+
+TEST(GainStageTest, MuteIsSilent)
+{
+    for (const auto dither : { GainStage::Dither::none, GainStage::Dither::tpdf, GainStage::Dither::shaped })
+    {
+        // AirPlay mutes by the lowest volume
+        GainStage gain(dither);
+        gain.SetGain(MIN_DB_VOLUME);
+        gain.Reset();
+
+        auto samples = Sine(352, 32767.);
+        gain.Process(samples.data(), 352);
+        EXPECT_EQ(vector<int16_t>(352 * 2, 0), samples);
+
+        // ramped down from 0 dB, silent from the next buffer on
+        GainStage ramp(dither);
+        samples = Sine(352, 32767.);
+        ramp.Process(samples.data(), 352);
+        ramp.SetGain(MIN_DB_VOLUME);
+        ramp.Process(samples.data(), 352);
+
+        samples = Sine(352, 32767.);
+        ramp.Process(samples.data(), 352);
+        EXPECT_EQ(vector<int16_t>(352 * 2, 0), samples);
+
+        // and audible again
+        ramp.SetGain(-6.);
+        samples = Sine(352, 32767.);
+        ramp.Process(samples.data(), 352);
+        EXPECT_NE(vector<int16_t>(352 * 2, 0), samples);
+    }
+}
+
+TEST(GainStageTest, InvalidGain)
+{
+    GainStage gain;
+
+    EXPECT_THROW(gain.SetGain(0.5), invalid_argument);
+    EXPECT_THROW(gain.SetGain(nan("")), invalid_argument);
+    EXPECT_THROW(GainStage(GainStage::Dither::none, 0), invalid_argument);
+    EXPECT_EQ(0., gain.GetGain());
+}
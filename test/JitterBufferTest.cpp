@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include "JitterBuffer.h"
+
+using namespace std;
+using namespace string_literals;
+
+static unique_ptr<RtpPacket> MakePacket(uint16_t seq)
+{
+    auto packet = GetNewPacketFromPool();
+    packet->InitHeader(PAYLOAD_TYPE_STREAM_DATA, 32);
+    packet->setSeqNo(seq);
+    return packet;
+}
+
+static vector<uint16_t> Drain(JitterBuffer& buffer)
+{
+    vector<uint16_t> result;
+
+    while (!buffer.Empty())
+    {
+        buffer.SkipMissing();
+
+        auto packet = buffer.Pop();
+        EXPECT_TRUE(packet);
+
+        if (packet)
+        {
+            result.push_back(packet->getSeqNo());
+            PutPacketToPool(move(packet));
+        }
+    }
+    return result;
+}
+
+TEST(JitterBufferTest, InvalidCapacity)
+{
+    EXPECT_THROW(JitterBuffer(0), invalid_argument);
+    EXPECT_THROW(JitterBuffer(1000), invalid_argument);
+    EXPECT_THROW(JitterBuffer(0x10000), invalid_argument);
+    EXPECT_NO_THROW(JitterBuffer(1024));
+}
+
+TEST(JitterBufferTest, InOrder)
+{
+    JitterBuffer buffer(64);
+
+    for (uint16_t seq = 100; seq < 110; ++seq)
+    {
+        EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(seq)));
+    }
+    EXPECT_EQ(static_cast<size_t>(10), buffer.Size());
+    EXPECT_EQ(static_cast<size_t>(10), buffer.Span());
+    EXPECT_EQ(100, buffer.GetHeadSeqNo());
+    EXPECT_EQ(110, buffer.GetEndSeqNo());
+
+    const auto seqs = Drain(buffer);
+    ASSERT_EQ(static_cast<size_t>(10), seqs.size());
+
+    for (size_t i = 0; i < seqs.size(); ++i)
+    {
+        EXPECT_EQ(100 + i, seqs[i]);
+    }
+}
+
+TEST(JitterBufferTest, Wraparound)
+{
+    JitterBuffer buffer(64);
+
+    // 65530 ... 65535, 0 ... 9
+    for (uint16_t i = 0; i < 16; ++i)
+    {
+        EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(static_cast<uint16_t>(65530 + i))));
+    }
+    EXPECT_EQ(static_cast<size_t>(16), buffer.Size());
+    EXPECT_EQ(static_cast<size_t>(16), buffer.Span());
+    EXPECT_EQ(65530, buffer.GetHeadSeqNo());
+    EXPECT_EQ(10, buffer.GetEndSeqNo());
+    EXPECT_TRUE(buffer.IsPresent(65535));
+    EXPECT_TRUE(buffer.IsPresent(0));
+
+    const auto seqs = Drain(buffer);
+    ASSERT_EQ(static_cast<size_t>(16), seqs.size());
+
+    for (uint16_t i = 0; i < 16; ++i)
+    {
+        EXPECT_EQ(static_cast<uint16_t>(65530 + i), seqs[i]);
+    }
+}
+
+TEST(JitterBufferTest, WraparoundOutOfOrder)
+{
+    JitterBuffer buffer(64);
+
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(65534)));
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(1)));
+
+    EXPECT_TRUE(buffer.IsMissing(65535));
+    EXPECT_TRUE(buffer.IsMissing(0));
+    EXPECT_FALSE(buffer.IsMissing(1));
+    EXPECT_FALSE(buffer.IsMissing(2));
+    EXPECT_EQ(2, buffer.GetMissingCount(65535));
+
+    // the resent packets fill the gap across the wraparound
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(0)));
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(65535)));
+    EXPECT_EQ(0, buffer.GetMissingCount(65535));
+
+    const auto seqs = Drain(buffer);
+    const vector<uint16_t> expected{ 65534, 65535, 0, 1 };
+    EXPECT_EQ(expected, seqs);
+}
+
+TEST(JitterBufferTest, Duplicates)
+{
+    JitterBuffer buffer(64);
+
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(10)));
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(11)));
+
+    auto duplicate = MakePacket(11);
+    EXPECT_EQ(JitterBuffer::InsertResult::duplicate, buffer.Insert(move(duplicate)));
+
+    // a rejected packet stays with the caller
+    ASSERT_TRUE(duplicate);
+    EXPECT_EQ(11, duplicate->getSeqNo());
+    PutPacketToPool(move(duplicate));
+
+    EXPECT_EQ(static_cast<size_t>(2), buffer.Size());
+}
+
+TEST(JitterBufferTest, LateArrivals)
+{
+    JitterBuffer buffer(64);
+
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(10)));
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(13)));
+
+    // 10 gets played, 11 and 12 are given up
+    auto packet = buffer.Pop();
+    ASSERT_TRUE(packet);
+    EXPECT_EQ(10, packet->getSeqNo());
+    PutPacketToPool(move(packet));
+
+    EXPECT_EQ(2, buffer.SkipMissing());
+    EXPECT_EQ(13, buffer.GetHeadSeqNo());
+
+    auto late = MakePacket(11);
+    EXPECT_EQ(JitterBuffer::InsertResult::late, buffer.Insert(move(late)));
+    ASSERT_TRUE(late);
+    PutPacketToPool(move(late));
+
+    // played packets are late as well, even if the buffer is empty
+    packet = buffer.Pop();
+    ASSERT_TRUE(packet);
+    PutPacketToPool(move(packet));
+    EXPECT_TRUE(buffer.Empty());
+
+    late = MakePacket(13);
+    EXPECT_EQ(JitterBuffer::InsertResult::late, buffer.Insert(move(late)));
+    PutPacketToPool(move(late));
+
+    // a gap ahead of an empty buffer is missing at the head
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(16)));
+    EXPECT_EQ(14, buffer.GetHeadSeqNo());
+    EXPECT_EQ(2, buffer.GetMissingCount(14));
+}
+
+TEST(JitterBufferTest, MissingRuns)
+{
+    JitterBuffer buffer(128);
+
+    for (uint16_t seq : { 65500, 65501, 65510, 65530, 5, 6, 70 })
+    {
+        EXPECT_NE(JitterBuffer::InsertResult::late, buffer.Insert(MakePacket(seq)));
+    }
+    vector<pair<uint16_t, uint16_t>> runs;
+
+    buffer.ForEachMissingRun([&runs](uint16_t seq, uint16_t count)
+    {
+        runs.emplace_back(seq, count);
+    });
+    const vector<pair<uint16_t, uint16_t>> expected{ { 65502, 8 }, { 65511, 19 }, { 65531, 10 }, { 7, 63 } };
+    EXPECT_EQ(expected, runs);
+}
+
+TEST(JitterBufferTest, Resync)
+{
+    JitterBuffer buffer(64);
+
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(100)));
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(101)));
+
+    // too far ahead to wait for the packets in between
+    EXPECT_EQ(JitterBuffer::InsertResult::resynced, buffer.Insert(MakePacket(1000)));
+    EXPECT_EQ(static_cast<size_t>(1), buffer.Size());
+    EXPECT_EQ(1000, buffer.GetHeadSeqNo());
+
+    // a new stream after a reset may start anywhere
+    buffer.Reset();
+    EXPECT_FALSE(buffer.IsStarted());
+    EXPECT_EQ(JitterBuffer::InsertResult::queued, buffer.Insert(MakePacket(5)));
+    EXPECT_EQ(5, buffer.GetHeadSeqNo());
+}
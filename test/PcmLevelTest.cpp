@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "PcmLevel.h"
+#include <cmath>
+
+using namespace std;
+using namespace string_literals;
+
+TEST(PcmLevelTest, Silence)
+{
+    const vector<int16_t> samples(704, 0);
+
+    const auto level = MeasureLevel(samples.data(), samples.size());
+    EXPECT_TRUE(level.silent);
+    EXPECT_EQ(0u, level.peak);
+    EXPECT_EQ(0.f, level.rms);
+    EXPECT_TRUE(isinf(level.GetPeakDb()));
+
+    EXPECT_TRUE(MeasureLevel(nullptr, 0).silent);
+}
+
+TEST(PcmLevelTest, SingleSampleAnywhere)
+{
+    // a single sample is found by the vector and by the scalar part
+    for (const size_t count : { size_t{ 7 }, size_t{ 8 }, size_t{ 703 }, size_t{ 704 } })
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            vector<int16_t> samples(count, 0);
+            samples[i] = -1;
+
+            const auto level = MeasureLevel(samples.data(), count);
+            ASSERT_FALSE(level.silent) << count << ", " << i;
+            ASSERT_EQ(1u, level.peak);
+            ASSERT_FLOAT_EQ(static_cast<float>(sqrt(1. / count)), level.rms);
+        }
+    }
+}
+
+TEST(PcmLevelTest, FullScale)
+{
+    // a square wave of full scale, the tail left to the scalar part
+    vector<int16_t> samples(4099);
+
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = (i & 1) ? INT16_MIN : INT16_MAX;
+    }
+    const auto level = MeasureLevel(samples.data(), samples.size());
+    EXPECT_FALSE(level.silent);
+    EXPECT_EQ(32767u, level.peak);
+    EXPECT_NEAR(32767.5, level.rms, 0.5);
+    EXPECT_NEAR(0., level.GetPeakDb(), 1e-9);
+}
+
+TEST(PcmLevelTest, Sine)
+{
+    vector<int16_t> samples(352 * 2);
+
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[i] = static_cast<int16_t>(lround(10000. * sin(i * 0.1)));
+    }
+    const auto level = MeasureLevel(samples.data(), samples.size());
+    EXPECT_EQ(10000u, level.peak);
+
+    // -3 dB below the peak
+    EXPECT_NEAR(10000. / sqrt(2.), level.rms, 50.);
+    EXPECT_NEAR(level.GetPeakDb() - 3.01, level.GetRmsDb(), 0.05);
+}
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include "PcmRingBuffer.h"
+#include <thread>
+
+using namespace std;
+using namespace string_literals;
+
+TEST(PcmRingBufferTest, WrapAround)
+{
+    SharedPtr<PcmRingBuffer> ring = MakeShared<PcmRingBuffer>(1000);
+    EXPECT_EQ(1024u, ring->GetCapacity());
+
+    uint8_t out[700];
+    uint8_t next = 0;
+    uint8_t expected = 0;
+
+    for (int round = 0; round < 10; ++round)
+    {
+        uint8_t in[700];
+
+        for (auto& b : in)
+        {
+            b = next++;
+        }
+        ULONG n = 0;
+        EXPECT_EQ(S_OK, ring->Write(in, sizeof(in), &n));
+        EXPECT_EQ(sizeof(in), n);
+        EXPECT_EQ(sizeof(in), ring->GetSize());
+
+        EXPECT_EQ(S_OK, ring->Read(out, sizeof(out), &n));
+        ASSERT_EQ(sizeof(out), n);
+
+        for (const auto b : out)
+        {
+            ASSERT_EQ(expected++, b);
+        }
+    }
+    EXPECT_EQ(0u, ring->GetSize());
+    EXPECT_EQ(7000u, ring->GetStats().read);
+}
+
+TEST(PcmRingBufferTest, DropsWhatDoesNotFit)
+{
+    SharedPtr<PcmRingBuffer> ring = MakeShared<PcmRingBuffer>(256);
+
+    const vector<uint8_t> in(200, 1);
+    ULONG n = 0;
+
+    EXPECT_EQ(S_OK, ring->Write(in.data(), 200, &n));
+    EXPECT_EQ(S_FALSE, ring->Write(in.data(), 200, &n));
+    EXPECT_EQ(56u, n);
+    EXPECT_EQ(256u, ring->GetSize());
+    EXPECT_EQ(144u, ring->GetStats().dropped);
+}
+
+TEST(PcmRingBufferTest, CloseEndsStream)
+{
+    SharedPtr<PcmRingBuffer> ring = MakeShared<PcmRingBuffer>(256);
+
+    const uint8_t in[10] = { 0 };
+    ring->Write(in, sizeof(in), nullptr);
+
+    thread reader([ring]()
+    {
+        uint8_t out[64];
+        ULONG n = 0;
+
+        // the rest of the data, then the end of the stream
+        EXPECT_EQ(S_OK, ring->Read(out, sizeof(out), &n));
+        EXPECT_EQ(10u, n);
+        EXPECT_EQ(STG_E_NOMOREFILES, ring->Read(out, sizeof(out), &n));
+        EXPECT_EQ(0u, n);
+    });
+    this_thread::sleep_for(20ms);
+    ring->Close();
+    reader.join();
+
+    EXPECT_EQ(STG_E_WRITEFAULT, ring->Write(in, sizeof(in), nullptr));
+    EXPECT_TRUE(ring->IsClosed());
+}
+
+TEST(PcmRingBufferTest, ReadWatermark)
+{
+    SharedPtr<PcmRingBuffer> ring = MakeShared<PcmRingBuffer>(4096);
+    ring->SetReadWatermark(1000);
+
+    atomic<ULONG> read{ 0 };
+
+    thread reader([ring, &read]()
+    {
+        uint8_t out[4096];
+        ULONG n = 0;
+
+        ring->Read(out, sizeof(out), &n);
+        read = n;
+    });
+    const vector<uint8_t> in(400, 0);
+
+    ring->Write(in.data(), 400, nullptr);
+    ring->Write(in.data(), 400, nullptr);
+    this_thread::sleep_for(20ms);
+    EXPECT_EQ(0u, read.load());
+
+    // the watermark is reached
+    ring->Write(in.data(), 400, nullptr);
+    reader.join();
+    EXPECT_EQ(1200u, read.load());
+    EXPECT_EQ(1u, ring->GetStats().waits);
+}
+
+TEST(PcmRingBufferTest, WaitForSize)
+{
+    SharedPtr<PcmRingBuffer> ring = MakeShared<PcmRingBuffer>(4096);
+
+    const vector<uint8_t> in(3000, 0);
+    ring->Write(in.data(), 3000, nullptr);
+
+    EXPECT_FALSE(ring->WaitForSize(1000, 10ms));
+
+    thread reader([ring]()
+    {
+        uint8_t out[500];
+
+        for (int i = 0; i < 6; ++i)
+        {
+            this_thread::sleep_for(2ms);
+            ring->Read(out, sizeof(out), nullptr);
+        }
+    });
+    EXPECT_TRUE(ring->WaitForSize(1000, 2000ms));
+    EXPECT_LE(ring->GetSize(), 1000u);
+    EXPECT_TRUE(ring->WaitForSize(0, 2000ms));
+    reader.join();
+}
+
+TEST(PcmRingBufferTest, ConcurrentTransfer)
+{
+    SharedPtr<PcmRingBuffer> ring = MakeShared<PcmRingBuffer>(8192);
+
+    const size_t total = 16 * 1024 * 1024;
+    bool ordered = true;
+
+    thread reader([ring, &ordered]()
+    {
+        vector<uint8_t> out(4096);
+        uint8_t expected = 0;
+        ULONG n = 0;
+
+        while (ring->Read(out.data(), static_cast<ULONG>(out.size()), &n) == S_OK)
+        {
+            for (ULONG i = 0; i < n; ++i)
+            {
+                ordered = ordered && out[i] == expected++;
+            }
+        }
+    });
+    vector<uint8_t> in(1408);
+    uint8_t next = 0;
+
+    for (size_t written = 0; written < total; written += in.size())
+    {
+        for (auto& b : in)
+        {
+            b = next++;
+        }
+        // the writer never blocks, it waits for room itself
+        ring->WaitForSize(ring->GetCapacity() - in.size(), 1000ms);
+
+        ULONG n = 0;
+        ASSERT_EQ(S_OK, ring->Write(in.data(), static_cast<ULONG>(in.size()), &n));
+    }
+    ring->Close();
+    reader.join();
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(0u, ring->GetStats().dropped);
+    EXPECT_EQ(ring->GetStats().written, ring->GetStats().read);
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "PlayoutClock.h"
+
+using namespace std;
+using namespace string_literals;
+
+// NTP units of a duration
+static uint64_t Ntp(chrono::nanoseconds d)
+{
+    if (d.count() < 0)
+    {
+        return 0 - Ntp(-d);
+    }
+    const uint64_t ns = static_cast<uint64_t>(d.count());
+    return ((ns / 1000000000) << 32) + ((ns % 1000000000) << 32) / 1000000000;
+}
+
+// the sender's clock runs the given offset ahead of ours
+static bool Exchange(PlayoutClock& clock, uint64_t local, uint64_t offset, chrono::nanoseconds forward, chrono::nanoseconds backward)
+{
+    const uint64_t received = local + offset + Ntp(forward);
+    const uint64_t send     = received + Ntp(100us);
+    const uint64_t arrival  = send - offset + Ntp(backward);
+
+    return clock.OnTimingResponse(local, received, send, arrival);
+}
+
+static int64_t DiffUs(uint64_t a, uint64_t b)
+{
+    return (static_cast<int64_t>(a - b) * 1000000) >> 32;
+}
+
+TEST(PlayoutClockTest, NtpConversion)
+{
+    const auto now = PlayoutClock::clock::now();
+    const auto back = PlayoutClock::FromNtp(PlayoutClock::ToNtp(now));
+
+    EXPECT_LE(chrono::abs(chrono::duration_cast<chrono::nanoseconds>(now - back)).count(), 1);
+    EXPECT_EQ(uint64_t{ 3 } << 32 | 0x80000000, PlayoutClock::ToNtp(PlayoutClock::clock::time_point(3500ms)));
+}
+
+TEST(PlayoutClockTest, Offset)
+{
+    PlayoutClock clock(44100);
+    EXPECT_FALSE(clock.GetOffset());
+
+    // the sender's clock is in the NTP era, ours starts at boot
+    const uint64_t local  = PlayoutClock::NowNtp();
+    const uint64_t offset = (uint64_t{ 0xE5000000 } << 32) - local + Ntp(12345us);
+
+    EXPECT_TRUE(Exchange(clock, local, offset, 1ms, 1ms));
+    ASSERT_TRUE(clock.GetOffset());
+    EXPECT_EQ(0, DiffUs(*clock.GetOffset(), offset));
+
+    const auto stats = clock.GetStats();
+    EXPECT_EQ(1u, stats.timingSamples);
+    EXPECT_NEAR(2000, chrono::duration_cast<chrono::microseconds>(stats.rtt).count(), 1);
+}
+
+TEST(PlayoutClockTest, FilterPrefersLowestRoundTrip)
+{
+    PlayoutClock clock(44100);
+
+    const uint64_t local  = PlayoutClock::NowNtp();
+    const uint64_t offset = Ntp(-5s);
+
+    // queueing delays in one direction distort the offset by half of them
+    EXPECT_TRUE(Exchange(clock, local, offset, 40ms, 1ms));
+    EXPECT_NEAR(19500, DiffUs(*clock.GetOffset(), offset), 1);
+
+    EXPECT_TRUE(Exchange(clock, local + Ntp(1s), offset, 2ms, 2ms));
+    EXPECT_TRUE(Exchange(clock, local + Ntp(2s), offset, 1ms, 30ms));
+    EXPECT_NEAR(0, DiffUs(*clock.GetOffset(), offset), 1);
+
+    // inconsistent samples are dropped
+    EXPECT_FALSE(clock.OnTimingResponse(local, local + offset, local + offset + Ntp(10ms), local + Ntp(1ms)));
+    EXPECT_FALSE(Exchange(clock, local, offset, 2s, 2s));
+    EXPECT_EQ(3u, clock.GetStats().timingSamples);
+}
+
+TEST(PlayoutClockTest, PlayoutTime)
+{
+    PlayoutClock clock(44100);
+
+    const auto now = PlayoutClock::clock::now();
+    const uint64_t local  = PlayoutClock::ToNtp(now);
+    const uint64_t offset = Ntp(1000s);
+
+    clock.OnSync(1000, local + offset + Ntp(500ms), 1000 + 88200);
+    EXPECT_FALSE(clock.IsSynchronized());
+    EXPECT_FALSE(clock.GetPlayoutTime(1000));
+
+    EXPECT_TRUE(Exchange(clock, local, offset, 1ms, 1ms));
+    EXPECT_TRUE(clock.IsSynchronized());
+    EXPECT_EQ(88200u, clock.GetStats().latency);
+
+    const auto anchor = clock.GetPlayoutTime(1000);
+    ASSERT_TRUE(anchor);
+    EXPECT_NEAR(500000, chrono::duration_cast<chrono::microseconds>(*anchor - now).count(), 2);
+
+    // a second later and earlier
+    EXPECT_NEAR(1000000, chrono::duration_cast<chrono::microseconds>(*clock.GetPlayoutTime(1000 + 44100) - *anchor).count(), 2);
+    EXPECT_NEAR(-10000, chrono::duration_cast<chrono::microseconds>(*clock.GetPlayoutTime(1000 - 441) - *anchor).count(), 2);
+
+    clock.ResetSync();
+    EXPECT_FALSE(clock.IsSynchronized());
+}
+
+TEST(PlayoutClockTest, RtpWraparound)
+{
+    PlayoutClock clock(44100);
+
+    const auto now = PlayoutClock::clock::now();
+    const uint64_t local = PlayoutClock::ToNtp(now);
+
+    EXPECT_TRUE(Exchange(clock, local, 0, 1ms, 1ms));
+    clock.OnSync(0xFFFFFF00, local, 0xFFFFFF00);
+
+    const auto before = clock.GetPlayoutTime(0xFFFFFF00);
+    const auto after  = clock.GetPlayoutTime(0x00000100);
+    ASSERT_TRUE(before && after);
+
+    EXPECT_NEAR(512 * 1000000 / 44100, chrono::duration_cast<chrono::microseconds>(*after - *before).count(), 2);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "Resampler.h"
+#include <cmath>
+#include <random>
+
+using namespace std;
+using namespace string_literals;
+
+static vector<int16_t> Resample(Resampler& resampler, const vector<int16_t>& in, size_t framesPerCall)
+{
+    vector<int16_t> out;
+
+    for (size_t i = 0; i < in.size(); i += framesPerCall * NUM_CHANNELS)
+    {
+        const size_t frames = min(framesPerCall, (in.size() - i) / NUM_CHANNELS);
+        resampler.Process(in.data() + i, frames, out);
+    }
+    return out;
+}
+
+TEST(ResamplerTest, UnityRatioIsTransparent)
+{
+    mt19937 random(42);
+    uniform_int_distribution<int> sample(INT16_MIN, INT16_MAX);
+
+    vector<int16_t> in(10000 * NUM_CHANNELS);
+
+    for (auto& s : in)
+    {
+        s = static_cast<int16_t>(sample(random));
+    }
+    Resampler resampler;
+    const auto out = Resample(resampler, in, 352);
+
+    // the frames held back are missing at the end only
+    ASSERT_EQ((10000 - Resampler::GetDelay()) * NUM_CHANNELS, out.size());
+    EXPECT_TRUE(equal(out.begin(), out.end(), in.begin()));
+}
+
+TEST(ResamplerTest, ChangesRate)
+{
+    const double ratio = 1.0002;
+    const double w = 2. * acos(-1.) * 1000. / 44100.;
+    const size_t frames = 5 * 44100;
+
+    vector<int16_t> in(frames * NUM_CHANNELS);
+
+    for (size_t i = 0; i < frames; ++i)
+    {
+        in[i * 2] = in[i * 2 + 1] = static_cast<int16_t>(lrint(16000. * sin(w * i)));
+    }
+    Resampler resampler;
+    resampler.SetRatio(ratio);
+    EXPECT_EQ(ratio, resampler.GetRatio());
+
+    const auto out = Resample(resampler, in, 352);
+    const size_t produced = out.size() / NUM_CHANNELS;
+
+    EXPECT_NEAR((frames - Resampler::GetDelay()) * ratio, static_cast<double>(produced), 2.);
+
+    // the output is the same sine, just sampled more often
+    double signal = 0.;
+    double noise = 0.;
+
+    for (size_t j = RESAMPLER_TAPS; j < produced; ++j)
+    {
+        const double expected = 16000. * sin(w * j / ratio);
+
+        signal += expected * expected;
+        noise += (out[j * 2] - expected) * (out[j * 2] - expected);
+        ASSERT_EQ(out[j * 2], out[j * 2 + 1]);
+    }
+    EXPECT_GT(10. * log10(signal / noise), 80.);
+}
+
+TEST(ResamplerTest, Reset)
+{
+    const vector<int16_t> in(1000 * NUM_CHANNELS, 1000);
+
+    Resampler resampler;
+    resampler.SetRatio(0.9999);
+
+    vector<int16_t> out;
+    EXPECT_GT(resampler.Process(in.data(), 1000, out), 0u);
+
+    // the held back frames are dropped
+    resampler.Reset();
+    out.clear();
+    EXPECT_EQ(0u, resampler.Process(in.data(), Resampler::GetDelay(), out));
+    EXPECT_TRUE(out.empty());
+
+    EXPECT_THROW(resampler.SetRatio(0.5), invalid_argument);
+    EXPECT_THROW(Resampler(0), invalid_argument);
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include "ResendScheduler.h"
+
+using namespace std;
+using namespace string_literals;
+
+// records the requests sent by a scheduler
+class RequestRecorder
+{
+public:
+    ResendScheduler::SendRequest GetSender()
+    {
+        return [this](uint16_t seq, uint16_t count)
+        {
+            lock_guard<mutex> guard(m_mtx);
+            m_requests.emplace_back(seq, count);
+            return true;
+        };
+    }
+
+    vector<pair<uint16_t, uint16_t>> Get() const
+    {
+        lock_guard<mutex> guard(m_mtx);
+        return m_requests;
+    }
+
+    bool WaitFor(size_t count, chrono::milliseconds timeout = 2000ms) const
+    {
+        const auto until = chrono::steady_clock::now() + timeout;
+
+        while (Get().size() < count)
+        {
+            if (chrono::steady_clock::now() > until)
+            {
+                return false;
+            }
+            this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+private:
+    mutable mutex                       m_mtx;
+    vector<pair<uint16_t, uint16_t>>    m_requests;
+};
+
+static ResendScheduler::clock::time_point InSeconds(int s)
+{
+    return ResendScheduler::clock::now() + chrono::seconds(s);
+}
+
+TEST(ResendSchedulerTest, CoalescesAdjacentGaps)
+{
+    RequestRecorder recorder;
+    ResendScheduler scheduler(recorder.GetSender());
+
+    // adjacent gaps across the wraparound and a separate one
+    EXPECT_EQ(static_cast<size_t>(2), scheduler.Request(65534, 2, InSeconds(5)));
+    EXPECT_EQ(static_cast<size_t>(3), scheduler.Request(0, 3, InSeconds(5)));
+    EXPECT_EQ(static_cast<size_t>(1), scheduler.Request(10, 1, InSeconds(5)));
+
+    // already pending
+    EXPECT_EQ(static_cast<size_t>(0), scheduler.Request(1, 2, InSeconds(5)));
+
+    ASSERT_TRUE(recorder.WaitFor(2));
+    this_thread::sleep_for(20ms);
+
+    const auto requests = recorder.Get();
+    ASSERT_EQ(static_cast<size_t>(2), requests.size());
+    EXPECT_EQ(make_pair(uint16_t(65534), uint16_t(5)), requests[0]);
+    EXPECT_EQ(make_pair(uint16_t(10), uint16_t(1)), requests[1]);
+
+    const auto stats = scheduler.GetStats();
+    EXPECT_EQ(6u, stats.requested);
+    EXPECT_EQ(2u, stats.sent);
+    EXPECT_EQ(0u, stats.retried);
+}
+
+TEST(ResendSchedulerTest, RecoveryCancelsRequest)
+{
+    RequestRecorder recorder;
+    ResendScheduler scheduler(recorder.GetSender());
+
+    scheduler.Request(100, 2, InSeconds(5));
+    ASSERT_TRUE(recorder.WaitFor(1));
+
+    EXPECT_TRUE(scheduler.IsPending(100));
+    EXPECT_TRUE(scheduler.OnArrival(100, true));
+    EXPECT_TRUE(scheduler.OnArrival(101, false));
+    EXPECT_FALSE(scheduler.IsPending(100));
+    EXPECT_FALSE(scheduler.OnArrival(100, true));
+    EXPECT_EQ(static_cast<size_t>(0), scheduler.GetPendingCount());
+
+    // the answer to the first request is a round trip sample
+    EXPECT_GT(scheduler.GetRoundTripTime().count(), 0);
+
+    // nothing is sent again
+    this_thread::sleep_for(chrono::milliseconds(RESEND_INITIAL_RTO_MS * 2));
+    EXPECT_EQ(static_cast<size_t>(1), recorder.Get().size());
+
+    scheduler.OnTooLate(100);
+
+    const auto stats = scheduler.GetStats();
+    EXPECT_EQ(2u, stats.recovered);
+    EXPECT_EQ(1u, stats.tooLate);
+    EXPECT_EQ(0u, stats.abandoned);
+}
+
+TEST(ResendSchedulerTest, RetriesWithBackoff)
+{
+    RequestRecorder recorder;
+    ResendScheduler scheduler(recorder.GetSender(), 3);
+
+    scheduler.Request(7, 1, InSeconds(10));
+
+    // the initial request and two retries
+    ASSERT_TRUE(recorder.WaitFor(3, chrono::milliseconds(RESEND_INITIAL_RTO_MS * 8)));
+
+    // the last attempt times out
+    const auto until = chrono::steady_clock::now() + chrono::milliseconds(RESEND_MAX_RTO_MS * 2);
+
+    while (scheduler.IsPending(7) && chrono::steady_clock::now() < until)
+    {
+        this_thread::sleep_for(5ms);
+    }
+    EXPECT_FALSE(scheduler.IsPending(7));
+    EXPECT_EQ(static_cast<size_t>(3), recorder.Get().size());
+
+    const auto stats = scheduler.GetStats();
+    EXPECT_EQ(3u, stats.sent);
+    EXPECT_EQ(2u, stats.retried);
+    EXPECT_EQ(1u, stats.abandoned);
+    EXPECT_EQ(0u, stats.recovered);
+}
+
+TEST(ResendSchedulerTest, DeadlineExpires)
+{
+    RequestRecorder recorder;
+    ResendScheduler scheduler(recorder.GetSender());
+
+    scheduler.Request(300, 4, ResendScheduler::clock::now() + 30ms);
+    this_thread::sleep_for(100ms);
+
+    EXPECT_EQ(static_cast<size_t>(0), scheduler.GetPendingCount());
+    EXPECT_EQ(static_cast<size_t>(1), recorder.Get().size());
+    EXPECT_EQ(4u, scheduler.GetStats().abandoned);
+
+    // the player skipped the sequences meanwhile
+    scheduler.Request(400, 4, InSeconds(5));
+    scheduler.Cancel(400, 2);
+    EXPECT_FALSE(scheduler.IsPending(401));
+    EXPECT_TRUE(scheduler.IsPending(402));
+    EXPECT_EQ(6u, scheduler.GetStats().abandoned);
+
+    scheduler.Clear();
+    EXPECT_EQ(static_cast<size_t>(0), scheduler.GetPendingCount());
+    EXPECT_EQ(6u, scheduler.GetStats().abandoned);
+}
+
+TEST(ResendSchedulerTest, RateLimit)
+{
+    RequestRecorder recorder;
+    ResendScheduler scheduler(recorder.GetSender(), RESEND_MAX_ATTEMPTS, 10);
+
+    // separate gaps can't be coalesced
+    for (uint16_t seq = 0; seq < 4 * RESEND_BURST; seq += 2)
+    {
+        scheduler.Request(seq, 1, InSeconds(10));
+    }
+    this_thread::sleep_for(50ms);
+
+    // the burst is sent at once, the rest is delayed
+    EXPECT_EQ(static_cast<size_t>(RESEND_BURST), recorder.Get().size());
+    EXPECT_TRUE(recorder.WaitFor(RESEND_BURST + 1, 1000ms));
+}
+
+TEST(ResendSchedulerTest, StopIgnoresRequests)
+{
+    RequestRecorder recorder;
+    ResendScheduler scheduler(recorder.GetSender());
+
+    scheduler.Stop();
+    EXPECT_EQ(static_cast<size_t>(0), scheduler.Request(1, 1, InSeconds(5)));
+    this_thread::sleep_for(20ms);
+    EXPECT_TRUE(recorder.Get().empty());
+}
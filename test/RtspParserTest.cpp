@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include "RtspParser.h"
+#include <random>
+#include <map>
+#include <vector>
+
+using namespace std;
+using namespace string_literals;
+
+static const string announce =
+    "v=0\r\n"
+    "o=iTunes 3413821438 0 IN IP4 fe80::217:f2ff:fe0f:e0f6\r\n"
+    "s=iTunes\r\n"
+    "c=IN IP4 fe80::5a55:caff:fe1a:e187\r\n"
+    "t=0 0\r\n"
+    "i=Kitchen iPhone\r\n"
+    "m=audio 0 RTP/AVP 96\r\n"
+    "a=rtpmap:96 AppleLossless\r\n"
+    "a=fmtp:96 352 0 16 40 10 14 2 255 0 0 44100\r\n"
+    "a=rsaaeskey:5QYIqmdZGTONY5SHjEJrqAhaa0W9wzDC5i6q221mdGZJ5ubO6Kg==\r\n"
+    "a=aesiv:zcZmAZtqh7uGcEwPXk0QeA==\r\n"
+    "a=recvonly\r\n";
+
+// the positions of the views in the text, so a fuzzed input can be checked for views out of it
+static bool IsWithin(string_view view, const string& text)
+{
+    return view.empty() || (view.data() >= text.data() && view.data() + view.size() <= text.data() + text.size());
+}
+
+TEST(RtspParserTest, Attributes)
+{
+    map<string, string> attributes;
+
+    string_view sdp(announce);
+    string_view key;
+    string_view value;
+
+    while (RtspParser::NextAttribute(sdp, key, value))
+    {
+        attributes[string(key)] = string(value);
+    }
+    ASSERT_EQ(4u, attributes.size());
+    EXPECT_EQ("96 AppleLossless"s, attributes["rtpmap"s]);
+    EXPECT_EQ("96 352 0 16 40 10 14 2 255 0 0 44100"s, attributes["fmtp"s]);
+    EXPECT_EQ("5QYIqmdZGTONY5SHjEJrqAhaa0W9wzDC5i6q221mdGZJ5ubO6Kg=="s, attributes["rsaaeskey"s]);
+    EXPECT_EQ("zcZmAZtqh7uGcEwPXk0QeA=="s, attributes["aesiv"s]);
+
+    EXPECT_EQ("Kitchen iPhone"s, RtspParser::FindLine(announce, 'i').value_or(""));
+    EXPECT_EQ("iTunes"s, RtspParser::FindLine(announce, 's').value_or(""));
+    EXPECT_FALSE(RtspParser::FindLine(announce, 'u'));
+
+    // base64 which ends with "i=" isn't a line of its own
+    EXPECT_FALSE(RtspParser::FindLine("a=aesiv:zcZmAZtqh7uGcEwPXk0Qi=\n"s, 'i'));
+}
+
+TEST(RtspParserTest, Parameters)
+{
+    const string body = "volume: -11.123456\r\nprogress: 1146221540/1146549156/1195701740\r\nno colon\r\n: no key\nbad key: 1\rlast:2";
+
+    vector<pair<string, string>> parameters;
+
+    string_view text(body);
+    string_view key;
+    string_view value;
+
+    while (RtspParser::NextParameter(text, key, value))
+    {
+        parameters.emplace_back(key, value);
+    }
+    ASSERT_EQ(3u, parameters.size());
+    EXPECT_EQ(make_pair("volume"s, "-11.123456"s), parameters[0]);
+    EXPECT_EQ(make_pair("progress"s, "1146221540/1146549156/1195701740"s), parameters[1]);
+    EXPECT_EQ(make_pair("last"s, "2"s), parameters[2]);
+
+    EXPECT_DOUBLE_EQ(-11.123456, RtspParser::ToDouble(parameters[0].second).value_or(0.));
+    EXPECT_DOUBLE_EQ(-144., RtspParser::ToDouble("-144.000000").value_or(0.));
+    EXPECT_FALSE(RtspParser::ToDouble("-20 dB"));
+    EXPECT_FALSE(RtspParser::ToDouble(""));
+
+    string_view progress(parameters[1].second);
+    uint64_t number = 0;
+
+    ASSERT_TRUE(RtspParser::NextNumber(progress, number));
+    EXPECT_EQ(1146221540u, number);
+    ASSERT_TRUE(RtspParser::NextNumber(progress, number));
+    EXPECT_EQ(1146549156u, number);
+    ASSERT_TRUE(RtspParser::NextNumber(progress, number));
+    EXPECT_EQ(1195701740u, number);
+    EXPECT_FALSE(RtspParser::NextNumber(progress, number));
+
+    // a number which doesn't fit is skipped
+    string_view large("99999999999999999999999/7");
+    ASSERT_TRUE(RtspParser::NextNumber(large, number));
+    EXPECT_EQ(7u, number);
+
+    EXPECT_TRUE(RtspParser::EqualsNoCase("Volume", "volume"));
+    EXPECT_FALSE(RtspParser::EqualsNoCase("volumes", "volume"));
+}
+
+TEST(RtspParserTest, TransportAndTokens)
+{
+    const string transport = "RTP/AVP/UDP;unicast;interleaved=0-1;mode=record;control_port=6001;timing_port= 6002 ";
+
+    EXPECT_EQ(6001, RtspParser::FindNumber(transport, "control_port").value_or(0));
+    EXPECT_EQ(6002, RtspParser::FindNumber(transport, "timing_port").value_or(0));
+    EXPECT_FALSE(RtspParser::FindNumber(transport, "port"));
+    EXPECT_FALSE(RtspParser::FindNumber(transport, "interleaved"));
+    EXPECT_FALSE(RtspParser::FindNumber("control_port=", "control_port"));
+
+    vector<int> fmtp;
+    string_view items("96 352 0 16\t40 10 14 2 255 0 0 44100\r\n");
+    string_view item;
+
+    while (RtspParser::NextToken(items, item))
+    {
+        fmtp.push_back(RtspParser::ToInt(item).value_or(-1));
+    }
+    EXPECT_EQ((vector<int>{ 96, 352, 0, 16, 40, 10, 14, 2, 255, 0, 0, 44100 }), fmtp);
+
+    EXPECT_FALSE(RtspParser::ToInt("12a"));
+    EXPECT_FALSE(RtspParser::ToInt("99999999999"));
+}
+
+TEST(RtspParserTest, QuotedPairs)
+{
+    const string auth = "username=\"iTunes\", realm=\"raop\", nonce = \"0f2a\",uri=\"*\", broken=, response=\"8c6b\" stale=\"";
+
+    vector<pair<string, string>> pairs;
+
+    string_view text(auth);
+    string_view key;
+    string_view value;
+
+    while (RtspParser::NextQuotedPair(text, key, value))
+    {
+        pairs.emplace_back(key, value);
+    }
+    const vector<pair<string, string>> expected = { { "username", "iTunes" }, { "realm", "raop" },
+        { "nonce", "0f2a" }, { "uri", "*" }, { "response", "8c6b" } };
+
+    EXPECT_EQ(expected, pairs);
+}
+
+// random bytes and mutated requests: no view may point out of the text, and each loop has to end
+TEST(RtspParserTest, Fuzz)
+{
+    mt19937 random(24);
+    uniform_int_distribution<int> byte(0, 255);
+
+    // characters the parsers look for, so they turn up often
+    const string special = "a=i:;\"\r\n \t,0123456789";
+    uniform_int_distribution<size_t> pick(0, special.size() - 1);
+
+    const string seeds[] = { announce, "volume: -20.5\r\nprogress: 1/2/3\r\n"s,
+        "control_port=6001;timing_port=6002"s, "username=\"a\", response=\"b\""s };
+
+    for (int round = 0; round < 20000; ++round)
+    {
+        string text;
+
+        if (round % 2)
+        {
+            text = seeds[round % size(seeds)];
+
+            for (int i = 0; i < 4 && !text.empty(); ++i)
+            {
+                text[uniform_int_distribution<size_t>(0, text.size() - 1)(random)] = special[pick(random)];
+            }
+            text.resize(uniform_int_distribution<size_t>(0, text.size())(random));
+        }
+        else
+        {
+            text.resize(uniform_int_distribution<size_t>(0, 200)(random));
+
+            for (auto& c : text)
+            {
+                c = (byte(random) & 1) ? special[pick(random)] : static_cast<char>(byte(random));
+            }
+        }
+        string_view key;
+        string_view value;
+        string_view view;
+        uint64_t number;
+
+        for (string_view rest(text); RtspParser::NextAttribute(rest, key, value);)
+        {
+            ASSERT_TRUE(IsWithin(key, text) && IsWithin(value, text) && !key.empty());
+        }
+        for (string_view rest(text); RtspParser::NextParameter(rest, key, value);)
+        {
+            ASSERT_TRUE(IsWithin(key, text) && IsWithin(value, text) && !key.empty());
+        }
+        for (string_view rest(text); RtspParser::NextQuotedPair(rest, key, value);)
+        {
+            ASSERT_TRUE(IsWithin(key, text) && IsWithin(value, text) && !key.empty());
+        }
+        for (string_view rest(text); RtspParser::NextToken(rest, view);)
+        {
+            ASSERT_TRUE(IsWithin(view, text) && !view.empty());
+            RtspParser::ToInt(view);
+            RtspParser::ToDouble(view);
+        }
+        for (string_view rest(text); RtspParser::NextNumber(rest, number);)
+        {
+        }
+        if (const auto line = RtspParser::FindLine(text, 'i'))
+        {
+            ASSERT_TRUE(IsWithin(*line, text));
+        }
+        RtspParser::FindNumber(text, "control_port");
+    }
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "SpscQueue.h"
+#include <memory>
+#include <thread>
+
+using namespace std;
+using namespace string_literals;
+using namespace literals;
+
+TEST(SpscQueueTest, FirstInFirstOut)
+{
+    SpscQueue<unique_ptr<int>> queue(3);
+    EXPECT_EQ(4u, queue.GetCapacity());
+
+    for (int i = 0; i < 4; ++i)
+    {
+        auto value = make_unique<int>(i);
+        ASSERT_TRUE(queue.TryPush(value));
+        EXPECT_FALSE(value);
+    }
+    // a full queue leaves the value to the caller
+    auto value = make_unique<int>(4);
+    EXPECT_FALSE(queue.TryPush(value));
+    ASSERT_TRUE(value);
+    EXPECT_EQ(4u, queue.Size());
+
+    for (int i = 0; i < 4; ++i)
+    {
+        unique_ptr<int> popped;
+        ASSERT_TRUE(queue.TryPop(popped));
+        EXPECT_EQ(i, *popped);
+    }
+    unique_ptr<int> popped;
+    EXPECT_FALSE(queue.TryPop(popped));
+    EXPECT_EQ(0u, queue.Size());
+}
+
+TEST(SpscQueueTest, CloseHandsOverTheRest)
+{
+    SpscQueue<int> queue(4);
+
+    EXPECT_TRUE(queue.Push(1));
+    EXPECT_TRUE(queue.Push(2));
+    queue.Close();
+
+    int value = 0;
+    EXPECT_FALSE(queue.Push(3));
+
+    ASSERT_TRUE(queue.Pop(value));
+    EXPECT_EQ(1, value);
+    ASSERT_TRUE(queue.Pop(value));
+    EXPECT_EQ(2, value);
+    EXPECT_FALSE(queue.Pop(value));
+}
+
+TEST(SpscQueueTest, CloseWakesUpBothSides)
+{
+    SpscQueue<int> empty(4);
+
+    thread consumer([&]()
+    {
+        int value = 0;
+        EXPECT_FALSE(empty.Pop(value));
+    });
+    this_thread::sleep_for(50ms);
+    empty.Close();
+    consumer.join();
+
+    SpscQueue<int> full(1);
+    ASSERT_TRUE(full.Push(1));
+
+    thread producer([&]()
+    {
+        EXPECT_FALSE(full.Push(2));
+    });
+    this_thread::sleep_for(50ms);
+    full.Close();
+    producer.join();
+}
+
+TEST(SpscQueueTest, ProducerAndConsumer)
+{
+    // a small queue, so both sides wait for each other often
+    SpscQueue<unique_ptr<uint32_t>> queue(8);
+    const uint32_t count = 200000;
+
+    thread producer([&]()
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ASSERT_TRUE(queue.Push(make_unique<uint32_t>(i)));
+        }
+        queue.Close();
+    });
+    uint32_t expected = 0;
+    unique_ptr<uint32_t> value;
+
+    while (queue.Pop(value))
+    {
+        ASSERT_EQ(expected, *value);
+        ++expected;
+    }
+    producer.join();
+
+    EXPECT_EQ(count, expected);
+}